@@ -236,9 +236,9 @@ enum fpta_bits {
    * специальный тип реверсивных индексов. При этом ограничение сохраняется,
    * но ключи обрабатываются и сравниваются с конца.
    *
-   * Ограничение можно немного "подвинуть" за счет производительности,
-   * но нельзя убрать полностью. Также будет рассмотрен вариант перехода
-   * на 128-битный хэш. */
+   * Ограничение можно "подвинуть" для отдельных индексов за счет
+   * производительности, см. fpta_describe_index_keylen(), но нельзя убрать
+   * полностью. Также будет рассмотрен вариант перехода на 128-битный хэш. */
   fpta_max_keylen = 64 * 1 - 8,
 
   /* Размер буфера достаточный для размещения любого ключа во внутреннем
@@ -246,6 +246,22 @@ enum fpta_bits {
    * fpta_get_column2buffer() для формирование fpta_value составной колонки. */
   fpta_keybuf_len = fpta_max_keylen + 8 + sizeof(void *) + sizeof(size_t),
 
+  /* Размер буфера, предоставляемого функции вычисления ключа индекса
+   * по выражению для размещения строк и бинарных данных результата,
+   * см. fpta_key_function. */
+  fpta_key_function_buffer = 256,
+
+  /* Допустимое и используемое по-умолчанию количество бит на ключ для
+   * фильтров Блума уникальных вторичных индексов, определяющее вероятность
+   * ложных срабатываний, см. fpta_describe_index_bloom(). */
+  fpta_bloom_bits_min = 4,
+  fpta_bloom_bits_default = 10,
+  fpta_bloom_bits_max = 32,
+
+  /* Размер памяти достаточный для размещения курсора, открываемого
+   * посредством fpta_cursor_open_external(). */
+  fpta_cursor_storage_size = 384,
+
   /* Минимальная длина имени/идентификатора */
   fpta_name_len_min = 1,
   /* Максимальная длина имени/идентификатора */
@@ -364,6 +380,7 @@ enum fpta_error {
   FPTA_ENOENT = 1168 /* ERROR_NOT_FOUND */,
   FPTA_EPERM = 1 /* ERROR_INVALID_FUNCTION */,
   FPTA_EBUSY = 170 /* ERROR_BUSY */,
+  FPTA_ETIMEDOUT = 1460 /* ERROR_TIMEOUT */,
   FPTA_ENAME = 123 /* ERROR_INVALID_NAME */,
   FPTA_EFLAG = 186 /* ERROR_INVALID_FLAG_NUMBER */,
 #else
@@ -381,6 +398,7 @@ enum fpta_error {
   FPTA_ENOENT = ENOENT /* No such file or directory (POSIX) */,
   FPTA_EPERM = EPERM /* Operation not permitted (POSIX) */,
   FPTA_EBUSY = EBUSY /* Device or resource busy (POSIX) */,
+  FPTA_ETIMEDOUT = ETIMEDOUT /* Connection timed out (POSIX) */,
 #ifdef EKEYREJECTED
   FPTA_ENAME = EKEYREJECTED,
 #else
@@ -1079,6 +1097,11 @@ typedef struct fpta_db_stat {
   fpta_regime_flags regime_flags; /* актуальный режим работы с учетом всех
                                      работающих с БД проецссов */
   bool alterable_schema /* возможность изменять схему БД в текущем процессе */;
+  uint64_t dbi_cache_overflows /* кол-во случаев переполнения кэша хендлов
+                                  таблиц и индексов в текущем процессе, при
+                                  переполнении хендлы используются без
+                                  кэширования, что снижает производительность */
+      ;
 } fpta_db_stat_t;
 
 /* Возвращает информацию о БД, включая геометрию.
@@ -1132,6 +1155,44 @@ static inline int fpta_db_open_existing(const char *path,
                                 alterable_schema, db, nullptr);
 }
 
+/* Функция вычисления ключа индекса по выражению.
+ *
+ * Вычисляет по строке row значение "виртуальной" колонки, которое
+ * не хранится в кортеже, а используется только для формирования ключей
+ * индексов. Результат помещается в value и должен соответствовать типу
+ * колонки по тем же правилам, что и в fpta_upsert_column(). Значение
+ * типа fpta_null означает отсутствие значения, что допустимо только для
+ * nullable колонок. Строки и бинарные данные результата могут ссылаться
+ * на данные внутри row, либо на предоставленный buffer размером
+ * fpta_key_function_buffer байт.
+ *
+ * Функция должна быть детерминированной, т.е. для одной строки всегда
+ * возвращать одно значение, иначе индекс будет испорчен. Вызовы могут
+ * производиться одновременно из нескольких потоков.
+ *
+ * В случае успеха функция должна вернуть ноль, иначе код ошибки, который
+ * будет возвращен из операции изменения или чтения данных. */
+typedef int (*fpta_key_function)(fptu_ro row, fpta_value *value, void *buffer,
+                                 void *context);
+
+/* Регистрирует функцию вычисления ключа индекса по выражению.
+ *
+ * Функция связывается с именем name, на которое ссылаются колонки-выражения
+ * в схемах таблиц, см. fpta_describe_expression_column(). Регистрацию
+ * следует производить сразу после открытия БД, до запуска транзакций,
+ * так как при отсутствии зарегистрированной функции операции с таблицами,
+ * содержащими ссылающиеся на неё колонки, будут завершаться с ошибкой
+ * FPTA_ENOIMP. Аргумент context передается функции при каждом вызове.
+ *
+ * Повторная регистрация под тем же именем не допускается и приводит
+ * к ошибке FPTA_EEXIST. Кол-во регистрируемых функций ограничено
+ * несколькими десятками, при исчерпании возвращается FPTA_TOOMANY.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_db_register_key_function(fpta_db *db, const char *name,
+                                           fpta_key_function function,
+                                           void *context);
+
 /* Закрывает ранее открытую базу.
  *
  * На момент закрытия базы должны быть закрыты все ранее открытые
@@ -1368,6 +1429,85 @@ FPTA_API int fpta_transaction_restart(fpta_txn *txn);
 FPTA_API int fpta_transaction_versions(fpta_txn *txn, uint64_t *db_version,
                                        uint64_t *schema_version);
 
+/* Групповая фиксация изменений (aka group commit).
+ *
+ * В каждый момент времени может существовать только одна пишущая транзакция,
+ * поэтому множество потоков выполняющих небольшие изменения в отдельных
+ * транзакциях выстраиваются в очередь, а каждый из них оплачивает полную
+ * стоимость фиксации. Функция fpta_transaction_submit() позволяет объединить
+ * такие изменения:
+ *  - запрос (функтор writer с аргументом arg) ставится в очередь, а текущий
+ *    поток ожидает его выполнения;
+ *  - один из ожидающих потоков становится "лидером", забирает из очереди все
+ *    накопившиеся запросы и выполняет их в одной пишущей транзакции уровня
+ *    fpta_write, после чего фиксирует её и пробуждает остальных;
+ *  - ошибка в одном из запросов не влияет на остальные, т.е. для каждого
+ *    запроса обеспечивается семантика "точки сохранения".
+ *
+ * Функтор получает транзакцию, которую НЕ должен завершать, и должен вернуть
+ * FPTA_SUCCESS для сохранения сделанных изменений. Любое другое значение
+ * означает отказ, при этом все изменения сделанные функтором будут отменены,
+ * а возвращенное значение будет результатом fpta_transaction_submit().
+ *
+ * ВАЖНО: Функтор вызывается в контексте потока-лидера, а также может быть
+ * вызван повторно (если в той же пачке какой-либо другой запрос завершился
+ * ошибкой). Поэтому функтор не должен иметь побочных эффектов помимо
+ * изменений в рамках переданной транзакции. Вызывающий поток не должен иметь
+ * незавершенных транзакций в той-же БД.
+ *
+ * Возвращает FPTA_SUCCESS если изменения запроса успешно зафиксированы,
+ * результат функтора при его отказе, либо иной код ошибки. */
+FPTA_API int fpta_transaction_submit(fpta_db *db,
+                                     int (*writer)(fpta_txn *txn, void *arg),
+                                     void *arg);
+
+/* Асинхронная фиксация и отслеживание durability.
+ *
+ * В режимах fpta_lazy и fpta_weak фиксация транзакции не формирует сильную
+ * точку фиксации, т.е. изменения могут быть потеряны при аварии. Следующие
+ * функции позволяют узнать, когда изменения конкретной транзакции стали
+ * "долговечными", без принудительного сброса на диск после каждой из них:
+ *
+ *  - fpta_transaction_commit_async() фиксирует пишущую транзакцию
+ *    и возвращает её номер (txnid), соответствующий версии данных
+ *    из fpta_transaction_versions();
+ *
+ *  - fpta_db_flusher_start() запускает фоновый поток, который формирует
+ *    сильные точки фиксации по достижению порогов: объема несброшенных
+ *    изменений sync_bytes и/или времени с последней сильной точки period_ms
+ *    (см. mdbx_env_set_syncbytes() и mdbx_env_set_syncperiod());
+ *
+ *  - fpta_durable_txnid() возвращает номер последней транзакции, изменения
+ *    которой гарантированно сохранены;
+ *
+ *  - fpta_durable_wait() ожидает сохранения изменений транзакции txnid,
+ *    но не более timeout_ms миллисекунд (ноль означает только проверку).
+ *    По истечении времени возвращает FPTA_ETIMEDOUT. Без запущенного
+ *    фонового потока выполняет сброс на диск самостоятельно;
+ *
+ *  - fpta_durable_notify() регистрирует функтор, который будет вызван
+ *    после сохранения изменений транзакции txnid, либо при ошибке сброса
+ *    на диск (с ненулевым err). Функтор вызывается в контексте фонового
+ *    потока, либо непосредственно внутри fpta_durable_notify(), если
+ *    изменения уже сохранены или фоновый поток не запущен.
+ *
+ * Фоновый поток останавливается fpta_db_flusher_stop() или при закрытии БД,
+ * при этом все ожидающие уведомления будут выполнены.
+ *
+ * В случае успеха функции возвращают ноль, иначе код ошибки. */
+FPTA_API int fpta_transaction_commit_async(fpta_txn *txn,
+                                           uint64_t *committed_txnid);
+FPTA_API int fpta_db_flusher_start(fpta_db *db, size_t sync_bytes,
+                                   unsigned period_ms);
+FPTA_API int fpta_db_flusher_stop(fpta_db *db);
+FPTA_API int fpta_durable_txnid(fpta_db *db, uint64_t *durable_txnid);
+FPTA_API int fpta_durable_wait(fpta_db *db, uint64_t txnid,
+                               unsigned timeout_ms);
+FPTA_API int fpta_durable_notify(fpta_db *db, uint64_t txnid,
+                                 void (*callback)(fpta_db *db, uint64_t txnid,
+                                                  int err, void *arg),
+                                 void *arg);
+
 //----------------------------------------------------------------------------
 /* Управление схемой:
  *  - Под управлением схемой в libfpta подразумевается её изменение,
@@ -1693,6 +1833,209 @@ FPTA_API int fpta_describe_composite_index_va(const char *composite_name,
                                               const char *second,
                                               const char *third, ...);
 
+/* Вспомогательная функция для создания покрывающих индексов.
+ *
+ * Делает индекс по колонке index_column_name покрывающим, т.е. вместе
+ * со значением первичного ключа во вторичном индексе будут храниться
+ * копии значений колонок, имена которых определяются вектором посредством
+ * аргументов column_names_array и column_names_count.
+ *
+ * Покрывающим может быть только уникальный вторичный индекс, в том числе
+ * составной. Индексируемая и покрываемые колонки уже должны быть добавлены
+ * в column_set, при этом покрываемые колонки не могут быть составными или
+ * массивами.
+ *
+ * Курсор открытый по покрывающему индексу вычисляет фильтр без чтения
+ * строк из основной таблицы, если все задействованные в фильтре колонки
+ * входят в число покрываемых, а fpta_cursor_get_covered() позволяет
+ * получить копии значений без обращения к строке. Платой за это является
+ * увеличение объема индекса и стоимости обновления строк, так как запись
+ * в индексе обновляется при любом изменении строки.
+ *
+ * Таблица с покрывающими индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_covering_index(
+    const char *index_column_name, fpta_column_set *column_set,
+    const char *const column_names_array[], size_t column_names_count);
+
+/* Вспомогательная функция для создания частичных индексов.
+ *
+ * Привязывает к вторичному индексу по колонке index_column_name предикат,
+ * так что в индекс попадают только удовлетворяющие ему строки. Предикат
+ * задается деревом узлов fpta_filter, которое копируется в схему таблицы.
+ * Допускаются только узлы fpta_node_not, fpta_node_and, fpta_node_or и
+ * сравнения колонок с константами, при этом в узлах сравнения достаточно
+ * инициализировать идентификатор колонки посредством fpta_column_init().
+ * Функторы (fpta_node_fncol и fpta_node_fnrow) не могут быть сохранены
+ * в схеме и поэтому не допускаются.
+ *
+ * Частичным может быть любой вторичный индекс, в том числе уникальный,
+ * составной или покрывающий. Для уникального индекса ограничение
+ * уникальности проверяется только для попадающих в индекс строк.
+ *
+ * Частичный индекс пригоден только для курсоров, из фильтра которых
+ * следует предикат индекса, иначе fpta_cursor_open() вернет FPTA_NO_INDEX.
+ * Проверка выполняется консервативно: каждое сравнение предиката должно
+ * следовать из сравнения с той же колонкой в фильтре, причем с константой
+ * того же типа. Аналогично FPTA_NO_INDEX возвращают fpta_get(),
+ * fpta_get_many() и fpta_delete_by_key() для частичного индекса.
+ * Обновление через курсор по частичному индексу, при котором строка
+ * перестает удовлетворять предикату, отвергается с FPTA_KEY_MISMATCH.
+ *
+ * Таблица с частичными индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+struct fpta_filter;
+FPTA_API int fpta_describe_partial_index(const char *index_column_name,
+                                         fpta_column_set *column_set,
+                                         const struct fpta_filter *predicate);
+
+/* Вспомогательная функция для создания индексов по выражениям.
+ *
+ * Делает колонку column_name вычисляемой: её значение не хранится
+ * в строках, а при формировании ключей вычисляется по строке функцией,
+ * зарегистрированной под именем function_name посредством
+ * fpta_db_register_key_function(). В схеме сохраняется только имя
+ * функции, поэтому её регистрация обязательна при каждом открытии БД.
+ *
+ * Колонка уже должна быть добавлена в column_set с типом результата
+ * функции и может быть вторичным индексом, либо не индексироваться
+ * и использоваться только в составе составных индексов. Первичный
+ * индекс и составные колонки не могут быть вычисляемыми.
+ *
+ * Значения вычисляемой колонки в строках игнорируются, а фильтры курсоров
+ * и предикаты частичных индексов считают их отсутствующими. Поиск и выборка
+ * по такому индексу производится обычным образом, по значению результата
+ * функции, например fpta_cursor_open() с диапазоном или fpta_get().
+ *
+ * Таблица с индексами по выражениям не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_expression_column(const char *column_name,
+                                             fpta_column_set *column_set,
+                                             const char *function_name);
+
+/* Вспомогательная функция для индексов с увеличенной длиной ключа.
+ *
+ * Задает для упорядоченного индекса index_column_name максимальную длину
+ * ключа max_keylen, превышающую fpta_max_keylen. Ключи такого индекса
+ * не подрезаются и не дополняются хэшем, а хранятся целиком, поэтому
+ * порядок сортировки сохраняется точно и для длинных значений (например,
+ * URL или путей), а выборки по диапазону не требуют дополнительной
+ * фильтрации. Платой является больший объем индекса и более дорогое
+ * сравнение ключей, из-за чего B-дерево становится выше.
+ *
+ * Допускается только для не-nullable упорядоченных индексов (первичного
+ * или вторичного) по колонкам типа fptu_cstr и fptu_opaque, которые
+ * не являются составными или вычисляемыми. Значения длиннее max_keylen
+ * не могут быть помещены в такой индекс, для них, а также при поиске
+ * по ним, возвращается ошибка FPTA_DATALEN_MISMATCH.
+ *
+ * При создании таблицы max_keylen проверяется относительно допустимого
+ * для БД размера ключа, который зависит от размера страницы и режима
+ * индекса (см. mdbx_env_get_maxkeysize_ex()). Для первичного индекса
+ * также учитывается допустимый размер значений во вторичных индексах
+ * с дубликатами, где хранятся ключи PK. При превышении fpta_table_create()
+ * вернет FPTA_DATALEN_MISMATCH.
+ *
+ * Таблица с такими индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_index_keylen(const char *index_column_name,
+                                        fpta_column_set *column_set,
+                                        size_t max_keylen);
+
+/* Вспомогательная функция для индексов с фильтром Блума.
+ *
+ * Задает для уникального вторичного индекса index_column_name фильтр
+ * Блума, который хранится в отдельной mdbx-таблице и обновляется в той же
+ * транзакции, что и сам индекс. Фильтр проверяется перед поиском в индексе
+ * при контроле уникальности вставляемых и обновляемых строк, а также в
+ * fpta_get(), поэтому отсутствующие значения в большинстве случаев
+ * отсекаются без спуска по B-дереву индекса. Копия фильтра удерживается
+ * в памяти процесса и сверяется с хранимой по счетчику изменений.
+ *
+ * Аргументом bits_per_key задается количество бит фильтра на один ключ
+ * в диапазоне от fpta_bloom_bits_min до fpta_bloom_bits_max, либо ноль
+ * для fpta_bloom_bits_default. Этим определяется вероятность ложных
+ * срабатываний, при которых поиск в индексе всё же выполняется: примерно
+ * 2% для 8 бит, 1% для 10 бит и 0.1% для 16 бит на ключ. Фильтр
+ * увеличивается (перестраивается по индексу) по мере роста количества
+ * ключей, а удаленные ключи вычищаются из него только при перестроении.
+ *
+ * Таблица с такими индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_index_bloom(const char *index_column_name,
+                                       fpta_column_set *column_set,
+                                       unsigned bits_per_key);
+
+/* Вспомогательная функция для битовых индексов.
+ *
+ * Задает для неуникального вторичного индекса index_column_name хранение
+ * в виде сжатых битовых множеств (roaring bitmap) номеров строк для каждого
+ * из значений колонки, вместо пар значение-PK в mdbx-таблице с дубликатами.
+ * Такие индексы предназначены для колонок с небольшим количеством различных
+ * значений (коды состояний, флаги и т.п.).
+ *
+ * Номером строки служит ключ первичного индекса, поэтому он должен быть
+ * уникальным и иметь ключи фиксированного размера (не составной, с типом от
+ * fptu_uint16 до fptu_datetime включительно). Индексируемая колонка также
+ * должна иметь один из этих типов, а сам индекс не может быть покрывающим,
+ * частичным или индексом колонки-выражения. Битовый индекс задается только
+ * при создании таблицы и не может быть добавлен посредством
+ * fpta_index_add().
+ *
+ * Курсоры по битовому индексу не поддерживаются (FPTA_NO_INDEX), вместо
+ * этого фильтры курсоров читающих транзакций предварительно вычисляются
+ * по битовым индексам таблицы: условия на колонки с такими индексами,
+ * объединенные "И", "ИЛИ" и "НЕ", сводятся к операциям над множествами,
+ * после чего строки вне результата пропускаются без чтения и проверки,
+ * а при полностью вычисленном фильтре проверка не выполняется вовсе.
+ *
+ * Таблица с такими индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_index_bitmap(const char *index_column_name,
+                                        fpta_column_set *column_set);
+
+/* Вспомогательная функция для многозначных индексов.
+ *
+ * Задает для неуникального вторичного индекса index_column_name режим,
+ * в котором колонка может содержать в строке несколько значений, а в индекс
+ * помещается отдельная пара значение-PK для каждого из них. Значения
+ * хранятся в строке как несколько полей колонки (коллекция fptu)
+ * и добавляются посредством fpta_insert_column(). Курсор по такому индексу
+ * с диапазоном из одного значения выбирает строки, содержащие это
+ * значение, а строка с несколькими попавшими в диапазон значениями
+ * выбирается соответствующее количество раз. Строка без значений
+ * индексируется как NULL (либо отвергается для не-nullable колонки).
+ *
+ * При изменении строки обновляются только пары для добавленных и удаленных
+ * значений. Остальные функции, включая fpta_get_column(), условия фильтров
+ * и fpta_upsert_column(), работают с первым значением колонки, а изменение
+ * строки через курсор по многозначному индексу допускается только если
+ * новая версия строки содержит текущее значение курсора.
+ *
+ * Индекс не может быть составным, покрывающим, частичным, битовым,
+ * индексом колонки-выражения или иметь увеличенный лимит длины ключа.
+ * Многозначный индекс задается только при создании таблицы и не может быть
+ * добавлен посредством fpta_index_add().
+ *
+ * Таблица с такими индексами не может быть открыта предыдущими
+ * версиями библиотеки.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_describe_index_multivalued(const char *index_column_name,
+                                             fpta_column_set *column_set);
+
 /* Инициализирует column_set перед заполнением посредством
  * fpta_column_describe(). */
 FPTA_API void fpta_column_set_init(fpta_column_set *column_set);
@@ -1738,6 +2081,127 @@ FPTA_API int fpta_table_create(fpta_txn *txn, const char *table_name,
  * В случае успеха возвращает ноль, иначе код ошибки. */
 FPTA_API int fpta_table_drop(fpta_txn *txn, const char *table_name);
 
+/* Добавление вторичного индекса для существующей колонки таблицы.
+ *
+ * Аргумент column_name задает имя не-индексируемой колонки, а index_type
+ * требуемый вид вторичного индекса (включая признак nullable), с теми же
+ * ограничениями что и при создании таблицы посредством fpta_column_describe().
+ *
+ * Новый индекс строится за один упорядоченный проход по первичному индексу,
+ * при этом пары ключ-значение упорядочиваются посредством внешней сортировки
+ * (см. fpta_loader_begin) и добавляются в конец индекса в режиме
+ * MDBX_APPEND. Если строки таблицы не удовлетворяют ограничениям индекса,
+ * например содержат повторяющиеся значения для уникального индекса, то
+ * возвращается соответствующая ошибка и транзакция отменяется.
+ *
+ * Номера колонок при этом не меняются, поэтому строки таблицы и другие
+ * индексы не перезаписываются. Однако индекс строится целиком внутри
+ * транзакции уровня fpta_schema, которая удерживает эксклюзивную блокировку
+ * схемы, т.е. на всё время построения блокирует как пишущие, так и читающие
+ * транзакции других потоков. Для больших таблиц следует использовать
+ * fpta_index_add_online().
+ *
+ * Индексы таблицы могут быть изменены только один раз за транзакцию, причем
+ * не в той транзакции, в которой таблица была создана. Иначе возвращается
+ * FPTA_EBUSY, а транзакция остается в прежнем состоянии.
+ *
+ * Требуется транзакция уровня fpta_schema. Изменения становятся
+ * видимыми из других транзакций и процессов только после успешной
+ * фиксации транзакции.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_index_add(fpta_txn *txn, const char *table_name,
+                            const char *column_name,
+                            fpta_index_type index_type);
+
+/* Удаление вторичного индекса колонки таблицы.
+ *
+ * Колонка с именем column_name сохраняется как не-индексируемая
+ * (с тем же признаком nullable), а связанная с индексом таблица
+ * удаляется вместе с описаниями покрываемых колонок, предиката
+ * частичного индекса и лимита длины ключей. Составные колонки не могут быть
+ * удалены посредством этой функции.
+ *
+ * Номера колонок не меняются, поэтому строки таблицы не перезаписываются.
+ * Посредством этой функции также может быть удален индекс, заполнение
+ * которого функцией fpta_index_add_online() было прервано.
+ *
+ * Требуется транзакция уровня fpta_schema. Изменения становятся
+ * видимыми из других транзакций и процессов только после успешной
+ * фиксации транзакции.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_index_drop(fpta_txn *txn, const char *table_name,
+                             const char *column_name);
+
+/* Добавление вторичного индекса без длительной блокировки схемы.
+ *
+ * Аргументы table_name, column_name и index_type аналогичны
+ * fpta_index_add(), но функция самостоятельно выполняет серию транзакций:
+ *  - короткую транзакцию уровня fpta_schema, объявляющую в схеме пустой
+ *    индекс, который поддерживается всеми последующими изменениями строк,
+ *    но пока не может использоваться для выборок (курсоры и поиск по нему
+ *    возвращают FPTA_NO_INDEX);
+ *  - транзакции уровня fpta_write, каждая из которых заполняет индекс
+ *    для очередных chunk_rows строк в порядке первичного ключа (при нуле
+ *    используется значение по-умолчанию). Эти транзакции не препятствуют
+ *    работе читателей и чередуются с транзакциями других писателей;
+ *  - короткую транзакцию уровня fpta_schema, после которой индекс
+ *    становится доступным для выборок.
+ *
+ * Если строки таблицы не удовлетворяют ограничениям индекса, либо его
+ * заполнение прервано ошибкой, то индекс удаляется и возвращается
+ * соответствующая ошибка. Если же заполнение было прервано сбоем, то
+ * повторный вызов с теми же аргументами заполнит индекс заново.
+ *
+ * Функция не должна вызываться внутри транзакции текущего потока.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_index_add_online(fpta_db *db, const char *table_name,
+                                   const char *column_name,
+                                   fpta_index_type index_type,
+                                   size_t chunk_rows);
+
+/* Добавление колонки в существующую таблицу.
+ *
+ * Добавляется не-индексируемая nullable колонка с именем column_name
+ * и типом data_type. Колонка размещается в конце списка колонок, поэтому
+ * номера остальных колонок не изменяются, а ранее записанные строки
+ * остаются корректными и не перезаписываются: отсутствующее в них поле
+ * новой колонки соответствует значению NULL. Таким образом изменяется
+ * только описание таблицы в схеме, независимо от кол-ва строк.
+ *
+ * Имя колонки должно быть уникальным в пределах таблицы, в том числе
+ * среди ранее удаленных посредством fpta_column_drop() колонок.
+ *
+ * Требуется транзакция уровня fpta_schema. Изменения становятся
+ * видимыми из других транзакций и процессов только после успешной
+ * фиксации транзакции.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_column_add(fpta_txn *txn, const char *table_name,
+                             const char *column_name, fptu_type data_type);
+
+/* Удаление колонки из существующей таблицы.
+ *
+ * Удалена может быть только не-индексируемая nullable колонка, которая
+ * не входит в составные колонки, а также не используется покрывающими
+ * и частичными индексами, иначе возвращается FPTA_EFLAG или FPTA_EBUSY.
+ *
+ * Колонка лишь помечается в схеме как удаленная и перестает быть доступной
+ * посредством fpta_name, но её номер и имя остаются занятыми. Поля колонки
+ * в ранее записанных строках удаляются при последующем обновлении строк
+ * посредством fpta_put(), fpta_probe_and_put() и fpta_cursor_update().
+ * Поэтому, как и при добавлении, изменяется только описание таблицы.
+ *
+ * Требуется транзакция уровня fpta_schema. Изменения становятся
+ * видимыми из других транзакций и процессов только после успешной
+ * фиксации транзакции.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_column_drop(fpta_txn *txn, const char *table_name,
+                              const char *column_name);
+
 //----------------------------------------------------------------------------
 /* Отслеживание версий схемы,
  * Идентификаторы таблиц/колонок и их кэширование:
@@ -2020,6 +2484,23 @@ typedef struct fpta_table_stat {
                            равноценно удалению с последующим добавлением. */
       ;
 
+  size_t bloom_bytes /* Суммарный размер фильтров Блума индексов таблицы,
+                        см. fpta_describe_index_bloom(). */
+      ;
+  uint64_t bloom_lookups /* Количество проверок по фильтрам Блума индексов
+                            таблицы, выполненных в текущем процессе. */
+      ;
+  uint64_t bloom_negatives /* Количество проверок, в которых фильтры Блума
+                              исключили поиск в индексе. */
+      ;
+  uint64_t bloom_false_positives /* Количество ложных срабатываний фильтров
+                                    Блума, когда последующий поиск в индексе
+                                    не нашел ключа. */
+      ;
+  size_t bitmap_bytes /* Суммарный размер битовых индексов таблицы,
+                         см. fpta_describe_index_bitmap(). */
+      ;
+
   unsigned index_costs_total /* Всего элементов index_costs, которые могут быть
                                 сформированы для таблицы. */
       ;
@@ -2393,6 +2874,17 @@ typedef enum fpta_cursor_options
      fpta_zeroed_range_is_point никак не влияет. */
   fpta_zeroed_range_is_point = 8,
 
+  /* Дополнительный флаг для пакетного извлечения строк по вторичному
+     индексу посредством fpta_cursor_fetch_batch(). Значения PK собираются
+     окнами, упорядочиваются и строки читаются одним курсором основной
+     таблицы в порядке PK, что заменяет произвольные обращения к ней
+     последовательными. Фильтр проверяется по уже прочитанным строкам.
+     Строки возвращаются в порядке индекса, а для курсоров без сортировки
+     (fpta_unsorted) в порядке PK в пределах каждого окна. На построчное
+     перемещение курсора и курсоры по первичному индексу флажок
+     не влияет. */
+  fpta_batched_lookup = 16,
+
   fpta_unsorted_dont_fetch = fpta_unsorted | fpta_dont_fetch,
   fpta_ascending_dont_fetch = fpta_ascending | fpta_dont_fetch,
   fpta_descending_dont_fetch = fpta_descending | fpta_dont_fetch,
@@ -2466,6 +2958,31 @@ FPTA_API int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id,
                               fpta_cursor **cursor);
 FPTA_API int fpta_cursor_close(fpta_cursor *cursor);
 
+/* Память для размещения курсора вне кучи, например на стеке.
+ * Содержимое непрозрачно и не должно изменяться до закрытия курсора. */
+typedef union fpta_cursor_storage {
+  uint64_t __align;
+  char __bytes[fpta_cursor_storage_size];
+} fpta_cursor_storage;
+
+/* Открывает курсор аналогично fpta_cursor_open(), но размещает его
+ * в предоставленной вызывающим кодом памяти storage, без выделения
+ * памяти в куче и без обращения к пулу курсоров.
+ *
+ * Такой курсор также должен быть закрыт посредством fpta_cursor_close()
+ * до завершения транзакции, а память storage должна оставаться доступной
+ * до закрытия курсора. После закрытия память может быть использована
+ * повторно, в том числе для открытия следующего курсора.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_cursor_open_external(fpta_txn *txn, fpta_name *column_id,
+                                       fpta_value range_from,
+                                       fpta_value range_to,
+                                       fpta_filter *filter,
+                                       fpta_cursor_options options,
+                                       fpta_cursor_storage *storage,
+                                       fpta_cursor **cursor);
+
 /* Структура для оценки размера выборки посредством функции fpta_estimate(). */
 typedef struct fpta_estimate_item {
   fpta_name *column_id /* Определяет "опорную" колонку/индекс, для которой будет
@@ -2595,6 +3112,16 @@ typedef struct fpta_cursor_stat {
                       * вставляемых или обновляемых значений. Стоимость одной
                       * операции амортизационно cost_uniq_MOlogN по таблице. */
       ;
+  size_t uniq_filtered /* Количество индексов, проверка уникальности в которых
+                        * выполнена только по фильтру Блума, без поиска в
+                        * самом индексе. */
+      ;
+  size_t bitmap_filtered /* Количество строк, отброшенных по битовым индексам
+                          * без чтения и проверки фильтром курсора. */
+      ;
+  size_t key_filtered /* Количество строк, отброшенных по значениям ключа
+                       * вторичного индекса и PK, без чтения строки. */
+      ;
   size_t upserts /* Количество вставок и/или обновлений строк-записей.
                   * Стоимость одной операции амортизационно от одного до
                   * удвоенного значения cost_alter_MOlogN для всей таблицы.
@@ -2681,6 +3208,47 @@ int fpta_apply_visitor(
     size_t *count, int (*visitor)(const fptu_ro *row, void *context, void *arg),
     void *visitor_context, void *visitor_arg);
 
+/* Параллельный вариант fpta_apply_visitor() для агрегации по большим выборкам.
+ *
+ * Диапазон выборки, задаваемый параметрами txn, column_id, range_from,
+ * range_to, filter и op аналогично fpta_apply_visitor(), разбивается по
+ * оценкам mdbx_estimate_range() на не более чем partitions поддиапазонов
+ * примерно равного размера. Строки каждого поддиапазона передаются функтору
+ * visitor вместе с контекстом partition_contexts[i] соответствующей части,
+ * при этом части обрабатываются одновременно несколькими потоками.
+ *
+ * Все потоки видят один и тот же снимок данных, что и транзакция txn.
+ * Вспомогательный поток, читающая транзакция которого оказалась на другой
+ * версии БД (т.е. другом db_version), не обрабатывает частей, и они будут
+ * обработаны вызывающим потоком в рамках txn. Для пишущей транзакции все
+ * части обрабатываются вызывающим потоком.
+ *
+ * Функтор visitor может вызываться одновременно из разных потоков, но для
+ * каждой части всегда последовательно и с её контекстом, а параметр arg
+ * передается "как есть" и должен использоваться только для чтения. После
+ * завершения обработки всех частей, вызывающий поток передает контексты
+ * частей функтору combiner вместе с параметрами result и arg в порядке
+ * следования частей в выборке (с учетом fpta_descending). Функтор combiner
+ * вызывается только для задействованных частей, количество которых может
+ * оказаться меньше partitions, например для небольших выборок, неупорядоченных
+ * индексов или при выборке по одному значению ключа.
+ *
+ * Параметр partitions должен быть в диапазоне от 1 до 1024, а массив
+ * partition_contexts должен содержать partitions элементов. Ненулевые
+ * значения visitor или combiner прерывают обработку и возвращаются
+ * в качестве результата. В опциональный count сохраняется общее количество
+ * строк, переданных функтору visitor.
+ *
+ * В случае успеха возвращается FPTA_SUCCESS, в том числе для пустой
+ * выборки. Иначе код ошибки, либо результат прервавшего обработку функтора. */
+FPTA_API int fpta_apply_visitor_parallel(
+    fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
+    fpta_value range_to, fpta_filter *filter, fpta_cursor_options op,
+    unsigned partitions, void **partition_contexts, size_t *count,
+    int (*visitor)(const fptu_ro *row, void *context, void *arg),
+    int (*combiner)(void *result, void *context, void *arg), void *result,
+    void *arg);
+
 /* Проверяет наличие за курсором данных.
  *
  * Отсутствие данных означает, что нет возможности их прочитать, изменить
@@ -2740,6 +3308,17 @@ FPTA_API int fpta_cursor_dups(fpta_cursor *cursor, size_t *dups);
  * В случае успеха возвращает ноль, иначе код ошибки. */
 FPTA_API int fpta_cursor_get(fpta_cursor *cursor, fptu_ro *tuple);
 
+/* Возвращает кортеж с копиями покрываемых колонок строки, на которой стоит
+ * курсор, без чтения самой строки из основной таблицы. В кортеже будут
+ * только покрываемые колонки, см. fpta_describe_covering_index().
+ *
+ * Если курсор открыт не по покрывающему индексу, то возвращает строку
+ * целиком, аналогично fpta_cursor_get().
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_cursor_get_covered(fpta_cursor *cursor,
+                                     fptu_ro *projection);
+
 /* Варианты перемещения курсора. */
 typedef enum fpta_seek_operations {
   /* Перемещение по диапазону строк за курсором. */
@@ -2771,6 +3350,28 @@ typedef enum fpta_seek_operations {
  * В случае успеха возвращает ноль, иначе код ошибки. */
 FPTA_API int fpta_cursor_move(fpta_cursor *cursor, fpta_seek_operations op);
 
+/* Перемещение курсора вперед (в порядке курсора) на n строк, аналогично
+ * n-кратному вызову fpta_cursor_move(cursor, fpta_next).
+ *
+ * При exact = true перемещение выполняется точно. Для неуникальных индексов
+ * при отсутствии фильтра группы дубликатов, целиком попадающие в пропуск,
+ * пропускаются одним переходом по количеству дубликатов, иначе строки
+ * перебираются последовательно.
+ *
+ * При exact = false выполняется приблизительное перемещение: бинарным
+ * поиском подбирается ключ, количество записей индекса до которого по
+ * оценке mdbx_estimate_range() не меньше n, и курсор переходит к первой
+ * подходящей под фильтр строке начиная с этого ключа. Стоимость такого
+ * перемещения логарифмически зависит от размера таблицы, но фактически
+ * пропущенное количество строк может отличаться от n, в том числе за счет
+ * строк отброшенных фильтром. Если подобрать ключ не удается (например,
+ * все пропускаемые строки имеют одинаковое значение ключа), то выполняется
+ * точное перемещение.
+ *
+ * В случае успеха возвращает ноль, при достижении конца данных FPTA_NODATA,
+ * иначе код ошибки. */
+FPTA_API int fpta_cursor_skip(fpta_cursor *cursor, size_t n, bool exact);
+
 /* Перемещение курсора к заданному ключу или к строке с аналогичным
  * значением ключевой колонки.
  *
@@ -2819,6 +3420,37 @@ FPTA_API int fpta_cursor_locate(fpta_cursor *cursor, bool exactly,
  * В случае успеха возвращает ноль, иначе код ошибки. */
 FPTA_API int fpta_cursor_key(fpta_cursor *cursor, fpta_value *key);
 
+/* Пакетно извлекает строки начиная с текущей позиции курсора.
+ *
+ * Заполняет до max элементов массива rows строками в порядке курсора,
+ * с учетом диапазона и фильтра, заданных при открытии курсора, а также
+ * при не-нулевом keys соответствующими значениями ключа, аналогично
+ * fpta_cursor_key(). Количество извлеченных строк возвращается через got.
+ * Результат равнозначен последовательности вызовов fpta_cursor_get()
+ * и fpta_cursor_move(fpta_next), но без проверки курсора и повторного
+ * входа в API для каждой строки.
+ *
+ * Строки и значения ключей не копируются, а указывают на данные в БД,
+ * поэтому остаются действительными до завершения транзакции, а в пишущей
+ * транзакции - до изменения данных.
+ *
+ * После возврата курсор стоит на строке, следующей за последней
+ * извлеченной, либо в конце выборки. Поэтому повторные вызовы извлекают
+ * следующие строки, а по исчерпании выборки возвращается FPTA_NODATA
+ * и got = 0.
+ *
+ * Для курсоров без фильтра по неуникальным вторичным индексам с PK
+ * фиксированного размера, кроме курсоров с сортировкой по-убыванию,
+ * дубликаты ключа извлекаются из индекса целыми страницами. Для курсоров
+ * по вторичным индексам, открытым с флажком fpta_batched_lookup, строки
+ * читаются окнами в порядке PK, см. описание флажка.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. При ошибке через got
+ * возвращается количество строк, извлеченных до её возникновения. */
+FPTA_API int fpta_cursor_fetch_batch(fpta_cursor *cursor, fptu_ro *rows,
+                                     fpta_value *keys, size_t max,
+                                     size_t *got);
+
 //----------------------------------------------------------------------------
 /* Манипуляция данными без курсоров. */
 
@@ -2838,6 +3470,29 @@ FPTA_API int fpta_cursor_key(fpta_cursor *cursor, fpta_value *key);
 FPTA_API int fpta_get(fpta_txn *txn, fpta_name *column_id,
                       const fpta_value *column_value, fptu_ro *row);
 
+/* Возвращает строки для нескольких значений ключевой колонки, аналогично
+ * вызову fpta_get() для каждого из count значений массива keys, но
+ * эффективнее при десятках и сотнях ключей.
+ *
+ * Схема и хендлы получаются однократно, после чего ключи упорядочиваются
+ * и индекс проходится одним курсором в порядке их возрастания, т.е. для
+ * соседних ключей поиск по дереву не требуется. Для вторичного индекса
+ * строки затем аналогично читаются в порядке значений первичного ключа.
+ *
+ * Найденные строки помещаются в rows в порядке следования ключей в keys,
+ * а для отсутствующих ключей в rows помещается пустая строка. Если rcs не
+ * NULL, то в него записываются коды результата для каждого из ключей
+ * (ноль или FPTA_NOTFOUND, либо ошибка преобразования значения в ключ).
+ *
+ * Требования к колонке column_id такие же, как для fpta_get().
+ *
+ * Возвращает ноль если найдены строки для всех ключей, иначе код ошибки
+ * для первого по порядку ненайденного ключа, либо код ошибки, которая
+ * помешала выполнению поиска (тогда этот код записывается и в rcs). */
+FPTA_API int fpta_get_many(fpta_txn *txn, fpta_name *column_id,
+                           const fpta_value *keys, size_t count, fptu_ro *rows,
+                           int *rcs);
+
 /* Опции при помещении или обновлении данных, т.е. для fpta_put(). */
 typedef enum fpta_put_options {
   /* Вставить новую запись, т.е. не обновлять существующую.
@@ -2915,15 +3570,105 @@ FPTA_API int fpta_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row_value,
 FPTA_API int fpta_validate_put(fpta_txn *txn, fpta_name *table_id,
                                fptu_ro row_value, fpta_put_options op);
 
-static __inline int fpta_probe_and_put(fpta_txn *txn, fpta_name *table_id,
-                                       fptu_ro row_value, fpta_put_options op) {
-  int rc =
-      fpta_validate_put(txn, table_id, row_value,
-                        (fpta_put_options)(op | fpta_skip_nonnullable_check));
-  if (rc == FPTA_SUCCESS)
-    rc = fpta_put(txn, table_id, row_value, op);
-  return rc;
-}
+/* Проверяет посредством fpta_validate_put() и затем выполняет fpta_put(),
+ * но вычисляет ключи индексов для старой и новой версии строки однократно.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_probe_and_put(fpta_txn *txn, fpta_name *table_id,
+                                fptu_ro row_value, fpta_put_options op);
+
+/* Пакетная вставка и обновление строк таблицы, аналогичная вызову fpta_put()
+ * для каждой из count строк массива rows, но более эффективная.
+ *
+ * Схема и хендлы таблицы и индексов получаются однократно, после чего
+ * строки упорядочиваются по значению первичного ключа (порциями до
+ * нескольких тысяч строк), а пары для вторичных индексов по значению
+ * соответствующих вторичных ключей. Таким образом изменения в B-деревьях
+ * выполняются последовательно по соседним листовым страницам. Если ключи
+ * добавляемых строк больше всех уже имеющихся в таблице или индексе,
+ * то вставка выполняется в режиме MDBX_APPEND/MDBX_APPENDDUP, т.е. без
+ * поиска по дереву.
+ *
+ * Порядок применения строк не соответствует их порядку в массиве rows,
+ * но строки с одинаковым значением первичного ключа применяются в порядке
+ * следования в массиве.
+ *
+ * Если per_row_rc не NULL, то в него записываются коды результата для
+ * каждой из строк. Ошибки, которые не приводят к прерыванию транзакции
+ * (например, отсутствие значения для не-nullable колонки, нарушение
+ * уникальности первичного ключа при fpta_insert или отсутствие строки
+ * при fpta_update), касаются только соответствующих строк, остальные
+ * строки применяются. Нарушение ограничений уникальности вторичных
+ * индексов, как и в fpta_put(), приводит к прерыванию транзакции, а для
+ * всех строк без ошибок будет возвращен этот же код.
+ *
+ * Аргумент table_id перед первым использованием должен
+ * быть инициализированы посредством fpta_table_init().
+ * Предварительный вызов fpta_name_refresh() не обязателен.
+ *
+ * Возвращает ноль если все строки применены успешно, иначе код первой
+ * обнаруженной ошибки. */
+FPTA_API int fpta_put_batch(fpta_txn *txn, fpta_name *table_id,
+                            const fptu_ro *rows, size_t count,
+                            fpta_put_options op, int *per_row_rc);
+
+/* Загрузчик для массовой вставки строк, например при первоначальном
+ * наполнении таблицы или восстановлении из резервной копии.
+ *
+ * Загрузка выполняется в рамках одной пишущей транзакции, которая
+ * запускается fpta_loader_begin() и фиксируется либо отменяется
+ * посредством fpta_loader_end(). Все вызовы должны производиться из
+ * одного потока, а другие пишущие транзакции на время загрузки
+ * блокируются.
+ *
+ * Строки с ключами больше уже имеющихся в таблице сразу добавляются в
+ * конец таблицы в режиме MDBX_APPEND, поэтому загрузка упорядоченных по
+ * первичному ключу данных выполняется наиболее эффективно. Остальные
+ * строки, а также пары для всех вторичных индексов накапливаются в
+ * памяти, упорядочиваются и по исчерпании бюджета сбрасываются во
+ * временные файлы в виде серий. При завершении загрузки серии сливаются и
+ * последовательно добавляются в основную таблицу и вторичные индексы.
+ * Наибольший эффект достигается при загрузке в пустую таблицу. */
+typedef struct fpta_loader fpta_loader;
+
+/* Начинает загрузку в таблицу.
+ *
+ * Аргумент spill_dir задаёт каталог для временных файлов, при NULL
+ * используются временные файлы по-умолчанию (см. tmpfile()). Аргумент
+ * run_bytes задаёт объем памяти для сортировки одной серии, причем
+ * отдельно для каждого из индексов, при нуле используется 64 мегабайта.
+ *
+ * Аргумент table_id перед первым использованием должен
+ * быть инициализированы посредством fpta_table_init().
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_loader_begin(fpta_db *db, fpta_name *table_id,
+                               const char *spill_dir, size_t run_bytes,
+                               fpta_loader **loader);
+
+/* Добавляет строку в загрузку. Данные строки копируются, поэтому
+ * переданный буфер можно использовать повторно сразу после возврата.
+ *
+ * Ошибки в данных строки (отсутствие значения для не-nullable колонки,
+ * недопустимые значения ключей) касаются только этой строки и не
+ * прерывают загрузку. После иных ошибок загрузка может быть только
+ * отменена, а все последующие вызовы вернут ту же ошибку.
+ *
+ * Нарушения уникальности ключей обнаруживаются только при завершении
+ * загрузки посредством fpta_loader_end().
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_loader_put(fpta_loader *loader, fptu_ro row);
+
+/* Завершает загрузку, выполняя слияние отложенных серий, и фиксирует
+ * транзакцию, либо отменяет загрузку при ненулевом abort. В любом случае
+ * освобождает загрузчик и удаляет временные файлы.
+ *
+ * При нарушении ограничений уникальности возвращает FPTA_KEYEXIST и
+ * отменяет загрузку целиком.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_loader_end(fpta_loader *loader, bool abort);
 
 /* Обновляет существующую строку таблицы с тем-же значением первичного ключа.
  * При обновлении одиночных строк функция дешевле в сравнении с открытием
@@ -3110,6 +3855,23 @@ static __inline int fpta_probe_and_upsert_row(fpta_txn *txn,
  * В случае успеха возвращает ноль, иначе код ошибки. */
 FPTA_API int fpta_delete(fpta_txn *txn, fpta_name *table_id, fptu_ro row_value);
 
+/* Удаляет строку с соответствующим значением в заданной ключевой колонке,
+ * не требуя предварительного получения самой строки посредством fpta_get().
+ *
+ * Указанная посредством column_id колонка должна иметь индекс с контролем
+ * уникальности (первичный или вторичный). Строка ищется и удаляется за один
+ * поиск в каждом из индексов, при этом значения для чистки вторичных индексов
+ * берутся из извлекаемой при удалении копии строки.
+ *
+ * Аргумент column_id перед первым использованием должен
+ * быть инициализированы посредством fpta_column_init().
+ * Предварительный вызов fpta_name_refresh() не обязателен.
+ *
+ * Если строки с заданным значением нет, то возвращается FPTA_NOTFOUND.
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_delete_by_key(fpta_txn *txn, fpta_name *column_id,
+                                const fpta_value *column_value);
+
 //----------------------------------------------------------------------------
 /* Манипуляция данными через курсоры. */
 
@@ -3235,6 +3997,19 @@ FPTA_API int fpta_upsert_column(fptu_rw *pt, const fpta_name *column_id,
 FPTA_API int fpta_upsert_column_ex(fptu_rw *pt, const fpta_name *column_id,
                                    fpta_value value, bool erase_on_denil);
 
+/* Добавляет в кортеж ещё одно значение колонки с многозначным индексом,
+ * см. fpta_describe_index_multivalued(). Для прочих колонок возвращает
+ * FPTA_EFLAG. Повторяющиеся значения допускаются, но индексируются
+ * однократно. Удалить все значения колонки можно посредством fptu_erase().
+ *
+ * Аргумент column_id идентифицирует колонку и должен быть
+ * предварительно подготовлен посредством fpta_name_refresh().
+ * Внутри функции column_id не обновляется.
+ *
+ * В случае успеха возвращает ноль, иначе код ошибки. */
+FPTA_API int fpta_insert_column(fptu_rw *pt, const fpta_name *column_id,
+                                fpta_value value);
+
 /* Получает значение указанной колонки из переданной строки таблицы (кортежа),
  * исключая составные колоноки.
  *
@@ -305,8 +305,157 @@ struct fpta_table_schema final {
     return FPTA_SUCCESS;
   }
 
-  cxx11_constexpr bool has_secondary() const {
-    return column_count() > 1 && fpta_index_is_secondary(column_shove(1));
+  /* После списков составных колонок хранятся дополнительные записи
+   * вторичных индексов в виде { вид | n, индексируемая колонка, n слов },
+   * где вид определяется битами record_kind_mask:
+   *  - covering_mark: список покрываемых колонок;
+   *  - partial_mark: закодированный предикат частичного индекса;
+   *  - option_mark: дополнительное свойство колонки, вид которого задается
+   *    первым словом после номера колонки:
+   *     - option_expression: имя (shove) функции вычисления колонки-выражения;
+   *     - option_keylen: увеличенный лимит длины ключа индекса;
+   *     - option_building: вторичный индекс добавлен, но еще заполняется
+   *       (см. fpta_index_add_online) и не используется для выборок;
+   *     - option_dropped: колонка удалена, но её номер остается занятым,
+   *       так как поля колонки могут оставаться в ранее записанных строках;
+   *     - option_bloom: фильтр Блума уникального вторичного индекса
+   *       и количество бит на ключ;
+   *     - option_bitmap: битовый индекс, значения которого хранятся в виде
+   *       сжатых битовых множеств номеров строк;
+   *     - option_multivalued: многозначный индекс, в который помещается
+   *       пара значение-PK для каждого из полей колонки в строке.
+   * Для быстрого доступа _covering_offsets хранит смещения записей
+   * покрывающих индексов для каждой колонки, либо record_none. */
+  enum : composite_item_t {
+    record_kind_mask = 0xC000,
+    covering_mark = 0x8000,
+    partial_mark = 0x4000,
+    option_mark = 0xC000,
+    record_none = 0xFFFF
+  };
+  enum : composite_item_t {
+    option_expression = 1,
+    option_keylen = 2,
+    option_building = 3,
+    option_dropped = 4,
+    option_bloom = 5,
+    option_bitmap = 6,
+    option_multivalued = 7
+  };
+  static cxx11_constexpr size_t record_length(composite_item_t head) {
+    return (head & ~record_kind_mask) + size_t(2);
+  }
+  composite_iter_t _covering_offsets;
+
+  bool is_covering(size_t number) const {
+    assert(number < _stored.count);
+    return _covering_offsets[number] != record_none;
+  }
+
+  void covering_list(size_t number, composite_iter_t &list_begin,
+                     composite_iter_t &list_end) const {
+    assert(is_covering(number));
+    const composite_iter_t covering =
+        composites_begin() + _covering_offsets[number];
+    list_begin = covering + 2;
+    list_end = list_begin + (*covering & ~record_kind_mask);
+  }
+
+  /* Предикаты частичных индексов, раскодированные при загрузке схемы
+   * в узлы fpta_filter. Равен nullptr, если частичных индексов нет. */
+  const fpta_filter *const *_partial_predicates;
+
+  bool has_partial() const { return _partial_predicates != nullptr; }
+  const fpta_filter *partial_predicate(size_t number) const {
+    assert(number < _stored.count);
+    return likely(_partial_predicates == nullptr)
+               ? nullptr
+               : _partial_predicates[number];
+  }
+
+  /* Имена (shove) функций вычисления колонок-выражений, либо nullptr,
+   * если таких колонок нет. Функции разрешаются по имени в реестре БД
+   * при каждом вычислении, так как могут быть зарегистрированы уже после
+   * загрузки схемы. Схема в fpta_name не привязана к конкретной БД,
+   * поэтому _expressions_db обновляется в fpta_name_refresh(). */
+  const fpta_shove_t *_expressions;
+  const fpta_db *_expressions_db;
+
+  bool has_expressions() const { return _expressions != nullptr; }
+  bool is_expression(size_t number) const {
+    assert(number < _stored.count);
+    return unlikely(_expressions != nullptr) && _expressions[number] != 0;
+  }
+  fpta_shove_t expression_function(size_t number) const {
+    assert(is_expression(number));
+    return _expressions[number];
+  }
+
+  /* Лимиты длины ключей индексов, либо nullptr, если для всех индексов
+   * действует fpta_max_keylen. */
+  const composite_item_t *_key_limits;
+
+  bool has_key_limits() const { return _key_limits != nullptr; }
+
+  size_t key_limit(size_t number) const {
+    assert(number < _stored.count);
+    return likely(_key_limits == nullptr) ? size_t(fpta_max_keylen)
+                                          : size_t(_key_limits[number]);
+  }
+
+  /* Признаки заполняемых вторичных индексов, либо nullptr, если таких нет. */
+  const bool *_building;
+
+  bool has_building() const { return _building != nullptr; }
+  bool is_building(size_t number) const {
+    assert(number < _stored.count);
+    return unlikely(_building != nullptr) && _building[number];
+  }
+
+  /* Признаки удаленных колонок, либо nullptr, если таких колонок нет. */
+  const bool *_dropped;
+
+  bool has_dropped() const { return _dropped != nullptr; }
+  bool is_dropped(size_t number) const {
+    assert(number < _stored.count);
+    return unlikely(_dropped != nullptr) && _dropped[number];
+  }
+
+  /* Кол-во колонок до последней индексированной включительно. Номера
+   * колонок не меняются при добавлении и удалении вторичных индексов
+   * (см. fpta_index_add), поэтому внутри этого диапазона могут быть
+   * и не-индексированные колонки. */
+  unsigned _index_span;
+
+  cxx11_constexpr size_t index_span() const { return _index_span; }
+  cxx11_constexpr bool has_secondary() const { return _index_span > 1; }
+
+  /* Количество бит на ключ фильтров Блума уникальных вторичных индексов,
+   * либо nullptr, если фильтров нет. */
+  const uint8_t *_bloom;
+
+  bool has_bloom() const { return _bloom != nullptr; }
+  unsigned bloom_bits(size_t number) const {
+    assert(number < _stored.count);
+    return likely(_bloom == nullptr) ? 0u : _bloom[number];
+  }
+
+  /* Признаки битовых индексов, либо nullptr, если таких индексов нет. */
+  const bool *_bitmap;
+
+  bool has_bitmap() const { return _bitmap != nullptr; }
+  bool is_bitmap(size_t number) const {
+    assert(number < _stored.count);
+    return unlikely(_bitmap != nullptr) && _bitmap[number];
+  }
+
+  /* Признаки многозначных индексов, либо nullptr, если таких нет. */
+  const bool *_multivalued;
+
+  bool has_multivalued() const { return _multivalued != nullptr; }
+  bool is_multivalued(size_t number) const {
+    assert(number < _stored.count);
+    return unlikely(_multivalued != nullptr) && _multivalued[number];
   }
 
   fpta_table_stored_schema _stored; /* must be last field (dynamic size) */
@@ -319,13 +468,66 @@ enum fpta_internals {
   fpta_dbi_cache_size = 6619 /* простое число ближайшее
                               * к golten_ratio * fpta_max_dbi = 6627.467 */
   ,
+  fpta_txn_pool_size = 16 /* кол-во "припаркованных" читающих транзакций */,
+  fpta_freelist_size = 64 /* кол-во свободных объектов курсоров и транзакций,
+                           * удерживаемых для повторного использования */
+  ,
+  fpta_commit_batch_max = 1024 /* макс. кол-во запросов в одной групповой
+                                * фиксации, см fpta_transaction_submit() */
+  ,
+  fpta_commit_replay_max = 4 /* макс. кол-во повторов пачки групповой
+                              * фиксации из-за ошибок в запросах */
+  ,
+  fpta_put_batch_chunk = 16384 /* кол-во строк упорядочиваемых за один
+                                * проход внутри fpta_put_batch() */
+  ,
+  fpta_loader_run_default = 64 << 20 /* объем памяти по-умолчанию для
+                                      * сортировки одной серии загрузчиком
+                                      * для каждого из индексов */
+  ,
+  fpta_loader_readahead = 64 << 10 /* размер буфера чтения для каждой из
+                                    * серий при их слиянии загрузчиком */
+  ,
   FTPA_SCHEMA_SIGNATURE = 1636722823,
+  FTPA_SCHEMA_SIGNATURE_EXTENDED = 1636722824 /* схема с покрывающими,
+                                               * частичными индексами или
+                                               * колонками-выражениями,
+                                               * которую не должны открывать
+                                               * старые версии библиотеки */
+  ,
+  fpta_max_key_functions = 64 /* макс. кол-во функций вычисления ключей,
+                               * см fpta_db_register_key_function() */
+  ,
+  fpta_index_build_chunk = 4096 /* кол-во строк, добавляемых в индекс
+                                 * за одну транзакцию по-умолчанию, см
+                                 * fpta_index_add_online() */
+  ,
+  fpta_bloom_cache_size = 64 /* кол-во фильтров Блума, копии которых
+                              * удерживаются в памяти, см bloom.cxx */
+  ,
+  fpta_bloom_blocks_min = 8 /* мин. кол-во блоков в фильтре Блума */,
+  fpta_bitmap_jump_distance = 64 /* мин. расстояние до следующей подходящей
+                                  * по битовым индексам строки, при котором
+                                  * курсор переходит к ней поиском */
+  ,
+  fpta_batched_lookup_window = 256 /* макс. кол-во PK, собираемых для чтения
+                                    * строк в порядке PK, см
+                                    * fpta_batched_lookup */
+  ,
+  fpta_parallel_partitions_max = 1024 /* макс. кол-во частей выборки, см
+                                       * fpta_apply_visitor_parallel() */
+  ,
   FTPA_SCHEMA_CHECKSEED = 67413473,
   fpta_shoved_keylen = fpta_max_keylen + 8,
   fpta_notnil_prefix_byte = 42,
   fpta_notnil_prefix_length = 1
 };
 
+static cxx11_constexpr bool fpta_schema_signature_valid(uint32_t signature) {
+  return signature == FTPA_SCHEMA_SIGNATURE ||
+         signature == FTPA_SCHEMA_SIGNATURE_EXTENDED;
+}
+
 //----------------------------------------------------------------------------
 
 struct fpta_txn {
@@ -333,7 +535,7 @@ struct fpta_txn {
   fpta_db *db;
   MDBX_txn *mdbx_txn;
   fpta_level level;
-  int unused_gap;
+  unsigned guard_slot /* слот читателя в fpta_db::schema_guard */;
   uint64_t db_version;
   uint64_t schema_tsn_;
 
@@ -351,6 +553,14 @@ struct fpta_key {
   }
   fpta_key(const fpta_key &) = delete;
 
+  /* Ключ индекса с увеличенным лимитом длины может не поместиться в place
+   * и тогда ссылается на исходные данные даже при запросе копирования,
+   * см. fpta_describe_index_keylen(). */
+  bool is_inplace() const {
+    return (const char *)mdbx.iov_base >= (const char *)&place &&
+           (const char *)mdbx.iov_base < (const char *)(&place + 1);
+  }
+
   MDBX_val mdbx;
   union {
     uint32_t u32;
@@ -367,6 +577,8 @@ struct fpta_key {
   } place;
 };
 
+class fpta_bitmap;
+
 struct fpta_cursor {
   fpta_cursor(const fpta_cursor &) = delete;
   MDBX_cursor *mdbx_cursor;
@@ -378,6 +590,9 @@ struct fpta_cursor {
     size_t scans;
     size_t pk_lookups;
     size_t uniq_checks;
+    size_t uniq_filtered;
+    size_t bitmap_filtered;
+    size_t key_filtered;
     size_t upserts;
     size_t deletions;
   } metrics;
@@ -423,6 +638,9 @@ struct fpta_cursor {
   /* uint8_t */ fpta_cursor_options options;
   uint8_t seek_range_state;
   uint8_t seek_range_flags;
+  bool external_storage /* память предоставлена вызывающим кодом */;
+  bool covered /* фильтр вычисляется по покрывающему индексу */;
+  bool key_filter /* часть фильтра вычисляется по ключу индекса и PK */;
   MDBX_dbi tbl_handle, idx_handle;
 
   fpta_table_schema *table_schema() const { return table_id->table_schema; }
@@ -439,6 +657,10 @@ struct fpta_cursor {
 
   fpta_key range_from_key;
   fpta_key range_to_key;
+  /* копии длинных ключей границ диапазона, не поместившихся в fpta_key */
+  void *range_spill;
+  /* строки, подходящие под фильтр по битовым индексам, см bitmap.cxx */
+  fpta_bitmap *bitmap_filter;
   fpta_db *db;
 };
 
@@ -451,28 +673,183 @@ unsigned fpta_index_shove2secondary_dbiflags(fpta_shove_t pk_shove,
 bool fpta_index_is_compat(fpta_shove_t shove, const fpta_value &value);
 
 int fpta_index_value2key(fpta_shove_t shove, const fpta_value &value,
-                         fpta_key &key, bool copy = false);
+                         fpta_key &key, bool copy = false,
+                         size_t limit = fpta_max_keylen);
 int fpta_index_key2value(fpta_shove_t shove, MDBX_val mdbx_key,
-                         fpta_value &key_value);
+                         fpta_value &key_value,
+                         size_t limit = fpta_max_keylen);
+
+/* Отображение ключей на 64-битные числа с сохранением порядка сравнения
+ * (для строк и бинарных ключей по 8 байтам после общего префикса границ),
+ * позволяющее подбирать ключ-границу бинарным поиском по оценкам
+ * mdbx_estimate_range(). */
+size_t fpta_index_ordinal_prefix(const MDBX_val &a, const MDBX_val &b,
+                                 unsigned dbi_flags);
+uint64_t fpta_index_key2ordinal(const MDBX_val &key, unsigned dbi_flags,
+                                size_t prefix = 0);
+void fpta_index_ordinal2key(uint64_t number, unsigned dbi_flags,
+                            const MDBX_val &base, size_t prefix,
+                            fpta_key &key);
 
 int fpta_index_row2key(const fpta_table_schema *const schema, size_t column,
                        const fptu_ro &row, fpta_key &key, bool copy = false);
+int fpta_index_field2key(const fpta_shove_t shove, const fptu_field *field,
+                         fpta_key &key, bool copy, size_t limit);
 
 int fpta_composite_row2key(const fpta_table_schema *const schema, size_t column,
                            const fptu_ro &row, fpta_key &key);
 
+/* Ключи первичного и всех вторичных индексов строки, которые вычисляются
+ * за один проход по полям кортежа (вместо поиска поля для каждого индекса),
+ * а также битовая карта индексов, ключи которых отличаются от ключей
+ * предыдущей версии строки. Позволяет не вычислять одни и те же ключи
+ * повторно при проверке уникальности и обновлении вторичных индексов. */
+class fpta_row_keys {
+  enum { inplace_keys = 16 };
+  size_t count_, capacity_;
+  fpta_key *keys_;
+  /* копии длинных ключей, не поместившихся в fpta_key */
+  void *spill_;
+  size_t spill_capacity_;
+  /* копия строки для обновления многозначных индексов */
+  void *row_copy_;
+  size_t row_copy_capacity_;
+  uint64_t changed_[fpta_max_indexes / 64];
+  uint64_t excluded_[fpta_max_indexes / 64];
+  fpta_key inplace_[inplace_keys];
+
+public:
+  fpta_row_keys()
+      : count_(0), capacity_(inplace_keys), keys_(inplace_), spill_(nullptr),
+        spill_capacity_(0), row_copy_(nullptr), row_copy_capacity_(0) {}
+  fpta_row_keys(const fpta_row_keys &) = delete;
+  ~fpta_row_keys() {
+    if (keys_ != inplace_)
+      free(keys_);
+    free(spill_);
+    free(row_copy_);
+  }
+
+  /* Вычисляет ключи всех индексов строки. Если строка может быть изменена
+   * (например, расположена в "грязной" странице), то следует задать copy
+   * для копирования значений ключей внутрь объекта. При ошибке остаются
+   * доступными ключи индексов, предшествующих проблемному.
+   * Для таблиц с многозначными индексами при copy копируется и сама
+   * строка, так как такие индексы обновляются по всем полям колонки.
+   * Для частичных индексов также вычисляется соответствие строки их
+   * предикатам, см. included(). */
+  int build(const fpta_table_schema *table_def, const fptu_ro &row,
+            bool copy = false);
+  /* Отмечает индексы, ключи которых отличаются от ключей предыдущей
+   * версии строки, либо для которых изменилось вхождение строки
+   * в частичный индекс. Пустой old означает отсутствие предыдущей версии. */
+  void diff(const fpta_row_keys &old);
+
+  bool empty() const { return count_ == 0; }
+  size_t count() const { return count_; }
+  const MDBX_val &operator[](size_t index) const {
+    assert(index < count_);
+    return keys_[index].mdbx;
+  }
+  bool changed(size_t index) const {
+    assert(index < count_);
+    return (changed_[index / 64] >> (index % 64)) & 1;
+  }
+  /* Должна ли строка присутствовать в индексе, т.е. индекс не является
+   * частичным, либо строка удовлетворяет его предикату. */
+  bool included(size_t index) const {
+    assert(index < count_);
+    return ((excluded_[index / 64] >> (index % 64)) & 1) == 0;
+  }
+  const fptu_ro &row() const { return row_; }
+
+private:
+  fptu_ro row_;
+};
+
+/* Значение во вторичном индексе. Для покрывающего индекса это кортеж
+ * с копиями покрываемых колонок строки, за которым следует ключ PK,
+ * а для остальных индексов только ключ PK. */
+class fpta_secondary_value {
+  enum { inplace_bytes = 1024 };
+  void *buffer_;
+  size_t capacity_;
+  MDBX_val value_;
+  uint64_t inplace_[inplace_bytes / sizeof(uint64_t)];
+
+public:
+  fpta_secondary_value() : buffer_(inplace_), capacity_(sizeof(inplace_)) {
+    value_.iov_base = nullptr;
+    value_.iov_len = 0;
+  }
+  fpta_secondary_value(const fpta_secondary_value &) = delete;
+  ~fpta_secondary_value() {
+    if (buffer_ != inplace_)
+      free(buffer_);
+  }
+
+  int build(const fpta_table_schema *table_def, size_t column,
+            const fptu_ro &row, const MDBX_val &pk_key);
+  const MDBX_val &value() const { return value_; }
+};
+
+/* Разделяет значение покрывающего индекса на кортеж-проекцию и ключ PK. */
+static __inline int fpta_covering_split(const MDBX_val &value,
+                                        fptu_ro &projection,
+                                        MDBX_val &pk_key) {
+  if (unlikely(value.iov_len < fptu_unit_size))
+    return FPTA_INDEX_CORRUPTED;
+  const size_t bytes = units2bytes(
+      ((const fptu_unit *)value.iov_base)->varlen.brutto + (size_t)1);
+  if (unlikely(bytes > value.iov_len))
+    return FPTA_INDEX_CORRUPTED;
+
+  projection.sys.iov_base = value.iov_base;
+  projection.sys.iov_len = bytes;
+  pk_key.iov_base = (uint8_t *)value.iov_base + bytes;
+  pk_key.iov_len = value.iov_len - bytes;
+  return FPTA_SUCCESS;
+}
+
+/* Извлекает ключ PK из значения во вторичном индексе. */
+static __inline int fpta_secondary2pk(const fpta_table_schema *table_def,
+                                      size_t column, const MDBX_val &value,
+                                      MDBX_val &pk_key) {
+  if (likely(!table_def->is_covering(column))) {
+    pk_key = value;
+    return FPTA_SUCCESS;
+  }
+  fptu_ro projection;
+  return fpta_covering_split(value, projection, pk_key);
+}
+
+/* Добавляет в кортеж копию поля ещё одним полем той же колонки. */
+int fpta_covering_copy(fptu_rw *pt, const fptu_field *pf);
+
 int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
                           MDBX_val old_pk_key, const fptu_ro &old_row,
                           MDBX_val new_pk_key, const fptu_ro &new_row,
                           const unsigned stepover);
+int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
+                          MDBX_val old_pk_key, const fpta_row_keys &old_keys,
+                          MDBX_val new_pk_key, const fpta_row_keys &new_keys,
+                          const unsigned stepover);
 
 int fpta_check_secondary_uniq(fpta_txn *txn, fpta_table_schema *table_def,
                               const fptu_ro &row_old, const fptu_ro &row_new,
-                              const unsigned stepover);
+                              const unsigned stepover,
+                              size_t *filtered = nullptr);
+int fpta_check_secondary_uniq(fpta_txn *txn, fpta_table_schema *table_def,
+                              const fpta_row_keys &new_keys,
+                              const unsigned stepover,
+                              size_t *filtered = nullptr);
 
 int fpta_secondary_remove(fpta_txn *txn, fpta_table_schema *table_def,
                           MDBX_val &pk_key, const fptu_ro &row,
                           const unsigned stepover);
+int fpta_secondary_remove(fpta_txn *txn, fpta_table_schema *table_def,
+                          MDBX_val &pk_key, const fpta_row_keys &keys,
+                          const unsigned stepover);
 
 int fpta_check_nonnullable(const fpta_table_schema *table_def,
                            const fptu_ro &row);
@@ -480,6 +857,21 @@ int fpta_check_nonnullable(const fpta_table_schema *table_def,
 int fpta_column_set_add(fpta_column_set *column_set, const char *column_name,
                         fptu_type data_type, fpta_index_type index_type);
 
+/* Дополнительные записи схемы (покрывающие, частичные индексы, свойства
+ * колонок) добавляются в описание таблицы за списками составных колонок:
+ * fpta_describe_* находят колонку, затем проверяют новую запись среди уже
+ * имеющихся и добавляют её в конец. */
+int fpta_column_set_lookup(const fpta_column_set *column_set,
+                           const char *column_name, size_t &column);
+int fpta_column_set_records(fpta_column_set *column_set,
+                            fpta_table_schema::composite_item_t *&records,
+                            fpta_table_schema::composite_item_t *&tail);
+int fpta_column_set_append(
+    fpta_column_set *column_set, fpta_table_schema::composite_item_t *tail,
+    const unsigned mark, const size_t column,
+    const fpta_table_schema::composite_item_t *const payload,
+    const size_t length);
+
 int fpta_composite_index_validate(
     const fpta_index_type index_type,
     const fpta_table_schema::composite_item_t *const items_begin,
@@ -489,8 +881,158 @@ int fpta_composite_index_validate(
     const fpta_table_schema::composite_item_t *const composites_end,
     const fpta_shove_t skipself);
 
+int fpta_covering_index_validate(
+    const size_t index_column,
+    const fpta_table_schema::composite_item_t *const items_begin,
+    const fpta_table_schema::composite_item_t *const items_end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const coverings_begin,
+    const fpta_table_schema::composite_item_t *const coverings_end);
+
+/* Предикат частичного индекса хранится в схеме в префиксной записи:
+ * узлы not/and/or представлены своим типом, за которым следуют операнды,
+ * а сравнение колонки с константой словами { тип узла, номер колонки,
+ * тип значения, длина данных в байтах, данные... }. */
+enum fpta_partial_layout {
+  fpta_partial_cmp_header = 4 /* кол-во слов перед данными константы */
+};
+
+/* Перебирает номера колонок в закодированном предикате, без проверки
+ * структуры дерева. Возвращает false при выходе за границы. */
+template <typename ITEM, typename FUNC>
+static inline bool fpta_partial_foreach_column(ITEM *scan, ITEM *const end,
+                                               FUNC func) {
+  while (scan < end) {
+    const int type = (int16_t)*scan;
+    if (type == fpta_node_not || type == fpta_node_or ||
+        type == fpta_node_and) {
+      ++scan;
+      continue;
+    }
+    if (unlikely(end - scan < fpta_partial_cmp_header))
+      return false;
+    ITEM *const next = scan + fpta_partial_cmp_header + (scan[3] + 1) / 2;
+    if (unlikely(next > end))
+      return false;
+    func(scan[1]);
+    scan = next;
+  }
+  return true;
+}
+
+/* Память для раскодирования предикатов частичных индексов. При нулевом
+ * nodes выполняется только подсчет требуемого кол-ва узлов и имен. */
+struct fpta_partial_arena {
+  fpta_filter *nodes;
+  fpta_name *names;
+  size_t nodes_used, names_used;
+};
+
+int fpta_partial_predicate_decode(
+    fpta_table_schema::composite_iter_t &scan,
+    const fpta_table_schema::composite_iter_t end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    fpta_partial_arena &arena, const fpta_filter **result);
+
+int fpta_partial_index_validate(
+    const size_t index_column,
+    const fpta_table_schema::composite_item_t *const items_begin,
+    const fpta_table_schema::composite_item_t *const items_end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_expression_column_validate(
+    const size_t column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_index_keylen_validate(
+    const size_t index_column, const size_t max_keylen,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_column_dropped_validate(
+    const size_t column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_index_building_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_index_bloom_validate(
+    const size_t index_column, const size_t bits_per_key,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+int fpta_index_bitmap_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end,
+    const fpta_table_schema::composite_item_t *const self);
+
+int fpta_index_multivalued_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end,
+    const fpta_table_schema::composite_item_t *const self);
+
+/* Ищет среди записей схемы свойство option колонки column.
+ * Возвращает указатель на запись, либо nullptr. */
+const fpta_table_schema::composite_item_t *fpta_column_option_lookup(
+    const size_t column, const fpta_table_schema::composite_item_t option,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+/* Размещает вычисленное значение колонки-выражения в виде поля кортежа,
+ * что позволяет формировать ключи общим с хранимыми колонками кодом.
+ * Поле действительно до следующего вычисления или разрушения объекта. */
+class fpta_expression_field {
+  enum { inplace_bytes = fpta_key_function_buffer * 2 };
+  void *tuple_;
+  size_t capacity_;
+  uint64_t inplace_[inplace_bytes / sizeof(uint64_t)];
+  uint64_t result_[fpta_key_function_buffer / sizeof(uint64_t)];
+
+public:
+  fpta_expression_field() : tuple_(inplace_), capacity_(sizeof(inplace_)) {}
+  fpta_expression_field(const fpta_expression_field &) = delete;
+  ~fpta_expression_field() {
+    if (tuple_ != inplace_)
+      free(tuple_);
+  }
+
+  int compute(const fpta_table_schema *table_def, size_t column,
+              const fptu_ro &row, const fptu_field *&field);
+};
+
+int fpta_upsert_value(fptu_rw *pt, const unsigned colnum,
+                      const fpta_shove_t shove, fpta_value value,
+                      bool erase_on_denil);
+
 int fpta_name_refresh_filter(fpta_txn *txn, fpta_name *table_id,
                              fpta_filter *filter);
+bool fpta_filter_is_covered(const fpta_filter *filter,
+                            fpta_table_schema::composite_iter_t covered_begin,
+                            fpta_table_schema::composite_iter_t covered_end);
+bool fpta_filter_has_covered(const fpta_filter *filter,
+                             fpta_table_schema::composite_iter_t covered_begin,
+                             fpta_table_schema::composite_iter_t covered_end);
+bool fpta_filter_match_covered(
+    const fpta_filter *filter, fptu_ro tuple,
+    fpta_table_schema::composite_iter_t covered_begin,
+    fpta_table_schema::composite_iter_t covered_end);
+bool fpta_filter_implies(const fpta_filter *filter,
+                         const fpta_filter *predicate);
 
 //----------------------------------------------------------------------------
 
@@ -508,6 +1050,11 @@ void fpta_cursor_free(fpta_db *db, fpta_cursor *cursor);
 
 int fpta_internal_abort(fpta_txn *txn, int errnum, bool txn_maybe_dead = false);
 
+/* Запускает читающую транзакцию для вспомогательного потока, пока txn
+ * удерживает блокировку схемы. Транзакция может оказаться на более новом
+ * снимке БД, что следует проверять сравнением db_version. */
+int fpta_transaction_sibling(fpta_txn *txn, fpta_txn **psibling);
+
 namespace std {
 FPTA_API ostream &operator<<(ostream &out, const MDBX_val &);
 FPTA_API ostream &operator<<(ostream &out, const fpta_key &);
@@ -0,0 +1,396 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Изменение индексов заполненной таблицы.
+ *
+ * Добавление и удаление вторичного индекса не меняет номеров колонок,
+ * поэтому строки таблицы, проекции покрывающих индексов и таблицы прочих
+ * индексов не требуют перезаписи, а индексированные колонки могут
+ * чередоваться с обычными (см. fpta_table_schema::index_span). При удалении
+ * индекса достаточно удалить его таблицу, а новый индекс заполняется
+ * проходом по строкам в порядке первичного ключа:
+ *  - внутри транзакции изменения схемы (см. fpta_index_add) посредством
+ *    внешней сортировки с добавлением в конец таблицы индекса;
+ *  - порциями в отдельных пишущих транзакциях (см. fpta_index_add_online).
+ *    Пока индекс заполняется, он помечается в схеме записью option_building
+ *    и обновляется писателями наравне с остальными, но прежних пар строки
+ *    в нём может еще не быть, а для выборок он не используется. */
+
+int __cold fpta_index_building_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(fpta_shove2index(index_shove)) ||
+               fpta_is_composite(index_shove)))
+    return FPTA_EFLAG;
+
+  if (unlikely(fpta_column_option_lookup(index_column,
+                                         fpta_table_schema::option_building,
+                                         records_begin, records_end)))
+    return FPTA_EEXIST;
+
+  return FPTA_SUCCESS;
+}
+
+int fpta_index_build(fpta_txn *txn, fpta_table_schema *table_def,
+                     size_t column, bool fill) {
+  const fpta_shove_t table_shove = table_def->table_shove();
+  const fpta_shove_t *const shoves = table_def->column_shoves_array();
+  const fpta_shove_t dbi_shove = fpta_dbi_shove(table_shove, column);
+  const unsigned dbi_flags = fpta_dbi_flags(shoves, column);
+  assert(column > 0 && fpta_is_indexed(shoves[column]));
+
+  MDBX_dbi pk_dbi, dbi;
+  int rc = fpta_dbi_open(txn, fpta_dbi_shove(table_shove, 0), pk_dbi,
+                         fpta_dbi_flags(shoves, 0));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  fpta_dbicache_remove(txn->db, dbi_shove);
+  rc = fpta_dbi_open(txn, dbi_shove, dbi, MDBX_CREATE | dbi_flags);
+  if (unlikely(rc != MDBX_SUCCESS) || !fill)
+    return rc;
+
+  fpta_sorter *sorter;
+  rc = fpta_sorter_create(txn->mdbx_txn, dbi, (dbi_flags & MDBX_DUPSORT) != 0,
+                          0, &sorter);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_cursor *cursor = nullptr;
+  fpta_secondary_value se_value;
+  const fpta_filter *const predicate = table_def->partial_predicate(column);
+  rc = mdbx_cursor_open(txn->mdbx_txn, pk_dbi, &cursor);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+
+  /* единственный проход по строкам в порядке первичного ключа */
+  MDBX_val pk_key, data;
+  rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_FIRST);
+  while (rc == MDBX_SUCCESS) {
+    fptu_ro row;
+    row.sys = data;
+    if (!predicate || fpta_filter_match(predicate, row)) {
+      fpta_key se_key;
+      rc = fpta_index_row2key(table_def, column, row, se_key, false);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      rc = se_value.build(table_def, column, row, pk_key);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      rc = fpta_sorter_push(sorter, se_key.mdbx, se_value.value());
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+    }
+    rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_NEXT);
+  }
+  if (unlikely(rc != MDBX_NOTFOUND))
+    goto bailout;
+
+  rc = fpta_sorter_complete(sorter, fpta_index_is_unique(shoves[column])
+                                        ? MDBX_NODUPDATA | MDBX_NOOVERWRITE
+                                        : MDBX_NODUPDATA);
+
+bailout:
+  if (cursor)
+    mdbx_cursor_close(cursor);
+  fpta_sorter_release(sorter);
+  return rc;
+}
+
+namespace {
+/* Копия ключа PK последней строки, добавленной в заполняемый индекс,
+ * с которой продолжается заполнение в следующей транзакции. */
+class fpta_build_position {
+  void *data_;
+  size_t length_, capacity_;
+
+public:
+  fpta_build_position() : data_(nullptr), length_(0), capacity_(0) {}
+  fpta_build_position(const fpta_build_position &) = delete;
+  ~fpta_build_position() { free(data_); }
+
+  bool empty() const { return data_ == nullptr; }
+  MDBX_val key() const {
+    MDBX_val key;
+    key.iov_base = data_;
+    key.iov_len = length_;
+    return key;
+  }
+
+  int assign(const MDBX_val &key) {
+    if (key.iov_len > capacity_ || data_ == nullptr) {
+      void *larger = realloc(data_, std::max(key.iov_len, size_t(1)));
+      if (unlikely(larger == nullptr))
+        return FPTA_ENOMEM;
+      data_ = larger;
+      capacity_ = std::max(key.iov_len, size_t(1));
+    }
+    memcpy(data_, key.iov_base, key.iov_len);
+    length_ = key.iov_len;
+    return FPTA_SUCCESS;
+  }
+};
+} // namespace
+
+/* Добавляет в заполняемый индекс пары для очередной порции строк, следующих
+ * за position. Возвращает FPTA_NODATA, если строк больше нет. */
+static int fpta_index_fill_chunk(fpta_txn *txn, fpta_table_schema *table_def,
+                                 size_t column, fpta_build_position &position,
+                                 size_t chunk_rows) {
+  assert(table_def->is_building(column));
+  MDBX_dbi dbi[fpta_max_indexes];
+  int rc = fpta_open_secondaries(txn, table_def, dbi);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_cursor *cursor;
+  rc = mdbx_cursor_open(txn->mdbx_txn, dbi[0], &cursor);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_val pk_key, data;
+  if (position.empty())
+    rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_FIRST);
+  else {
+    /* строка могла быть удалена, а перед ней вставлены другие,
+     * но пары для них уже добавлены писателями */
+    pk_key = position.key();
+    rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_SET_RANGE);
+    if (rc == MDBX_SUCCESS && fpta_is_same(pk_key, position.key()))
+      rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_NEXT);
+  }
+
+  const bool unique =
+      fpta_index_is_unique(fpta_shove2index(table_def->column_shove(column)));
+  const fpta_filter *const predicate = table_def->partial_predicate(column);
+  fpta_secondary_value se_value;
+  for (size_t rows = 0; rc == MDBX_SUCCESS && rows < chunk_rows; ++rows) {
+    /* ключ PK копируется, так как вставка в индекс может затронуть
+     * страницы основной таблицы */
+    rc = position.assign(pk_key);
+    if (unlikely(rc != FPTA_SUCCESS))
+      break;
+
+    fptu_ro row;
+    row.sys = data;
+    if (!predicate || fpta_filter_match(predicate, row)) {
+      fpta_key se_key;
+      rc = fpta_index_row2key(table_def, column, row, se_key, true);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+      rc = se_value.build(table_def, column, row, position.key());
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+
+      MDBX_val se_key_clone = se_key.mdbx, value = se_value.value();
+      rc = mdbx_put(txn->mdbx_txn, dbi[column], &se_key_clone, &value,
+                    unique ? MDBX_NODUPDATA | MDBX_NOOVERWRITE
+                           : MDBX_NODUPDATA);
+      if (rc == MDBX_KEYEXIST) {
+        /* пара могла быть добавлена писателем при изменении строки,
+         * иначе это нарушение уникальности */
+        MDBX_val present;
+        se_key_clone = se_key.mdbx;
+        rc = unique ? mdbx_get(txn->mdbx_txn, dbi[column], &se_key_clone,
+                               &present)
+                    : MDBX_SUCCESS;
+        if (rc == MDBX_SUCCESS && unique &&
+            !fpta_is_same(present, se_value.value()))
+          rc = MDBX_KEYEXIST;
+      }
+      if (unlikely(rc != MDBX_SUCCESS))
+        break;
+    }
+    rc = mdbx_cursor_get(cursor, &pk_key, &data, MDBX_NEXT);
+  }
+
+  mdbx_cursor_close(cursor);
+  return (rc == MDBX_NOTFOUND) ? (int)FPTA_NODATA : rc;
+}
+
+/* Выполняет fn в отдельной транзакции уровня level. */
+template <typename FN>
+static int fpta_index_build_step(fpta_db *db, fpta_level level,
+                                 fpta_name *table_id, fpta_name *column_id,
+                                 FN fn) {
+  fpta_txn *txn = nullptr;
+  int rc = fpta_transaction_begin(db, level, &txn);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  rc = fpta_name_refresh_couple(txn, table_id, column_id);
+  if (likely(rc == FPTA_SUCCESS))
+    rc = fn(txn, table_id->table_schema, column_id->column.num);
+  int err = fpta_transaction_end(
+      txn, rc != FPTA_SUCCESS && rc != FPTA_NODATA);
+  return (rc == FPTA_SUCCESS || rc == FPTA_NODATA) && err != FPTA_SUCCESS
+             ? err
+             : rc;
+}
+
+int fpta_index_add_online(fpta_db *db, const char *table_name,
+                          const char *column_name, fpta_index_type index_type,
+                          size_t chunk_rows) {
+  if (unlikely(db == nullptr))
+    return FPTA_EINVAL;
+  if (chunk_rows == 0)
+    chunk_rows = fpta_index_build_chunk;
+
+  fpta_name table_id, column_id;
+  int rc = fpta_table_init(&table_id, table_name);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  rc = fpta_column_init(&table_id, &column_id, column_name);
+  if (unlikely(rc != FPTA_SUCCESS)) {
+    fpta_name_destroy(&table_id);
+    return rc;
+  }
+
+  const auto building = [&](fpta_table_schema *table_def, size_t column) {
+    return fpta_shove2index(column_id.shove) == index_type &&
+           table_def->is_building(column);
+  };
+
+  /* индекс объявляется в схеме пустым, а если объявлен ранее (например
+   * до сбоя), то заполнение начинается заново */
+  rc = fpta_index_build_step(
+      db, fpta_schema, &table_id, &column_id,
+      [&](fpta_txn *txn, fpta_table_schema *table_def, size_t column) {
+        if (!fpta_is_indexed(column_id.shove))
+          return fpta_index_declare(txn, table_name, column_name,
+                                    index_type);
+        return building(table_def, column) ? (int)FPTA_SUCCESS
+                                           : (int)FPTA_EEXIST;
+      });
+
+  if (likely(rc == FPTA_SUCCESS)) {
+    /* порции заполняются под разделяемой блокировкой схемы */
+    fpta_build_position position;
+    do
+      rc = fpta_index_build_step(
+          db, fpta_write, &table_id, &column_id,
+          [&](fpta_txn *txn, fpta_table_schema *table_def, size_t column) {
+            if (unlikely(!building(table_def, column)))
+              /* индекс удален или заменен параллельно */
+              return (int)FPTA_SCHEMA_CHANGED;
+            return fpta_index_fill_chunk(txn, table_def, column, position,
+                                         chunk_rows);
+          });
+    while (rc == FPTA_SUCCESS);
+
+    if (rc == FPTA_NODATA)
+      /* индекс заполнен и становится доступным для выборок */
+      rc = fpta_index_build_step(
+          db, fpta_schema, &table_id, &column_id,
+          [&](fpta_txn *txn, fpta_table_schema *table_def, size_t column) {
+            if (unlikely(!building(table_def, column)))
+              return (int)FPTA_SCHEMA_CHANGED;
+            return fpta_index_publish(txn, table_name, column_name);
+          });
+    else
+      /* строки таблицы не удовлетворяют ограничениям индекса,
+       * либо заполнение прервано ошибкой */
+      fpta_index_build_step(
+          db, fpta_schema, &table_id, &column_id,
+          [&](fpta_txn *txn, fpta_table_schema *table_def, size_t column) {
+            return building(table_def, column)
+                       ? fpta_index_drop(txn, table_name, column_name)
+                       : (int)FPTA_SUCCESS;
+          });
+  }
+
+  fpta_name_destroy(&column_id);
+  fpta_name_destroy(&table_id);
+  return rc;
+}
+
+//----------------------------------------------------------------------------
+
+/* Удаление колонок.
+ *
+ * Удаленная колонка только помечается в схеме записью option_dropped,
+ * а её номер остается занятым, так как поля колонки могут оставаться
+ * в ранее записанных строках. Такие поля удаляются при следующем
+ * обновлении строки (см. fpta_dropped_stripper), поэтому изменение схемы
+ * не требует перезаписи всех строк таблицы. */
+
+int __cold fpta_column_dropped_validate(
+    const size_t column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  /* удалены могут быть только не-индексируемые nullable колонки */
+  const fpta_shove_t shove = columns_shoves[column];
+  if (unlikely(fpta_is_indexed(shove) || !fpta_column_is_nullable(shove)))
+    return FPTA_EFLAG;
+
+  if (unlikely(fpta_column_option_lookup(column,
+                                         fpta_table_schema::option_dropped,
+                                         records_begin, records_end)))
+    return FPTA_EEXIST;
+
+  return FPTA_SUCCESS;
+}
+
+int fpta_dropped_stripper::apply(const fpta_table_schema *table_def,
+                                 fptu_ro &row) {
+  assert(table_def->has_dropped());
+  const size_t count = table_def->column_count();
+  bool found = false;
+  const fptu_field *const end = fptu_end_ro(row);
+  for (const fptu_field *pf = fptu_begin_ro(row); pf < end; ++pf) {
+    const unsigned column = pf->colnum();
+    if (!pf->is_dead() && column < count && table_def->is_dropped(column)) {
+      found = true;
+      break;
+    }
+  }
+  if (likely(!found))
+    return FPTA_SUCCESS;
+
+  const char *error = nullptr;
+  const size_t bytes = fptu_check_and_get_buffer_size(row, 0, 0, &error);
+  if (unlikely(error != nullptr))
+    return FPTA_EVALUE;
+  if (bytes > capacity_) {
+    void *larger = realloc(buffer_, bytes);
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    buffer_ = larger;
+    capacity_ = bytes;
+  }
+
+  fptu_rw *rw = fptu_fetch(row, buffer_, capacity_, 0);
+  if (unlikely(rw == nullptr))
+    return FPTA_EOOPS;
+  for (size_t i = 0; i < count; ++i)
+    if (table_def->is_dropped(i))
+      fptu::erase(rw, (unsigned)i, fptu_any);
+  fptu_shrink(rw);
+  row = fptu_take_noshrink(rw);
+  return FPTA_SUCCESS;
+}
@@ -0,0 +1,791 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+#include "../externals/libfptu/src/erthink/erthink_clz.h"
+
+#include <new>
+
+/* Битовые индексы.
+ *
+ * Вместо пар значение-PK в mdbx-таблице с дубликатами битовый индекс
+ * хранит для каждого значения колонки множество номеров строк, которыми
+ * служат ключи PK. Множества хранятся в отдельной mdbx-таблице по частям
+ * (контейнерам) для каждых 65536 номеров: ключом служит ключ значения
+ * в индексе (4 или 8 байт), за которым следуют старшие 48 бит номеров
+ * в big-endian, а данными либо упорядоченный массив младших 16 бит номеров,
+ * либо битовая карта из 1024 слов. Собственная mdbx-таблица индекса при
+ * этом остается пустой.
+ *
+ * Множества изменяются в той же транзакции, что и строки таблицы. При
+ * открытии курсора читающей транзакции фильтр курсора предварительно
+ * вычисляется по битовым индексам (см. fpta_bitmap_select), после чего
+ * строки вне полученного множества пропускаются без проверки фильтром.
+ * Поддерево фильтра, ссылающееся только на одну колонку с битовым
+ * индексом, вычисляется однократно для каждого из её значений, а сами
+ * значения подставляются в поддерево посредством кортежа из одного поля.
+ * Поэтому сравнения и предикаты-функторы колонки вычисляются в точности
+ * так же, как и при проверке строк. */
+
+static __inline unsigned fpta_bitmap_popcount(uint64_t v) {
+  v -= (v >> 1) & UINT64_C(0x5555555555555555);
+  v = (v & UINT64_C(0x3333333333333333)) +
+      ((v >> 2) & UINT64_C(0x3333333333333333));
+  v = (v + (v >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+  return unsigned((v * UINT64_C(0x0101010101010101)) >> 56);
+}
+
+static __inline unsigned fpta_bitmap_ctz(uint64_t v) {
+  assert(v != 0);
+  return 63u - unsigned(erthink::clz(v & (0 - v)));
+}
+
+//----------------------------------------------------------------------------
+
+size_t fpta_bitmap::container::cardinality() const {
+  if (!dense())
+    return array.size();
+  size_t count = 0;
+  for (const uint64_t word : bits)
+    count += fpta_bitmap_popcount(word);
+  return count;
+}
+
+bool fpta_bitmap::container::test(unsigned low) const {
+  assert(low <= UINT16_MAX);
+  if (dense())
+    return (bits[low / 64] >> (low % 64)) & 1;
+  return std::binary_search(array.begin(), array.end(), uint16_t(low));
+}
+
+bool fpta_bitmap::container::next(unsigned low, unsigned &found) const {
+  if (!dense()) {
+    const auto it =
+        std::lower_bound(array.begin(), array.end(), uint16_t(low));
+    if (it == array.end())
+      return false;
+    found = *it;
+    return true;
+  }
+
+  size_t n = low / 64;
+  uint64_t word = bits[n] & (~UINT64_C(0) << (low % 64));
+  while (word == 0) {
+    if (++n == fpta_bitmap_words)
+      return false;
+    word = bits[n];
+  }
+  found = unsigned(n * 64 + fpta_bitmap_ctz(word));
+  return true;
+}
+
+void fpta_bitmap::container::set(unsigned low) {
+  if (dense()) {
+    bits[low / 64] |= UINT64_C(1) << (low % 64);
+    return;
+  }
+  const auto it = std::lower_bound(array.begin(), array.end(), uint16_t(low));
+  if (it == array.end() || *it != low)
+    array.insert(it, uint16_t(low));
+}
+
+void fpta_bitmap::container::clear(unsigned low) {
+  if (dense()) {
+    bits[low / 64] &= ~(UINT64_C(1) << (low % 64));
+    return;
+  }
+  const auto it = std::lower_bound(array.begin(), array.end(), uint16_t(low));
+  if (it != array.end() && *it == low)
+    array.erase(it);
+}
+
+void fpta_bitmap::container::expand() {
+  if (dense())
+    return;
+  bits.assign(fpta_bitmap_words, 0);
+  for (const uint16_t low : array)
+    bits[low / 64] |= UINT64_C(1) << (low % 64);
+  array.clear();
+  array.shrink_to_fit();
+}
+
+void fpta_bitmap::container::normalize() {
+  if (!dense()) {
+    if (array.size() >= fpta_bitmap_array_max)
+      expand();
+    return;
+  }
+  if (cardinality() >= fpta_bitmap_array_max)
+    return;
+
+  array.clear();
+  for (size_t n = 0; n < fpta_bitmap_words; ++n)
+    for (uint64_t word = bits[n]; word; word &= word - 1)
+      array.push_back(uint16_t(n * 64 + fpta_bitmap_ctz(word)));
+  bits.clear();
+  bits.shrink_to_fit();
+}
+
+int fpta_bitmap::container::load(const MDBX_val &data) {
+  if (data.iov_len == fpta_bitmap_bits_bytes) {
+    array.clear();
+    bits.resize(fpta_bitmap_words);
+    memcpy(bits.data(), data.iov_base, data.iov_len);
+    return FPTA_SUCCESS;
+  }
+  if (unlikely(data.iov_len == 0 || data.iov_len % sizeof(uint16_t) ||
+               data.iov_len > fpta_bitmap_bits_bytes))
+    return FPTA_INDEX_CORRUPTED;
+
+  bits.clear();
+  array.resize(data.iov_len / sizeof(uint16_t));
+  memcpy(array.data(), data.iov_base, data.iov_len);
+  return FPTA_SUCCESS;
+}
+
+MDBX_val fpta_bitmap::container::image() const {
+  MDBX_val data;
+  if (dense()) {
+    data.iov_base = (void *)bits.data();
+    data.iov_len = fpta_bitmap_bits_bytes;
+  } else {
+    data.iov_base = (void *)array.data();
+    data.iov_len = array.size() * sizeof(uint16_t);
+  }
+  return data;
+}
+
+enum fpta_bitmap_op { fpta_bitmap_or, fpta_bitmap_and, fpta_bitmap_andnot };
+
+/* Выполняет операцию над парой контейнеров с одинаковыми старшими битами,
+ * помещая результат в первый из них. */
+static void fpta_bitmap_combine(fpta_bitmap::container &a,
+                                const fpta_bitmap::container &b,
+                                fpta_bitmap_op op) {
+  assert(a.high == b.high);
+  if (!a.dense() && !b.dense()) {
+    std::vector<uint16_t> result;
+    result.reserve(op == fpta_bitmap_or ? a.array.size() + b.array.size()
+                                        : a.array.size());
+    auto out = std::back_inserter(result);
+    switch (op) {
+    case fpta_bitmap_or:
+      std::set_union(a.array.begin(), a.array.end(), b.array.begin(),
+                     b.array.end(), out);
+      break;
+    case fpta_bitmap_and:
+      std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(),
+                            b.array.end(), out);
+      break;
+    case fpta_bitmap_andnot:
+      std::set_difference(a.array.begin(), a.array.end(), b.array.begin(),
+                          b.array.end(), out);
+      break;
+    }
+    a.array.swap(result);
+  } else if (op == fpta_bitmap_or) {
+    a.expand();
+    if (b.dense()) {
+      for (size_t n = 0; n < fpta_bitmap::fpta_bitmap_words; ++n)
+        a.bits[n] |= b.bits[n];
+    } else {
+      for (const uint16_t low : b.array)
+        a.set(low);
+    }
+  } else if (!a.dense()) {
+    /* массив фильтруется по битовой карте */
+    const bool keep = (op == fpta_bitmap_and);
+    a.array.erase(std::remove_if(a.array.begin(), a.array.end(),
+                                 [&](uint16_t low) {
+                                   return b.test(low) != keep;
+                                 }),
+                  a.array.end());
+  } else if (!b.dense()) {
+    if (op == fpta_bitmap_and) {
+      std::vector<uint16_t> result;
+      result.reserve(b.array.size());
+      for (const uint16_t low : b.array)
+        if (a.test(low))
+          result.push_back(low);
+      a.bits.clear();
+      a.array.swap(result);
+    } else {
+      for (const uint16_t low : b.array)
+        a.clear(low);
+    }
+  } else {
+    for (size_t n = 0; n < fpta_bitmap::fpta_bitmap_words; ++n)
+      a.bits[n] = (op == fpta_bitmap_and) ? a.bits[n] & b.bits[n]
+                                          : a.bits[n] & ~b.bits[n];
+  }
+  a.normalize();
+}
+
+bool fpta_bitmap::test(uint64_t rowid) const {
+  const uint64_t high = rowid >> 16;
+  const auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), high,
+      [](const container &c, uint64_t value) { return c.high < value; });
+  return it != containers_.end() && it->high == high &&
+         it->test(unsigned(rowid & UINT16_MAX));
+}
+
+bool fpta_bitmap::next(uint64_t from, uint64_t &rowid) const {
+  const uint64_t high = from >> 16;
+  auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), high,
+      [](const container &c, uint64_t value) { return c.high < value; });
+  unsigned low = (it != containers_.end() && it->high == high)
+                     ? unsigned(from & UINT16_MAX)
+                     : 0;
+  for (; it != containers_.end(); ++it, low = 0) {
+    unsigned found;
+    if (it->next(low, found)) {
+      rowid = (it->high << 16) + found;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t fpta_bitmap::cardinality() const {
+  uint64_t count = 0;
+  for (const auto &c : containers_)
+    count += c.cardinality();
+  return count;
+}
+
+void fpta_bitmap::unite(const fpta_bitmap &other) {
+  std::vector<container> result;
+  result.reserve(containers_.size() + other.containers_.size());
+  auto a = containers_.begin();
+  auto b = other.containers_.begin();
+  while (a != containers_.end() || b != other.containers_.end()) {
+    if (b == other.containers_.end() ||
+        (a != containers_.end() && a->high < b->high))
+      result.push_back(std::move(*a++));
+    else if (a == containers_.end() || b->high < a->high)
+      result.push_back(*b++);
+    else {
+      fpta_bitmap_combine(*a, *b++, fpta_bitmap_or);
+      result.push_back(std::move(*a++));
+    }
+  }
+  containers_.swap(result);
+}
+
+void fpta_bitmap::intersect(const fpta_bitmap &other) {
+  std::vector<container> result;
+  auto b = other.containers_.begin();
+  for (auto &a : containers_) {
+    while (b != other.containers_.end() && b->high < a.high)
+      ++b;
+    if (b == other.containers_.end())
+      break;
+    if (b->high == a.high) {
+      fpta_bitmap_combine(a, *b, fpta_bitmap_and);
+      if (!a.empty())
+        result.push_back(std::move(a));
+    }
+  }
+  containers_.swap(result);
+}
+
+void fpta_bitmap::subtract(const fpta_bitmap &other) {
+  std::vector<container> result;
+  result.reserve(containers_.size());
+  auto b = other.containers_.begin();
+  for (auto &a : containers_) {
+    while (b != other.containers_.end() && b->high < a.high)
+      ++b;
+    if (b != other.containers_.end() && b->high == a.high)
+      fpta_bitmap_combine(a, *b, fpta_bitmap_andnot);
+    if (!a.empty())
+      result.push_back(std::move(a));
+  }
+  containers_.swap(result);
+}
+
+int fpta_bitmap::merge(uint64_t high, const MDBX_val &data) {
+  container loaded;
+  loaded.high = high;
+  int rc = loaded.load(data);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  const auto it = std::lower_bound(
+      containers_.begin(), containers_.end(), high,
+      [](const container &c, uint64_t value) { return c.high < value; });
+  if (it != containers_.end() && it->high == high)
+    fpta_bitmap_combine(*it, loaded, fpta_bitmap_or);
+  else
+    containers_.insert(it, std::move(loaded));
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+int __cold fpta_index_bitmap_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end,
+    const fpta_table_schema::composite_item_t *const self) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  const fpta_index_type index = fpta_shove2index(index_shove);
+  const fptu_type type = fpta_shove2type(index_shove);
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(index) ||
+               fpta_index_is_unique(index)))
+    return FPTA_EFLAG;
+  if (unlikely(fpta_is_composite(index_shove) || type < fptu_uint16 ||
+               type >= fptu_96))
+    return FPTA_ETYPE;
+
+  /* номером строки служит ключ PK, который должен быть уникальным
+   * и фиксированного размера (пока PK не задан нулевой слот пуст) */
+  const fpta_shove_t pk_shove = columns_shoves[0];
+  if (pk_shove) {
+    const fptu_type pk_type = fpta_shove2type(pk_shove);
+    if (unlikely(!fpta_index_is_unique(fpta_shove2index(pk_shove))))
+      return FPTA_EFLAG;
+    if (unlikely(fpta_is_composite(pk_shove) || pk_type < fptu_uint16 ||
+                 pk_type >= fptu_96))
+      return FPTA_ETYPE;
+  }
+
+  /* битовый индекс несовместим с другими записями для той же колонки */
+  for (auto scan = records_begin;
+       scan < records_end && (*scan & fpta_table_schema::record_kind_mask);
+       scan += fpta_table_schema::record_length(*scan)) {
+    if (scan == self || scan[1] != index_column)
+      continue;
+    if ((*scan & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::option_mark &&
+        scan[2] == fpta_table_schema::option_bitmap)
+      return FPTA_EEXIST;
+    return FPTA_EFLAG;
+  }
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_index_bitmap(const char *index_name,
+                                      fpta_column_set *column_set) {
+  if (unlikely(column_set == nullptr))
+    return FPTA_EINVAL;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи битовых индексов следуют за списками составных колонок,
+   * вместе с записями покрывающих и частичных индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_index_bitmap_validate(index_column, column_set->shoves,
+                                  column_set->count, records, tail,
+                                  nullptr);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  const fpta_table_schema::composite_item_t payload[] = {
+      fpta_table_schema::option_bitmap};
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::option_mark, index_column,
+                                payload, FPT_ARRAY_LENGTH(payload));
+}
+
+//----------------------------------------------------------------------------
+
+int fpta_bitmap_open(fpta_txn *txn, const fpta_shove_t bitmap_shove,
+                     MDBX_dbi &handle, bool create) {
+  if (create)
+    return fpta_dbi_open(txn, bitmap_shove, handle, MDBX_CREATE);
+
+  unsigned cache_hint = ~0u;
+  return fpta_dbicache_open(txn, bitmap_shove, handle, 0, &cache_hint);
+}
+
+int fpta_bitmap_drop(fpta_txn *txn, const fpta_shove_t bitmap_shove) {
+  MDBX_dbi dbi;
+  int rc = fpta_dbi_open(txn, bitmap_shove, dbi, 0);
+  if (rc == MDBX_NOTFOUND)
+    /* индекс не является битовым */
+    return MDBX_SUCCESS;
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  fpta_dbicache_remove(txn->db, bitmap_shove);
+  return mdbx_drop(txn->mdbx_txn, dbi, true);
+}
+
+static __inline int fpta_bitmap_dbi(fpta_txn *txn,
+                                    const fpta_table_schema *table_def,
+                                    size_t column, MDBX_dbi &dbi) {
+  assert(table_def->is_bitmap(column));
+  return fpta_bitmap_open(txn,
+                          fpta_bitmap_shove(table_def->table_shove(),
+                                            table_def->column_shove(column)),
+                          dbi, false);
+}
+
+int fpta_bitmap_clear(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column) {
+  MDBX_dbi dbi;
+  int rc = fpta_bitmap_dbi(txn, table_def, column, dbi);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  return mdbx_drop(txn->mdbx_txn, dbi, false);
+}
+
+namespace {
+/* Ключ контейнера: ключ значения в индексе и старшие биты номеров. */
+class fpta_bitmap_key {
+  uint8_t bytes_[sizeof(uint64_t) * 2];
+
+public:
+  MDBX_val mdbx;
+
+  fpta_bitmap_key(const MDBX_val &value_key, uint64_t high) {
+    assert(value_key.iov_len == 4 || value_key.iov_len == 8);
+    memcpy(bytes_, value_key.iov_base, value_key.iov_len);
+    for (size_t i = 0; i < sizeof(high); ++i)
+      bytes_[value_key.iov_len + i] =
+          uint8_t(high >> (8 * (sizeof(high) - 1 - i)));
+    mdbx.iov_base = bytes_;
+    mdbx.iov_len = value_key.iov_len + sizeof(high);
+  }
+
+  static int split(const MDBX_val &key, MDBX_val &value_key, uint64_t &high) {
+    if (unlikely(key.iov_len != 4 + sizeof(high) &&
+                 key.iov_len != 8 + sizeof(high)))
+      return FPTA_INDEX_CORRUPTED;
+    value_key.iov_base = key.iov_base;
+    value_key.iov_len = key.iov_len - sizeof(high);
+    const uint8_t *const bytes =
+        (const uint8_t *)key.iov_base + value_key.iov_len;
+    high = 0;
+    for (size_t i = 0; i < sizeof(high); ++i)
+      high = (high << 8) | bytes[i];
+    return FPTA_SUCCESS;
+  }
+};
+} // namespace
+
+int fpta_bitmap_update(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, const MDBX_val &value_key,
+                       uint64_t *rowids, size_t count, bool set) {
+  MDBX_dbi dbi;
+  int rc = fpta_bitmap_dbi(txn, table_def, column, dbi);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  /* номера группируются по контейнерам, чтобы каждый из них читался
+   * и записывался однократно */
+  std::sort(rowids, rowids + count);
+  fpta_bitmap::container container;
+  for (size_t i = 0; i < count;) {
+    const uint64_t high = rowids[i] >> 16;
+    fpta_bitmap_key key(value_key, high);
+    MDBX_val data;
+    rc = mdbx_get(txn->mdbx_txn, dbi, &key.mdbx, &data);
+    if (rc == MDBX_SUCCESS) {
+      rc = container.load(data);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+    } else if (rc == MDBX_NOTFOUND && set) {
+      container.array.clear();
+      container.bits.clear();
+    } else
+      return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+
+    container.high = high;
+    for (; i < count && (rowids[i] >> 16) == high; ++i) {
+      const unsigned low = unsigned(rowids[i] & UINT16_MAX);
+      if (set)
+        container.set(low);
+      else if (likely(container.test(low)))
+        container.clear(low);
+      else
+        return FPTA_INDEX_CORRUPTED;
+    }
+    container.normalize();
+
+    if (container.empty())
+      rc = mdbx_del(txn->mdbx_txn, dbi, &key.mdbx, nullptr);
+    else {
+      data = container.image();
+      rc = mdbx_put(txn->mdbx_txn, dbi, &key.mdbx, &data, 0);
+    }
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  }
+  return FPTA_SUCCESS;
+}
+
+int fpta_bitmap_upsert(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, const MDBX_val &old_pk_key,
+                       const fpta_row_keys &old_keys,
+                       const MDBX_val &new_pk_key,
+                       const fpta_row_keys &new_keys) {
+  uint64_t new_rowid = fpta_bitmap_rowid(new_pk_key);
+  if (old_keys.empty())
+    /* добавление новой строки */
+    return fpta_bitmap_update(txn, table_def, column, new_keys[column],
+                              &new_rowid, 1, true);
+
+  uint64_t old_rowid = fpta_bitmap_rowid(old_pk_key);
+  if (!new_keys.changed(column) && old_rowid == new_rowid)
+    return FPTA_SUCCESS;
+
+  /* изменилось значение колонки и/или PK */
+  int rc = fpta_bitmap_update(txn, table_def, column, old_keys[column],
+                              &old_rowid, 1, false);
+  if (likely(rc == FPTA_SUCCESS))
+    rc = fpta_bitmap_update(txn, table_def, column, new_keys[column],
+                            &new_rowid, 1, true);
+  return rc;
+}
+
+int fpta_bitmap_stat(fpta_txn *txn, const fpta_table_schema *table_def,
+                     size_t column, fpta_table_stat *stat) {
+  MDBX_dbi dbi;
+  int rc = fpta_bitmap_dbi(txn, table_def, column, dbi);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_stat mdbx_stat;
+  rc = mdbx_dbi_stat(txn->mdbx_txn, dbi, &mdbx_stat, sizeof(mdbx_stat));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  stat->bitmap_bytes +=
+      size_t(mdbx_stat.ms_branch_pages + mdbx_stat.ms_leaf_pages +
+             mdbx_stat.ms_overflow_pages) *
+      mdbx_stat.ms_psize;
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+namespace {
+class fpta_bitmap_evaluator {
+  fpta_txn *const txn_;
+  const fpta_table_schema *const table_def_;
+
+  enum : size_t { none = ~size_t(0) };
+
+  size_t bitmap_column(const fpta_name *column_id) const {
+    const size_t column = column_id->column.num;
+    return (column < table_def_->column_count() &&
+            table_def_->is_bitmap(column))
+               ? column
+               : size_t(none);
+  }
+
+  /* Возвращает номер колонки с битовым индексом, если только на неё
+   * ссылаются все условия поддерева, иначе none. */
+  size_t single_column(const fpta_filter *node,
+                       const fpta_name *&column_id) const {
+    switch (node->type) {
+    case fpta_node_not:
+      return single_column(node->node_not, column_id);
+    case fpta_node_or:
+    case fpta_node_and: {
+      const size_t a = single_column(node->node_and.a, column_id);
+      return (a == single_column(node->node_and.b, column_id)) ? a
+                                                               : size_t(none);
+    }
+    case fpta_node_fncol:
+      column_id = node->node_fncol.column_id;
+      return bitmap_column(column_id);
+    case fpta_node_fnrow:
+      return none;
+    default:
+      column_id = node->node_cmp.left_id;
+      return bitmap_column(column_id);
+    }
+  }
+
+  /* Объединяет множества строк для значений колонки, удовлетворяющих
+   * поддереву predicate, либо для всех значений. */
+  int gather(size_t column, const fpta_filter *predicate,
+             const fpta_name *column_id, fpta_bitmap &result) {
+    MDBX_dbi dbi;
+    int rc = fpta_bitmap_dbi(txn_, table_def_, column, dbi);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    MDBX_cursor *mdbx_cursor;
+    rc = mdbx_cursor_open(txn_->mdbx_txn, dbi, &mdbx_cursor);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    /* кортеж из одного поля для вычисления поддерева */
+    uint64_t space[(sizeof(fptu_rw) + sizeof(fptu_field) * 2 +
+                    sizeof(uint64_t) * 2) /
+                       sizeof(uint64_t) +
+                   1];
+    MDBX_val last = {nullptr, 0};
+    bool match = false;
+    MDBX_val key, data;
+    for (rc = mdbx_cursor_get(mdbx_cursor, &key, &data, MDBX_FIRST);
+         rc == MDBX_SUCCESS;
+         rc = mdbx_cursor_get(mdbx_cursor, &key, &data, MDBX_NEXT)) {
+      MDBX_val value_key;
+      uint64_t high;
+      rc = fpta_bitmap_key::split(key, value_key, high);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+
+      if (predicate && !fpta_is_same(value_key, last)) {
+        fpta_value value;
+        rc = fpta_index_key2value(table_def_->column_shove(column), value_key,
+                                  value);
+        if (unlikely(rc != FPTA_SUCCESS))
+          break;
+        fptu_rw *pt = fptu_init(space, sizeof(space), 1);
+        if (unlikely(pt == nullptr)) {
+          rc = FPTA_EOOPS;
+          break;
+        }
+        if (value.type != fpta_null) {
+          rc = fpta_upsert_column(pt, column_id, value);
+          if (unlikely(rc != FPTA_SUCCESS))
+            break;
+        }
+        match = fpta_filter_match(predicate, fptu_take_noshrink(pt));
+        last = value_key;
+      }
+
+      if (!predicate || match) {
+        rc = result.merge(high, data);
+        if (unlikely(rc != FPTA_SUCCESS))
+          break;
+      }
+    }
+    mdbx_cursor_close(mdbx_cursor);
+    return (rc == MDBX_NOTFOUND) ? (int)FPTA_SUCCESS : rc;
+  }
+
+  /* Все строки таблицы, т.е. объединение множеств для всех значений любой
+   * из колонок с битовым индексом. */
+  int universe(fpta_bitmap &result) {
+    for (size_t column = 1; column < table_def_->column_count(); ++column)
+      if (table_def_->is_bitmap(column))
+        return gather(column, nullptr, nullptr, result);
+    return FPTA_EOOPS;
+  }
+
+public:
+  fpta_bitmap_evaluator(fpta_txn *txn, const fpta_table_schema *table_def)
+      : txn_(txn), table_def_(table_def) {}
+
+  /* Вычисляет множество строк, удовлетворяющих узлу фильтра, либо его
+   * надмножество (тогда сбрасывается признак exact). Если узел не может
+   * быть вычислен по битовым индексам, то evaluated сбрасывается. */
+  int evaluate(const fpta_filter *node, fpta_bitmap &result, bool &evaluated) {
+    evaluated = true;
+    const fpta_name *column_id = nullptr;
+    const size_t column = single_column(node, column_id);
+    if (column != none)
+      return gather(column, node, column_id, result);
+
+    int rc;
+    bool a_evaluated, b_evaluated;
+    fpta_bitmap b;
+    switch (node->type) {
+    case fpta_node_and:
+      rc = evaluate(node->node_and.a, result, a_evaluated);
+      if (likely(rc == FPTA_SUCCESS))
+        rc = evaluate(node->node_and.b, b, b_evaluated);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      if (a_evaluated && b_evaluated) {
+        result.intersect(b);
+        result.exact &= b.exact;
+      } else if (b_evaluated) {
+        std::swap(result, b);
+        result.exact = false;
+      } else if (a_evaluated)
+        result.exact = false;
+      else
+        evaluated = false;
+      return FPTA_SUCCESS;
+
+    case fpta_node_or:
+      /* объединение надмножеств остается надмножеством */
+      rc = evaluate(node->node_or.a, result, a_evaluated);
+      if (likely(rc == FPTA_SUCCESS) && a_evaluated)
+        rc = evaluate(node->node_or.b, b, b_evaluated);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      if (a_evaluated && b_evaluated) {
+        result.unite(b);
+        result.exact &= b.exact;
+      } else
+        evaluated = false;
+      return FPTA_SUCCESS;
+
+    case fpta_node_not:
+      /* дополнение вычисляется только для точного множества */
+      rc = evaluate(node->node_not, b, b_evaluated);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      if (!b_evaluated || !b.exact) {
+        evaluated = false;
+        return FPTA_SUCCESS;
+      }
+      rc = universe(result);
+      if (likely(rc == FPTA_SUCCESS))
+        result.subtract(b);
+      return rc;
+
+    default:
+      evaluated = false;
+      return FPTA_SUCCESS;
+    }
+  }
+};
+} // namespace
+
+int fpta_bitmap_select(fpta_txn *txn, const fpta_table_schema *table_def,
+                       const fpta_filter *filter, fpta_bitmap **presult) {
+  assert(filter != nullptr && table_def->has_bitmap());
+  *presult = nullptr;
+
+  fpta_bitmap *result = new (std::nothrow) fpta_bitmap();
+  if (unlikely(result == nullptr))
+    return FPTA_ENOMEM;
+
+  bool evaluated;
+  fpta_bitmap_evaluator evaluator(txn, table_def);
+  int rc = evaluator.evaluate(filter, *result, evaluated);
+  if (likely(rc == FPTA_SUCCESS) && evaluated)
+    *presult = result;
+  else
+    delete result;
+  return rc;
+}
+
+void fpta_bitmap_release(fpta_bitmap *bitmap) { delete bitmap; }
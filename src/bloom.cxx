@@ -0,0 +1,862 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Фильтры Блума уникальных вторичных индексов.
+ *
+ * Фильтр хранится в отдельной mdbx-таблице с целочисленными ключами:
+ * под нулевым ключом заголовок, далее блоки по 64 байта (512 бит). Все
+ * биты ключа устанавливаются в одном блоке, выбираемом по хэшу, поэтому
+ * проверка затрагивает одну кэш-линию. Фильтр изменяется в той же
+ * транзакции, что и индекс, а счетчик изменений (sequence таблицы
+ * фильтра) увеличивается при каждой вставке и перестроении.
+ *
+ * Копия фильтра удерживается в памяти процесса и пригодна для транзакции,
+ * если её счетчик совпадает со счетчиком в снимке данных транзакции.
+ * Пишущая транзакция изменяет копию вместе с таблицей, а после фиксации
+ * или отмены копия соответственно становится чистой либо сбрасывается,
+ * см. fpta_bloom_settle(). До фиксации копия остается надмножеством
+ * предыдущего состояния и поэтому пригодна для читающих транзакций
+ * с этим состоянием. Читающие транзакции со старыми снимками проверяют
+ * блок в самой таблице фильтра.
+ *
+ * Удаления из индекса не отражаются в фильтре, а при росте количества
+ * ключей сверх емкости фильтр перестраивается по индексу с удвоением. */
+
+struct fpta_bloom_header {
+  uint32_t blocks;
+  uint16_t hashes;
+  uint16_t bits_per_key;
+  uint64_t keys /* кол-во ключей при перестроении */;
+  uint64_t seq /* значение счетчика после перестроения */;
+};
+
+enum {
+  fpta_bloom_block_words = 8,
+  fpta_bloom_block_bits = fpta_bloom_block_words * 64,
+  fpta_bloom_hashes_max = 16
+};
+
+/* Значение fpta_bloom_slot::base при отсутствии покрываемого состояния. */
+static cxx11_constexpr_var uint64_t fpta_bloom_nobase = UINT64_MAX;
+
+static __inline uint64_t fpta_bloom_hash(const MDBX_val &key) {
+  return t1ha2_atonce(key.iov_base, key.iov_len, 2020);
+}
+
+static __inline uint32_t fpta_bloom_block(uint64_t hash, uint32_t blocks) {
+  return uint32_t(((hash >> 32) * blocks) >> 32);
+}
+
+/* Биты ключа внутри блока выбираются двойным хэшированием
+ * по младшей половине хэша, старшая используется для выбора блока. */
+template <typename FUNC>
+static __inline void fpta_bloom_bits(uint64_t hash, unsigned hashes,
+                                     FUNC func) {
+  uint32_t bit = uint32_t(hash);
+  const uint32_t step =
+      uint32_t((hash * UINT64_C(0x9E3779B97F4A7C15)) >> 32) | 1;
+  for (unsigned i = 0; i < hashes; ++i, bit += step)
+    if (!func((bit / 64) % fpta_bloom_block_words, UINT64_C(1) << (bit % 64)))
+      break;
+}
+
+static __inline bool fpta_bloom_test(const uint64_t *block, uint64_t hash,
+                                     unsigned hashes) {
+  bool present = true;
+  fpta_bloom_bits(hash, hashes, [&](unsigned word, uint64_t mask) {
+    present = (block[word] & mask) != 0;
+    return present;
+  });
+  return present;
+}
+
+static __inline bool fpta_bloom_set(uint64_t *block, uint64_t hash,
+                                    unsigned hashes) {
+  bool changed = false;
+  fpta_bloom_bits(hash, hashes, [&](unsigned word, uint64_t mask) {
+    changed |= (block[word] & mask) == 0;
+    block[word] |= mask;
+    return true;
+  });
+  return changed;
+}
+
+static unsigned fpta_bloom_hashes(unsigned bits_per_key) {
+  /* оптимальное кол-во хэшей k = ln(2) * m/n */
+  const unsigned hashes = (bits_per_key * 69 + 50) / 100;
+  return std::min(std::max(hashes, 1u), unsigned(fpta_bloom_hashes_max));
+}
+
+static uint32_t fpta_bloom_blocks(uint64_t keys, unsigned bits_per_key) {
+  /* с двукратным запасом, чтобы перестроение не повторялось часто */
+  const uint64_t needed = (keys + 1) * 2 * bits_per_key / fpta_bloom_block_bits;
+  uint64_t blocks = fpta_bloom_blocks_min;
+  while (blocks < needed && blocks < UINT32_MAX / 2)
+    blocks <<= 1;
+  return uint32_t(blocks);
+}
+
+//----------------------------------------------------------------------------
+
+int __cold fpta_index_bloom_validate(
+    const size_t index_column, const size_t bits_per_key,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  const fpta_index_type index = fpta_shove2index(index_shove);
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(index) ||
+               !fpta_index_is_unique(index)))
+    return FPTA_EFLAG;
+
+  if (unlikely(bits_per_key < fpta_bloom_bits_min ||
+               bits_per_key > fpta_bloom_bits_max))
+    return FPTA_EINVAL;
+
+  /* для индекса допускается только один фильтр */
+  if (unlikely(fpta_column_option_lookup(index_column,
+                                         fpta_table_schema::option_bloom,
+                                         records_begin, records_end)))
+    return FPTA_EEXIST;
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_index_bloom(const char *index_name,
+                                     fpta_column_set *column_set,
+                                     unsigned bits_per_key) {
+  if (unlikely(column_set == nullptr))
+    return FPTA_EINVAL;
+  if (bits_per_key == 0)
+    bits_per_key = fpta_bloom_bits_default;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи фильтров следуют за списками составных колонок,
+   * вместе с записями покрывающих и частичных индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_index_bloom_validate(index_column, bits_per_key,
+                                 column_set->shoves, column_set->count,
+                                 records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  const fpta_table_schema::composite_item_t payload[] = {
+      fpta_table_schema::option_bloom,
+      (fpta_table_schema::composite_item_t)bits_per_key};
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::option_mark, index_column,
+                                payload, FPT_ARRAY_LENGTH(payload));
+}
+
+//----------------------------------------------------------------------------
+
+int fpta_bloom_open(fpta_txn *txn, const fpta_shove_t bloom_shove,
+                    MDBX_dbi &handle, bool create) {
+  if (create)
+    return fpta_dbi_open(txn, bloom_shove, handle,
+                         MDBX_CREATE | MDBX_INTEGERKEY);
+
+  unsigned cache_hint = ~0u;
+  return fpta_dbicache_open(txn, bloom_shove, handle, MDBX_INTEGERKEY,
+                            &cache_hint);
+}
+
+int fpta_bloom_drop(fpta_txn *txn, const fpta_shove_t bloom_shove) {
+  MDBX_dbi dbi;
+  int rc = fpta_dbi_open(txn, bloom_shove, dbi, MDBX_INTEGERKEY);
+  if (rc == MDBX_NOTFOUND)
+    /* фильтр не был включен для индекса */
+    return MDBX_SUCCESS;
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  fpta_dbicache_remove(txn->db, bloom_shove);
+  return mdbx_drop(txn->mdbx_txn, dbi, true);
+}
+
+static int fpta_bloom_header_get(MDBX_txn *txn, MDBX_dbi dbi,
+                                 fpta_bloom_header &header) {
+  const uint32_t zero = 0;
+  MDBX_val key, data;
+  key.iov_base = (void *)&zero;
+  key.iov_len = sizeof(zero);
+  int rc = mdbx_get(txn, dbi, &key, &data);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  if (unlikely(data.iov_len != sizeof(header)))
+    return FPTA_INDEX_CORRUPTED;
+  memcpy(&header, data.iov_base, sizeof(header));
+  if (unlikely(header.blocks < 1 || header.hashes < 1 ||
+               header.hashes > fpta_bloom_hashes_max))
+    return FPTA_INDEX_CORRUPTED;
+  return MDBX_SUCCESS;
+}
+
+static int fpta_bloom_block_get(MDBX_txn *txn, MDBX_dbi dbi, uint32_t number,
+                                uint64_t *block) {
+  /* нулевой ключ занят заголовком */
+  const uint32_t block_key = number + 1;
+  MDBX_val key, data;
+  key.iov_base = (void *)&block_key;
+  key.iov_len = sizeof(block_key);
+  int rc = mdbx_get(txn, dbi, &key, &data);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+  if (unlikely(data.iov_len != fpta_bloom_block_words * sizeof(uint64_t)))
+    return FPTA_INDEX_CORRUPTED;
+  /* значения в страницах mdbx не выровнены */
+  memcpy(block, data.iov_base, data.iov_len);
+  return MDBX_SUCCESS;
+}
+
+static int fpta_bloom_block_put(MDBX_txn *txn, MDBX_dbi dbi, uint32_t number,
+                                const uint64_t *block, unsigned flags) {
+  const uint32_t block_key = number + 1;
+  MDBX_val key, data;
+  key.iov_base = (void *)&block_key;
+  key.iov_len = sizeof(block_key);
+  data.iov_base = (void *)block;
+  data.iov_len = fpta_bloom_block_words * sizeof(uint64_t);
+  return mdbx_put(txn, dbi, &key, &data, flags);
+}
+
+static fpta_bloom_buffer *fpta_bloom_buffer_alloc(size_t blocks) {
+  const size_t bytes = offsetof(fpta_bloom_buffer, words) +
+                       blocks * fpta_bloom_block_words * sizeof(uint64_t);
+  fpta_bloom_buffer *buffer = (fpta_bloom_buffer *)malloc(bytes);
+  if (likely(buffer)) {
+    buffer->retired_next = nullptr;
+    buffer->capacity = blocks;
+  }
+  return buffer;
+}
+
+/* Обеспечивает копию буфером достаточного размера. Прежний буфер может
+ * читаться конкурентно, поэтому его освобождение откладывается до
+ * завершения начатых ранее читающих транзакций, см fpta_bloom_reclaim().
+ * Размер удваивается, чтобы отложенные буферы слота были в сумме меньше
+ * текущего. */
+static int fpta_bloom_reserve(fpta_db *db, fpta_bloom_slot *slot,
+                              uint32_t blocks) {
+  fpta_bloom_buffer *const buffer =
+      slot->buffer.load(std::memory_order_relaxed);
+  if (buffer && buffer->capacity >= blocks)
+    return FPTA_SUCCESS;
+
+  MDBX_envinfo info;
+  if (buffer) {
+    /* Замененный буфер может читаться только транзакциями, начатыми до
+     * замены, а их снимки не новее последней зафиксированной транзакции. */
+    int rc = mdbx_env_info_ex(db->mdbx_env, nullptr, &info, sizeof(info));
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  }
+
+  size_t capacity = buffer ? buffer->capacity : 1;
+  while (capacity < blocks)
+    capacity <<= 1;
+  fpta_bloom_buffer *const larger = fpta_bloom_buffer_alloc(capacity);
+  if (unlikely(!larger))
+    return FPTA_ENOMEM;
+  if (buffer) {
+    buffer->retired_txnid = info.mi_recent_txnid;
+    buffer->retired_next = db->bloom_retired;
+    db->bloom_retired = buffer;
+  }
+  slot->buffer.store(larger, std::memory_order_relaxed);
+  return FPTA_SUCCESS;
+}
+
+static __inline std::atomic<uint64_t> *
+fpta_bloom_words(const fpta_bloom_slot *slot, uint32_t number) {
+  return slot->buffer.load(std::memory_order_relaxed)->words +
+         size_t(number) * fpta_bloom_block_words;
+}
+
+static __inline void fpta_bloom_block_store(std::atomic<uint64_t> *words,
+                                            const uint64_t *block) {
+  for (size_t i = 0; i < fpta_bloom_block_words; ++i)
+    words[i].store(block[i], std::memory_order_relaxed);
+}
+
+/* Загружает копию фильтра из снимка данных транзакции,
+ * вызывается при изменении копии (seqlock) под bloom_mutex. */
+static int fpta_bloom_load(fpta_db *db, MDBX_txn *txn, MDBX_dbi dbi,
+                           uint64_t seq, fpta_bloom_slot *slot) {
+  slot->valid.store(false, std::memory_order_relaxed);
+  slot->base.store(fpta_bloom_nobase, std::memory_order_relaxed);
+  fpta_bloom_header header;
+  int rc = fpta_bloom_header_get(txn, dbi, header);
+  if (rc == MDBX_NOTFOUND) {
+    /* фильтр еще не построен и не может отсекать поиск */
+    slot->blocks.store(0, std::memory_order_relaxed);
+    slot->seq.store(seq, std::memory_order_relaxed);
+    slot->valid.store(true, std::memory_order_relaxed);
+    return FPTA_SUCCESS;
+  }
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  slot->blocks.store(0, std::memory_order_relaxed);
+  rc = fpta_bloom_reserve(db, slot, header.blocks);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_cursor *cursor;
+  rc = mdbx_cursor_open(txn, dbi, &cursor);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  MDBX_val key, data;
+  uint32_t expected = 0;
+  for (rc = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST);
+       rc == MDBX_SUCCESS;
+       rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
+    uint32_t number;
+    memcpy(&number, key.iov_base, sizeof(number));
+    if (unlikely(key.iov_len != sizeof(number) || number != expected++)) {
+      rc = FPTA_INDEX_CORRUPTED;
+      break;
+    }
+    if (number == 0)
+      continue;
+    if (unlikely(number > header.blocks ||
+                 data.iov_len != fpta_bloom_block_words * sizeof(uint64_t))) {
+      rc = FPTA_INDEX_CORRUPTED;
+      break;
+    }
+    /* значения в страницах mdbx не выровнены */
+    uint64_t block[fpta_bloom_block_words];
+    memcpy(block, data.iov_base, data.iov_len);
+    fpta_bloom_block_store(fpta_bloom_words(slot, number - 1), block);
+  }
+  mdbx_cursor_close(cursor);
+  if (unlikely(rc != MDBX_NOTFOUND))
+    return rc;
+  if (unlikely(expected != header.blocks + 1))
+    return FPTA_INDEX_CORRUPTED;
+
+  slot->blocks.store(header.blocks, std::memory_order_relaxed);
+  slot->hashes.store(header.hashes, std::memory_order_relaxed);
+  slot->seq.store(seq, std::memory_order_relaxed);
+  slot->valid.store(true, std::memory_order_relaxed);
+  return FPTA_SUCCESS;
+}
+
+/* Возвращает слот копии фильтра, при отсутствии и take == true
+ * занимает свободный либо вытесняет один из занятых.
+ * Вызывается под bloom_mutex. */
+static fpta_bloom_slot *fpta_bloom_slot_get(fpta_db *db,
+                                            const fpta_shove_t shove,
+                                            bool take) {
+  fpta_bloom_slot *vacant = nullptr;
+  for (size_t i = 0; i < fpta_bloom_cache_size; ++i) {
+    fpta_bloom_slot *slot = &db->bloom_cache[i];
+    const fpta_shove_t slot_shove = slot->shove.load(std::memory_order_relaxed);
+    if (slot_shove == shove)
+      return slot;
+    if (!vacant && slot_shove == 0)
+      vacant = slot;
+  }
+  if (!take)
+    return nullptr;
+
+  if (!vacant) {
+    /* вытесняем не измененную транзакцией копию */
+    for (size_t i = 0; i < fpta_bloom_cache_size && !vacant; ++i) {
+      fpta_bloom_slot *slot =
+          &db->bloom_cache[(shove + i) % fpta_bloom_cache_size];
+      if (!slot->dirty.load(std::memory_order_relaxed))
+        vacant = slot;
+    }
+    if (!vacant)
+      return nullptr;
+  }
+
+  /* буфер остается за слотом и используется повторно */
+  vacant->begin_update();
+  vacant->shove.store(shove, std::memory_order_relaxed);
+  vacant->tsn.store(0, std::memory_order_relaxed);
+  vacant->seq.store(0, std::memory_order_relaxed);
+  vacant->base.store(fpta_bloom_nobase, std::memory_order_relaxed);
+  vacant->blocks.store(0, std::memory_order_relaxed);
+  vacant->hashes.store(0, std::memory_order_relaxed);
+  vacant->valid.store(false, std::memory_order_relaxed);
+  vacant->dirty.store(false, std::memory_order_relaxed);
+  vacant->lookups.store(0, std::memory_order_relaxed);
+  vacant->negatives.store(0, std::memory_order_relaxed);
+  vacant->false_positives.store(0, std::memory_order_relaxed);
+  vacant->end_update();
+  return vacant;
+}
+
+/* Поиск слота копии без блокировки, для статистики. */
+static fpta_bloom_slot *fpta_bloom_slot_peek(fpta_db *db,
+                                             const fpta_shove_t shove) {
+  for (size_t i = 0; i < fpta_bloom_cache_size; ++i) {
+    fpta_bloom_slot *slot = &db->bloom_cache[i];
+    if (slot->shove.load(std::memory_order_relaxed) == shove)
+      return slot;
+  }
+  return nullptr;
+}
+
+static __inline fpta_shove_t
+fpta_bloom_shove(const fpta_table_schema *table_def, size_t column) {
+  return fpta_bloom_shove(table_def->table_shove(),
+                          table_def->column_shove(column));
+}
+
+/* Измененная копия до завершения пишущей транзакции пригодна для
+ * читающих только как надмножество предыдущего состояния. */
+static __inline bool fpta_bloom_usable(const fpta_bloom_slot *slot,
+                                       uint64_t tsn, uint64_t seq,
+                                       bool writer) {
+  if (!slot->valid.load(std::memory_order_relaxed) ||
+      slot->tsn.load(std::memory_order_relaxed) != tsn)
+    return false;
+  return (writer || !slot->dirty.load(std::memory_order_relaxed))
+             ? slot->seq.load(std::memory_order_relaxed) == seq
+             : slot->base.load(std::memory_order_relaxed) == seq;
+}
+
+/* Копирует блок ключа из копии, возвращает false если фильтр не построен.
+ * Без блокировки результат действителен только при неизменном seqlock. */
+static __inline bool fpta_bloom_fetch(const fpta_bloom_slot *slot,
+                                      uint64_t hash, uint64_t *block,
+                                      unsigned &hashes) {
+  const uint32_t blocks = slot->blocks.load(std::memory_order_relaxed);
+  const fpta_bloom_buffer *buffer =
+      slot->buffer.load(std::memory_order_relaxed);
+  if (blocks == 0 || !buffer || blocks > buffer->capacity)
+    return false;
+  hashes = slot->hashes.load(std::memory_order_relaxed);
+  const std::atomic<uint64_t> *words =
+      buffer->words +
+      size_t(fpta_bloom_block(hash, blocks)) * fpta_bloom_block_words;
+  for (size_t i = 0; i < fpta_bloom_block_words; ++i)
+    block[i] = words[i].load(std::memory_order_relaxed);
+  return true;
+}
+
+static __inline int fpta_bloom_account(fpta_bloom_slot *slot,
+                                       const uint64_t *block, uint64_t hash,
+                                       unsigned hashes) {
+  slot->lookups.fetch_add(1, std::memory_order_relaxed);
+  if (fpta_bloom_test(block, hash, hashes))
+    return FPTA_SUCCESS;
+  slot->negatives.fetch_add(1, std::memory_order_relaxed);
+  return FPTA_NODATA;
+}
+
+/* Проверка ключа по копии фильтра без блокировки. Возвращает false, если
+ * копии нет, она непригодна для транзакции либо изменяется конкурентно,
+ * тогда проверка повторяется под bloom_mutex. */
+static bool fpta_bloom_probe(fpta_db *db, const fpta_shove_t shove,
+                             uint64_t tsn, uint64_t seq, bool writer,
+                             uint64_t hash, int &rc, bool &accounted) {
+  fpta_bloom_slot *const slot = fpta_bloom_slot_peek(db, shove);
+  if (!slot)
+    return false;
+
+  const uint32_t begin = slot->seqlock.load(std::memory_order_acquire);
+  if (unlikely(begin & 1))
+    return false;
+  uint64_t block[fpta_bloom_block_words];
+  unsigned hashes = 0;
+  const bool usable = slot->shove.load(std::memory_order_relaxed) == shove &&
+                      fpta_bloom_usable(slot, tsn, seq, writer);
+  const bool built = usable && fpta_bloom_fetch(slot, hash, block, hashes);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot->seqlock.load(std::memory_order_relaxed) != begin || !usable)
+    return false;
+
+  accounted = built;
+  rc = built ? fpta_bloom_account(slot, block, hash, hashes)
+             : (int)FPTA_SUCCESS;
+  return true;
+}
+
+int fpta_bloom_lookup(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column, const MDBX_val &key, bool &accounted) {
+  assert(table_def->bloom_bits(column) > 0);
+  accounted = false;
+  const fpta_shove_t shove = fpta_bloom_shove(table_def, column);
+  MDBX_dbi dbi;
+  int rc = fpta_bloom_open(txn, shove, dbi, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  uint64_t seq;
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, dbi, &seq, 0);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  const uint64_t hash = fpta_bloom_hash(key);
+  const uint64_t tsn = table_def->version_tsn();
+  const bool writer = txn->level >= fpta_write;
+  fpta_db *db = txn->db;
+  if (likely(fpta_bloom_probe(db, shove, tsn, seq, writer, hash, rc,
+                              accounted)))
+    return rc;
+
+  fpta_lock_guard guard;
+  rc = guard.lock(&db->bloom_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+
+  fpta_bloom_slot *slot = fpta_bloom_slot_get(db, shove, true);
+  if (likely(slot)) {
+    bool usable = fpta_bloom_usable(slot, tsn, seq, writer);
+    const bool dirty = slot->dirty.load(std::memory_order_relaxed);
+    const bool valid = slot->valid.load(std::memory_order_relaxed);
+    const uint64_t slot_tsn = slot->tsn.load(std::memory_order_relaxed);
+    if (!usable &&
+        (writer ||
+         (!dirty && (!valid || slot_tsn < tsn ||
+                     (slot_tsn == tsn &&
+                      slot->seq.load(std::memory_order_relaxed) < seq))))) {
+      /* копия устарела, а снимок данных транзакции новее */
+      slot->begin_update();
+      slot->tsn.store(tsn, std::memory_order_relaxed);
+      rc = fpta_bloom_load(db, txn->mdbx_txn, dbi, seq, slot);
+      if (likely(rc == FPTA_SUCCESS))
+        slot->dirty.store(writer, std::memory_order_relaxed);
+      slot->end_update();
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      db->bloom_dirty |= writer;
+      usable = true;
+    }
+
+    if (usable) {
+      uint64_t block[fpta_bloom_block_words];
+      unsigned hashes;
+      if (!fpta_bloom_fetch(slot, hash, block, hashes))
+        return FPTA_SUCCESS;
+      accounted = true;
+      return fpta_bloom_account(slot, block, hash, hashes);
+    }
+  }
+  guard.unlock();
+
+  /* проверяем блок в самой таблице фильтра */
+  fpta_bloom_header header;
+  rc = fpta_bloom_header_get(txn->mdbx_txn, dbi, header);
+  if (rc != MDBX_SUCCESS)
+    return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_SUCCESS;
+  uint64_t block[fpta_bloom_block_words];
+  rc = fpta_bloom_block_get(txn->mdbx_txn, dbi,
+                            fpta_bloom_block(hash, header.blocks), block);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  return fpta_bloom_test(block, hash, header.hashes) ? FPTA_SUCCESS
+                                                     : FPTA_NODATA;
+}
+
+void fpta_bloom_false_positive(fpta_txn *txn,
+                               const fpta_table_schema *table_def,
+                               size_t column) {
+  fpta_bloom_slot *slot =
+      fpta_bloom_slot_peek(txn->db, fpta_bloom_shove(table_def, column));
+  if (slot)
+    slot->false_positives.fetch_add(1, std::memory_order_relaxed);
+}
+
+int fpta_bloom_insert(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column, MDBX_dbi index_dbi, const MDBX_val &key) {
+  assert(txn->level >= fpta_write);
+  const fpta_shove_t shove = fpta_bloom_shove(table_def, column);
+  MDBX_dbi dbi;
+  int rc = fpta_bloom_open(txn, shove, dbi, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_bloom_header header;
+  rc = fpta_bloom_header_get(txn->mdbx_txn, dbi, header);
+  if (rc == MDBX_NOTFOUND)
+    /* ключ уже добавлен в индекс и попадет в фильтр при построении */
+    return fpta_bloom_rebuild(txn, table_def, column, index_dbi);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  uint64_t seq;
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, dbi, &seq, 1);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  const uint64_t capacity =
+      uint64_t(header.blocks) * fpta_bloom_block_bits / header.bits_per_key;
+  if (header.keys + (seq + 1 - header.seq) > capacity)
+    return fpta_bloom_rebuild(txn, table_def, column, index_dbi);
+
+  const uint64_t hash = fpta_bloom_hash(key);
+  const uint32_t number = fpta_bloom_block(hash, header.blocks);
+  uint64_t block[fpta_bloom_block_words];
+  rc = fpta_bloom_block_get(txn->mdbx_txn, dbi, number, block);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  if (fpta_bloom_set(block, hash, header.hashes)) {
+    rc = fpta_bloom_block_put(txn->mdbx_txn, dbi, number, block, 0);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  }
+
+  fpta_db *db = txn->db;
+  fpta_lock_guard guard;
+  rc = guard.lock(&db->bloom_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+  fpta_bloom_slot *slot = fpta_bloom_slot_get(db, shove, false);
+  if (slot) {
+    const bool dirty = slot->dirty.load(std::memory_order_relaxed);
+    slot->begin_update();
+    if (slot->valid.load(std::memory_order_relaxed) &&
+        slot->tsn.load(std::memory_order_relaxed) ==
+            table_def->version_tsn() &&
+        slot->seq.load(std::memory_order_relaxed) == seq &&
+        slot->blocks.load(std::memory_order_relaxed) == header.blocks) {
+      /* блок копии совпадает с уже измененным блоком таблицы */
+      fpta_bloom_block_store(fpta_bloom_words(slot, number), block);
+      if (!dirty)
+        slot->base.store(seq, std::memory_order_relaxed);
+      slot->seq.store(seq + 1, std::memory_order_relaxed);
+      slot->dirty.store(true, std::memory_order_relaxed);
+      db->bloom_dirty = true;
+    } else if (!dirty)
+      slot->valid.store(false, std::memory_order_relaxed);
+    slot->end_update();
+  }
+  return FPTA_SUCCESS;
+}
+
+int fpta_bloom_rebuild(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, MDBX_dbi index_dbi) {
+  assert(txn->level >= fpta_write);
+  const unsigned bits_per_key = table_def->bloom_bits(column);
+  assert(bits_per_key > 0);
+  const fpta_shove_t shove = fpta_bloom_shove(table_def, column);
+  MDBX_dbi dbi;
+  int rc = fpta_bloom_open(txn, shove, dbi, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_stat stat;
+  rc = mdbx_dbi_stat(txn->mdbx_txn, index_dbi, &stat, sizeof(stat));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  fpta_bloom_header header;
+  memset(&header, 0, sizeof(header));
+  header.blocks = fpta_bloom_blocks(stat.ms_entries, bits_per_key);
+  header.hashes = (uint16_t)fpta_bloom_hashes(bits_per_key);
+  header.bits_per_key = (uint16_t)bits_per_key;
+  header.keys = stat.ms_entries;
+
+  uint64_t *words = (uint64_t *)calloc(
+      size_t(header.blocks) * fpta_bloom_block_words, sizeof(uint64_t));
+  if (unlikely(!words))
+    return FPTA_ENOMEM;
+
+  MDBX_cursor *cursor;
+  MDBX_val key, data;
+  uint64_t seq;
+  rc = mdbx_cursor_open(txn->mdbx_txn, index_dbi, &cursor);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  for (rc = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST);
+       rc == MDBX_SUCCESS;
+       rc = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT_NODUP)) {
+    const uint64_t hash = fpta_bloom_hash(key);
+    fpta_bloom_set(words + size_t(fpta_bloom_block(hash, header.blocks)) *
+                               fpta_bloom_block_words,
+                   hash, header.hashes);
+  }
+  mdbx_cursor_close(cursor);
+  if (unlikely(rc != MDBX_NOTFOUND))
+    goto bailout;
+
+  /* mdbx_drop() сбрасывает счетчик, поэтому он восстанавливается
+   * с увеличением, что делает недействительными прежние копии */
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, dbi, &seq, 0);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  rc = mdbx_drop(txn->mdbx_txn, dbi, false);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  header.seq = seq + 1;
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, dbi, nullptr, header.seq);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+
+  {
+    const uint32_t zero = 0;
+    key.iov_base = (void *)&zero;
+    key.iov_len = sizeof(zero);
+    data.iov_base = &header;
+    data.iov_len = sizeof(header);
+    rc = mdbx_put(txn->mdbx_txn, dbi, &key, &data, MDBX_APPEND);
+  }
+  for (uint32_t n = 0; n < header.blocks && rc == MDBX_SUCCESS; ++n)
+    rc = fpta_bloom_block_put(txn->mdbx_txn, dbi, n,
+                              words + size_t(n) * fpta_bloom_block_words,
+                              MDBX_APPEND);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+
+  {
+    /* построенный фильтр сразу становится копией в памяти */
+    fpta_db *db = txn->db;
+    fpta_lock_guard guard;
+    rc = guard.lock(&db->bloom_mutex);
+    if (unlikely(rc != 0))
+      goto bailout;
+    fpta_bloom_slot *slot = fpta_bloom_slot_get(db, shove, true);
+    if (slot) {
+      slot->begin_update();
+      slot->base.store(fpta_bloom_nobase, std::memory_order_relaxed);
+      slot->blocks.store(0, std::memory_order_relaxed);
+      if (likely(fpta_bloom_reserve(db, slot, header.blocks) ==
+                 FPTA_SUCCESS)) {
+        for (uint32_t n = 0; n < header.blocks; ++n)
+          fpta_bloom_block_store(fpta_bloom_words(slot, n),
+                                 words + size_t(n) * fpta_bloom_block_words);
+        slot->blocks.store(header.blocks, std::memory_order_relaxed);
+        slot->hashes.store(header.hashes, std::memory_order_relaxed);
+        slot->tsn.store(table_def->version_tsn(), std::memory_order_relaxed);
+        slot->seq.store(header.seq, std::memory_order_relaxed);
+        slot->valid.store(true, std::memory_order_relaxed);
+      } else {
+        /* не критично, копия будет загружена при следующей проверке */
+        slot->valid.store(false, std::memory_order_relaxed);
+      }
+      slot->dirty.store(true, std::memory_order_relaxed);
+      slot->end_update();
+      db->bloom_dirty = true;
+    }
+  }
+
+bailout:
+  free(words);
+  return rc;
+}
+
+int fpta_bloom_stat(fpta_txn *txn, const fpta_table_schema *table_def,
+                    size_t column, fpta_table_stat *stat) {
+  const fpta_shove_t shove = fpta_bloom_shove(table_def, column);
+  MDBX_dbi dbi;
+  int rc = fpta_bloom_open(txn, shove, dbi, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_stat mdbx_stat;
+  rc = mdbx_dbi_stat(txn->mdbx_txn, dbi, &mdbx_stat, sizeof(mdbx_stat));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  stat->bloom_bytes += size_t(mdbx_stat.ms_branch_pages +
+                              mdbx_stat.ms_leaf_pages +
+                              mdbx_stat.ms_overflow_pages) *
+                       mdbx_stat.ms_psize;
+
+  const fpta_bloom_slot *slot = fpta_bloom_slot_peek(txn->db, shove);
+  if (slot) {
+    stat->bloom_lookups += slot->lookups.load(std::memory_order_relaxed);
+    stat->bloom_negatives += slot->negatives.load(std::memory_order_relaxed);
+    stat->bloom_false_positives +=
+        slot->false_positives.load(std::memory_order_relaxed);
+  }
+  return FPTA_SUCCESS;
+}
+
+/* Завершает изменения копий фильтров пишущей транзакцией: после фиксации
+ * копии становятся чистыми, а после отмены сбрасываются. */
+void fpta_bloom_settle(fpta_db *db, bool committed) {
+  assert(db->bloom_dirty);
+  int err = fpta_mutex_lock(&db->bloom_mutex);
+  assert(err == 0);
+  for (size_t i = 0; i < fpta_bloom_cache_size; ++i) {
+    fpta_bloom_slot *slot = &db->bloom_cache[i];
+    if (slot->dirty.load(std::memory_order_relaxed)) {
+      slot->begin_update();
+      slot->dirty.store(false, std::memory_order_relaxed);
+      slot->base.store(fpta_bloom_nobase, std::memory_order_relaxed);
+      if (!committed)
+        slot->valid.store(false, std::memory_order_relaxed);
+      slot->end_update();
+    }
+  }
+  db->bloom_dirty = false;
+  err = fpta_mutex_unlock(&db->bloom_mutex);
+  assert(err == 0);
+  (void)err;
+}
+
+/* Освобождает замененные буферы копий, которые не могут читаться
+ * конкурентно. Вызывается при старте пишущей транзакции, т.е. когда
+ * других писателей нет, а при блокировке схемы (exclusive) нет и читателей.
+ * Иначе освобождаются буферы, замененные до начала самой старой из
+ * читающих транзакций процесса, так как копии фильтров у каждого процесса
+ * свои. Ошибки не критичны, буферы будут освобождены позже. */
+void fpta_bloom_reclaim(fpta_db *db, bool exclusive) {
+  int err = fpta_mutex_lock(&db->bloom_mutex);
+  assert(err == 0);
+  if (db->bloom_retired) {
+    uint64_t oldest_reader = UINT64_MAX;
+    if (!exclusive) {
+      MDBX_envinfo info;
+      oldest_reader =
+          (mdbx_env_info_ex(db->mdbx_env, nullptr, &info, sizeof(info)) ==
+           MDBX_SUCCESS)
+              ? info.mi_self_latter_reader_txnid
+              : 0;
+    }
+    fpta_bloom_buffer **ptr = &db->bloom_retired;
+    while (*ptr) {
+      fpta_bloom_buffer *const buffer = *ptr;
+      if (buffer->retired_txnid < oldest_reader) {
+        *ptr = buffer->retired_next;
+        free(buffer);
+      } else
+        ptr = &buffer->retired_next;
+    }
+  }
+  err = fpta_mutex_unlock(&db->bloom_mutex);
+  assert(err == 0);
+  (void)err;
+}
+
+void fpta_bloom_purge(fpta_db *db) {
+  for (size_t i = 0; i < fpta_bloom_cache_size; ++i) {
+    free(db->bloom_cache[i].buffer.exchange(nullptr));
+    db->bloom_cache[i].shove.store(0, std::memory_order_relaxed);
+  }
+  while (db->bloom_retired) {
+    fpta_bloom_buffer *const buffer = db->bloom_retired;
+    db->bloom_retired = buffer->retired_next;
+    free(buffer);
+  }
+}
@@ -17,15 +17,27 @@
 
 #include "details.h"
 
-static int fpta_db_lock(fpta_db *db, fpta_level level) {
+#include <chrono>
+
+static __inline size_t fpta_thread_hint() {
+  /* Адрес thread-local переменной уникален для каждого потока, что позволяет
+   * разнести потоки по разным слотам пулов и снизить конкуренцию. */
+  static thread_local char anchor;
+  const uint64_t mix = uint64_t(reinterpret_cast<uintptr_t>(&anchor) >> 4) *
+                       UINT64_C(0x9E3779B97F4A7C15);
+  return size_t(mix >> 40);
+}
+
+static int fpta_db_lock(fpta_db *db, fpta_level level, unsigned &guard_slot) {
   assert(level >= fpta_read && level <= fpta_schema);
 
   int rc;
   if (db->alterable_schema) {
-    if (level < fpta_schema)
-      rc = fpta_rwl_sharedlock(&db->schema_rwlock);
-    else
-      rc = fpta_rwl_exclusivelock(&db->schema_rwlock);
+    if (level < fpta_schema) {
+      guard_slot = unsigned(fpta_thread_hint() % FPTA_BRWL_SHARDS);
+      rc = fpta_brwl_sharedlock(&db->schema_guard, guard_slot);
+    } else
+      rc = fpta_brwl_exclusivelock(&db->schema_guard);
     assert(rc == FPTA_SUCCESS);
   } else {
     rc = (level < fpta_schema) ? FPTA_SUCCESS : FPTA_EPERM;
@@ -34,13 +46,14 @@ static int fpta_db_lock(fpta_db *db, fpta_level level) {
   return rc;
 }
 
-static int fpta_db_unlock(fpta_db *db, fpta_level level) {
-  (void)level;
+static int fpta_db_unlock(fpta_db *db, fpta_level level, unsigned guard_slot) {
   assert(level >= fpta_read && level <= fpta_schema);
 
   int rc;
   if (db->alterable_schema) {
-    rc = fpta_rwl_unlock(&db->schema_rwlock);
+    rc = (level < fpta_schema)
+             ? fpta_brwl_sharedunlock(&db->schema_guard, guard_slot)
+             : fpta_brwl_exclusiveunlock(&db->schema_guard);
   } else {
     rc = (level < fpta_schema) ? FPTA_SUCCESS : FPTA_EOOPS;
   }
@@ -49,9 +62,11 @@ static int fpta_db_unlock(fpta_db *db, fpta_level level) {
 }
 
 static fpta_txn *fpta_txn_alloc(fpta_db *db, fpta_level level) {
-  // TODO: use pool
-  (void)level;
-  fpta_txn *txn = (fpta_txn *)calloc(1, sizeof(fpta_txn));
+  fpta_txn *txn = db->txn_freelist.take(fpta_thread_hint());
+  if (likely(txn))
+    memset((void *)txn, 0, sizeof(fpta_txn));
+  else
+    txn = (fpta_txn *)calloc(1, sizeof(fpta_txn));
   if (likely(txn)) {
     txn->db = db;
     txn->level = level;
@@ -60,30 +75,144 @@ static fpta_txn *fpta_txn_alloc(fpta_db *db, fpta_level level) {
 }
 
 static void fpta_txn_free(fpta_db *db, fpta_txn *txn) {
-  // TODO: use pool
-  (void)db;
   if (likely(txn)) {
     assert(txn->db == db);
     txn->db = nullptr;
-    free(txn);
+    if (!db->txn_freelist.put(txn, fpta_thread_hint()))
+      free(txn);
   }
 }
 
+//----------------------------------------------------------------------------
+
+/* Пул "припаркованных" читающих транзакций.
+ *
+ * Каждый слот пула либо пуст (nullptr), либо временно занят (резерв для
+ * помещения транзакции в пул или её изъятия), либо содержит транзакцию,
+ * MDBX-часть которой сброшена посредством mdbx_txn_reset(). Такая транзакция
+ * не удерживает снимок данных и слот читателя, и может быть возобновлена
+ * через mdbx_txn_renew() в любом потоке. */
+
+static __inline fpta_txn *fpta_txn_pool_busy() {
+  return reinterpret_cast<fpta_txn *>(uintptr_t(1));
+}
+
+static __inline bool fpta_txn_pool_parked(const fpta_txn *txn) {
+  return uintptr_t(txn) > uintptr_t(fpta_txn_pool_busy());
+}
+
+static std::atomic<fpta_txn *> *fpta_txn_pool_reserve(fpta_db *db) {
+  const size_t hint = fpta_thread_hint();
+  for (size_t i = 0; i < fpta_txn_pool_size; ++i) {
+    std::atomic<fpta_txn *> &slot =
+        db->txn_pool[(hint + i) % fpta_txn_pool_size];
+    fpta_txn *expected = slot.load(std::memory_order_relaxed);
+    if (expected == nullptr &&
+        slot.compare_exchange_strong(expected, fpta_txn_pool_busy(),
+                                     std::memory_order_relaxed))
+      return &slot;
+  }
+  return nullptr;
+}
+
+static std::atomic<fpta_txn *> *fpta_txn_pool_take(fpta_db *db,
+                                                   fpta_txn *&txn) {
+  const size_t hint = fpta_thread_hint();
+  for (size_t i = 0; i < fpta_txn_pool_size; ++i) {
+    std::atomic<fpta_txn *> &slot =
+        db->txn_pool[(hint + i) % fpta_txn_pool_size];
+    fpta_txn *parked = slot.load(std::memory_order_relaxed);
+    if (fpta_txn_pool_parked(parked) &&
+        slot.compare_exchange_strong(parked, fpta_txn_pool_busy(),
+                                     std::memory_order_acquire)) {
+      assert(parked->db == db && parked->level == fpta_read);
+      txn = parked;
+      return &slot;
+    }
+  }
+  txn = nullptr;
+  return nullptr;
+}
+
+static void fpta_txn_pool_drain(fpta_db *db) {
+  for (size_t i = 0; i < fpta_txn_pool_size; ++i) {
+    fpta_txn *txn = db->txn_pool[i].exchange(nullptr);
+    assert(txn != fpta_txn_pool_busy());
+    if (fpta_txn_pool_parked(txn)) {
+      /* Сброшенную транзакцию libmdbx позволяет освободить только после
+       * её возобновления в текущем потоке. */
+      int err = mdbx_txn_renew(txn->mdbx_txn);
+      if (likely(err == MDBX_SUCCESS))
+        err = mdbx_txn_abort(txn->mdbx_txn);
+      assert(err == MDBX_SUCCESS);
+      (void)err;
+      txn->mdbx_txn = nullptr;
+      fpta_txn_free(db, txn);
+    }
+  }
+}
+
+/* Кэш версии схемы для последнего проверенного снимка данных.
+ * Схема не может измениться в пределах одного снимка (txnid), поэтому
+ * для читающих транзакций, получивших тот-же снимок, повторная проверка
+ * посредством fpta_open_schema() не требуется. */
+
+static bool fpta_schema_probe_lookup(fpta_db *db, fpta_txn *txn) {
+  const uint64_t seq = db->schema_probe_seq.load(std::memory_order_acquire);
+  if (unlikely(seq & 1))
+    return false;
+
+  const uint64_t txnid = db->schema_probe_txnid.load(std::memory_order_relaxed);
+  const uint64_t tsn = db->schema_probe_tsn.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (unlikely(db->schema_probe_seq.load(std::memory_order_relaxed) != seq ||
+               txnid != txn->db_version || db->schema_dbi < 1))
+    return false;
+
+  assert(tsn <= txn->db_version);
+  txn->schema_tsn_ = tsn;
+  return true;
+}
+
+static void fpta_schema_probe_update(fpta_db *db, const fpta_txn *txn) {
+  uint64_t seq = db->schema_probe_seq.load(std::memory_order_relaxed);
+  if ((seq & 1) == 0 &&
+      db->schema_probe_seq.compare_exchange_strong(seq, seq + 1,
+                                                   std::memory_order_relaxed)) {
+    std::atomic_thread_fence(std::memory_order_release);
+    db->schema_probe_txnid.store(txn->db_version, std::memory_order_relaxed);
+    db->schema_probe_tsn.store(txn->schema_tsn_, std::memory_order_relaxed);
+    db->schema_probe_seq.store(seq + 2, std::memory_order_release);
+  }
+}
+
+//----------------------------------------------------------------------------
+
 fpta_cursor *fpta_cursor_alloc(fpta_db *db) {
-  // TODO: use pool
-  fpta_cursor *cursor = (fpta_cursor *)calloc(1, sizeof(fpta_cursor));
+  fpta_cursor *cursor = db->cursor_freelist.take(fpta_thread_hint());
+  if (likely(cursor))
+    memset((void *)cursor, 0, sizeof(fpta_cursor));
+  else
+    cursor = (fpta_cursor *)calloc(1, sizeof(fpta_cursor));
   if (likely(cursor))
     cursor->db = db;
   return cursor;
 }
 
 void fpta_cursor_free(fpta_db *db, fpta_cursor *cursor) {
-  // TODO: use pool
   if (likely(cursor)) {
     assert(cursor->db == db);
-    (void)db;
     cursor->db = nullptr;
-    free(cursor);
+    cursor->mdbx_cursor = nullptr;
+    free(cursor->range_spill);
+    cursor->range_spill = nullptr;
+    fpta_bitmap_release(cursor->bitmap_filter);
+    cursor->bitmap_filter = nullptr;
+    if (cursor->external_storage)
+      /* память курсора предоставлена вызывающим кодом */
+      return;
+    if (!db->cursor_freelist.put(cursor, fpta_thread_hint()))
+      free(cursor);
   }
 }
 
@@ -137,7 +266,10 @@ int fpta_db_create_or_open(const char *path, fpta_durability durability,
     break;
   }
 
-  fpta_db *db = (fpta_db *)calloc(1, sizeof(fpta_db));
+  /* выравнивание требуется для размещения счетчиков schema_guard
+   * в отдельных кэш-линиях */
+  fpta_db *db =
+      (fpta_db *)fpta_aligned_calloc(sizeof(fpta_db), alignof(fpta_db));
   if (unlikely(db == nullptr))
     return FPTA_ENOMEM;
   db->regime_flags = regime_flags;
@@ -145,21 +277,38 @@ int fpta_db_create_or_open(const char *path, fpta_durability durability,
   int rc;
   db->alterable_schema = alterable_schema;
   if (db->alterable_schema) {
-    rc = fpta_rwl_init(&db->schema_rwlock);
+    rc = fpta_brwl_init(&db->schema_guard);
     if (unlikely(rc != 0)) {
-      free(db);
+      fpta_aligned_free(db);
       return (fpta_error)rc;
     }
   }
 
+  int err;
   rc = fpta_mutex_init(&db->dbi_mutex);
-  if (unlikely(rc != 0)) {
-    int err = fpta_rwl_destroy(&db->schema_rwlock);
-    assert(err == 0);
-    (void)err;
-    free(db);
-    return (fpta_error)rc;
-  }
+  if (unlikely(rc != 0))
+    goto bailout_schema_guard;
+
+  rc = fpta_mutex_init(&db->commit_mutex);
+  if (unlikely(rc != 0))
+    goto bailout_dbi_mutex;
+
+  rc = fpta_cond_init(&db->commit_cond);
+  if (unlikely(rc != 0))
+    goto bailout_commit_mutex;
+  db->commit_tail = &db->commit_head;
+
+  rc = fpta_mutex_init(&db->durable_mutex);
+  if (unlikely(rc != 0))
+    goto bailout_commit_cond;
+
+  rc = fpta_cond_init(&db->durable_cond);
+  if (unlikely(rc != 0))
+    goto bailout_durable_mutex;
+
+  rc = fpta_mutex_init(&db->bloom_mutex);
+  if (unlikely(rc != 0))
+    goto bailout_durable_cond;
 
   if (unlikely(regime_flags & fpta_madness4testing)) {
     mdbx_setup_debug(MDBX_LOG_WARN,
@@ -218,20 +367,34 @@ int fpta_db_create_or_open(const char *path, fpta_durability durability,
 
 bailout:
   if (db->mdbx_env) {
-    int err = mdbx_env_close_ex(db->mdbx_env, true /* don't touch/save/sync */);
+    err = mdbx_env_close_ex(db->mdbx_env, true /* don't touch/save/sync */);
     assert(err == MDBX_SUCCESS);
-    (void)err;
   }
-
-  int err = fpta_mutex_destroy(&db->dbi_mutex);
+  err = fpta_mutex_destroy(&db->bloom_mutex);
+  assert(err == 0);
+bailout_durable_cond:
+  err = fpta_cond_destroy(&db->durable_cond);
+  assert(err == 0);
+bailout_durable_mutex:
+  err = fpta_mutex_destroy(&db->durable_mutex);
   assert(err == 0);
+bailout_commit_cond:
+  err = fpta_cond_destroy(&db->commit_cond);
+  assert(err == 0);
+bailout_commit_mutex:
+  err = fpta_mutex_destroy(&db->commit_mutex);
+  assert(err == 0);
+bailout_dbi_mutex:
+  err = fpta_mutex_destroy(&db->dbi_mutex);
+  assert(err == 0);
+bailout_schema_guard:
   if (alterable_schema) {
-    err = fpta_rwl_destroy(&db->schema_rwlock);
+    err = fpta_brwl_destroy(&db->schema_guard);
     assert(err == 0);
   }
   (void)err;
 
-  free(db);
+  fpta_aligned_free(db);
   return (fpta_error)rc;
 }
 
@@ -239,18 +402,27 @@ int fpta_db_close(fpta_db *db) {
   if (unlikely(!fpta_db_validate(db)))
     return FPTA_EINVAL;
 
-  int rc = fpta_db_lock(db, db->alterable_schema ? fpta_schema : fpta_write);
+  int rc = fpta_db_flusher_stop(db);
+  if (unlikely(rc != 0))
+    return (fpta_error)rc;
+
+  const fpta_level level = db->alterable_schema ? fpta_schema : fpta_write;
+  unsigned guard_slot = 0;
+  rc = fpta_db_lock(db, level, guard_slot);
   if (unlikely(rc != 0))
     return (fpta_error)rc;
 
   rc = fpta_mutex_lock(&db->dbi_mutex);
   if (unlikely(rc != 0)) {
-    int err = fpta_db_unlock(db, fpta_schema);
+    int err = fpta_db_unlock(db, level, guard_slot);
     assert(err == 0);
     (void)err;
     return (fpta_error)rc;
   }
 
+  fpta_txn_pool_drain(db);
+  db->txn_freelist.drain();
+  db->cursor_freelist.drain();
   rc = (fpta_error)mdbx_env_close_ex(db->mdbx_env, false);
   assert(rc == MDBX_SUCCESS);
   db->mdbx_env = nullptr;
@@ -260,15 +432,31 @@ int fpta_db_close(fpta_db *db) {
   err = fpta_mutex_destroy(&db->dbi_mutex);
   assert(err == 0);
 
-  err = fpta_db_unlock(db, db->alterable_schema ? fpta_schema : fpta_write);
+  assert(db->commit_head == nullptr && !db->commit_leader);
+  err = fpta_cond_destroy(&db->commit_cond);
+  assert(err == 0);
+  err = fpta_mutex_destroy(&db->commit_mutex);
+  assert(err == 0);
+
+  assert(db->durable_pending == nullptr && !db->flusher_active);
+  err = fpta_cond_destroy(&db->durable_cond);
+  assert(err == 0);
+  err = fpta_mutex_destroy(&db->durable_mutex);
+  assert(err == 0);
+
+  fpta_bloom_purge(db);
+  err = fpta_mutex_destroy(&db->bloom_mutex);
+  assert(err == 0);
+
+  err = fpta_db_unlock(db, level, guard_slot);
   assert(err == 0);
   if (db->alterable_schema) {
-    err = fpta_rwl_destroy(&db->schema_rwlock);
+    err = fpta_brwl_destroy(&db->schema_guard);
     assert(err == 0);
   }
   (void)err;
 
-  free(db);
+  fpta_aligned_free(db);
   return (fpta_error)rc;
 }
 
@@ -328,6 +516,9 @@ static int fpta_open_schema(fpta_txn *txn) {
   return MDBX_SUCCESS;
 }
 
+static int fpta_transaction_start(fpta_db *db, fpta_level level,
+                                  unsigned guard_slot, fpta_txn **ptxn);
+
 int fpta_transaction_begin(fpta_db *db, fpta_level level, fpta_txn **ptxn) {
   if (unlikely(ptxn == nullptr))
     return FPTA_EINVAL;
@@ -339,29 +530,86 @@ int fpta_transaction_begin(fpta_db *db, fpta_level level, fpta_txn **ptxn) {
   if (unlikely(!fpta_db_validate(db)))
     return FPTA_EINVAL;
 
-  int err = fpta_db_lock(db, level);
+  unsigned guard_slot = 0;
+  int err = fpta_db_lock(db, level, guard_slot);
   if (unlikely(err != 0))
     return err;
 
-  int rc = FPTA_ENOMEM;
-  fpta_txn *txn = fpta_txn_alloc(db, level);
-  if (unlikely(txn == nullptr))
-    goto bailout;
+  return fpta_transaction_start(db, level, guard_slot, ptxn);
+}
 
-  rc = mdbx_txn_begin(db->mdbx_env, nullptr,
-                      (level == fpta_read) ? (unsigned)MDBX_RDONLY : 0u,
-                      &txn->mdbx_txn);
-  if (unlikely(rc != MDBX_SUCCESS))
-    goto bailout;
+int fpta_transaction_sibling(fpta_txn *txn, fpta_txn **psibling) {
+  if (unlikely(psibling == nullptr))
+    return FPTA_EINVAL;
+  *psibling = nullptr;
 
-  for (;;) {
-    txn->db_version = mdbx_txn_id(txn->mdbx_txn);
-    rc = fpta_open_schema(txn);
+  int rc = fpta_txn_validate(txn, fpta_read);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (unlikely(txn->level != fpta_read))
+    return FPTA_EPERM;
+
+  /* Блокировка схемы уже удерживается транзакцией txn, поэтому захватывается
+   * без уступки ожидающему писателю. Иначе возможна взаимоблокировка, так как
+   * писатель ждет завершения txn, а владелец txn ждет соседнюю транзакцию. */
+  fpta_db *db = txn->db;
+  unsigned guard_slot = 0;
+  if (db->alterable_schema) {
+    guard_slot = unsigned(fpta_thread_hint() % FPTA_BRWL_SHARDS);
+    rc = fpta_brwl_sharedlock_nested(&db->schema_guard, guard_slot);
+    if (unlikely(rc != 0))
+      return rc;
+  }
+
+  return fpta_transaction_start(db, fpta_read, guard_slot, psibling);
+}
+
+static int fpta_transaction_start(fpta_db *db, fpta_level level,
+                                  unsigned guard_slot, fpta_txn **ptxn) {
+  int err, rc = FPTA_ENOMEM;
+  fpta_txn *txn = nullptr;
+  if (level == fpta_read) {
+    std::atomic<fpta_txn *> *const slot = fpta_txn_pool_take(db, txn);
+    if (slot) {
+      rc = mdbx_txn_renew(txn->mdbx_txn);
+      if (unlikely(rc != MDBX_SUCCESS)) {
+        /* возвращаем транзакцию обратно в пул */
+        slot->store(txn, std::memory_order_release);
+        txn = nullptr;
+        goto bailout;
+      }
+      slot->store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  if (txn == nullptr) {
+    txn = fpta_txn_alloc(db, level);
+    if (unlikely(txn == nullptr))
+      goto bailout;
+
+    rc = mdbx_txn_begin(db->mdbx_env, nullptr,
+                        (level == fpta_read) ? (unsigned)MDBX_RDONLY : 0u,
+                        &txn->mdbx_txn);
     if (unlikely(rc != MDBX_SUCCESS))
       goto bailout;
+  }
+
+  for (;;) {
+    txn->db_version = mdbx_txn_id(txn->mdbx_txn);
+    if (level != fpta_read || !fpta_schema_probe_lookup(db, txn)) {
+      rc = fpta_open_schema(txn);
+      if (unlikely(rc != MDBX_SUCCESS))
+        goto bailout;
+      if (level == fpta_read)
+        fpta_schema_probe_update(db, txn);
+    }
 
     rc = fpta_dbicache_cleanup(txn, nullptr);
     if (likely(rc == FPTA_SUCCESS)) {
+      txn->guard_slot = guard_slot;
+      if (level != fpta_read)
+        /* замененные копии фильтров Блума, которые уже не читаются */
+        fpta_bloom_reclaim(db, level == fpta_schema);
       *ptxn = txn;
       return FPTA_SUCCESS;
     }
@@ -380,7 +628,7 @@ int fpta_transaction_begin(fpta_db *db, fpta_level level, fpta_txn **ptxn) {
   rc = fpta_internal_abort(txn, rc, false);
 
 bailout:
-  err = fpta_db_unlock(db, level);
+  err = fpta_db_unlock(db, level, guard_slot);
   assert(err == 0);
   (void)err;
   fpta_txn_free(db, txn);
@@ -397,7 +645,24 @@ int fpta_transaction_end(fpta_txn *txn, bool abort) {
   }
 
   if (txn->level == fpta_read) {
-    // TODO: reuse txn with mdbx_txn_reset(), but pool needed...
+    /* Вместо завершения "паркуем" читающую транзакцию в пуле, если в нём
+     * есть свободный слот. Слот резервируется до сброса транзакции, а сама
+     * транзакция помещается в пул до освобождения блокировки схемы, что
+     * исключает утечку при конкурентном закрытии БД. */
+    std::atomic<fpta_txn *> *const slot = fpta_txn_pool_reserve(txn->db);
+    if (likely(slot)) {
+      rc = mdbx_txn_reset(txn->mdbx_txn);
+      if (likely(rc == MDBX_SUCCESS)) {
+        fpta_db *const db = txn->db;
+        const unsigned guard_slot = txn->guard_slot;
+        slot->store(txn, std::memory_order_release);
+        int err = fpta_db_unlock(db, fpta_read, guard_slot);
+        assert(err == 0);
+        (void)err;
+        return FPTA_SUCCESS;
+      }
+      slot->store(nullptr, std::memory_order_relaxed);
+    }
     rc = mdbx_txn_commit(txn->mdbx_txn);
     abort = false;
   } else if (likely(!abort)) {
@@ -407,6 +672,8 @@ int fpta_transaction_end(fpta_txn *txn, bool abort) {
     rc = mdbx_txn_commit(txn->mdbx_txn);
     if (unlikely(rc == MDBX_RESULT_TRUE))
       rc = FPTA_TXN_CANCELLED;
+    if (unlikely(txn->db->bloom_dirty))
+      fpta_bloom_settle(txn->db, rc == MDBX_SUCCESS);
   }
 
   if (unlikely(abort))
@@ -414,7 +681,7 @@ int fpta_transaction_end(fpta_txn *txn, bool abort) {
 
 cancelled:
   txn->mdbx_txn = nullptr;
-  int err = fpta_db_unlock(txn->db, txn->level);
+  int err = fpta_db_unlock(txn->db, txn->level, txn->guard_slot);
   assert(err == 0);
   (void)err;
   fpta_txn_free(txn->db, txn);
@@ -449,6 +716,455 @@ int fpta_db_sequence(fpta_txn *txn, uint64_t *result, uint64_t increment) {
 
 //----------------------------------------------------------------------------
 
+/* Выполняет пачку запросов групповой фиксации в одной пишущей транзакции.
+ *
+ * Текущая версия libmdbx не поддерживает вложенные транзакции в режиме
+ * MDBX_WRITEMAP (используется по-умолчанию для fpta_lazy и fpta_weak), а их
+ * создание достаточно дорого. Поэтому семантика "точек сохранения" для
+ * каждого запроса обеспечивается повтором: при ошибке любого из запросов
+ * транзакция отменяется и пачка выполняется заново, но уже без запросов
+ * завершившихся ошибкой.
+ *
+ * Чтобы множество ошибок в одной пачке не приводило к квадратичным
+ * затратам, количество повторов ограничено fpta_commit_replay_max. После
+ * исчерпания повторов следующие за ошибочным запросы отделяются от пачки,
+ * т.е. фиксируются только предшествующие ему запросы, уже успешно
+ * выполненные в той же последовательности. Отделенные запросы возвращаются
+ * в виде списка для постановки в начало очереди. */
+static fpta_commit_request *fpta_commit_batch(fpta_db *db,
+                                              fpta_commit_request *batch) {
+  fpta_commit_request *deferred = nullptr;
+  for (unsigned replay = 0;; ++replay) {
+    fpta_txn *txn = nullptr;
+    int rc = fpta_transaction_begin(db, fpta_write, &txn);
+    if (likely(rc == FPTA_SUCCESS)) {
+      fpta_commit_request *failed = nullptr;
+      for (fpta_commit_request *r = batch; r; r = r->next) {
+        if (r->rc != FPTA_SUCCESS)
+          continue /* запрос уже отвергнут на предыдущем проходе */;
+        r->rc = r->writer(txn, r->arg);
+        if (unlikely(r->rc != FPTA_SUCCESS)) {
+          failed = r;
+          break;
+        }
+      }
+
+      if (unlikely(failed)) {
+        rc = fpta_transaction_end(txn, true);
+        if (likely(rc == FPTA_SUCCESS || rc == FPTA_TXN_CANCELLED)) {
+          if (replay >= fpta_commit_replay_max) {
+            /* Отделяем не отвергнутые запросы после ошибочного, а уже
+             * отвергнутые оставляем в пачке для выдачи результата. */
+            fpta_commit_request *cut = nullptr, **cut_tail = &cut;
+            fpta_commit_request **kept = &failed->next;
+            for (fpta_commit_request *r = failed->next; r;) {
+              fpta_commit_request *const next = r->next;
+              if (r->rc == FPTA_SUCCESS) {
+                *cut_tail = r;
+                cut_tail = &r->next;
+              } else {
+                *kept = r;
+                kept = &r->next;
+              }
+              r = next;
+            }
+            *kept = nullptr;
+            *cut_tail = deferred;
+            deferred = cut;
+          }
+          continue;
+        }
+      } else
+        rc = fpta_transaction_end(txn, false);
+    }
+
+    for (fpta_commit_request *r = batch; r; r = r->next)
+      if (r->rc == FPTA_SUCCESS)
+        r->rc = rc;
+    return deferred;
+  }
+}
+
+int fpta_transaction_submit(fpta_db *db,
+                            int (*writer)(fpta_txn *txn, void *arg),
+                            void *arg) {
+  if (unlikely(writer == nullptr))
+    return FPTA_EINVAL;
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+
+  fpta_commit_request request;
+  request.next = nullptr;
+  request.writer = writer;
+  request.arg = arg;
+  request.rc = FPTA_SUCCESS;
+  request.done = false;
+
+  int err = fpta_mutex_lock(&db->commit_mutex);
+  if (unlikely(err != 0))
+    return err;
+  *db->commit_tail = &request;
+  db->commit_tail = &request.next;
+
+  while (!request.done) {
+    if (db->commit_leader) {
+      err = fpta_cond_wait(&db->commit_cond, &db->commit_mutex);
+      assert(err == 0);
+      continue;
+    }
+
+    /* Лидера нет, поэтому текущий поток становится лидером и забирает
+     * из очереди пачку запросов (включая собственный, если он попадает
+     * в ограничение размера пачки). */
+    db->commit_leader = true;
+    fpta_commit_request *const batch = db->commit_head;
+    fpta_commit_request **tail = &db->commit_head;
+    for (size_t n = 0; *tail && n < fpta_commit_batch_max; ++n)
+      tail = &(*tail)->next;
+    db->commit_head = *tail;
+    *tail = nullptr;
+    if (db->commit_head == nullptr)
+      db->commit_tail = &db->commit_head;
+
+    err = fpta_mutex_unlock(&db->commit_mutex);
+    assert(err == 0);
+    fpta_commit_request *const deferred = fpta_commit_batch(db, batch);
+    err = fpta_mutex_lock(&db->commit_mutex);
+    assert(err == 0);
+
+    if (unlikely(deferred)) {
+      /* отложенные запросы выполняются следующей пачкой */
+      fpta_commit_request **last = &deferred->next;
+      while (*last)
+        last = &(*last)->next;
+      *last = db->commit_head;
+      if (db->commit_head == nullptr)
+        db->commit_tail = last;
+      db->commit_head = deferred;
+    }
+
+    for (fpta_commit_request *r = batch; r;) {
+      /* после взведения done запрос может быть сразу освобожден */
+      fpta_commit_request *const next = r->next;
+      r->done = true;
+      r = next;
+    }
+    /* Передаем лидерство одному из ожидающих потоков, если собственный
+     * запрос выполнен, либо остаемся лидером на следующем цикле. */
+    db->commit_leader = false;
+    err = fpta_cond_broadcast(&db->commit_cond);
+    assert(err == 0);
+  }
+
+  const int rc = request.rc;
+  err = fpta_mutex_unlock(&db->commit_mutex);
+  assert(err == 0);
+  (void)err;
+  return rc;
+}
+
+//----------------------------------------------------------------------------
+
+/* Обновляет отметку durability по сигнатурам мета-страниц и возвращает
+ * номер последней зафиксированной транзакции. Сигнатура больше
+ * MDBX_DATASIGN_WEAK (1) означает сильную (steady) точку фиксации. */
+static int fpta_durable_refresh(fpta_db *db, uint64_t *recent_txnid) {
+  MDBX_envinfo info;
+  int rc = mdbx_env_info_ex(db->mdbx_env, nullptr, &info, sizeof(info));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  uint64_t steady = 0;
+  if (info.mi_meta0_sign > 1 && steady < info.mi_meta0_txnid)
+    steady = info.mi_meta0_txnid;
+  if (info.mi_meta1_sign > 1 && steady < info.mi_meta1_txnid)
+    steady = info.mi_meta1_txnid;
+  if (info.mi_meta2_sign > 1 && steady < info.mi_meta2_txnid)
+    steady = info.mi_meta2_txnid;
+
+  uint64_t durable = db->durable_txnid.load(std::memory_order_relaxed);
+  while (durable < steady &&
+         !db->durable_txnid.compare_exchange_weak(durable, steady))
+    ;
+  if (recent_txnid)
+    *recent_txnid = info.mi_recent_txnid;
+  return FPTA_SUCCESS;
+}
+
+/* Вызывает функторы уведомлений, для которых достигнута durability,
+ * либо все ожидающие в случае ошибки, и пробуждает ожидающие потоки. */
+static void fpta_durable_fire(fpta_db *db, int err) {
+  fpta_durable_request *ready = nullptr;
+  int rc = fpta_mutex_lock(&db->durable_mutex);
+  assert(rc == 0);
+  const uint64_t durable = db->durable_txnid.load(std::memory_order_acquire);
+  for (fpta_durable_request **ptr = &db->durable_pending; *ptr;) {
+    fpta_durable_request *const request = *ptr;
+    if (err != FPTA_SUCCESS || request->txnid <= durable) {
+      *ptr = request->next;
+      request->next = ready;
+      ready = request;
+    } else
+      ptr = &request->next;
+  }
+  rc = fpta_cond_broadcast(&db->durable_cond);
+  assert(rc == 0);
+  rc = fpta_mutex_unlock(&db->durable_mutex);
+  assert(rc == 0);
+  (void)rc;
+
+  while (ready) {
+    fpta_durable_request *const request = ready;
+    ready = request->next;
+    request->callback(db, request->txnid, err, request->arg);
+    free(request);
+  }
+}
+
+/* Принудительная фиксация сильной точки, если фоновый поток не запущен. */
+static int fpta_durable_sync(fpta_db *db) {
+  int rc = mdbx_env_sync(db->mdbx_env);
+  if (rc == MDBX_RESULT_TRUE)
+    rc = MDBX_SUCCESS;
+  if (likely(rc == MDBX_SUCCESS))
+    rc = fpta_durable_refresh(db, nullptr);
+  fpta_durable_fire(db, rc);
+  return rc;
+}
+
+static void *fpta_flusher_proc(void *arg) {
+  fpta_db *const db = static_cast<fpta_db *>(arg);
+  int err = fpta_mutex_lock(&db->durable_mutex);
+  assert(err == 0);
+  while (!db->flusher_stop) {
+    err = fpta_cond_timedwait(&db->durable_cond, &db->durable_mutex,
+                              db->flusher_tick_ms);
+    assert(err == 0 || err == FPTA_ETIMEDOUT);
+    if (db->flusher_stop)
+      break;
+
+    err = fpta_mutex_unlock(&db->durable_mutex);
+    assert(err == 0);
+    /* Сброс выполняется только по достижении порогов, заданных
+     * через mdbx_env_set_syncbytes() и mdbx_env_set_syncperiod(). */
+    int rc = mdbx_env_sync_poll(db->mdbx_env);
+    if (rc == MDBX_RESULT_TRUE || rc == MDBX_BUSY)
+      rc = MDBX_SUCCESS;
+    if (likely(rc == MDBX_SUCCESS))
+      rc = fpta_durable_refresh(db, nullptr);
+    fpta_durable_fire(db, rc);
+    err = fpta_mutex_lock(&db->durable_mutex);
+    assert(err == 0);
+  }
+  err = fpta_mutex_unlock(&db->durable_mutex);
+  assert(err == 0);
+  (void)err;
+  return nullptr;
+}
+
+int fpta_db_flusher_start(fpta_db *db, size_t sync_bytes, unsigned period_ms) {
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+  if (unlikely(sync_bytes == 0 && period_ms == 0))
+    return FPTA_EINVAL;
+
+  unsigned env_flags;
+  int rc = mdbx_env_get_flags(db->mdbx_env, &env_flags);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  if (unlikely(env_flags & MDBX_RDONLY))
+    return FPTA_EPERM;
+
+  rc = mdbx_env_set_syncbytes(db->mdbx_env, sync_bytes);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  rc = mdbx_env_set_syncperiod(db->mdbx_env,
+                               unsigned(uint64_t(period_ms) * 65536 / 1000));
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  rc = fpta_mutex_lock(&db->durable_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+  if (unlikely(db->flusher_active)) {
+    rc = FPTA_EBUSY;
+    goto bailout;
+  }
+
+  /* Порог по объему проверяется при фиксации транзакций, а по времени
+   * фоновым потоком с периодичностью в четверть заданного интервала. */
+  db->flusher_tick_ms = period_ms ? (period_ms + 3) / 4 : 100;
+  db->flusher_stop = false;
+  rc = fpta_thread_create(&db->flusher, fpta_flusher_proc, db);
+  if (likely(rc == 0))
+    db->flusher_active = true;
+
+bailout:
+  int err = fpta_mutex_unlock(&db->durable_mutex);
+  assert(err == 0);
+  (void)err;
+  return rc;
+}
+
+int fpta_db_flusher_stop(fpta_db *db) {
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+
+  int rc = fpta_mutex_lock(&db->durable_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+  const bool active = db->flusher_active;
+  db->flusher_active = false;
+  db->flusher_stop = true;
+  rc = fpta_cond_broadcast(&db->durable_cond);
+  assert(rc == 0);
+  rc = fpta_mutex_unlock(&db->durable_mutex);
+  assert(rc == 0);
+  if (!active)
+    return FPTA_SUCCESS;
+
+  rc = fpta_thread_join(&db->flusher);
+  if (unlikely(rc != 0))
+    return rc;
+
+  /* Ожидающие запросы уведомлений не должны остаться без ответа */
+  return fpta_durable_sync(db);
+}
+
+int fpta_transaction_commit_async(fpta_txn *txn, uint64_t *committed_txnid) {
+  if (unlikely(committed_txnid == nullptr))
+    return FPTA_EINVAL;
+  *committed_txnid = 0;
+
+  int rc = fpta_txn_validate(txn, fpta_write);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_db *const db = txn->db;
+  const uint64_t txnid = mdbx_txn_id(txn->mdbx_txn);
+  rc = fpta_transaction_end(txn, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  /* Транзакция без изменений не порождает новой версии данных,
+   * поэтому результат ограничивается последней зафиксированной. */
+  uint64_t recent_txnid;
+  rc = fpta_durable_refresh(db, &recent_txnid);
+  if (likely(rc == FPTA_SUCCESS))
+    *committed_txnid = (txnid < recent_txnid) ? txnid : recent_txnid;
+  return rc;
+}
+
+int fpta_durable_txnid(fpta_db *db, uint64_t *durable_txnid) {
+  if (unlikely(durable_txnid == nullptr))
+    return FPTA_EINVAL;
+  *durable_txnid = 0;
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+
+  int rc = fpta_durable_refresh(db, nullptr);
+  if (likely(rc == FPTA_SUCCESS))
+    *durable_txnid = db->durable_txnid.load(std::memory_order_acquire);
+  return rc;
+}
+
+int fpta_durable_wait(fpta_db *db, uint64_t txnid, unsigned timeout_ms) {
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+
+  uint64_t recent_txnid;
+  int rc = fpta_durable_refresh(db, &recent_txnid);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (unlikely(txnid > recent_txnid))
+    return FPTA_EINVAL;
+  if (db->durable_txnid.load(std::memory_order_acquire) >= txnid)
+    return FPTA_SUCCESS;
+  if (timeout_ms == 0)
+    return FPTA_ETIMEDOUT;
+
+  rc = fpta_mutex_lock(&db->durable_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+  while (db->durable_txnid.load(std::memory_order_acquire) < txnid) {
+    if (!db->flusher_active) {
+      /* без фонового потока фиксируем сильную точку самостоятельно */
+      rc = fpta_mutex_unlock(&db->durable_mutex);
+      assert(rc == 0);
+      return fpta_durable_sync(db);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= deadline) {
+      rc = FPTA_ETIMEDOUT;
+      break;
+    }
+    const auto left =
+        std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+    rc = fpta_cond_timedwait(&db->durable_cond, &db->durable_mutex,
+                             unsigned(left.count()) + 1);
+    if (unlikely(rc != 0 && rc != FPTA_ETIMEDOUT))
+      break;
+    rc = FPTA_SUCCESS;
+  }
+
+  int err = fpta_mutex_unlock(&db->durable_mutex);
+  assert(err == 0);
+  (void)err;
+  return rc;
+}
+
+int fpta_durable_notify(fpta_db *db, uint64_t txnid,
+                        void (*callback)(fpta_db *db, uint64_t txnid, int err,
+                                         void *arg),
+                        void *arg) {
+  if (unlikely(callback == nullptr))
+    return FPTA_EINVAL;
+  if (unlikely(!fpta_db_validate(db)))
+    return FPTA_EINVAL;
+
+  uint64_t recent_txnid;
+  int rc = fpta_durable_refresh(db, &recent_txnid);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (unlikely(txnid > recent_txnid))
+    return FPTA_EINVAL;
+
+  fpta_durable_request *request =
+      (fpta_durable_request *)malloc(sizeof(fpta_durable_request));
+  if (unlikely(request == nullptr))
+    return FPTA_ENOMEM;
+  request->txnid = txnid;
+  request->callback = callback;
+  request->arg = arg;
+
+  rc = fpta_mutex_lock(&db->durable_mutex);
+  if (unlikely(rc != 0)) {
+    free(request);
+    return rc;
+  }
+  request->next = db->durable_pending;
+  db->durable_pending = request;
+  const bool active = db->flusher_active;
+  rc = fpta_mutex_unlock(&db->durable_mutex);
+  assert(rc == 0);
+  (void)rc;
+
+  /* Функтор вызывается сразу, если durability уже достигнута,
+   * либо после принудительной фиксации без фонового потока. */
+  if (db->durable_txnid.load(std::memory_order_acquire) >= txnid) {
+    fpta_durable_fire(db, FPTA_SUCCESS);
+    return FPTA_SUCCESS;
+  }
+  if (!active)
+    fpta_durable_sync(db);
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
 int
 #if defined(__GNUC__) || __has_attribute(weak)
     __attribute__((weak))
@@ -472,8 +1188,9 @@ int fpta_internal_abort(fpta_txn *txn, int errnum, bool txn_maybe_dead) {
     bool dbi_locked = false;
     fpta_db *db = txn->db;
     for (size_t i = 0; i < fpta_dbi_cache_size; ++i) {
-      const MDBX_dbi dbi = db->dbi_handles[i];
-      const fpta_shove_t shove = db->dbi_shoves[i];
+      fpta_dbi_slot &slot = db->dbi_cache[i];
+      const MDBX_dbi dbi = slot.handle();
+      const fpta_shove_t shove = slot.shove();
       if (shove && dbi) {
         unsigned tbl_flags = 0, tbl_state = 0;
         int err = mdbx_dbi_flags_ex(txn->mdbx_txn, dbi, &tbl_flags, &tbl_state);
@@ -485,10 +1202,8 @@ int fpta_internal_abort(fpta_txn *txn, int errnum, bool txn_maybe_dead) {
             dbi_locked = true;
           }
 
-          if (shove == db->dbi_shoves[i] && dbi == db->dbi_handles[i]) {
-            db->dbi_shoves[i] = 0;
-            db->dbi_handles[i] = 0;
-          }
+          if (shove == slot.shove() && dbi == slot.handle())
+            slot.clear();
         }
       }
     }
@@ -513,6 +1228,10 @@ int fpta_internal_abort(fpta_txn *txn, int errnum, bool txn_maybe_dead) {
       assert(err == 0);
       (void)err;
     }
+
+    /* Измененные транзакцией копии фильтров Блума более не верны */
+    if (unlikely(db->bloom_dirty))
+      fpta_bloom_settle(db, false);
   }
 
   int rc = mdbx_txn_abort(txn->mdbx_txn);
@@ -730,5 +1449,7 @@ int fpta_db_info(const fpta_db *db, const fpta_txn *txn, fpta_db_stat_t *stat) {
     stat->regime_flags |= fpta_frendly4compaction;
 
   stat->alterable_schema = (db ? db : txn->db)->alterable_schema;
+  stat->dbi_cache_overflows =
+      (db ? db : txn->db)->dbi_cache_overflows.load(std::memory_order_relaxed);
   return FPTA_SUCCESS;
 }
@@ -32,18 +32,15 @@ static __inline uint64_t add_rotate_xor(uint64_t base, uint64_t addend,
 }
 
 typedef int (*concat_column_t)(fpta_key &key, const bool tersely,
-                               const fpta_table_schema *const schema,
-                               const fptu_ro &row, unsigned column);
+                               const fpta_shove_t shove,
+                               const fptu_field *field);
 
 static int __hot concat_unordered(fpta_key &key, const bool unused_tersely,
-                                  const fpta_table_schema *const schema,
-                                  const fptu_ro &row, unsigned column) {
+                                  const fpta_shove_t shove,
+                                  const fptu_field *field) {
   (void)unused_tersely;
   const uint64_t MARKER_ABSENT = UINT64_C(0x974BC764BAC4C7F);
   uint64_t *const hash = (uint64_t *)key.mdbx.iov_base;
-  const fpta_shove_t shove = schema->column_shove(column);
-  const fptu_type type = fpta_shove2type(shove);
-  const fptu_field *field = fptu::lookup(row, column, type);
   if (unlikely(field == nullptr)) {
     if (unlikely(!fpta_column_is_nullable(shove)))
       return FPTA_COLUMN_MISSING;
@@ -111,11 +108,9 @@ static int __hot concat_bytes(fpta_key &key, const void *data, size_t length) {
 }
 
 static int __hot concat_ordered(fpta_key &key, const bool tersely,
-                                const fpta_table_schema *const schema,
-                                const fptu_ro &row, unsigned column) {
-  const fpta_shove_t shove = schema->column_shove(column);
+                                const fpta_shove_t shove,
+                                const fptu_field *field) {
   const fptu_type type = fpta_shove2type(shove);
-  const fptu_field *field = fptu::lookup(row, column, type);
 
   const uint8_t prefix_absent = 0;
   const uint8_t prefix_present_empty = 42;
@@ -385,15 +380,31 @@ int __hot fpta_composite_row2key(const fpta_table_schema *const schema,
   }
 
   const bool tersely = (index & fpta_tersely_composite) ? true : false;
+  fpta_expression_field expression;
+  const auto concat_item = [&](unsigned item) {
+    const fpta_shove_t item_shove = schema->column_shove(item);
+    const fptu_field *field;
+    if (unlikely(schema->is_expression(item))) {
+      /* значение колонки-выражения вычисляется и сразу добавляется
+       * в ключ, поэтому временное поле можно переиспользовать */
+      int err = expression.compute(schema, item, row, field);
+      if (unlikely(err != FPTA_SUCCESS))
+        return err;
+    } else {
+      field = fptu::lookup(row, item, fpta_shove2type(item_shove));
+    }
+    return concat(key, tersely, item_shove, field);
+  };
+
   if (fpta_index_is_obverse(index)) {
     for (auto i = begin; i != end; ++i) {
-      rc = concat(key, tersely, schema, row, *i);
+      rc = concat_item(*i);
       if (unlikely(rc != FPTA_SUCCESS))
         return rc;
     }
   } else {
     for (auto i = end; i != begin;) {
-      rc = concat(key, tersely, schema, row, *--i);
+      rc = concat_item(*--i);
       if (unlikely(rc != FPTA_SUCCESS))
         return rc;
     }
@@ -699,13 +710,21 @@ int __cold fpta_describe_composite_index(const char *composite_name,
   fpta_table_schema::composite_item_t *const begin = column_set->composites;
   fpta_table_schema::composite_item_t *const end =
       FPT_ARRAY_END(column_set->composites);
-  fpta_table_schema::composite_item_t *tail;
-  for (tail = begin; *tail;) {
+  fpta_table_schema::composite_item_t *tail, *coverings_end;
+  for (tail = begin;
+       *tail && !(*tail & fpta_table_schema::record_kind_mask);) {
     tail += *tail + 1;
     if (unlikely(tail >= end))
       return (tail == end) ? FPTA_TOOMANY : FPTA_SCHEMA_CORRUPTED;
   }
-  if (end - tail <= (ptrdiff_t)column_names_count)
+  /* записи покрывающих и частичных индексов следуют за списками составных,
+   * поэтому новый список составных колонок вставляется перед ними */
+  for (coverings_end = tail; *coverings_end;) {
+    coverings_end += fpta_table_schema::record_length(*coverings_end);
+    if (unlikely(coverings_end >= end))
+      return (coverings_end == end) ? FPTA_TOOMANY : FPTA_SCHEMA_CORRUPTED;
+  }
+  if (end - coverings_end <= (ptrdiff_t)column_names_count)
     return FPTA_TOOMANY;
 
   /* add name to column's shoves */
@@ -715,12 +734,15 @@ int __cold fpta_describe_composite_index(const char *composite_name,
     return rc;
 
   /* append index's items to composites */
+  memmove(tail + column_names_count + 1, tail,
+          (coverings_end - tail) * sizeof(*tail));
+  coverings_end += column_names_count + 1;
   *tail++ = (fpta_table_schema::composite_item_t)column_names_count;
   for (auto n : items)
     *tail++ = n;
-  assert(tail <= end);
-  if (tail < end)
-    *tail = 0;
+  assert(coverings_end <= end);
+  if (coverings_end < end)
+    *coverings_end = 0;
 
   return FPTA_SUCCESS;
 }
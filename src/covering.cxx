@@ -0,0 +1,234 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Покрывающие вторичные индексы.
+ *
+ * Для покрывающего индекса во вторичной таблице вместе с ключом PK
+ * хранятся копии значений перечисленных в схеме колонок строки. Значение
+ * во вторичной таблице имеет вид [кортеж-проекция][ключ PK], где длина
+ * кортежа определяется его заголовком. Это позволяет курсору вычислять
+ * фильтр и возвращать данные без обращения к основной таблице.
+ *
+ * Поддерживаются только уникальные вторичные индексы, так как для индексов
+ * с дубликатами ключи PK хранятся как упорядоченные multi-значения
+ * (в том числе фиксированного размера) и не могут быть дополнены. */
+
+int __cold fpta_covering_index_validate(
+    const size_t index_column,
+    const fpta_table_schema::composite_item_t *const items_begin,
+    const fpta_table_schema::composite_item_t *const items_end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const coverings_begin,
+    const fpta_table_schema::composite_item_t *const coverings_end) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(index_shove) ||
+               !fpta_index_is_unique(index_shove)))
+    return FPTA_EFLAG;
+
+  if (unlikely(items_begin >= items_end ||
+               items_end - items_begin > (ptrdiff_t)column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  for (auto scan = items_begin; scan < items_end; ++scan) {
+    const size_t column_number = *scan;
+    if (unlikely(column_number >= column_count))
+      return FPTA_SCHEMA_CORRUPTED;
+    const fptu_type data_type = fpta_shove2type(columns_shoves[column_number]);
+    if (unlikely(data_type == /* composite */ fptu_null ||
+                 data_type > fptu_nested))
+      return FPTA_ETYPE;
+    if (unlikely(std::find(items_begin, scan, column_number) != scan))
+      return FPTA_EEXIST;
+  }
+
+  /* для индекса допускается только один список покрываемых колонок */
+  for (auto scan = coverings_begin; scan < coverings_end;
+       scan += fpta_table_schema::record_length(*scan)) {
+    if (unlikely(!(*scan & fpta_table_schema::record_kind_mask)))
+      return FPTA_SCHEMA_CORRUPTED;
+    if ((*scan & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::covering_mark &&
+        unlikely(scan[1] == index_column))
+      return FPTA_EEXIST;
+  }
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_covering_index(const char *index_name,
+                                        fpta_column_set *column_set,
+                                        const char *const column_names_array[],
+                                        size_t column_names_count) {
+  if (unlikely(column_set == nullptr || column_names_array == nullptr))
+    return FPTA_EINVAL;
+
+  if (unlikely(column_names_count < 1 ||
+               column_names_count > column_set->count))
+    return FPTA_EINVAL;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  std::vector<fpta_table_schema::composite_item_t> items(column_names_count);
+  for (size_t i = 0; i < column_names_count; ++i) {
+    size_t column;
+    rc = fpta_column_set_lookup(column_set, column_names_array[i], column);
+    if (rc != FPTA_SUCCESS)
+      return rc;
+    items[i] = (fpta_table_schema::composite_item_t)column;
+  }
+
+  /* списки покрываемых колонок следуют за списками составных */
+  fpta_table_schema::composite_item_t *coverings, *tail;
+  rc = fpta_column_set_records(column_set, coverings, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_covering_index_validate(index_column, items.data(),
+                                    items.data() + items.size(),
+                                    column_set->shoves, column_set->count,
+                                    coverings, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::covering_mark,
+                                index_column, items.data(), items.size());
+}
+
+//----------------------------------------------------------------------------
+
+static size_t fpta_covering_field_bytes(const fptu_field *pf) {
+  const fptu_type type = pf->type();
+  if (likely(type < fptu_cstr))
+    return fptu_internal_map_t2b[type];
+
+  const fptu_payload *payload = pf->payload();
+  if (type == fptu_cstr)
+    return strlen(payload->cstr) + 1;
+
+  return units2bytes(payload->other.varlen.brutto + (size_t)1);
+}
+
+int fpta_covering_copy(fptu_rw *pt, const fptu_field *pf) {
+  const unsigned column = pf->colnum();
+  switch (pf->type()) {
+  default:
+    return FPTA_ETYPE;
+  case fptu_uint16:
+    return fptu_insert_uint16(pt, column, fptu_field_uint16(pf));
+  case fptu_int32:
+    return fptu_insert_int32(pt, column, fptu_field_int32(pf));
+  case fptu_uint32:
+    return fptu_insert_uint32(pt, column, fptu_field_uint32(pf));
+  case fptu_fp32:
+    return fptu_insert_fp32(pt, column, fptu_field_fp32(pf));
+  case fptu_int64:
+    return fptu_insert_int64(pt, column, fptu_field_int64(pf));
+  case fptu_uint64:
+    return fptu_insert_uint64(pt, column, fptu_field_uint64(pf));
+  case fptu_fp64:
+    return fptu_insert_fp64(pt, column, fptu_field_fp64(pf));
+  case fptu_datetime:
+    return fptu_insert_datetime(pt, column, fptu_field_datetime(pf));
+  case fptu_96:
+    return fptu_insert_96(pt, column, fptu_field_96(pf));
+  case fptu_128:
+    return fptu_insert_128(pt, column, fptu_field_128(pf));
+  case fptu_160:
+    return fptu_insert_160(pt, column, fptu_field_160(pf));
+  case fptu_256:
+    return fptu_insert_256(pt, column, fptu_field_256(pf));
+  case fptu_cstr: {
+    const char *cstr = fptu_field_cstr(pf);
+    return fptu_insert_string(pt, column, cstr, strlen(cstr));
+  }
+  case fptu_opaque: {
+    const struct iovec opaque = fptu_field_opaque(pf);
+    return fptu_insert_opaque(pt, column, opaque.iov_base, opaque.iov_len);
+  }
+  case fptu_nested:
+    return fptu_insert_nested(pt, column, fptu_field_nested(pf));
+  }
+}
+
+int fpta_secondary_value::build(const fpta_table_schema *table_def,
+                                size_t column, const fptu_ro &row,
+                                const MDBX_val &pk_key) {
+  if (!table_def->is_covering(column)) {
+    value_ = pk_key;
+    return FPTA_SUCCESS;
+  }
+
+  fpta_table_schema::composite_iter_t list_begin, list_end;
+  table_def->covering_list(column, list_begin, list_end);
+
+  const fptu_field *fields[fpta_max_cols];
+  size_t items = 0, data_bytes = 0;
+  for (auto i = list_begin; i != list_end; ++i) {
+    const fptu_field *pf =
+        fptu::lookup(row, *i, fpta_shove2type(table_def->column_shove(*i)));
+    if (pf) {
+      fields[items++] = pf;
+      data_bytes +=
+          FPT_ALIGN_CEIL(fpta_covering_field_bytes(pf), fptu_unit_size);
+    }
+  }
+
+  /* ключ PK дописывается в свободное место сразу за кортежем */
+  const size_t space =
+      fptu_space(items, data_bytes + FPT_ALIGN_CEIL(pk_key.iov_len,
+                                                    fptu_unit_size));
+  if (space > capacity_) {
+    void *larger = malloc(space);
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    if (buffer_ != inplace_)
+      free(buffer_);
+    buffer_ = larger;
+    capacity_ = space;
+  }
+
+  fptu_rw *pt = fptu_init(buffer_, space, items);
+  if (unlikely(pt == nullptr))
+    return FPTA_EOOPS;
+
+  for (size_t i = 0; i < items; ++i) {
+    int rc = fpta_covering_copy(pt, fields[i]);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  const fptu_ro projection = fptu_take_noshrink(pt);
+  uint8_t *const tail =
+      (uint8_t *)projection.sys.iov_base + projection.total_bytes;
+  if (unlikely(tail + pk_key.iov_len > (uint8_t *)&pt->units[pt->end]))
+    return FPTA_EOOPS;
+
+  memcpy(tail, pk_key.iov_base, pk_key.iov_len);
+  value_.iov_base = projection.sys.iov_base;
+  value_.iov_len = projection.total_bytes + pk_key.iov_len;
+  return FPTA_SUCCESS;
+}
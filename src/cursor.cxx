@@ -35,14 +35,44 @@ int fpta_cursor_close(fpta_cursor *cursor) {
   return rc;
 }
 
-int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
-                     fpta_value range_to, fpta_filter *filter,
-                     fpta_cursor_options options, fpta_cursor **pcursor) {
+static int fpta_cursor_spill_range(fpta_cursor *cursor) {
+  fpta_key *const range[2] = {&cursor->range_from_key, &cursor->range_to_key};
+  size_t bytes = 0;
+  for (const auto key : range)
+    if (key->mdbx.iov_base && !key->is_inplace())
+      bytes += key->mdbx.iov_len;
+  if (likely(bytes == 0))
+    return FPTA_SUCCESS;
+
+  uint8_t *ptr = (uint8_t *)malloc(bytes);
+  if (unlikely(ptr == nullptr))
+    return FPTA_ENOMEM;
+  free(cursor->range_spill);
+  cursor->range_spill = ptr;
+  for (const auto key : range)
+    if (key->mdbx.iov_base && !key->is_inplace()) {
+      key->mdbx.iov_base = memcpy(ptr, key->mdbx.iov_base, key->mdbx.iov_len);
+      ptr += key->mdbx.iov_len;
+    }
+  return FPTA_SUCCESS;
+}
+
+static_assert(sizeof(fpta_cursor) <= sizeof(fpta_cursor_storage) &&
+                  alignof(fpta_cursor) <= alignof(fpta_cursor_storage),
+              "fpta_cursor_storage_size is too small");
+
+static int fpta_cursor_open_ex(fpta_txn *txn, fpta_name *column_id,
+                               fpta_value range_from, fpta_value range_to,
+                               fpta_filter *filter,
+                               fpta_cursor_options options,
+                               fpta_cursor_storage *storage,
+                               fpta_cursor **pcursor) {
   if (unlikely(pcursor == nullptr))
     return FPTA_EINVAL;
   *pcursor = nullptr;
 
-  switch (options & ~(fpta_dont_fetch | fpta_zeroed_range_is_point)) {
+  switch (options & ~(fpta_dont_fetch | fpta_zeroed_range_is_point |
+                      fpta_batched_lookup)) {
   default:
     return FPTA_EFLAG;
 
@@ -64,6 +94,10 @@ int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
   if (unlikely(!fpta_is_indexed(column_id->shove)))
     return FPTA_NO_INDEX;
 
+  /* битовый индекс не содержит пар значение-PK для перебора */
+  if (unlikely(table_id->table_schema->is_bitmap(column_id->column.num)))
+    return FPTA_NO_INDEX;
+
   if (unlikely(!fpta_index_is_compat(column_id->shove, range_from) ||
                !fpta_index_is_compat(column_id->shove, range_to)))
     return FPTA_ETYPE;
@@ -90,10 +124,25 @@ int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
   if (unlikely(!fpta_filter_validate(filter)))
     return FPTA_EINVAL;
 
+  /* частичный индекс пригоден только если из фильтра следует его предикат,
+   * иначе часть подходящих под фильтр строк окажется пропущена */
+  if (unlikely(!fpta_filter_implies(
+          filter, table_id->table_schema->partial_predicate(
+                      column_id->column.num))))
+    return FPTA_NO_INDEX;
+
   fpta_db *db = txn->db;
-  fpta_cursor *cursor = fpta_cursor_alloc(db);
-  if (unlikely(cursor == nullptr))
-    return FPTA_ENOMEM;
+  fpta_cursor *cursor;
+  if (storage) {
+    cursor = reinterpret_cast<fpta_cursor *>(storage);
+    memset((void *)cursor, 0, sizeof(fpta_cursor));
+    cursor->db = db;
+    cursor->external_storage = true;
+  } else {
+    cursor = fpta_cursor_alloc(db);
+    if (unlikely(cursor == nullptr))
+      return FPTA_ENOMEM;
+  }
 
   cursor->options = options & /* Сбрасываем флажок fpta_zeroed_range_is_point,
                                  чтобы в дальнейшем использовать его только как
@@ -104,11 +153,32 @@ int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
   cursor->column_number = column_id->column.num;
   cursor->tbl_handle = tbl_handle;
   cursor->idx_handle = idx_handle;
+  cursor->covered = false;
+  if (filter && fpta_index_is_secondary(index) &&
+      table_id->table_schema->is_covering(cursor->column_number)) {
+    fpta_table_schema::composite_iter_t covered_begin, covered_end;
+    table_id->table_schema->covering_list(cursor->column_number, covered_begin,
+                                          covered_end);
+    cursor->covered =
+        fpta_filter_is_covered(filter, covered_begin, covered_end);
+  }
+  cursor->key_filter = false;
+  if (filter && fpta_index_is_secondary(index) && !cursor->covered &&
+      !fpta_is_composite(column_id->shove) &&
+      !table_id->table_schema->is_multivalued(cursor->column_number) &&
+      !table_id->table_schema->is_expression(cursor->column_number)) {
+    /* условия на колонку индекса и PK можно проверить до чтения строки */
+    const fpta_table_schema::composite_item_t key_columns[2] = {
+        fpta_table_schema::composite_item_t(cursor->column_number), 0};
+    cursor->key_filter =
+        fpta_filter_has_covered(filter, key_columns, key_columns + 2);
+  }
 
   assert(cursor->seek_range_flags == 0);
   if (range_from.type <= fpta_shoved) {
-    rc = fpta_index_value2key(cursor->index_shove(), range_from,
-                              cursor->range_from_key, true);
+    rc = fpta_index_value2key(
+        cursor->index_shove(), range_from, cursor->range_from_key, true,
+        cursor->table_schema()->key_limit(cursor->column_number));
     if (unlikely(rc != FPTA_SUCCESS))
       goto bailout;
     assert(cursor->range_from_key.mdbx.iov_base != nullptr);
@@ -116,14 +186,22 @@ int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
   }
 
   if (range_to.type <= fpta_shoved) {
-    rc = fpta_index_value2key(cursor->index_shove(), range_to,
-                              cursor->range_to_key, true);
+    rc = fpta_index_value2key(
+        cursor->index_shove(), range_to, cursor->range_to_key, true,
+        cursor->table_schema()->key_limit(cursor->column_number));
     if (unlikely(rc != FPTA_SUCCESS))
       goto bailout;
     assert(cursor->range_to_key.mdbx.iov_base != nullptr);
     cursor->seek_range_flags |= fpta_cursor::need_cmp_range_to;
   }
 
+  if (unlikely(cursor->table_schema()->has_key_limits())) {
+    /* длинные ключи границ не помещаются в fpta_key и копируются отдельно */
+    rc = fpta_cursor_spill_range(cursor);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+  }
+
   rc =
       mdbx_cursor_open(txn->mdbx_txn, cursor->idx_handle, &cursor->mdbx_cursor);
   if (unlikely(rc != MDBX_SUCCESS))
@@ -180,6 +258,17 @@ int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
     }
   }
 
+  if (filter && txn->level == fpta_read &&
+      cursor->table_schema()->has_bitmap()) {
+    /* Снимок данных читающей транзакции неизменен, поэтому фильтр можно
+     * заранее вычислить по битовым индексам. В пишущей транзакции строки
+     * могут изменяться во время перебора, поэтому там это не делается. */
+    rc = fpta_bitmap_select(txn, cursor->table_schema(), filter,
+                            &cursor->bitmap_filter);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+  }
+
   cursor->filter = filter;
   if ((options & fpta_dont_fetch) == 0) {
     rc = fpta_cursor_move(cursor, fpta_first);
@@ -197,6 +286,28 @@ bailout:
   return rc;
 }
 
+int fpta_cursor_open(fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
+                     fpta_value range_to, fpta_filter *filter,
+                     fpta_cursor_options options, fpta_cursor **pcursor) {
+  return fpta_cursor_open_ex(txn, column_id, range_from, range_to, filter,
+                             options, nullptr, pcursor);
+}
+
+int fpta_cursor_open_external(fpta_txn *txn, fpta_name *column_id,
+                              fpta_value range_from, fpta_value range_to,
+                              fpta_filter *filter, fpta_cursor_options options,
+                              fpta_cursor_storage *storage,
+                              fpta_cursor **pcursor) {
+  if (unlikely(storage == nullptr)) {
+    if (likely(pcursor))
+      *pcursor = nullptr;
+    return FPTA_EINVAL;
+  }
+
+  return fpta_cursor_open_ex(txn, column_id, range_from, range_to, filter,
+                             options, storage, pcursor);
+}
+
 //----------------------------------------------------------------------------
 
 int fpta_cursor::bring(MDBX_val *key, MDBX_val *data, const MDBX_cursor_op op) {
@@ -228,6 +339,66 @@ static inline bool is_backward_direction(MDBX_cursor_op op) {
   return 1 & (mask >> op);
 }
 
+/* Проверяет условия фильтра на колонку вторичного индекса и PK по их
+ * значениям, восстановленным из ключей, без чтения строки. Результат
+ * match = false означает, что строка заведомо не подходит под фильтр.
+ * Если значение колонки не восстанавливается из ключа (хэш или усеченный
+ * длинный ключ), то проверка откладывается до чтения строки. */
+static int fpta_cursor_key_match(const fpta_cursor *cursor,
+                                 const fpta_filter *filter,
+                                 const MDBX_val &pk_key, bool &match) {
+  match = true;
+  const fpta_table_schema *const table_def = cursor->table_schema();
+  fpta_value key_value, pk_value;
+  int rc = fpta_index_key2value(cursor->index_shove(), cursor->current,
+                                key_value,
+                                table_def->key_limit(cursor->column_number));
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (key_value.type == fpta_shoved)
+    return FPTA_SUCCESS;
+  rc = fpta_index_key2value(table_def->table_pk(), pk_key, pk_value,
+                            table_def->key_limit(0));
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_table_schema::composite_item_t columns[2] = {
+      fpta_table_schema::composite_item_t(cursor->column_number), 0};
+  const size_t columns_count = (pk_value.type == fpta_shoved) ? 1 : 2;
+
+  size_t data_bytes = 2 * sizeof(uint64_t);
+  if (key_value.type >= fpta_string && key_value.type <= fpta_binary)
+    data_bytes += key_value.binary_length;
+  if (pk_value.type >= fpta_string && pk_value.type <= fpta_binary)
+    data_bytes += pk_value.binary_length;
+  const size_t bytes = fptu_space(2, data_bytes);
+  uint64_t inplace[64];
+  void *const buffer = (bytes > sizeof(inplace)) ? malloc(bytes) : inplace;
+  if (unlikely(buffer == nullptr))
+    return FPTA_ENOMEM;
+
+  fptu_rw *tuple = fptu_init(buffer, bytes, 2);
+  if (unlikely(tuple == nullptr)) {
+    rc = FPTA_EOOPS;
+    goto bailout;
+  }
+  rc = fpta_upsert_value(tuple, cursor->column_number, cursor->index_shove(),
+                         key_value, false);
+  if (likely(rc == FPTA_SUCCESS) && columns_count > 1)
+    rc = fpta_upsert_value(tuple, 0, table_def->table_pk(), pk_value, false);
+  if (likely(rc == FPTA_SUCCESS))
+    match = fpta_filter_match_covered(filter, fptu_take_noshrink(tuple),
+                                      columns, columns + columns_count);
+  else
+    /* значение не представимо в колонке, проверяем по строке */
+    rc = FPTA_SUCCESS;
+
+bailout:
+  if (buffer != inplace)
+    free(buffer);
+  return rc;
+}
+
 static int fpta_cursor_seek(fpta_cursor *cursor,
                             const MDBX_cursor_op mdbx_seek_op,
                             const MDBX_cursor_op mdbx_step_op,
@@ -324,13 +495,21 @@ static int fpta_cursor_seek(fpta_cursor *cursor,
     assert(cursor->range_from_key.mdbx.iov_base == nullptr &&
            cursor->range_to_key.mdbx.iov_base == nullptr);
     assert(mdbx_seek_op == MDBX_FIRST || mdbx_seek_op == MDBX_LAST);
-    assert(cursor->current.iov_len <= sizeof(cursor->range_from_key.place));
-    cursor->range_from_key.mdbx.iov_len =
-        std::min(cursor->current.iov_len,
-                 /* paranoia */ sizeof(cursor->range_from_key.place));
-    cursor->range_from_key.mdbx.iov_base =
-        ::memcpy(&cursor->range_from_key.place, cursor->current.iov_base,
-                 cursor->range_from_key.mdbx.iov_len);
+    assert(cursor->current.iov_len <= sizeof(cursor->range_from_key.place) ||
+           cursor->table_schema()->has_key_limits());
+    cursor->range_from_key.mdbx = cursor->current;
+    if (likely(cursor->current.iov_len <=
+               sizeof(cursor->range_from_key.place)))
+      cursor->range_from_key.mdbx.iov_base =
+          ::memcpy(&cursor->range_from_key.place, cursor->current.iov_base,
+                   cursor->current.iov_len);
+    else {
+      int err = fpta_cursor_spill_range(cursor);
+      if (unlikely(err != FPTA_SUCCESS)) {
+        cursor->set_poor();
+        return err;
+      }
+    }
     cursor->range_to_key.mdbx = cursor->range_from_key.mdbx;
     cursor->seek_range_state = cursor->seek_range_flags =
         fpta_cursor::need_cmp_range_both;
@@ -426,8 +605,81 @@ static int fpta_cursor_seek(fpta_cursor *cursor,
       return FPTA_SUCCESS;
     }
 
-    if (fpta_index_is_secondary(cursor->index_shove())) {
-      MDBX_val pk_key = mdbx_data.sys;
+    if (cursor->bitmap_filter) {
+      MDBX_val pk_key = cursor->current;
+      if (fpta_index_is_secondary(cursor->index_shove())) {
+        rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                               mdbx_data.sys, pk_key);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
+      const uint64_t rowid = fpta_bitmap_rowid(pk_key);
+      if (cursor->bitmap_filter->test(rowid)) {
+        if (cursor->bitmap_filter->exact) {
+          /* фильтр полностью вычислен по битовым индексам */
+          cursor->metrics.results += 1;
+          return FPTA_SUCCESS;
+        }
+      } else {
+        cursor->metrics.bitmap_filtered += 1;
+        if (step_op != MDBX_NEXT ||
+            fpta_index_is_secondary(cursor->index_shove()))
+          goto next;
+
+        /* При переборе PK по-возрастанию переходим сразу к следующей
+         * подходящей строке, так как порядок ключей PK совпадает
+         * с порядком номеров строк. */
+        uint64_t target;
+        if (rowid == UINT64_MAX ||
+            !cursor->bitmap_filter->next(rowid + 1, target))
+          goto eof;
+        if (target - rowid < fpta_bitmap_jump_distance)
+          goto next;
+        union {
+          uint32_t u32;
+          uint64_t u64;
+        } target_key;
+        if (pk_key.iov_len == 4)
+          target_key.u32 = uint32_t(target);
+        else
+          target_key.u64 = target;
+        cursor->current.iov_base = &target_key;
+        cursor->current.iov_len = pk_key.iov_len;
+        rc = cursor->bring(&cursor->current, &mdbx_data.sys, MDBX_SET_RANGE);
+        continue;
+      }
+    }
+
+    if (cursor->key_filter) {
+      MDBX_val pk_key;
+      rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                             mdbx_data.sys, pk_key);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      bool match;
+      rc = fpta_cursor_key_match(cursor, cursor->filter, pk_key, match);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      if (!match) {
+        cursor->metrics.key_filtered += 1;
+        goto next;
+      }
+    }
+
+    if (cursor->covered) {
+      /* все колонки фильтра есть в покрывающем индексе,
+       * поэтому фильтр вычисляется без чтения строки */
+      const MDBX_val se_value = mdbx_data.sys;
+      MDBX_val pk_key;
+      rc = fpta_covering_split(se_value, mdbx_data, pk_key);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+    } else if (fpta_index_is_secondary(cursor->index_shove())) {
+      MDBX_val pk_key;
+      rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                             mdbx_data.sys, pk_key);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
       mdbx_data.sys.iov_base = nullptr;
       mdbx_data.sys.iov_len = 0;
       cursor->metrics.pk_lookups += 1;
@@ -603,6 +855,342 @@ int fpta_cursor_move(fpta_cursor *cursor, fpta_seek_operations op) {
                           nullptr);
 }
 
+/* Проверяет, что после перехода к другому ключу курсор остался в пределах
+ * диапазона со стороны направления перемещения. */
+static bool fpta_cursor_within_range(const fpta_cursor *cursor, bool forward) {
+  if (forward) {
+    if ((cursor->seek_range_flags & fpta_cursor::need_cmp_range_to) == 0)
+      return true;
+    const auto cmp = mdbx_cmp(cursor->txn->mdbx_txn, cursor->idx_handle,
+                              &cursor->current, &cursor->range_to_key.mdbx);
+    return cmp < ((cursor->options & fpta_zeroed_range_is_point) ? 1 : 0);
+  }
+
+  if ((cursor->seek_range_flags & fpta_cursor::need_cmp_range_from) == 0)
+    return true;
+  return mdbx_cmp(cursor->txn->mdbx_txn, cursor->idx_handle, &cursor->current,
+                  &cursor->range_from_key.mdbx) >= 0;
+}
+
+/* Перемещение внутри группы дубликатов MDBX_DUPFIXED-индекса постранично
+ * посредством MDBX_GET_MULTIPLE и MDBX_NEXT/PREV_MULTIPLE. Если цель
+ * находится в текущей группе, то курсор устанавливается на неё и взводится
+ * done, иначе из n вычитается количество пройденных дубликатов. */
+static int fpta_cursor_skip_page(fpta_cursor *cursor, bool forward, size_t &n,
+                                 bool &done) {
+  done = false;
+  MDBX_val key, item, page;
+  int rc = cursor->bring(&key, &item, MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  for (;;) {
+    page.iov_base = nullptr;
+    page.iov_len = 0;
+    rc = cursor->bring(&key, &page, MDBX_GET_MULTIPLE);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+    if (page.iov_base)
+      break;
+
+    /* единственное значение для ключа, либо вложенный курсор в состоянии
+     * EOF, когда MDBX_GET_MULTIPLE не возвращает страницу: делаем шаг */
+    rc = cursor->bring(&key, &item, forward ? MDBX_NEXT_DUP : MDBX_PREV_DUP);
+    if (rc == MDBX_NOTFOUND)
+      /* группа пройдена */
+      return FPTA_SUCCESS;
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+    if (--n == 0) {
+      cursor->current = key;
+      done = true;
+      return FPTA_SUCCESS;
+    }
+  }
+
+  const size_t xsize = item.iov_len;
+  const uint8_t *begin = (const uint8_t *)page.iov_base;
+  const uint8_t *const ptr = (const uint8_t *)item.iov_base;
+  if (unlikely(xsize == 0 || ptr < begin || ptr >= begin + page.iov_len ||
+               (size_t)(ptr - begin) % xsize))
+    return FPTA_EOOPS;
+
+  size_t count = page.iov_len / xsize;
+  size_t index = (size_t)(ptr - begin) / xsize;
+  size_t avail = forward ? count - 1 - index : index;
+  while (n > avail) {
+    n -= avail;
+    rc = cursor->bring(&key, &page,
+                       forward ? MDBX_NEXT_MULTIPLE : MDBX_PREV_MULTIPLE);
+    if (rc == MDBX_NOTFOUND)
+      /* группа пройдена */
+      return FPTA_SUCCESS;
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    /* переход на крайний элемент следующей страницы тоже шаг */
+    n -= 1;
+    begin = (const uint8_t *)page.iov_base;
+    count = page.iov_len / xsize;
+    index = forward ? 0 : count - 1;
+    avail = count - 1;
+  }
+
+  item.iov_base = (void *)(begin + (forward ? index + n : index - n) * xsize);
+  cursor->current = key;
+  rc = cursor->bring(&cursor->current, &item, MDBX_GET_BOTH);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+  n = 0;
+  done = true;
+  return FPTA_SUCCESS;
+}
+
+/* Точное перемещение по неуникальному индексу без фильтра: группа
+ * дубликатов, которая целиком попадает в пропуск, пропускается одним
+ * переходом к следующему ключу, а её размер берется из mdbx_cursor_count().
+ * Внутри группы MDBX_DUPFIXED-индекса перемещение выполняется постранично. */
+static int fpta_cursor_skip_dups(fpta_cursor *cursor, size_t n) {
+  const bool forward = !fpta_cursor_is_descending(cursor->options);
+  const MDBX_cursor_op step_op = forward ? MDBX_NEXT_DUP : MDBX_PREV_DUP;
+  const MDBX_cursor_op jump_op = forward ? MDBX_NEXT_NODUP : MDBX_PREV_NODUP;
+
+  /* признак нахождения курсора на первом в порядке курсора дубликате */
+  bool group_head, paged;
+  unsigned dbi_flags;
+  MDBX_val data, head, head_data;
+  int rc =
+      mdbx_dbi_flags(cursor->txn->mdbx_txn, cursor->idx_handle, &dbi_flags);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  paged = (dbi_flags & MDBX_DUPFIXED) != 0;
+  rc = mdbx_cursor_get(cursor->mdbx_cursor, &cursor->current, &data,
+                       MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  rc = cursor->bring(&head, &head_data,
+                     forward ? MDBX_FIRST_DUP : MDBX_LAST_DUP);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  group_head = mdbx_dcmp(cursor->txn->mdbx_txn, cursor->idx_handle, &head_data,
+                         &data) == 0;
+  if (!group_head) {
+    /* возвращаемся к исходной позиции внутри группы */
+    rc = cursor->bring(&cursor->current, &data, MDBX_GET_BOTH);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+  }
+
+  while (n > 0) {
+    if (group_head) {
+      size_t dups;
+      rc = mdbx_cursor_count(cursor->mdbx_cursor, &dups);
+      if (unlikely(rc != MDBX_SUCCESS))
+        goto bailout;
+      if (dups <= n) {
+        rc = cursor->bring(&cursor->current, &data, jump_op);
+        if (rc != MDBX_SUCCESS || !fpta_cursor_within_range(cursor, forward))
+          goto eof;
+        n -= dups;
+        continue;
+      }
+    }
+
+    if (paged) {
+      bool done;
+      rc = fpta_cursor_skip_page(cursor, forward, n, done);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      if (done)
+        break;
+    } else {
+      rc = cursor->bring(&cursor->current, &data, step_op);
+      if (rc == MDBX_SUCCESS) {
+        group_head = false;
+        n -= 1;
+        continue;
+      }
+      if (unlikely(rc != MDBX_NOTFOUND))
+        goto bailout;
+    }
+
+    /* текущая группа пройдена, переходим к следующему ключу */
+    rc = cursor->bring(&cursor->current, &data, jump_op);
+    if (rc != MDBX_SUCCESS || !fpta_cursor_within_range(cursor, forward))
+      goto eof;
+    group_head = true;
+    n -= 1;
+  }
+
+  cursor->metrics.results += 1;
+  return FPTA_SUCCESS;
+
+eof:
+  if (unlikely(rc != MDBX_SUCCESS && rc != MDBX_NOTFOUND))
+    goto bailout;
+  cursor->set_eof(forward ? fpta_cursor::after_last
+                          : fpta_cursor::before_first);
+  cursor->seek_range_state = 0;
+  return FPTA_NODATA;
+
+bailout:
+  cursor->set_poor();
+  return rc;
+}
+
+/* Оценивает количество записей индекса от текущей позиции курсора до первого
+ * ключа, не меньшего заданного числом (в направлении курсора). */
+static int fpta_cursor_skip_probe(fpta_cursor *cursor, MDBX_cursor *probe,
+                                  unsigned dbi_flags, const MDBX_val &base,
+                                  size_t prefix, uint64_t number,
+                                  const MDBX_val &data, MDBX_val &found,
+                                  ptrdiff_t &distance) {
+  fpta_key key;
+  fpta_index_ordinal2key(number, dbi_flags, base, prefix, key);
+  found = key.mdbx;
+  MDBX_val found_data;
+  int rc = mdbx_cursor_get(probe, &found, &found_data, MDBX_SET_RANGE);
+  if (rc == MDBX_NOTFOUND) {
+    found.iov_base = nullptr;
+    distance = fpta_cursor_is_descending(cursor->options) ? 0 : PTRDIFF_MAX;
+    return FPTA_SUCCESS;
+  }
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_val current = cursor->current, current_data = data;
+  return fpta_cursor_is_descending(cursor->options)
+             ? mdbx_estimate_range(cursor->txn->mdbx_txn, cursor->idx_handle,
+                                   &found, nullptr, &current, &current_data,
+                                   &distance)
+             : mdbx_estimate_range(cursor->txn->mdbx_txn, cursor->idx_handle,
+                                   &current, &current_data, &found, nullptr,
+                                   &distance);
+}
+
+/* Приблизительное перемещение: бинарным поиском подбирается ближайший ключ,
+ * по оценке отстоящий от текущей позиции не менее чем на n записей.
+ * Если такой ключ не отличается от текущего, то взводится fallback. */
+static int fpta_cursor_skip_estimated(fpta_cursor *cursor, size_t n,
+                                      bool &fallback) {
+  const bool forward = !fpta_cursor_is_descending(cursor->options);
+  MDBX_txn *const txn = cursor->txn->mdbx_txn;
+  unsigned dbi_flags;
+  int rc = mdbx_dbi_flags(txn, cursor->idx_handle, &dbi_flags);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_val data;
+  rc = mdbx_cursor_get(cursor->mdbx_cursor, &cursor->current, &data,
+                       MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_cursor *probe;
+  rc = mdbx_cursor_open(txn, cursor->idx_handle, &probe);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  /* граница диапазона, либо крайний ключ в направлении перемещения */
+  MDBX_val bound, bound_data;
+  if (forward && (cursor->seek_range_flags & fpta_cursor::need_cmp_range_to))
+    bound = cursor->range_to_key.mdbx;
+  else if (!forward &&
+           (cursor->seek_range_flags & fpta_cursor::need_cmp_range_from))
+    bound = cursor->range_from_key.mdbx;
+  else {
+    rc = mdbx_cursor_get(probe, &bound, &bound_data,
+                         forward ? MDBX_LAST : MDBX_FIRST);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+  }
+
+  {
+    const ptrdiff_t target = (n < size_t(PTRDIFF_MAX)) ? ptrdiff_t(n)
+                                                       : PTRDIFF_MAX;
+    const size_t prefix =
+        fpta_index_ordinal_prefix(cursor->current, bound, dbi_flags);
+    const uint64_t here =
+        fpta_index_key2ordinal(cursor->current, dbi_flags, prefix);
+    const uint64_t there = fpta_index_key2ordinal(bound, dbi_flags, prefix);
+    uint64_t lo = forward ? here : there, hi = forward ? there : here;
+    MDBX_val found;
+    ptrdiff_t distance;
+    while (lo < hi) {
+      /* вперед ищется наименьший подходящий ключ, назад наибольший */
+      const uint64_t middle =
+          forward ? lo + (hi - lo) / 2 : hi - (hi - lo) / 2;
+      rc = fpta_cursor_skip_probe(cursor, probe, dbi_flags, bound, prefix,
+                                  middle, data, found, distance);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      if (distance >= target)
+        (forward ? hi : lo) = middle;
+      else if (forward)
+        lo = middle + 1;
+      else
+        hi = middle - 1;
+    }
+
+    rc = fpta_cursor_skip_probe(cursor, probe, dbi_flags, bound, prefix, lo,
+                                data, found, distance);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+    if (distance < target || !found.iov_base) {
+      /* по оценке строк до конца диапазона меньше n */
+      mdbx_cursor_close(probe);
+      cursor->set_eof(forward ? fpta_cursor::after_last
+                              : fpta_cursor::before_first);
+      cursor->seek_range_state = 0;
+      return FPTA_NODATA;
+    }
+
+    const auto cmp = mdbx_cmp(txn, cursor->idx_handle, &found,
+                              &cursor->current);
+    if (forward ? cmp <= 0 : cmp >= 0) {
+      /* ключи неразличимы для поиска, либо пропуск внутри группы
+       * дубликатов текущего ключа */
+      fallback = true;
+      mdbx_cursor_close(probe);
+      return FPTA_SUCCESS;
+    }
+
+    rc = fpta_cursor_seek(cursor, MDBX_SET_RANGE,
+                          forward ? MDBX_NEXT : MDBX_PREV, &found, nullptr);
+  }
+
+bailout:
+  mdbx_cursor_close(probe);
+  return rc;
+}
+
+int fpta_cursor_skip(fpta_cursor *cursor, size_t n, bool exact) {
+  int rc = fpta_cursor_validate(cursor, fpta_read);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  if (n == 0) {
+    if (unlikely(!cursor->is_filled()))
+      return cursor->unladed_state();
+    return FPTA_SUCCESS;
+  }
+
+  if (cursor->is_filled()) {
+    if (!exact) {
+      bool fallback = false;
+      rc = fpta_cursor_skip_estimated(cursor, n, fallback);
+      if (!fallback)
+        return rc;
+    }
+    if (!cursor->filter && !fpta_index_is_unique(cursor->index_shove()))
+      return fpta_cursor_skip_dups(cursor, n);
+  }
+
+  for (rc = FPTA_SUCCESS; n > 0 && likely(rc == FPTA_SUCCESS); --n)
+    rc = fpta_cursor_move(cursor, fpta_next);
+  return rc;
+}
+
 int fpta_cursor_locate(fpta_cursor *cursor, bool exactly, const fpta_value *key,
                        const fptu_ro *row) {
   int rc = fpta_cursor_validate(cursor, fpta_read);
@@ -633,7 +1221,9 @@ int fpta_cursor_locate(fpta_cursor *cursor, bool exactly, const fpta_value *key,
   if (key) {
     /* Поиск по значению проиндексированной колонки, конвертируем его в ключ
      * для поиска по индексу. Дополнительных данных для поиска нет. */
-    rc = fpta_index_value2key(cursor->index_shove(), *key, seek_key, false);
+    rc = fpta_index_value2key(
+        cursor->index_shove(), *key, seek_key, false,
+        cursor->table_schema()->key_limit(cursor->column_number));
     if (unlikely(rc != FPTA_SUCCESS)) {
       cursor->set_poor();
       return rc;
@@ -841,6 +1431,24 @@ int fpta_cursor_dups(fpta_cursor *cursor, size_t *pdups) {
 
 //----------------------------------------------------------------------------
 
+static int fpta_cursor_fetch_row(fpta_cursor *cursor, fptu_ro *row) {
+  if (fpta_index_is_primary(cursor->index_shove()))
+    return cursor->bring(&cursor->current, &row->sys, MDBX_GET_CURRENT);
+
+  MDBX_val se_value, pk_key;
+  int rc = cursor->bring(&cursor->current, &se_value, MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                         se_value, pk_key);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  cursor->metrics.pk_lookups += 1;
+  rc = mdbx_get(cursor->txn->mdbx_txn, cursor->tbl_handle, &pk_key, &row->sys);
+  return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+}
+
 int fpta_cursor_get(fpta_cursor *cursor, fptu_ro *row) {
   if (unlikely(row == nullptr))
     return FPTA_EINVAL;
@@ -855,17 +1463,30 @@ int fpta_cursor_get(fpta_cursor *cursor, fptu_ro *row) {
   if (unlikely(!cursor->is_filled()))
     return cursor->unladed_state();
 
-  if (fpta_index_is_primary(cursor->index_shove()))
-    return cursor->bring(&cursor->current, &row->sys, MDBX_GET_CURRENT);
+  return fpta_cursor_fetch_row(cursor, row);
+}
 
-  MDBX_val pk_key;
-  rc = cursor->bring(&cursor->current, &pk_key, MDBX_GET_CURRENT);
-  if (unlikely(rc != MDBX_SUCCESS))
+int fpta_cursor_get_covered(fpta_cursor *cursor, fptu_ro *projection) {
+  if (unlikely(projection == nullptr))
+    return FPTA_EINVAL;
+
+  int rc = fpta_cursor_validate(cursor, fpta_read);
+  if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  cursor->metrics.pk_lookups += 1;
-  rc = mdbx_get(cursor->txn->mdbx_txn, cursor->tbl_handle, &pk_key, &row->sys);
-  return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+  if (!cursor->table_schema()->is_covering(cursor->column_number))
+    return fpta_cursor_get(cursor, projection);
+
+  projection->total_bytes = 0;
+  projection->units = nullptr;
+  if (unlikely(!cursor->is_filled()))
+    return cursor->unladed_state();
+
+  MDBX_val se_value, pk_key;
+  rc = cursor->bring(&cursor->current, &se_value, MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  return fpta_covering_split(se_value, *projection, pk_key);
 }
 
 int fpta_cursor_key(fpta_cursor *cursor, fpta_value *key) {
@@ -878,7 +1499,307 @@ int fpta_cursor_key(fpta_cursor *cursor, fpta_value *key) {
   if (unlikely(!cursor->is_filled()))
     return cursor->unladed_state();
 
-  rc = fpta_index_key2value(cursor->index_shove(), cursor->current, *key);
+  rc = fpta_index_key2value(
+      cursor->index_shove(), cursor->current, *key,
+      cursor->table_schema()->key_limit(cursor->column_number));
+  return rc;
+}
+
+/* Извлекает строки для дубликатов ключа в текущей позиции курсора,
+ * получая значения вторичного индекса целой страницей посредством
+ * MDBX_GET_MULTIPLE, начиная с текущего дубликата.
+ *
+ * Если вся оставшаяся часть страницы уместилась в max, то курсор остается
+ * на последнем дубликате страницы и page_end = true. Иначе курсор
+ * переставляется на первый не извлеченный дубликат. Если у ключа нет
+ * дубликатов, то ничего не извлекается и fetched = 0. */
+static int fpta_cursor_fetch_page(fpta_cursor *cursor, fptu_ro *rows,
+                                  size_t max, size_t &fetched,
+                                  bool &page_end) {
+  fetched = 0;
+  page_end = true;
+
+  MDBX_val key, item, page;
+  int rc = cursor->bring(&key, &item, MDBX_GET_CURRENT);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  page.iov_base = nullptr;
+  page.iov_len = 0;
+  rc = cursor->bring(&key, &page, MDBX_GET_MULTIPLE);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  if (page.iov_base == nullptr)
+    /* единственное значение для ключа, курсор не перемещался */
+    return FPTA_SUCCESS;
+
+  /* MDBX_GET_MULTIPLE возвращает страницу целиком, поэтому пропускаем
+   * дубликаты перед текущим */
+  const uint8_t *const begin = (const uint8_t *)page.iov_base;
+  const uint8_t *const end = begin + page.iov_len;
+  const uint8_t *const ptr = (const uint8_t *)item.iov_base;
+  const size_t xsize = item.iov_len;
+  if (unlikely(xsize == 0 || ptr < begin || ptr >= end ||
+               (size_t)(ptr - begin) % xsize)) {
+    cursor->set_poor();
+    return FPTA_EOOPS;
+  }
+
+  size_t count = (size_t)(end - ptr) / xsize;
+  if (count > max) {
+    count = max;
+    page_end = false;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    MDBX_val pk_key;
+    item.iov_base = (void *)(ptr + i * xsize);
+    rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                           item, pk_key);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+    cursor->metrics.pk_lookups += 1;
+    rc = mdbx_get(cursor->txn->mdbx_txn, cursor->tbl_handle, &pk_key,
+                  &rows[i].sys);
+    if (unlikely(rc != MDBX_SUCCESS)) {
+      if (rc == MDBX_NOTFOUND)
+        rc = FPTA_INDEX_CORRUPTED;
+      goto bailout;
+    }
+    fetched += 1;
+  }
+  /* первый дубликат уже учтен при позиционировании курсора */
+  cursor->metrics.results += count - 1;
+
+  if (!page_end) {
+    item.iov_base = (void *)(ptr + count * xsize);
+    rc = cursor->bring(&cursor->current, &item, MDBX_GET_BOTH);
+    if (unlikely(rc != MDBX_SUCCESS)) {
+      if (rc == MDBX_NOTFOUND)
+        rc = FPTA_INDEX_CORRUPTED;
+      goto bailout;
+    }
+    cursor->metrics.results += 1;
+  }
+  return FPTA_SUCCESS;
+
+bailout:
+  cursor->set_poor();
+  return rc;
+}
+
+/* Извлекает строки по вторичному индексу в режиме fpta_batched_lookup.
+ *
+ * Перебирает окно записей индекса без чтения строк, начиная с текущей
+ * позиции курсора и проверяя только условия фильтра по ключу, затем
+ * читает строки по упорядоченным PK курсором основной таблицы, который
+ * при этом движется только вперед. После проверки фильтра строки
+ * возвращаются в порядке индекса, либо в порядке PK для курсоров
+ * без сортировки.
+ *
+ * Текущая позиция курсора всегда удовлетворяет фильтру, поэтому в окне
+ * есть хотя бы одна подходящая строка. По завершении курсор переставляется
+ * на следующую за окном подходящую строку. */
+static int fpta_cursor_fetch_window(fpta_cursor *cursor,
+                                    MDBX_cursor *pk_cursor, fptu_ro *rows,
+                                    fpta_value *keys, size_t max,
+                                    size_t &fetched) {
+  MDBX_val pk[fpta_batched_lookup_window];
+  fptu_ro found[fpta_batched_lookup_window];
+  fpta_value found_keys[fpta_batched_lookup_window];
+  unsigned order[fpta_batched_lookup_window];
+
+  fetched = 0;
+  const size_t window = std::min(max, size_t(fpta_batched_lookup_window));
+  const MDBX_cursor_op step_op =
+      fpta_cursor_is_descending(cursor->options) ? MDBX_PREV : MDBX_NEXT;
+  const fpta_shove_t index_shove = cursor->index_shove();
+  const size_t key_limit =
+      cursor->table_schema()->key_limit(cursor->column_number);
+  const size_t results_before = cursor->metrics.results;
+
+  /* собираем окно PK, временно отключив фильтр */
+  const fpta_filter *const filter = cursor->filter;
+  cursor->filter = nullptr;
+  size_t count = 0;
+  int rc;
+  for (;;) {
+    MDBX_val se_value;
+    rc = cursor->bring(&cursor->current, &se_value, MDBX_GET_CURRENT);
+    if (unlikely(rc != MDBX_SUCCESS))
+      break;
+    rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                           se_value, pk[count]);
+    if (unlikely(rc != FPTA_SUCCESS))
+      break;
+    /* первая запись окна уже проверена фильтром при позиционировании */
+    bool match = true;
+    if (cursor->key_filter && count > 0) {
+      rc = fpta_cursor_key_match(cursor, filter, pk[count], match);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+    }
+    if (match) {
+      if (keys) {
+        rc = fpta_index_key2value(index_shove, cursor->current,
+                                  found_keys[count], key_limit);
+        if (unlikely(rc != FPTA_SUCCESS))
+          break;
+      }
+      order[count] = unsigned(count);
+      if (++count == window)
+        break;
+    } else {
+      cursor->metrics.key_filtered += 1;
+    }
+    rc = fpta_cursor_seek(cursor, step_op, step_op, nullptr, nullptr);
+    if (rc != FPTA_SUCCESS)
+      break;
+  }
+  cursor->filter = filter;
+  if (unlikely(rc != FPTA_SUCCESS && rc != FPTA_NODATA)) {
+    cursor->set_poor();
+    return rc;
+  }
+  const bool eof = (rc == FPTA_NODATA);
+
+  /* читаем строки в порядке PK */
+  MDBX_txn *const mdbx_txn = cursor->txn->mdbx_txn;
+  const MDBX_dbi tbl_handle = cursor->tbl_handle;
+  std::sort(order, order + count, [&](unsigned a, unsigned b) {
+    return mdbx_cmp(mdbx_txn, tbl_handle, &pk[a], &pk[b]) < 0;
+  });
+  for (size_t i = 0; i < count; ++i) {
+    MDBX_val key = pk[order[i]];
+    cursor->metrics.pk_lookups += 1;
+    rc = mdbx_cursor_get(pk_cursor, &key, &found[order[i]].sys, MDBX_SET_KEY);
+    if (unlikely(rc != MDBX_SUCCESS)) {
+      cursor->set_poor();
+      return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+    }
+  }
+
+  const bool pk_order = !fpta_cursor_is_ordered(cursor->options);
+  for (size_t i = 0; i < count; ++i) {
+    const unsigned n = pk_order ? order[i] : unsigned(i);
+    if (filter && !fpta_filter_match(filter, found[n]))
+      continue;
+    rows[fetched] = found[n];
+    if (keys)
+      keys[fetched] = found_keys[n];
+    ++fetched;
+  }
+  /* строки окна учтены при позиционировании без фильтра */
+  cursor->metrics.results = results_before + fetched - (fetched ? 1 : 0);
+
+  if (eof)
+    return FPTA_SUCCESS;
+  rc = fpta_cursor_seek(cursor, step_op, step_op, nullptr, nullptr);
+  return (rc == FPTA_NODATA) ? (int)FPTA_SUCCESS : rc;
+}
+
+int fpta_cursor_fetch_batch(fpta_cursor *cursor, fptu_ro *rows,
+                            fpta_value *keys, size_t max, size_t *got) {
+  if (unlikely(got == nullptr || (rows == nullptr && max)))
+    return FPTA_EINVAL;
+  *got = 0;
+
+  int rc = fpta_cursor_validate(cursor, fpta_read);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  if (unlikely(!cursor->is_filled()))
+    return cursor->unladed_state();
+
+  if ((cursor->options & fpta_batched_lookup) &&
+      fpta_index_is_secondary(cursor->index_shove()) && !cursor->covered &&
+      !cursor->bitmap_filter) {
+    MDBX_cursor *pk_cursor;
+    rc = mdbx_cursor_open(cursor->txn->mdbx_txn, cursor->tbl_handle,
+                          &pk_cursor);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+    size_t n = 0;
+    while (n < max && cursor->is_filled()) {
+      size_t fetched;
+      rc = fpta_cursor_fetch_window(cursor, pk_cursor, rows + n,
+                                    keys ? keys + n : nullptr, max - n,
+                                    fetched);
+      n += fetched;
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+    }
+    mdbx_cursor_close(pk_cursor);
+    *got = n;
+    return rc;
+  }
+
+  const MDBX_cursor_op step_op =
+      fpta_cursor_is_descending(cursor->options) ? MDBX_PREV : MDBX_NEXT;
+
+  /* Без фильтра все дубликаты ключа попадают в выборку, поэтому для
+   * вторичных индексов с PK фиксированного размера их можно извлекать
+   * страницами при движении в порядке дубликатов. Для последней строки
+   * пакета это не выгодно, так как потребует поиска для перестановки
+   * курсора. */
+  bool multiple = false;
+  if (step_op == MDBX_NEXT && !cursor->filter &&
+      fpta_index_is_secondary(cursor->index_shove()) &&
+      !fpta_index_is_unique(cursor->index_shove())) {
+    unsigned dbi_flags;
+    rc = mdbx_dbi_flags(cursor->txn->mdbx_txn, cursor->idx_handle,
+                        &dbi_flags);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+    multiple = (dbi_flags & MDBX_DUPFIXED) != 0;
+  }
+
+  const fpta_shove_t index_shove = cursor->index_shove();
+  const size_t key_limit =
+      cursor->table_schema()->key_limit(cursor->column_number);
+  size_t n = 0;
+  while (n < max) {
+    if (keys) {
+      rc = fpta_index_key2value(index_shove, cursor->current, keys[n],
+                                key_limit);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+    }
+
+    size_t fetched = 0;
+    bool page_end = true;
+    if (multiple && max - n > 1) {
+      rc = fpta_cursor_fetch_page(cursor, rows + n, max - n, fetched,
+                                  page_end);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+    }
+    if (fetched == 0) {
+      rc = fpta_cursor_fetch_row(cursor, rows + n);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+      fetched = 1;
+    }
+
+    if (keys) {
+      for (size_t i = 1; i < fetched; ++i)
+        keys[n + i] = keys[n];
+    }
+    n += fetched;
+
+    if (!page_end)
+      /* курсор уже стоит на следующей строке */
+      break;
+
+    rc = fpta_cursor_seek(cursor, step_op, step_op, nullptr, nullptr);
+    if (unlikely(rc != FPTA_SUCCESS)) {
+      if (rc == FPTA_NODATA)
+        rc = FPTA_SUCCESS;
+      break;
+    }
+  }
+
+  *got = n;
   return rc;
 }
 
@@ -910,7 +1831,11 @@ int fpta_cursor_delete(fpta_cursor *cursor) {
         pk_key.iov_base = memcpy(buffer, pk_key.iov_base, pk_key.iov_len);
       }
     } else {
-      rc = cursor->bring(&cursor->current, &pk_key, MDBX_GET_CURRENT);
+      MDBX_val se_value;
+      rc = cursor->bring(&cursor->current, &se_value, MDBX_GET_CURRENT);
+      if (likely(rc == MDBX_SUCCESS))
+        rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                               se_value, pk_key);
       if (unlikely(rc != MDBX_SUCCESS)) {
         cursor->set_poor();
         return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
@@ -949,6 +1874,28 @@ int fpta_cursor_delete(fpta_cursor *cursor) {
       return fpta_internal_abort(cursor->txn, rc);
     }
 
+    if (unlikely(cursor->table_schema()->is_multivalued(
+            cursor->column_number))) {
+      /* Пары для остальных значений строки удаляются из индекса курсора
+       * до удаления текущей. Страницы индекса при этом изменяются, поэтому
+       * ключи предварительно копируются. */
+      MDBX_val pk_copy, current;
+      pk_copy.iov_len = pk_key.iov_len;
+      pk_copy.iov_base = memcpy(alloca(pk_key.iov_len + 1), pk_key.iov_base,
+                                pk_key.iov_len);
+      current.iov_len = cursor->current.iov_len;
+      current.iov_base =
+          memcpy(alloca(current.iov_len + 1), cursor->current.iov_base,
+                 current.iov_len);
+      rc = fpta_multivalued_update(cursor->txn, cursor->table_schema(),
+                                   cursor->column_number, cursor->idx_handle,
+                                   pk_copy, &row, pk_copy, nullptr, &current);
+      if (unlikely(rc != MDBX_SUCCESS)) {
+        cursor->set_poor();
+        return fpta_internal_abort(cursor->txn, rc);
+      }
+    }
+
     if (!fpta_index_is_primary(cursor->index_shove())) {
       rc = mdbx_cursor_del(cursor->mdbx_cursor, 0);
       if (unlikely(rc != MDBX_SUCCESS)) {
@@ -976,6 +1923,27 @@ int fpta_cursor_delete(fpta_cursor *cursor) {
 
 //----------------------------------------------------------------------------
 
+/* Формирует ключ индекса курсора для новой версии текущей строки, который
+ * должен совпадать с текущим. Для многозначного индекса достаточно, чтобы
+ * текущее значение оставалось среди значений колонки. */
+static int fpta_cursor_column_key(const fpta_cursor *cursor,
+                                  const fptu_ro &new_row_value,
+                                  fpta_key &column_key) {
+  const fpta_table_schema *table_def = cursor->table_schema();
+  if (unlikely(table_def->is_multivalued(cursor->column_number)))
+    return fpta_multivalued_lookup(table_def, cursor->column_number,
+                                   new_row_value, cursor->current, column_key);
+
+  int rc = fpta_index_row2key(table_def, cursor->column_number, new_row_value,
+                              column_key, false);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  return fpta_is_same(cursor->current, column_key.mdbx)
+             ? (int)FPTA_SUCCESS
+             : (int)FPTA_KEY_MISMATCH;
+}
+
 int fpta_cursor_validate_update_ex(fpta_cursor *cursor, fptu_ro new_row_value,
                                    fpta_put_options op) {
   if (unlikely(op != fpta_update &&
@@ -990,12 +1958,13 @@ int fpta_cursor_validate_update_ex(fpta_cursor *cursor, fptu_ro new_row_value,
     return cursor->unladed_state();
 
   fpta_key column_key;
-  rc = fpta_index_row2key(cursor->table_schema(), cursor->column_number,
-                          new_row_value, column_key, false);
+  rc = fpta_cursor_column_key(cursor, new_row_value, column_key);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  if (!fpta_is_same(cursor->current, column_key.mdbx))
+  const fpta_filter *predicate =
+      cursor->table_schema()->partial_predicate(cursor->column_number);
+  if (predicate && !fpta_filter_match(predicate, new_row_value))
     return FPTA_KEY_MISMATCH;
 
   if ((op & fpta_skip_nonnullable_check) == 0) {
@@ -1015,13 +1984,18 @@ int fpta_cursor_validate_update_ex(fpta_cursor *cursor, fptu_ro new_row_value,
 
     cursor->metrics.uniq_checks += 1;
     return fpta_check_secondary_uniq(cursor->txn, cursor->table_schema(),
-                                     present_row, new_row_value, 0);
+                                     present_row, new_row_value, 0,
+                                     &cursor->metrics.uniq_filtered);
   }
 
-  MDBX_val present_pk_key;
-  rc = cursor->bring(&cursor->current, &present_pk_key, MDBX_GET_CURRENT);
+  MDBX_val present_se_value, present_pk_key;
+  rc = cursor->bring(&cursor->current, &present_se_value, MDBX_GET_CURRENT);
   if (unlikely(rc != MDBX_SUCCESS))
     return rc;
+  rc = fpta_secondary2pk(cursor->table_schema(), cursor->column_number,
+                         present_se_value, present_pk_key);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
 
   fpta_key new_pk_key;
   rc = fpta_index_row2key(cursor->table_schema(), 0, new_row_value, new_pk_key,
@@ -1038,7 +2012,8 @@ int fpta_cursor_validate_update_ex(fpta_cursor *cursor, fptu_ro new_row_value,
   cursor->metrics.uniq_checks += 1;
   return fpta_check_secondary_uniq(cursor->txn, cursor->table_schema(),
                                    present_row, new_row_value,
-                                   cursor->column_number);
+                                   cursor->column_number,
+                                   &cursor->metrics.uniq_filtered);
 }
 
 int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
@@ -1050,17 +2025,27 @@ int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
     return cursor->unladed_state();
 
   const fpta_table_schema *table_def = cursor->table_schema();
+  /* поля удаленных колонок не переносятся в новую версию строки */
+  fpta_dropped_stripper stripper;
+  if (unlikely(table_def->has_dropped())) {
+    rc = stripper.apply(table_def, new_row_value);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
   rc = fpta_check_nonnullable(table_def, new_row_value);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
   fpta_key column_key;
-  rc = fpta_index_row2key(table_def, cursor->column_number, new_row_value,
-                          column_key, false);
+  rc = fpta_cursor_column_key(cursor, new_row_value, column_key);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  if (!fpta_is_same(cursor->current, column_key.mdbx))
+  /* строка не может покинуть частичный индекс, по которому открыт курсор */
+  const fpta_filter *predicate =
+      table_def->partial_predicate(cursor->column_number);
+  if (predicate && !fpta_filter_match(predicate, new_row_value))
     return FPTA_KEY_MISMATCH;
 
   cursor->metrics.upserts += 1;
@@ -1082,7 +2067,11 @@ int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
   if (fpta_index_is_primary(cursor->index_shove())) {
     old_pk_key = cursor->current;
   } else {
-    rc = cursor->bring(&cursor->current, &old_pk_key, MDBX_GET_CURRENT);
+    MDBX_val old_se_value;
+    rc = cursor->bring(&cursor->current, &old_se_value, MDBX_GET_CURRENT);
+    if (likely(rc == MDBX_SUCCESS))
+      rc = fpta_secondary2pk(table_def, cursor->column_number, old_se_value,
+                             old_pk_key);
     if (unlikely(rc != MDBX_SUCCESS)) {
       cursor->set_poor();
       return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
@@ -1123,6 +2112,18 @@ int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
+  /* Значение в покрывающем индексе курсора обновляется всегда,
+   * так как вместе с PK в нём хранятся копии колонок строки. */
+  const bool covering = table_def->is_covering(cursor->column_number);
+  fpta_secondary_value se_value;
+  if (covering) {
+    rc = se_value.build(table_def, cursor->column_number, new_row_value,
+                        new_pk_key.mdbx);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  MDBX_val se_data = covering ? se_value.value() : new_pk_key.mdbx;
+
 #if 0 /* LY: в данный момент нет необходимости */
   if (old_pk_key.iov_len > 0 &&
       mdbx_is_dirty(cursor->txn->mdbx_txn, old_pk_key.iov_base) !=
@@ -1133,6 +2134,19 @@ int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
   }
 #endif
 
+  if (unlikely(table_def->is_multivalued(cursor->column_number))) {
+    /* пары для остальных значений строки в индексе курсора обновляются
+     * по разнице, а текущая ниже самим курсором */
+    rc = fpta_multivalued_update(cursor->txn, table_def, cursor->column_number,
+                                 cursor->idx_handle, old_pk_key, &old_row,
+                                 new_pk_key.mdbx, &new_row_value,
+                                 &column_key.mdbx);
+    if (unlikely(rc != MDBX_SUCCESS)) {
+      cursor->set_poor();
+      return fpta_internal_abort(cursor->txn, rc);
+    }
+  }
+
   rc = fpta_secondary_upsert(cursor->txn, cursor->table_schema(), old_pk_key,
                              old_row, new_pk_key.mdbx, new_row_value,
                              cursor->column_number);
@@ -1158,12 +2172,15 @@ int fpta_cursor_update(fpta_cursor *cursor, fptu_ro new_row_value) {
       return fpta_internal_abort(cursor->txn, rc);
     }
 
-    rc = mdbx_cursor_put(cursor->mdbx_cursor, &column_key.mdbx,
-                         &new_pk_key.mdbx, MDBX_CURRENT | MDBX_NODUPDATA);
+    rc = mdbx_cursor_put(cursor->mdbx_cursor, &column_key.mdbx, &se_data,
+                         MDBX_CURRENT | MDBX_NODUPDATA);
 
   } else {
     rc = mdbx_put(cursor->txn->mdbx_txn, cursor->tbl_handle, &new_pk_key.mdbx,
                   &new_row_value.sys, MDBX_CURRENT | MDBX_NODUPDATA);
+    if (covering && likely(rc == MDBX_SUCCESS))
+      rc = mdbx_cursor_put(cursor->mdbx_cursor, &column_key.mdbx, &se_data,
+                           MDBX_CURRENT | MDBX_NODUPDATA);
   }
 
   if (likely(rc == MDBX_SUCCESS) &&
@@ -1192,18 +2209,20 @@ int fpta_apply_visitor(
   if (unlikely(limit < 1 || !visitor))
     return FPTA_EINVAL;
 
-  fpta_cursor *cursor = nullptr /* TODO: заменить на объект на стеке */;
-  int rc =
-      fpta_cursor_open(txn, column_id, range_from, range_to, filter,
-                       (fpta_cursor_options)(op & ~fpta_dont_fetch), &cursor);
+  fpta_cursor_storage storage;
+  fpta_cursor *cursor = nullptr;
+  int rc = fpta_cursor_open_external(
+      txn, column_id, range_from, range_to, filter,
+      (fpta_cursor_options)(op & ~fpta_dont_fetch), &storage, &cursor);
 
-  for (; skip > 0 && likely(rc == FPTA_SUCCESS); --skip)
-    rc = fpta_cursor_move(cursor, fpta_next);
+  if (skip > 0 && likely(rc == FPTA_SUCCESS))
+    rc = fpta_cursor_skip(cursor, skip, true);
 
   if (page_top) {
     if (rc == FPTA_SUCCESS) {
-      int err = fpta_index_key2value(cursor->index_shove(), cursor->current,
-                                     *page_top);
+      int err = fpta_index_key2value(
+          cursor->index_shove(), cursor->current, *page_top,
+          cursor->table_schema()->key_limit(cursor->column_number));
       assert(err == FPTA_SUCCESS);
       if (unlikely(err != FPTA_SUCCESS))
         rc = err;
@@ -1229,8 +2248,9 @@ int fpta_apply_visitor(
 
   if (page_bottom) {
     if (cursor && cursor->is_filled()) {
-      int err = fpta_index_key2value(cursor->index_shove(), cursor->current,
-                                     *page_bottom);
+      int err = fpta_index_key2value(
+          cursor->index_shove(), cursor->current, *page_bottom,
+          cursor->table_schema()->key_limit(cursor->column_number));
       assert(err == FPTA_SUCCESS);
       if (unlikely(err != FPTA_SUCCESS))
         rc = err;
@@ -1263,6 +2283,9 @@ int fpta_cursor_info(fpta_cursor *cursor, fpta_cursor_stat *stat) {
   stat->index_scans = cursor->metrics.scans;
   stat->pk_lookups = cursor->metrics.pk_lookups;
   stat->uniq_checks = cursor->metrics.uniq_checks;
+  stat->uniq_filtered = cursor->metrics.uniq_filtered;
+  stat->bitmap_filtered = cursor->metrics.bitmap_filtered;
+  stat->key_filtered = cursor->metrics.key_filtered;
   stat->upserts = cursor->metrics.upserts;
   stat->deletions = cursor->metrics.deletions;
 
@@ -1320,6 +2343,10 @@ int fpta_cursor_rerere(fpta_cursor *cursor) {
     }
   }
 
+  /* выборка по битовым индексам относится к прежнему снимку данных */
+  fpta_bitmap_release(cursor->bitmap_filter);
+  cursor->bitmap_filter = nullptr;
+
   /* всегда перезапускаем транзакцию и собираем ошибки */
   int err = fpta_transaction_restart(cursor->txn);
   rc = (err == MDBX_SUCCESS) ? rc : err;
@@ -297,10 +297,16 @@ int fpta_upsert_column_ex(fptu_rw *pt, const fpta_name *column_id,
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  const unsigned colnum = column_id->column.num;
+  return fpta_upsert_value(pt, column_id->column.num, column_id->shove, value,
+                           erase_on_denil);
+}
+
+int fpta_upsert_value(fptu_rw *pt, const unsigned colnum,
+                      const fpta_shove_t shove, fpta_value value,
+                      bool erase_on_denil) {
   assert(colnum <= fpta_max_cols);
-  const fptu_type coltype = fpta_shove2type(column_id->shove);
-  const fpta_index_type index = fpta_name_colindex(column_id);
+  const fptu_type coltype = fpta_shove2type(shove);
+  const fpta_index_type index = fpta_shove2index(shove);
 
   if (unlikely(value.type == fpta_null))
     goto erase_field;
@@ -521,7 +527,7 @@ denil_catched:
     return FPTA_EVALUE;
 
 erase_field:
-  rc = fptu::erase(pt, colnum, fptu_any);
+  int rc = fptu::erase(pt, colnum, fptu_any);
   assert(rc >= 0);
   (void)rc;
   return FPTA_SUCCESS;
@@ -529,39 +535,24 @@ erase_field:
 
 //----------------------------------------------------------------------------
 
-int fpta_validate_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row_value,
-                      fpta_put_options op) {
-  if (unlikely(op < fpta_insert ||
-               op > (fpta_upsert | fpta_skip_nonnullable_check)))
-    return FPTA_EFLAG;
-
-  int rc = fpta_name_refresh_couple(txn, table_id, nullptr);
-  if (unlikely(rc != FPTA_SUCCESS))
-    return rc;
-
-  fpta_table_schema *table_def = table_id->table_schema;
-  fpta_key pk_key;
-  rc = fpta_index_row2key(table_def, 0, row_value, pk_key, false);
-  if (unlikely(rc != FPTA_SUCCESS))
-    return rc;
-
-  if (op & fpta_skip_nonnullable_check)
-    op = (fpta_put_options)(op - fpta_skip_nonnullable_check);
-  else {
-    rc = fpta_check_nonnullable(table_def, row_value);
-    if (unlikely(rc != FPTA_SUCCESS))
-      return rc;
-  }
-
-  MDBX_dbi handle;
-  rc = fpta_open_table(txn, table_def, handle);
-  if (unlikely(rc != FPTA_SUCCESS))
-    return rc;
-
+/* Проверяет возможность вставки или обновления строки по ключам new_keys,
+ * keys_rc - результат их вычисления. Для таблиц со вторичными индексами
+ * ключи текущей версии строки копируются в old_keys (строка может быть
+ * в "грязной" странице), а в new_keys отмечаются индексы с изменившимися
+ * ключами. Для полного дубликата существующей строки при обновлении
+ * возвращает MDBX_RESULT_TRUE, т.е. что ничего делать не нужно. */
+static int fpta_validate_put_keys(fpta_txn *txn, fpta_table_schema *table_def,
+                                  MDBX_dbi handle, const fptu_ro &row_value,
+                                  fpta_put_options op, fpta_row_keys &new_keys,
+                                  int keys_rc, fpta_row_keys &old_keys) {
+  assert(!new_keys.empty());
+  /* mdbx_get_ex() заменяет ключ на указывающий внутрь страницы,
+   * поэтому передается копия. */
+  MDBX_val pk_key = new_keys[0];
   fptu_ro present_row;
   size_t rows_with_same_key;
-  rc = mdbx_get_ex(txn->mdbx_txn, handle, &pk_key.mdbx, &present_row.sys,
-                   &rows_with_same_key);
+  int rc = mdbx_get_ex(txn->mdbx_txn, handle, &pk_key, &present_row.sys,
+                       &rows_with_same_key);
   if (rc != MDBX_SUCCESS) {
     if (unlikely(rc != MDBX_NOTFOUND))
       return rc;
@@ -598,23 +589,58 @@ int fpta_validate_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row_value,
     if (present_row.total_bytes == row_value.total_bytes &&
         !memcmp(present_row.units, row_value.units, present_row.total_bytes))
       /* если полный дубликат записи */
-      return (op == fpta_insert) ? FPTA_KEYEXIST : FPTA_SUCCESS;
+      return (op == fpta_insert) ? (int)FPTA_KEYEXIST : (int)MDBX_RESULT_TRUE;
   }
 
-  if (!table_def->has_secondary())
-    return FPTA_SUCCESS;
+  if (unlikely(keys_rc != FPTA_SUCCESS) || !table_def->has_secondary())
+    return keys_rc;
 
-  return fpta_check_secondary_uniq(txn, table_def, present_row, row_value, 0);
+  if (present_row.sys.iov_base) {
+    rc = old_keys.build(table_def, present_row, true);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  new_keys.diff(old_keys);
+  return fpta_check_secondary_uniq(txn, table_def, new_keys, 0);
 }
 
-int fpta_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row,
-             fpta_put_options op) {
+int fpta_validate_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row_value,
+                      fpta_put_options op) {
+  if (unlikely(op < fpta_insert ||
+               op > (fpta_upsert | fpta_skip_nonnullable_check)))
+    return FPTA_EFLAG;
+
   int rc = fpta_name_refresh_couple(txn, table_id, nullptr);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
   fpta_table_schema *table_def = table_id->table_schema;
-  unsigned flags = MDBX_NODUPDATA;
+  fpta_row_keys new_keys, old_keys;
+  const int keys_rc = new_keys.build(table_def, row_value);
+  if (unlikely(new_keys.empty()))
+    return keys_rc;
+
+  if (op & fpta_skip_nonnullable_check)
+    op = (fpta_put_options)(op - fpta_skip_nonnullable_check);
+  else {
+    rc = fpta_check_nonnullable(table_def, row_value);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  MDBX_dbi handle;
+  rc = fpta_open_table(txn, table_def, handle);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  rc = fpta_validate_put_keys(txn, table_def, handle, row_value, op, new_keys,
+                              keys_rc, old_keys);
+  return (rc != MDBX_RESULT_TRUE) ? rc : (int)FPTA_SUCCESS;
+}
+
+static int fpta_put_flags(const fpta_table_schema *table_def,
+                          fpta_put_options op, unsigned &flags) {
+  flags = MDBX_NODUPDATA;
   switch (op) {
   default:
     return FPTA_EFLAG;
@@ -630,13 +656,103 @@ int fpta_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row,
       flags |= MDBX_NOOVERWRITE;
     break;
   }
+  return FPTA_SUCCESS;
+}
+
+/* Вставляет или обновляет строку в таблице со вторичными индексами.
+ * Если known_old, то old_keys уже содержат ключи текущей версии строки,
+ * полученные при проверке посредством fpta_validate_put_keys(). Иначе
+ * они вычисляются по предыдущей версии строки, извлекаемой при замене. */
+static int fpta_put_keys(fpta_txn *txn, fpta_table_schema *table_def,
+                         MDBX_dbi handle, fptu_ro row, unsigned flags,
+                         fpta_row_keys &new_keys, fpta_row_keys &old_keys,
+                         bool known_old) {
+  assert(table_def->has_secondary());
+  MDBX_val pk_key = new_keys[0];
+  int rc;
+  if (known_old) {
+    rc = mdbx_put(txn->mdbx_txn, handle, &pk_key, &row.sys, flags);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  } else {
+    fptu_ro old_row;
+#if defined(NDEBUG)
+    cxx11_constexpr_var size_t likely_enough = 64u * 42u;
+#else
+    const size_t likely_enough = (time(nullptr) & 1) ? 11u : 64u * 42u;
+#endif /* NDEBUG */
+    void *buffer = alloca(likely_enough);
+    old_row.sys.iov_base = buffer;
+    old_row.sys.iov_len = likely_enough;
+
+    rc = mdbx_replace(txn->mdbx_txn, handle, &pk_key, &row.sys, &old_row.sys,
+                      flags);
+    if (unlikely(rc == MDBX_RESULT_TRUE)) {
+      assert(old_row.sys.iov_base == nullptr &&
+             old_row.sys.iov_len > likely_enough);
+      old_row.sys.iov_base = alloca(old_row.sys.iov_len);
+      rc = mdbx_replace(txn->mdbx_txn, handle, &pk_key, &row.sys,
+                        &old_row.sys, flags);
+    }
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    if (old_row.sys.iov_base) {
+      rc = old_keys.build(table_def, old_row);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return fpta_internal_abort(txn, rc);
+    }
+    new_keys.diff(old_keys);
+  }
+
+  rc = fpta_secondary_upsert(txn, table_def, pk_key, old_keys, pk_key,
+                             new_keys, 0);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return fpta_internal_abort(txn, rc);
+
+  return FPTA_SUCCESS;
+}
+
+int fpta_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row,
+             fpta_put_options op) {
+  int rc = fpta_name_refresh_couple(txn, table_id, nullptr);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_table_schema *table_def = table_id->table_schema;
+  unsigned flags;
+  rc = fpta_put_flags(table_def, op, flags);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  /* поля удаленных колонок не переносятся в новую версию строки */
+  fpta_dropped_stripper stripper;
+  if (unlikely(table_def->has_dropped())) {
+    rc = stripper.apply(table_def, row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
 
   rc = fpta_check_nonnullable(table_def, row);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  fpta_key pk_key;
-  rc = fpta_index_row2key(table_def, 0, row, pk_key, false);
+  if (!table_def->has_secondary()) {
+    fpta_key pk_key;
+    rc = fpta_index_row2key(table_def, 0, row, pk_key, false);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+
+    MDBX_dbi handle;
+    rc = fpta_open_table(txn, table_def, handle);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+
+    return mdbx_put(txn->mdbx_txn, handle, &pk_key.mdbx, &row.sys, flags);
+  }
+
+  fpta_row_keys new_keys, old_keys;
+  rc = new_keys.build(table_def, row);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
@@ -645,39 +761,361 @@ int fpta_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row,
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  if (!table_def->has_secondary())
-    return mdbx_put(txn->mdbx_txn, handle, &pk_key.mdbx, &row.sys, flags);
+  return fpta_put_keys(txn, table_def, handle, row, flags, new_keys, old_keys,
+                       false);
+}
 
-  fptu_ro old_row;
-#if defined(NDEBUG)
-  cxx11_constexpr_var size_t likely_enough = 64u * 42u;
-#else
-  const size_t likely_enough = (time(nullptr) & 1) ? 11u : 64u * 42u;
-#endif /* NDEBUG */
-  void *buffer = alloca(likely_enough);
-  old_row.sys.iov_base = buffer;
-  old_row.sys.iov_len = likely_enough;
+int fpta_probe_and_put(fpta_txn *txn, fpta_name *table_id, fptu_ro row,
+                       fpta_put_options op) {
+  int rc = fpta_name_refresh_couple(txn, table_id, nullptr);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
 
-  rc = mdbx_replace(txn->mdbx_txn, handle, &pk_key.mdbx, &row.sys, &old_row.sys,
-                    flags);
-  if (unlikely(rc == MDBX_RESULT_TRUE)) {
-    assert(old_row.sys.iov_base == nullptr &&
-           old_row.sys.iov_len > likely_enough);
-    old_row.sys.iov_base = alloca(old_row.sys.iov_len);
-    rc = mdbx_replace(txn->mdbx_txn, handle, &pk_key.mdbx, &row.sys,
-                      &old_row.sys, flags);
+  fpta_table_schema *table_def = table_id->table_schema;
+  unsigned flags;
+  rc = fpta_put_flags(table_def, op, flags);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  /* поля удаленных колонок не переносятся в новую версию строки */
+  fpta_dropped_stripper stripper;
+  if (unlikely(table_def->has_dropped())) {
+    rc = stripper.apply(table_def, row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
   }
-  if (unlikely(rc != MDBX_SUCCESS))
+
+  fpta_row_keys new_keys, old_keys;
+  const int keys_rc = new_keys.build(table_def, row);
+  if (unlikely(new_keys.empty()))
+    return keys_rc;
+
+  MDBX_dbi handle;
+  rc = fpta_open_table(txn, table_def, handle);
+  if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  rc = fpta_secondary_upsert(txn, table_def, pk_key.mdbx, old_row, pk_key.mdbx,
-                             row, 0);
-  if (unlikely(rc != MDBX_SUCCESS))
-    return fpta_internal_abort(txn, rc);
+  /* Ключи обеих версий строки вычисляются однократно и используются как
+   * для проверки, так и для обновления вторичных индексов. */
+  rc = fpta_validate_put_keys(txn, table_def, handle, row, op, new_keys,
+                              keys_rc, old_keys);
+  if (rc != FPTA_SUCCESS)
+    return (rc != MDBX_RESULT_TRUE) ? rc : (int)FPTA_SUCCESS;
+
+  rc = fpta_check_nonnullable(table_def, row);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
 
+  if (!table_def->has_secondary())
+    return mdbx_put(txn->mdbx_txn, handle, const_cast<MDBX_val *>(&new_keys[0]),
+                    &row.sys, flags);
+
+  return fpta_put_keys(txn, table_def, handle, row, flags, new_keys, old_keys,
+                       true);
+}
+
+//----------------------------------------------------------------------------
+
+/* Упорядочивает номера строк по ключу, а для таблиц с дубликатами также
+ * по значению, в порядке соответствующей mdbx-таблицы. */
+template <typename KEY, typename VALUE>
+static void fpta_batch_sort(MDBX_txn *txn, MDBX_dbi dbi, bool dupsort,
+                            unsigned *begin, unsigned *end, const KEY &key,
+                            const VALUE &value) {
+  std::stable_sort(begin, end, [&](unsigned a, unsigned b) {
+    int cmp = mdbx_cmp(txn, dbi, key(a), key(b));
+    if (cmp == 0 && dupsort)
+      cmp = mdbx_dcmp(txn, dbi, value(a), value(b));
+    return cmp < 0;
+  });
+}
+
+/* Вставляет в каждый из вторичных индексов пары для строк, которые были
+ * добавлены в основную таблицу (а не обновлены), предварительно упорядочивая
+ * их по значению вторичного ключа. */
+static int fpta_batch_secondaries(fpta_txn *txn, fpta_table_schema *table_def,
+                                  const MDBX_dbi *dbi, const fptu_ro *rows,
+                                  const fpta_key *pk_keys, fpta_key *se_keys,
+                                  unsigned *order, size_t total) {
+  for (size_t i = 1; i < table_def->index_span(); ++i) {
+    const auto shove = table_def->column_shove(i);
+    const auto index = fpta_shove2index(shove);
+    assert(i < fpta_max_indexes);
+    if (!fpta_is_indexed(index))
+      continue;
+
+    /* в частичный индекс попадают только строки подходящие под предикат */
+    size_t count = total;
+    const fpta_filter *predicate = table_def->partial_predicate(i);
+    if (predicate)
+      count = std::partition(order, order + total,
+                             [&](unsigned n) {
+                               return fpta_filter_match(predicate, rows[n]);
+                             }) -
+              order;
+
+    if (table_def->is_multivalued(i)) {
+      /* каждое из значений строки добавляется в индекс отдельной парой */
+      for (size_t n = 0; n < count; ++n) {
+        const MDBX_val &pk_key = pk_keys[order[n]].mdbx;
+        int rc = fpta_multivalued_update(txn, table_def, i, dbi[i], pk_key,
+                                         nullptr, pk_key, &rows[order[n]]);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
+      continue;
+    }
+
+    for (size_t n = 0; n < count; ++n) {
+      int rc = fpta_index_row2key(table_def, i, rows[order[n]],
+                                  se_keys[order[n]], false);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+    }
+
+    const bool unique = fpta_index_is_unique(index);
+    fpta_batch_sort(
+        txn->mdbx_txn, dbi[i], !unique, order, order + count,
+        [&](unsigned n) { return &se_keys[n].mdbx; },
+        [&](unsigned n) { return &pk_keys[n].mdbx; });
+
+    if (table_def->is_bitmap(i)) {
+      /* строки с одинаковым значением добавляются в битовый индекс
+       * одной серией */
+      std::vector<uint64_t> rowids;
+      for (size_t n = 0; n < count;) {
+        const MDBX_val &se_key = se_keys[order[n]].mdbx;
+        rowids.clear();
+        for (; n < count && fpta_is_same(se_keys[order[n]].mdbx, se_key); ++n)
+          rowids.push_back(fpta_bitmap_rowid(pk_keys[order[n]].mdbx));
+        int rc = fpta_bitmap_update(txn, table_def, i, se_key, rowids.data(),
+                                    rowids.size(), true);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
+      continue;
+    }
+
+    fpta_appender appender(txn->mdbx_txn, dbi[i], !unique);
+    int rc = appender.init();
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    const unsigned flags =
+        unique ? MDBX_NODUPDATA | MDBX_NOOVERWRITE : MDBX_NODUPDATA;
+    const bool covering = table_def->is_covering(i);
+    fpta_secondary_value se_value;
+    for (size_t n = 0; n < count; ++n) {
+      const MDBX_val &se_key = se_keys[order[n]].mdbx;
+      MDBX_val se_data = pk_keys[order[n]].mdbx;
+      if (covering) {
+        rc = se_value.build(table_def, i, rows[order[n]], se_data);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+        se_data = se_value.value();
+      }
+      const unsigned append = appender.flags(se_key, se_data);
+      rc = mdbx_put(txn->mdbx_txn, dbi[i], const_cast<MDBX_val *>(&se_key),
+                    &se_data, flags | append);
+      if (unlikely(rc != MDBX_SUCCESS))
+        return rc;
+      if (append)
+        appender.appended(se_key, se_data);
+      if (unique && table_def->bloom_bits(i)) {
+        rc = fpta_bloom_insert(txn, table_def, i, dbi[i], se_key);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
+    }
+  }
   return FPTA_SUCCESS;
 }
 
+int fpta_put_batch(fpta_txn *txn, fpta_name *table_id, const fptu_ro *rows,
+                   size_t count, fpta_put_options op, int *per_row_rc) {
+  if (unlikely(rows == nullptr && count > 0))
+    return FPTA_EINVAL;
+
+  int rc = fpta_name_refresh_couple(txn, table_id, nullptr);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_table_schema *table_def = table_id->table_schema;
+  unsigned flags;
+  rc = fpta_put_flags(table_def, op, flags);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_dbi handle;
+  rc = fpta_open_table(txn, table_def, handle);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  const bool has_secondary = table_def->has_secondary();
+  MDBX_dbi dbi[fpta_max_indexes];
+  if (has_secondary) {
+    rc = fpta_open_secondaries(txn, table_def, dbi);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  if (unlikely(count == 0))
+    return FPTA_SUCCESS;
+
+  /* Добавлять в конец таблицы можно только новые строки. */
+  const bool pk_dupsort = !fpta_index_is_unique(table_def->table_pk());
+  fpta_appender appender(txn->mdbx_txn, handle, pk_dupsort);
+  const bool appendable = op != fpta_update;
+  if (appendable) {
+    rc = appender.init();
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  }
+
+  const size_t chunk_max = std::min(count, (size_t)fpta_put_batch_chunk);
+  fpta_key *pk_keys = (fpta_key *)malloc(chunk_max * sizeof(fpta_key));
+  fpta_key *se_keys =
+      has_secondary ? (fpta_key *)malloc(chunk_max * sizeof(fpta_key))
+                    : nullptr;
+  unsigned *order = (unsigned *)malloc(chunk_max * sizeof(unsigned) * 2);
+  unsigned *inserted = order + chunk_max;
+  void *buffer = nullptr;
+  size_t buffer_size = 0, done = 0;
+  if (unlikely(!pk_keys || !order || (has_secondary && !se_keys))) {
+    rc = FPTA_ENOMEM;
+    goto bailout;
+  }
+
+  rc = FPTA_SUCCESS;
+  for (size_t base = 0; base < count; base += chunk_max) {
+    const size_t chunk = std::min(count - base, chunk_max);
+    const fptu_ro *const chunk_rows = rows + base;
+    int *const chunk_rc = per_row_rc ? per_row_rc + base : nullptr;
+
+    /* Формируем ключи, отсеивая строки с ошибками. */
+    size_t n = 0;
+    for (size_t i = 0; i < chunk; ++i) {
+      int err = fpta_check_nonnullable(table_def, chunk_rows[i]);
+      if (likely(err == FPTA_SUCCESS))
+        err = fpta_index_row2key(table_def, 0, chunk_rows[i], pk_keys[i],
+                                 false);
+      if (chunk_rc)
+        chunk_rc[i] = err;
+      if (likely(err == FPTA_SUCCESS))
+        order[n++] = (unsigned)i;
+      else if (rc == FPTA_SUCCESS)
+        rc = err;
+    }
+    done = base + chunk;
+
+    fpta_batch_sort(
+        txn->mdbx_txn, handle, pk_dupsort, order, order + n,
+        [&](unsigned i) { return &pk_keys[i].mdbx; },
+        [&](unsigned i) { return &chunk_rows[i].sys; });
+
+    size_t inserted_count = 0;
+    for (size_t k = 0; k < n; ++k) {
+      const unsigned i = order[k];
+      MDBX_val *const pk_key = &pk_keys[i].mdbx;
+      MDBX_val *const row = const_cast<MDBX_val *>(&chunk_rows[i].sys);
+
+      int err;
+      if (inserted_count > 0 &&
+          mdbx_cmp(txn->mdbx_txn, handle, pk_key,
+                   &pk_keys[order[k - 1]].mdbx) == 0) {
+        /* Строка с тем же ключом может заменить только что добавленную,
+         * поэтому её пары во вторичных индексах должны уже быть на месте. */
+        err = fpta_batch_secondaries(txn, table_def, dbi, chunk_rows, pk_keys,
+                                     se_keys, inserted, inserted_count);
+        if (unlikely(err != FPTA_SUCCESS)) {
+          rc = fpta_internal_abort(txn, err);
+          goto bailout_cancel;
+        }
+        inserted_count = 0;
+      }
+
+      const unsigned append = appendable ? appender.flags(*pk_key, *row) : 0;
+      if (!has_secondary || append) {
+        err = mdbx_put(txn->mdbx_txn, handle, pk_key, row, flags | append);
+        if (likely(err == MDBX_SUCCESS)) {
+          if (append)
+            appender.appended(*pk_key, *row);
+          if (has_secondary)
+            inserted[inserted_count++] = i;
+        }
+      } else {
+        fptu_ro old_row;
+        old_row.sys.iov_base = buffer;
+        old_row.sys.iov_len = buffer_size;
+        err = mdbx_replace(txn->mdbx_txn, handle, pk_key, row, &old_row.sys,
+                           flags);
+        if (unlikely(err == MDBX_RESULT_TRUE)) {
+          assert(old_row.sys.iov_base == nullptr &&
+                 old_row.sys.iov_len > buffer_size);
+          void *larger = realloc(buffer, old_row.sys.iov_len);
+          if (unlikely(larger == nullptr)) {
+            rc = fpta_internal_abort(txn, FPTA_ENOMEM);
+            goto bailout_cancel;
+          }
+          buffer = larger;
+          buffer_size = old_row.sys.iov_len;
+          old_row.sys.iov_base = buffer;
+          err = mdbx_replace(txn->mdbx_txn, handle, pk_key, row, &old_row.sys,
+                             flags);
+        }
+        if (likely(err == MDBX_SUCCESS)) {
+          if (old_row.sys.iov_base == nullptr)
+            inserted[inserted_count++] = i;
+          else {
+            err = fpta_secondary_upsert(txn, table_def, *pk_key, old_row,
+                                        *pk_key, chunk_rows[i], 0);
+            if (unlikely(err != MDBX_SUCCESS)) {
+              rc = fpta_internal_abort(txn, err);
+              goto bailout_cancel;
+            }
+          }
+        }
+      }
+
+      /* Ошибки при вставке в основную таблицу (нарушение уникальности
+       * первичного ключа, отсутствие обновляемой строки) происходят до
+       * каких-либо изменений и не требуют прерывания транзакции. */
+      if (unlikely(err != MDBX_SUCCESS)) {
+        if (chunk_rc)
+          chunk_rc[i] = err;
+        if (rc == FPTA_SUCCESS)
+          rc = err;
+      }
+    }
+
+    if (inserted_count > 0) {
+      int err = fpta_batch_secondaries(txn, table_def, dbi, chunk_rows,
+                                       pk_keys, se_keys, inserted,
+                                       inserted_count);
+      if (unlikely(err != FPTA_SUCCESS)) {
+        rc = fpta_internal_abort(txn, err);
+        goto bailout_cancel;
+      }
+    }
+  }
+
+bailout:
+  free(buffer);
+  free(order);
+  free(se_keys);
+  free(pk_keys);
+  return rc;
+
+bailout_cancel:
+  /* Транзакция прервана, все изменения утрачены. */
+  if (per_row_rc) {
+    for (size_t i = 0; i < count; ++i)
+      if (i >= done || per_row_rc[i] == FPTA_SUCCESS)
+        per_row_rc[i] = rc;
+  }
+  goto bailout;
+}
+
 //----------------------------------------------------------------------------
 
 int fpta_delete(fpta_txn *txn, fpta_name *table_id, fptu_ro row) {
@@ -731,6 +1169,111 @@ int fpta_delete(fpta_txn *txn, fpta_name *table_id, fptu_ro row) {
   return FPTA_SUCCESS;
 }
 
+int fpta_delete_by_key(fpta_txn *txn, fpta_name *column_id,
+                       const fpta_value *column_value) {
+  if (unlikely(column_value == nullptr))
+    return FPTA_EINVAL;
+  int rc = fpta_id_validate(column_id, fpta_column);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_name *table_id = column_id->column.table;
+  rc = fpta_name_refresh_couple(txn, table_id, column_id);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  if (unlikely(!fpta_is_indexed(column_id->shove)))
+    return FPTA_NO_INDEX;
+
+  const fpta_index_type index = fpta_shove2index(column_id->shove);
+  if (unlikely(!fpta_index_is_unique(index)))
+    return FPTA_NO_INDEX;
+
+  /* частичный индекс содержит не все строки таблицы */
+  if (unlikely(table_id->table_schema->partial_predicate(
+          column_id->column.num)))
+    return FPTA_NO_INDEX;
+
+  fpta_key column_key;
+  rc = fpta_index_value2key(
+      column_id->shove, *column_value, column_key, false,
+      table_id->table_schema->key_limit(column_id->column.num));
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  MDBX_dbi tbl_handle, idx_handle;
+  rc = fpta_open_column(txn, column_id, tbl_handle, idx_handle);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_table_schema *table_def = table_id->table_schema;
+  if (!table_def->has_secondary())
+    return mdbx_del(txn->mdbx_txn, tbl_handle, &column_key.mdbx, nullptr);
+
+  /* Строка и значение PK извлекаются одновременно с удалением, т.е.
+   * за один поиск по каждому из деревьев. Копирование выполняется только
+   * если данные расположены в "грязной" странице. */
+  MDBX_val pk_key;
+  uint64_t pk_buffer[(fpta_keybuf_len + 7) / 8];
+  if (fpta_index_is_primary(index))
+    pk_key = column_key.mdbx;
+  else {
+    MDBX_val se_value;
+    se_value.iov_base = pk_buffer;
+    se_value.iov_len = sizeof(pk_buffer);
+    rc = mdbx_replace(txn->mdbx_txn, idx_handle, &column_key.mdbx, nullptr,
+                      &se_value, MDBX_CURRENT);
+    if (unlikely(rc == MDBX_RESULT_TRUE)) {
+      /* значение покрывающего индекса, либо PK с увеличенным лимитом длины,
+       * может не поместиться в буфер */
+      assert(se_value.iov_base == nullptr &&
+             se_value.iov_len > sizeof(pk_buffer));
+      se_value.iov_base = alloca(se_value.iov_len);
+      rc = mdbx_replace(txn->mdbx_txn, idx_handle, &column_key.mdbx, nullptr,
+                        &se_value, MDBX_CURRENT);
+    }
+    if (unlikely(rc != MDBX_SUCCESS))
+      return (rc != MDBX_RESULT_TRUE) ? rc : (int)FPTA_INDEX_CORRUPTED;
+    rc = fpta_secondary2pk(table_def, column_id->column.num, se_value,
+                           pk_key);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return fpta_internal_abort(txn, rc);
+  }
+
+  fptu_ro row;
+#if defined(NDEBUG)
+  cxx11_constexpr_var size_t likely_enough = 64u * 42u;
+#else
+  const size_t likely_enough = (time(nullptr) & 1) ? 11u : 64u * 42u;
+#endif /* NDEBUG */
+  row.sys.iov_base = alloca(likely_enough);
+  row.sys.iov_len = likely_enough;
+  rc = mdbx_replace(txn->mdbx_txn, tbl_handle, &pk_key, nullptr, &row.sys,
+                    MDBX_CURRENT);
+  if (unlikely(rc == MDBX_RESULT_TRUE)) {
+    assert(row.sys.iov_base == nullptr && row.sys.iov_len > likely_enough);
+    row.sys.iov_base = alloca(row.sys.iov_len);
+    rc = mdbx_replace(txn->mdbx_txn, tbl_handle, &pk_key, nullptr, &row.sys,
+                      MDBX_CURRENT);
+  }
+  if (unlikely(rc != MDBX_SUCCESS)) {
+    if (fpta_index_is_primary(index))
+      return rc;
+    /* Запись во вторичном индексе уже удалена. */
+    return fpta_internal_abort(
+        txn, (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED);
+  }
+
+  rc = fpta_secondary_remove(txn, table_def, pk_key, row,
+                             fpta_index_is_primary(index)
+                                 ? 0
+                                 : column_id->column.num);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return fpta_internal_abort(txn, rc);
+
+  return FPTA_SUCCESS;
+}
+
 int fpta_get(fpta_txn *txn, fpta_name *column_id,
              const fpta_value *column_value, fptu_ro *row) {
   if (unlikely(row == nullptr))
@@ -757,8 +1300,15 @@ int fpta_get(fpta_txn *txn, fpta_name *column_id,
   if (unlikely(!fpta_index_is_unique(index)))
     return FPTA_NO_INDEX;
 
+  /* частичный индекс содержит не все строки таблицы */
+  if (unlikely(table_id->table_schema->partial_predicate(
+          column_id->column.num)))
+    return FPTA_NO_INDEX;
+
   fpta_key column_key;
-  rc = fpta_index_value2key(column_id->shove, *column_value, column_key, false);
+  rc = fpta_index_value2key(
+      column_id->shove, *column_value, column_key, false,
+      table_id->table_schema->key_limit(column_id->column.num));
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
@@ -770,9 +1320,29 @@ int fpta_get(fpta_txn *txn, fpta_name *column_id,
   if (fpta_index_is_primary(index))
     return mdbx_get(txn->mdbx_txn, idx_handle, &column_key.mdbx, &row->sys);
 
-  MDBX_val pk_key;
-  rc = mdbx_get(txn->mdbx_txn, idx_handle, &column_key.mdbx, &pk_key);
-  if (unlikely(rc != MDBX_SUCCESS))
+  const bool bloom =
+      table_id->table_schema->bloom_bits(column_id->column.num) != 0;
+  bool accounted = false;
+  if (bloom) {
+    rc = fpta_bloom_lookup(txn, table_id->table_schema, column_id->column.num,
+                           column_key.mdbx, accounted);
+    if (rc == FPTA_NODATA)
+      return MDBX_NOTFOUND;
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  MDBX_val se_value, pk_key;
+  rc = mdbx_get(txn->mdbx_txn, idx_handle, &column_key.mdbx, &se_value);
+  if (unlikely(rc != MDBX_SUCCESS)) {
+    if (accounted && rc == MDBX_NOTFOUND)
+      fpta_bloom_false_positive(txn, table_id->table_schema,
+                                column_id->column.num);
+    return rc;
+  }
+  rc = fpta_secondary2pk(table_id->table_schema, column_id->column.num,
+                         se_value, pk_key);
+  if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
   rc = mdbx_get(txn->mdbx_txn, tbl_handle, &pk_key, &row->sys);
@@ -781,3 +1351,237 @@ int fpta_get(fpta_txn *txn, fpta_name *column_id,
 
   return rc;
 }
+
+/* Элемент для упорядочивания ключей при пакетном поиске: 64-битный префикс
+ * ключа, порядок которых совпадает с порядком ключей в индексе, позволяет
+ * обойтись без вызова компаратора mdbx для большинства сравнений. */
+struct fpta_ordinal {
+  uint64_t prefix;
+  unsigned index;
+};
+
+static uint64_t fpta_ordinal_prefix(unsigned dbi_flags, const MDBX_val &key) {
+  const uint8_t *const bytes = (const uint8_t *)key.iov_base;
+  if (dbi_flags & MDBX_INTEGERKEY) {
+    if (key.iov_len == 4) {
+      uint32_t u32;
+      memcpy(&u32, bytes, 4);
+      return u32;
+    }
+    assert(key.iov_len == 8);
+    uint64_t u64;
+    memcpy(&u64, bytes, 8);
+    return u64;
+  }
+
+  /* для MDBX_REVERSEKEY байты ключа сравниваются с конца. */
+  uint64_t prefix = 0;
+  const size_t n = std::min(key.iov_len, sizeof(prefix));
+  for (size_t i = 0; i < n; ++i)
+    prefix = prefix << 8 |
+             bytes[(dbi_flags & MDBX_REVERSEKEY) ? key.iov_len - 1 - i : i];
+  return prefix << (sizeof(prefix) - n) * 8;
+}
+
+template <typename KEY>
+static void fpta_ordinal_sort(MDBX_txn *txn, MDBX_dbi dbi,
+                              fpta_ordinal *begin, fpta_ordinal *end,
+                              const KEY &key) {
+  unsigned dbi_flags = 0;
+  int rc = mdbx_dbi_flags(txn, dbi, &dbi_flags);
+  assert(rc == MDBX_SUCCESS);
+  (void)rc;
+  for (fpta_ordinal *i = begin; i != end; ++i)
+    i->prefix = fpta_ordinal_prefix(dbi_flags, *key(i->index));
+
+  const bool exact = (dbi_flags & MDBX_INTEGERKEY) != 0;
+  std::sort(begin, end, [&](const fpta_ordinal &a, const fpta_ordinal &b) {
+    if (likely(a.prefix != b.prefix || exact))
+      return a.prefix < b.prefix;
+    return mdbx_cmp(txn, dbi, key(a.index), key(b.index)) < 0;
+  });
+}
+
+/* Позиционирует курсор на ключ key в предположении, что ключи запрашиваются
+ * в порядке возрастания. Если курсор уже стоит на искомом или большем ключе,
+ * то поиск не требуется, а в остальных случаях mdbx сама избегает спуска
+ * по дереву, если искомый ключ находится на текущей странице. */
+static int fpta_seek_ascending(MDBX_cursor *cursor, MDBX_txn *txn,
+                               MDBX_dbi dbi, bool &positioned,
+                               MDBX_val &cursor_key, MDBX_val &cursor_data,
+                               const MDBX_val &key) {
+  if (positioned) {
+    const int cmp = mdbx_cmp(txn, dbi, &key, &cursor_key);
+    if (cmp <= 0)
+      return cmp ? MDBX_NOTFOUND : MDBX_SUCCESS;
+  }
+
+  cursor_key = key;
+  int rc = mdbx_cursor_get(cursor, &cursor_key, &cursor_data, MDBX_SET_RANGE);
+  positioned = (rc == MDBX_SUCCESS);
+  if (unlikely(!positioned))
+    return rc;
+  return mdbx_cmp(txn, dbi, &key, &cursor_key) ? MDBX_NOTFOUND : MDBX_SUCCESS;
+}
+
+int fpta_get_many(fpta_txn *txn, fpta_name *column_id, const fpta_value *keys,
+                  size_t count, fptu_ro *rows, int *rcs) {
+  if (unlikely(rows == nullptr && count > 0))
+    return FPTA_EINVAL;
+
+  for (size_t i = 0; i < count; ++i) {
+    rows[i].units = nullptr;
+    rows[i].total_bytes = 0;
+  }
+
+  fpta_key *column_keys = nullptr;
+  fpta_ordinal *order = nullptr;
+  MDBX_cursor *cursor = nullptr;
+  fpta_index_type index;
+  MDBX_dbi tbl_handle, idx_handle;
+  int rc = FPTA_EINVAL;
+  if (unlikely(keys == nullptr && count > 0))
+    goto bailout;
+  rc = fpta_id_validate(column_id, fpta_column);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+
+  rc = fpta_name_refresh_couple(txn, column_id->column.table, column_id);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+
+  rc = FPTA_NO_INDEX;
+  if (unlikely(!fpta_is_indexed(column_id->shove)))
+    goto bailout;
+  index = fpta_shove2index(column_id->shove);
+  if (unlikely(!fpta_index_is_unique(index) ||
+               column_id->column.table->table_schema->partial_predicate(
+                   column_id->column.num)))
+    goto bailout;
+
+  rc = fpta_open_column(txn, column_id, tbl_handle, idx_handle);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+  if (unlikely(count == 0))
+    goto done;
+
+  column_keys = (fpta_key *)malloc(count * sizeof(fpta_key));
+  order = (fpta_ordinal *)malloc(count * sizeof(fpta_ordinal));
+  if (unlikely(!column_keys || !order)) {
+    rc = FPTA_ENOMEM;
+    goto bailout;
+  }
+
+  {
+    /* Результатом будет код ошибки для первого по порядку ключа. */
+    int first_rc = FPTA_SUCCESS;
+    size_t first_index = count;
+    const auto failed = [&](size_t i, int err) {
+      if (rcs)
+        rcs[i] = err;
+      if (i < first_index) {
+        first_index = i;
+        first_rc = err;
+      }
+    };
+
+    /* Формируем ключи, отсеивая значения с ошибками. */
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+      int err = fpta_index_value2key(
+          column_id->shove, keys[i], column_keys[i], false,
+          column_id->column.table->table_schema->key_limit(
+              column_id->column.num));
+      if (likely(err == FPTA_SUCCESS))
+        order[n++].index = (unsigned)i;
+      else
+        failed(i, err);
+    }
+
+    /* Проходим индекс одним курсором в порядке возрастания ключей. */
+    fpta_ordinal_sort(txn->mdbx_txn, idx_handle, order, order + n,
+                      [&](unsigned i) { return &column_keys[i].mdbx; });
+    rc = mdbx_cursor_open(txn->mdbx_txn, idx_handle, &cursor);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+
+    bool positioned = false;
+    MDBX_val cursor_key, cursor_data;
+    size_t found = 0;
+    for (size_t k = 0; k < n; ++k) {
+      const unsigned i = order[k].index;
+      int err = fpta_seek_ascending(cursor, txn->mdbx_txn, idx_handle,
+                                    positioned, cursor_key, cursor_data,
+                                    column_keys[i].mdbx);
+      if (likely(err == MDBX_SUCCESS)) {
+        /* Для вторичного индекса временно сохраняем значение PK. */
+        rows[i].sys = cursor_data;
+        if (fpta_index_is_secondary(index)) {
+          err = fpta_secondary2pk(column_id->column.table->table_schema,
+                                  column_id->column.num, cursor_data,
+                                  rows[i].sys);
+          if (unlikely(err != FPTA_SUCCESS)) {
+            rc = err;
+            goto bailout;
+          }
+        }
+        order[found++].index = i;
+        if (rcs)
+          rcs[i] = FPTA_SUCCESS;
+      } else if (likely(err == MDBX_NOTFOUND))
+        failed(i, err);
+      else {
+        rc = err;
+        goto bailout;
+      }
+    }
+
+    if (fpta_index_is_secondary(index) && found > 0) {
+      /* Читаем строки в порядке первичного ключа. */
+      fpta_ordinal_sort(txn->mdbx_txn, tbl_handle, order, order + found,
+                        [&](unsigned i) { return &rows[i].sys; });
+      mdbx_cursor_close(cursor);
+      cursor = nullptr;
+      rc = mdbx_cursor_open(txn->mdbx_txn, tbl_handle, &cursor);
+      if (unlikely(rc != MDBX_SUCCESS))
+        goto bailout;
+
+      positioned = false;
+      for (size_t k = 0; k < found; ++k) {
+        const unsigned i = order[k].index;
+        const MDBX_val pk_key = rows[i].sys;
+        int err = fpta_seek_ascending(cursor, txn->mdbx_txn, tbl_handle,
+                                      positioned, cursor_key, cursor_data,
+                                      pk_key);
+        if (likely(err == MDBX_SUCCESS))
+          rows[i].sys = cursor_data;
+        else {
+          rows[i].units = nullptr;
+          rows[i].total_bytes = 0;
+          if (unlikely(err != MDBX_NOTFOUND)) {
+            rc = err;
+            goto bailout;
+          }
+          failed(i, FPTA_INDEX_CORRUPTED);
+        }
+      }
+    }
+    rc = first_rc;
+    goto done;
+  }
+
+bailout:
+  for (size_t i = 0; i < count; ++i) {
+    rows[i].units = nullptr;
+    rows[i].total_bytes = 0;
+    if (rcs)
+      rcs[i] = rc;
+  }
+
+done:
+  if (cursor)
+    mdbx_cursor_close(cursor);
+  free(order);
+  free(column_keys);
+  return rc;
+}
@@ -52,31 +52,66 @@ static __inline MDBX_dbi fpta_dbicache_peek(const fpta_txn *txn,
                                             const unsigned cache_hint,
                                             const uint64_t current_tsn) {
   if (likely(cache_hint < fpta_dbi_cache_size)) {
-    const fpta_db *db = txn->db;
-    if (likely(db->dbi_shoves[cache_hint] == shove &&
-               db->dbi_tsns[cache_hint] == current_tsn))
-      return db->dbi_handles[cache_hint];
+    fpta_shove_t cached_shove;
+    MDBX_dbi cached_handle;
+    uint64_t cached_tsn;
+    if (likely(txn->db->dbi_cache[cache_hint].fetch(cached_shove, cached_handle,
+                                                    cached_tsn) &&
+               cached_shove == shove && cached_tsn == current_tsn))
+      return cached_handle;
   }
   return 0;
 }
 
+/* Поиск в кэше без блокировки. Возвращает 0 как при отсутствии хендла
+ * в кэше, так и при конкурентном изменении кэша, в обоих случаях следует
+ * повторить поиск под блокировкой посредством fpta_dbicache_lookup(). */
+static __hot MDBX_dbi fpta_dbicache_search(const fpta_db *db,
+                                           const fpta_shove_t shove,
+                                           unsigned *__restrict cache_hint,
+                                           uint64_t &tsn) {
+  fpta_shove_t cached_shove;
+  MDBX_dbi cached_handle;
+  if (likely(*cache_hint < fpta_dbi_cache_size) &&
+      db->dbi_cache[*cache_hint].fetch(cached_shove, cached_handle, tsn) &&
+      cached_shove == shove)
+    return cached_handle;
+
+  const size_t n = shove % fpta_dbi_cache_size;
+  size_t i = n;
+  do {
+    const fpta_dbi_slot &slot = db->dbi_cache[i];
+    if (slot.shove() == shove) {
+      if (slot.fetch(cached_shove, cached_handle, tsn) &&
+          cached_shove == shove && cached_handle) {
+        *cache_hint = (unsigned)i;
+        return cached_handle;
+      }
+      break;
+    }
+    i = (i + 1) % fpta_dbi_cache_size;
+  } while (i != n && db->dbi_cache[i].shove());
+
+  return 0;
+}
+
 static __hot MDBX_dbi fpta_dbicache_lookup(fpta_db *db, fpta_shove_t shove,
                                            unsigned *__restrict cache_hint) {
   if (likely(*cache_hint < fpta_dbi_cache_size)) {
-    if (likely(db->dbi_shoves[*cache_hint] == shove))
-      return db->dbi_handles[*cache_hint];
+    if (likely(db->dbi_cache[*cache_hint].shove() == shove))
+      return db->dbi_cache[*cache_hint].handle();
     *cache_hint = ~0u;
   }
 
   const size_t n = shove % fpta_dbi_cache_size;
   size_t i = n;
   do {
-    if (db->dbi_shoves[i] == shove) {
+    if (db->dbi_cache[i].shove() == shove) {
       *cache_hint = (unsigned)i;
-      return db->dbi_handles[i];
+      return db->dbi_cache[i].handle();
     }
     i = (i + 1) % fpta_dbi_cache_size;
-  } while (i != n && db->dbi_shoves[i]);
+  } while (i != n && db->dbi_cache[i].shove());
 
   return 0;
 }
@@ -88,17 +123,17 @@ static unsigned fpta_dbicache_update(fpta_db *db, const fpta_shove_t shove,
   const size_t n = shove % fpta_dbi_cache_size;
   size_t i = n;
   do {
-    assert(db->dbi_shoves[i] != shove);
-    if (db->dbi_shoves[i] == 0) {
-      db->dbi_handles[i] = dbi;
-      db->dbi_tsns[i] = tsn;
-      db->dbi_shoves[i] = shove;
+    assert(db->dbi_cache[i].shove() != shove);
+    if (db->dbi_cache[i].shove() == 0) {
+      db->dbi_cache[i].store(shove, dbi, tsn);
       return (unsigned)i;
     }
     i = (i + 1) % fpta_dbi_cache_size;
   } while (i != n);
 
-  /* TODO: прокричать что кэш переполнен (слишком много таблиц и индексов) */
+  /* Кэш переполнен (слишком много таблиц и индексов), хендл будет
+   * работать, но без кэширования. Учитываем для fpta_db_info(). */
+  db->dbi_cache_overflows.fetch_add(1, std::memory_order_relaxed);
   return ~0u;
 }
 
@@ -110,9 +145,9 @@ __cold MDBX_dbi fpta_dbicache_remove(fpta_db *db, const fpta_shove_t shove,
     const size_t i = *cache_hint;
     if (i < fpta_dbi_cache_size) {
       *cache_hint = ~0u;
-      if (db->dbi_shoves[i] == shove) {
-        MDBX_dbi dbi = db->dbi_handles[i];
-        db->dbi_shoves[i] = 0;
+      if (db->dbi_cache[i].shove() == shove) {
+        MDBX_dbi dbi = db->dbi_cache[i].handle();
+        db->dbi_cache[i].clear();
         return dbi;
       }
     }
@@ -122,13 +157,13 @@ __cold MDBX_dbi fpta_dbicache_remove(fpta_db *db, const fpta_shove_t shove,
   const size_t n = shove % fpta_dbi_cache_size;
   size_t i = n;
   do {
-    if (db->dbi_shoves[i] == shove) {
-      MDBX_dbi dbi = db->dbi_handles[i];
-      db->dbi_shoves[i] = 0;
+    if (db->dbi_cache[i].shove() == shove) {
+      MDBX_dbi dbi = db->dbi_cache[i].handle();
+      db->dbi_cache[i].clear();
       return dbi;
     }
     i = (i + 1) % fpta_dbi_cache_size;
-  } while (i != n && db->dbi_shoves[i]);
+  } while (i != n && db->dbi_cache[i].shove());
 
   return 0;
 }
@@ -157,19 +192,19 @@ fpta_dbicache_validate_locked(fpta_txn *txn, const fpta_shove_t dbi_shove,
   assert(cache_hint);
   fpta_db *db = txn->db;
   if (likely(*cache_hint < fpta_dbi_cache_size &&
-             db->dbi_shoves[*cache_hint] == dbi_shove &&
-             db->dbi_handles[*cache_hint])) {
-
-    if (likely(db->dbi_tsns[*cache_hint] == txn->schema_tsn()))
+             db->dbi_cache[*cache_hint].shove() == dbi_shove &&
+             db->dbi_cache[*cache_hint].handle())) {
+    fpta_dbi_slot &slot = db->dbi_cache[*cache_hint];
+    if (likely(slot.tsn() == txn->schema_tsn()))
       return FPTA_SUCCESS;
-    if (db->dbi_tsns[*cache_hint] > txn->schema_tsn())
+    if (slot.tsn() > txn->schema_tsn())
       return FPTA_SCHEMA_CHANGED;
 
     MDBX_dbi handle;
     int rc = fpta_dbi_open(txn, dbi_shove, handle, dbi_flags);
     if (likely(rc == MDBX_SUCCESS)) {
-      assert(handle == db->dbi_handles[*cache_hint]);
-      db->dbi_tsns[*cache_hint] = txn->schema_tsn();
+      assert(handle == slot.handle());
+      slot.set_tsn(txn->schema_tsn());
       return MDBX_SUCCESS;
     }
 
@@ -200,9 +235,20 @@ __cold int fpta_dbicache_open(fpta_txn *txn, const fpta_shove_t dbi_shove,
                               unsigned *__restrict const cache_hint) {
   assert(fpta_txn_validate(txn, fpta_read) == FPTA_SUCCESS);
   assert(cache_hint != nullptr);
-  fpta_lock_guard guard;
   fpta_db *db = txn->db;
 
+  /* Сначала без блокировки, мьютекс нужен только при отсутствии
+   * актуального хендла в кэше, т.е. для открытия dbi. */
+  uint64_t cached_tsn;
+  handle = fpta_dbicache_search(db, dbi_shove, cache_hint, cached_tsn);
+  if (likely(handle)) {
+    if (likely(cached_tsn == txn->schema_tsn()))
+      return FPTA_SUCCESS;
+    if (cached_tsn > txn->schema_tsn())
+      return FPTA_SCHEMA_CHANGED;
+  }
+
+  fpta_lock_guard guard;
   if (txn->level < fpta_schema) {
     int err = guard.lock(&db->dbi_mutex);
     if (unlikely(err != 0))
@@ -216,7 +262,7 @@ __cold int fpta_dbicache_open(fpta_txn *txn, const fpta_shove_t dbi_shove,
     if (likely(rc != FPTA_NODATA)) {
       if (rc == FPTA_SUCCESS) {
         assert(*cache_hint < fpta_dbi_cache_size);
-        assert(handle == db->dbi_handles[*cache_hint]);
+        assert(handle == db->dbi_cache[*cache_hint].handle());
       }
       return rc;
     }
@@ -264,10 +310,10 @@ __cold int fpta_dbicache_cleanup(fpta_txn *txn, fpta_table_schema *table_def) {
     if (unlikely(rc != FPTA_SUCCESS && rc != FPTA_NODATA))
       return rc;
 
-    for (size_t i = 1; i < table_def->column_count(); ++i) {
+    for (size_t i = 1; i < table_def->index_span(); ++i) {
       const fpta_shove_t shove = table_def->column_shove(i);
       if (!fpta_is_indexed(shove))
-        break;
+        continue;
 
       rc = fpta_dbicache_validate_locked(
           txn, fpta_dbi_shove(table_def->table_shove(), i),
@@ -280,14 +326,14 @@ __cold int fpta_dbicache_cleanup(fpta_txn *txn, fpta_table_schema *table_def) {
 
   if (tardy_tsn == txn->schema_tsn() && db->schema_tsn != txn->schema_tsn()) {
     for (size_t i = 0; i < fpta_dbi_cache_size; ++i) {
-      if (!db->dbi_handles[i] || db->dbi_tsns[i] >= tardy_tsn)
+      fpta_dbi_slot &slot = db->dbi_cache[i];
+      if (!slot.handle() || slot.tsn() >= tardy_tsn)
         continue;
 
-      rc = mdbx_dbi_close(db->mdbx_env, db->dbi_handles[i]);
+      rc = mdbx_dbi_close(db->mdbx_env, slot.handle());
       if (rc != MDBX_SUCCESS && rc != MDBX_BAD_DBI)
         return rc;
-      db->dbi_handles[i] = 0;
-      db->dbi_shoves[i] = 0;
+      slot.clear();
     }
   }
 
@@ -326,6 +372,9 @@ int __hot fpta_open_column(fpta_txn *txn, fpta_name *column_id,
     idx_handle = tbl_handle;
     return FPTA_SUCCESS;
   }
+  if (unlikely(table_def->is_building(column_id->column.num)))
+    /* индекс еще заполняется, см. fpta_index_add_online() */
+    return FPTA_NO_INDEX;
 
   const unsigned dbi_flags =
       fpta_dbi_flags(table_def->column_shoves_array(), column_id->column.num);
@@ -347,10 +396,13 @@ int __hot fpta_open_secondaries(fpta_txn *txn, fpta_table_schema *table_def,
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  for (size_t i = 1; i < table_def->column_count(); ++i) {
+  for (size_t i = 1; i < table_def->index_span(); ++i) {
     const fpta_shove_t shove = table_def->column_shove(i);
-    if (!fpta_is_indexed(shove))
-      break;
+    if (!fpta_is_indexed(shove)) {
+      /* колонка между индексированными, см. index_span() */
+      dbi_array[i] = 0;
+      continue;
+    }
 
     const unsigned dbi_flags =
         fpta_dbi_flags(table_def->column_shoves_array(), i);
@@ -29,19 +29,215 @@
                                    for aligment */
 #endif                          /* _MSC_VER (warnings) */
 
+/* Неблокирующий список свободных объектов фиксированной емкости.
+ * Каждый слот либо пуст, либо содержит объект, а захват и возврат
+ * выполняются атомарными операциями над слотами, что исключает ABA-проблему
+ * свойственную односвязным спискам. При отсутствии свободного слота объект
+ * просто освобождается посредством free(). */
+template <typename T, size_t N> struct fpta_freelist {
+  std::atomic<T *> slots[N];
+
+  T *take(size_t hint) {
+    for (size_t i = 0; i < N; ++i) {
+      std::atomic<T *> &slot = slots[(hint + i) % N];
+      if (slot.load(std::memory_order_relaxed)) {
+        T *item = slot.exchange(nullptr, std::memory_order_acquire);
+        if (likely(item))
+          return item;
+      }
+    }
+    return nullptr;
+  }
+
+  bool put(T *item, size_t hint) {
+    for (size_t i = 0; i < N; ++i) {
+      std::atomic<T *> &slot = slots[(hint + i) % N];
+      T *expected = slot.load(std::memory_order_relaxed);
+      if (expected == nullptr &&
+          slot.compare_exchange_strong(expected, item,
+                                       std::memory_order_release))
+        return true;
+    }
+    return false;
+  }
+
+  void drain() {
+    for (size_t i = 0; i < N; ++i)
+      free(slots[i].exchange(nullptr));
+  }
+};
+
+/* Элемент кэша dbi-хендлов.
+ *
+ * Читатели обращаются к кэшу без блокировок, а согласованность тройки
+ * shove/handle/tsn обеспечивается счетчиком изменений (seqlock). Изменения
+ * выполняются только под dbi_mutex, либо в транзакции изменения схемы,
+ * поэтому писатель всегда один. */
+struct fpta_dbi_slot {
+  std::atomic<uint32_t> seqlock;
+  std::atomic<MDBX_dbi> handle_;
+  std::atomic<fpta_shove_t> shove_;
+  std::atomic<uint64_t> tsn_;
+
+  /* Для писателя и для предварительного просмотра без гарантий
+   * согласованности с остальными полями. */
+  fpta_shove_t shove() const { return shove_.load(std::memory_order_relaxed); }
+  MDBX_dbi handle() const { return handle_.load(std::memory_order_relaxed); }
+  uint64_t tsn() const { return tsn_.load(std::memory_order_relaxed); }
+
+  /* Согласованное чтение без блокировки, возвращает false если элемент
+   * изменяется конкурентно. */
+  bool fetch(fpta_shove_t &shove, MDBX_dbi &handle, uint64_t &tsn) const {
+    const uint32_t seq = seqlock.load(std::memory_order_acquire);
+    if (unlikely(seq & 1))
+      return false;
+    shove = shove_.load(std::memory_order_relaxed);
+    handle = handle_.load(std::memory_order_relaxed);
+    tsn = tsn_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return likely(seqlock.load(std::memory_order_relaxed) == seq);
+  }
+
+  void store(fpta_shove_t shove, MDBX_dbi handle, uint64_t tsn) {
+    const uint32_t seq = seqlock.load(std::memory_order_relaxed);
+    assert((seq & 1) == 0);
+    seqlock.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    shove_.store(shove, std::memory_order_relaxed);
+    handle_.store(handle, std::memory_order_relaxed);
+    tsn_.store(tsn, std::memory_order_relaxed);
+    seqlock.store(seq + 2, std::memory_order_release);
+  }
+
+  void set_tsn(uint64_t tsn) { store(shove(), handle(), tsn); }
+  void clear() { store(0, 0, 0); }
+};
+
+/* Запрос групповой фиксации, размещается в стеке ожидающего потока. */
+struct fpta_commit_request {
+  fpta_commit_request *next;
+  int (*writer)(fpta_txn *txn, void *arg);
+  void *arg;
+  int rc;
+  bool done;
+};
+
+/* Запрос уведомления о достижении durability, см fpta_durable_notify(). */
+struct fpta_durable_request {
+  fpta_durable_request *next;
+  uint64_t txnid;
+  void (*callback)(fpta_db *db, uint64_t txnid, int err, void *arg);
+  void *arg;
+};
+
+/* Буфер блоков копии фильтра Блума. Читатели обращаются к блокам без
+ * блокировки, поэтому замененный буфер освобождается только когда
+ * читателей заведомо нет, см fpta_bloom_reclaim(). */
+struct fpta_bloom_buffer {
+  fpta_bloom_buffer *retired_next;
+  uint64_t retired_txnid /* последняя зафиксированная транзакция
+                          * на момент замены */;
+  size_t capacity /* в блоках */;
+  std::atomic<uint64_t> words[1];
+};
+
+/* Копия фильтра Блума индекса в памяти процесса, см bloom.cxx.
+ *
+ * Читатели проверяют ключ по копии без блокировки, а согласованность
+ * полей и блока обеспечивается счетчиком изменений (seqlock), аналогично
+ * кэшу dbi-хендлов. Изменения выполняются только под bloom_mutex. */
+struct fpta_bloom_slot {
+  std::atomic<uint32_t> seqlock;
+  std::atomic<fpta_shove_t> shove /* имя (shove) таблицы фильтра,
+                                   * 0 для пустого слота */;
+  std::atomic<uint64_t> tsn /* версия схемы таблицы, отличающая
+                             * пересозданный фильтр */;
+  std::atomic<uint64_t> seq /* счетчик изменений, которому соответствует
+                             * копия */;
+  std::atomic<uint64_t> base /* зафиксированное состояние, которое
+                              * покрывает измененная пишущей транзакцией
+                              * копия */;
+  std::atomic<fpta_bloom_buffer *> buffer;
+  std::atomic<uint32_t> blocks /* 0 если фильтр еще не построен */;
+  std::atomic<unsigned> hashes;
+  std::atomic<bool> valid, dirty /* копия изменена не зафиксированной
+                                  * транзакцией */;
+  std::atomic<uint64_t> lookups, negatives, false_positives;
+
+  void begin_update() {
+    const uint32_t seq = seqlock.load(std::memory_order_relaxed);
+    assert((seq & 1) == 0);
+    seqlock.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void end_update() {
+    const uint32_t seq = seqlock.load(std::memory_order_relaxed);
+    assert((seq & 1) != 0);
+    seqlock.store(seq + 1, std::memory_order_release);
+  }
+};
+
 struct fpta_db {
   fpta_db(const fpta_db &) = delete;
   MDBX_env *mdbx_env;
   bool alterable_schema;
   MDBX_dbi schema_dbi;
-  fpta_rwl_t schema_rwlock;
+  fpta_brwl_t schema_guard;
   uint64_t schema_tsn;
   fpta_regime_flags regime_flags;
 
-  fpta_mutex_t dbi_mutex /* TODO: убрать мьютекс и перевести на atomic */;
-  fpta_shove_t dbi_shoves[fpta_dbi_cache_size];
-  uint64_t dbi_tsns[fpta_dbi_cache_size];
-  MDBX_dbi dbi_handles[fpta_dbi_cache_size];
+  /* Пул "припаркованных" читающих транзакций, у которых MDBX-транзакция
+   * сброшена посредством mdbx_txn_reset() и может быть возобновлена через
+   * mdbx_txn_renew() без выделения памяти и повторной инициализации. */
+  std::atomic<fpta_txn *> txn_pool[fpta_txn_pool_size];
+
+  /* Результат последней проверки версии схемы в читающей транзакции,
+   * позволяет не проверять схему повторно для того-же снимка данных.
+   * Согласованность пары txnid/tsn обеспечивается счетчиком (seqlock). */
+  std::atomic<uint64_t> schema_probe_seq;
+  std::atomic<uint64_t> schema_probe_txnid;
+  std::atomic<uint64_t> schema_probe_tsn;
+
+  fpta_freelist<fpta_txn, fpta_freelist_size> txn_freelist;
+  fpta_freelist<fpta_cursor, fpta_freelist_size> cursor_freelist;
+
+  /* Функции вычисления ключей индексов по выражениям, которые только
+   * добавляются под защитой dbi_mutex и читаются без блокировки,
+   * см fpta_db_register_key_function(). */
+  struct key_function_slot {
+    fpta_shove_t shove;
+    fpta_key_function function;
+    void *context;
+  } key_functions[fpta_max_key_functions];
+  std::atomic<unsigned> key_functions_count;
+
+  fpta_mutex_t dbi_mutex /* только для открытия dbi и изменения кэша */;
+  std::atomic<uint64_t> dbi_cache_overflows;
+  fpta_dbi_slot dbi_cache[fpta_dbi_cache_size];
+
+  /* Копии фильтров Блума, см bloom.cxx. Признак bloom_dirty изменяется
+   * только пишущей транзакцией, а слоты изменяются под защитой
+   * bloom_mutex, но читаются без блокировки. */
+  fpta_mutex_t bloom_mutex;
+  bool bloom_dirty;
+  fpta_bloom_buffer *bloom_retired /* замененные буферы копий */;
+  fpta_bloom_slot bloom_cache[fpta_bloom_cache_size];
+
+  /* Очередь запросов групповой фиксации, см fpta_transaction_submit(). */
+  fpta_mutex_t commit_mutex;
+  fpta_cond_t commit_cond;
+  fpta_commit_request *commit_head, **commit_tail;
+  bool commit_leader /* есть поток, выполняющий запросы из очереди */;
+
+  /* Асинхронная фиксация, см fpta_transaction_commit_async(). */
+  std::atomic<uint64_t> durable_txnid /* последняя сильная точка фиксации */;
+  fpta_mutex_t durable_mutex;
+  fpta_cond_t durable_cond;
+  fpta_durable_request *durable_pending;
+  fpta_thread_t flusher;
+  unsigned flusher_tick_ms;
+  bool flusher_active, flusher_stop;
 };
 
 #ifdef _MSC_VER
@@ -90,6 +286,139 @@ public:
 
 //----------------------------------------------------------------------------
 
+/* Отслеживает "хвост" таблицы, т.е. последний ключ (и значение для таблиц
+ * с дубликатами), для добавления упорядоченной последовательности
+ * ключей посредством MDBX_APPEND/MDBX_APPENDDUP без поиска по B-дереву.
+ *
+ * Если copy_values == false, то переданное в appended() значение должно
+ * оставаться доступным до следующего вызова, иначе делается его копия. */
+class fpta_appender {
+  fpta_appender(const fpta_appender &) = delete;
+  MDBX_txn *const txn;
+  const MDBX_dbi dbi;
+  const bool dupsort, copy_values;
+  bool empty, lost_tail, own_tail;
+  MDBX_val tail_key, tail_value;
+  void *key_buffer, *value_buffer;
+  size_t key_capacity, value_capacity;
+  uint64_t tail_buffer[(fpta_keybuf_len + 7) / sizeof(uint64_t)];
+
+  /* Копирует ключ в tail_buffer, а для длинных ключей (индексы с увеличенным
+   * лимитом длины) в буфер из кучи. Возвращает false при нехватке памяти. */
+  bool hold_tail(const MDBX_val &key) {
+    void *place = tail_buffer;
+    if (key.iov_len > sizeof(tail_buffer)) {
+      if (key.iov_len > key_capacity) {
+        void *larger = realloc(key_buffer, key.iov_len);
+        if (unlikely(larger == nullptr))
+          return false;
+        key_buffer = larger;
+        key_capacity = key.iov_len;
+      }
+      place = key_buffer;
+    }
+    memcpy(place, key.iov_base, key.iov_len);
+    tail_key.iov_base = place;
+    tail_key.iov_len = key.iov_len;
+    return true;
+  }
+
+public:
+  fpta_appender(MDBX_txn *txn, MDBX_dbi dbi, bool dupsort,
+                bool copy_values = false)
+      : txn(txn), dbi(dbi), dupsort(dupsort), copy_values(copy_values),
+        empty(true), lost_tail(false), own_tail(false), key_buffer(nullptr),
+        value_buffer(nullptr), key_capacity(0), value_capacity(0) {
+    tail_key.iov_base = tail_value.iov_base = nullptr;
+    tail_key.iov_len = tail_value.iov_len = 0;
+  }
+
+  ~fpta_appender() {
+    free(key_buffer);
+    free(value_buffer);
+  }
+
+  int init() {
+    MDBX_cursor *cursor;
+    int rc = mdbx_cursor_open(txn, dbi, &cursor);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    MDBX_val key, value;
+    rc = mdbx_cursor_get(cursor, &key, &value, MDBX_LAST);
+    mdbx_cursor_close(cursor);
+    if (rc == MDBX_NOTFOUND)
+      return MDBX_SUCCESS;
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+
+    /* Копируем ключ, так как последующие изменения могут затронуть
+     * содержимое "грязной" страницы. Значение не потребуется, так как
+     * MDBX_APPENDDUP используется только для собственных ключей. */
+    if (unlikely(!hold_tail(key)))
+      return FPTA_ENOMEM;
+    empty = false;
+    return MDBX_SUCCESS;
+  }
+
+  unsigned flags(const MDBX_val &key, const MDBX_val &value) const {
+    if (empty)
+      return MDBX_APPEND;
+    if (unlikely(lost_tail))
+      return 0;
+    const int cmp = mdbx_cmp(txn, dbi, &key, &tail_key);
+    if (cmp > 0)
+      return MDBX_APPEND;
+    if (cmp == 0 && dupsort && own_tail &&
+        mdbx_dcmp(txn, dbi, &value, &tail_value) > 0)
+      return MDBX_APPENDDUP;
+    return 0;
+  }
+
+  void appended(const MDBX_val &key, const MDBX_val &value) {
+    empty = false;
+    if (tail_key.iov_base != key.iov_base && unlikely(!hold_tail(key))) {
+      /* не критично, далее ключи добавляются без MDBX_APPEND */
+      lost_tail = true;
+      own_tail = false;
+      return;
+    }
+    lost_tail = false;
+    own_tail = dupsort;
+    if (!dupsort || !copy_values) {
+      tail_value = value;
+      return;
+    }
+
+    if (value.iov_len > value_capacity) {
+      void *larger = realloc(value_buffer, value.iov_len);
+      if (unlikely(larger == nullptr)) {
+        /* не критично, просто не будет MDBX_APPENDDUP */
+        own_tail = false;
+        return;
+      }
+      value_buffer = larger;
+      value_capacity = value.iov_len;
+    }
+    memcpy(value_buffer, value.iov_base, value.iov_len);
+    tail_value.iov_base = value_buffer;
+    tail_value.iov_len = value.iov_len;
+  }
+};
+
+/* Внешняя сортировка пар ключ-значение в порядке mdbx-таблицы с последующим
+ * добавлением в неё, см loader.cxx. Нулевой budget означает объем памяти
+ * по-умолчанию, т.е. fpta_loader_run_default. */
+struct fpta_sorter;
+int fpta_sorter_create(MDBX_txn *txn, MDBX_dbi dbi, bool dupsort,
+                       size_t budget, fpta_sorter **psorter);
+int fpta_sorter_push(fpta_sorter *sorter, const MDBX_val &key,
+                     const MDBX_val &value);
+int fpta_sorter_complete(fpta_sorter *sorter, unsigned flags);
+void fpta_sorter_release(fpta_sorter *sorter);
+
+//----------------------------------------------------------------------------
+
 bool fpta_filter_validate(const fpta_filter *filter);
 
 static __inline bool fpta_db_validate(const fpta_db *db) {
@@ -132,7 +461,8 @@ static cxx14_constexpr int fpta_id_validate(const fpta_name *id,
       const fpta_table_schema *table_schema = id->table_schema;
       if (unlikely(table_schema == nullptr))
         return FPTA_EINVAL;
-      if (unlikely(table_schema->signature() != FTPA_SCHEMA_SIGNATURE))
+      if (unlikely(
+              !fpta_schema_signature_valid(table_schema->signature())))
         return FPTA_SCHEMA_CORRUPTED;
       if (unlikely(table_schema->table_shove() != id->shove))
         return FPTA_SCHEMA_CORRUPTED;
@@ -226,6 +556,218 @@ static __inline fpta_shove_t fpta_data_shove(const fpta_shove_t *shoves_defs,
 int fpta_dbi_open(fpta_txn *txn, const fpta_shove_t dbi_shove,
                   MDBX_dbi &__restrict handle, const unsigned dbi_flags);
 
+/* Проверяет увеличенные лимиты длины ключей индексов таблицы относительно
+ * допустимых для БД размеров ключей и значений. */
+int fpta_index_keylen_check(
+    const fpta_db *db, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end);
+
+/* Удаляет из строки поля удаленных колонок перед её записью, при этом
+ * строка копируется в принадлежащий объекту буфер, см alter.cxx. */
+class fpta_dropped_stripper {
+  void *buffer_;
+  size_t capacity_;
+
+public:
+  fpta_dropped_stripper() : buffer_(nullptr), capacity_(0) {}
+  fpta_dropped_stripper(const fpta_dropped_stripper &) = delete;
+  ~fpta_dropped_stripper() { free(buffer_); }
+
+  int apply(const fpta_table_schema *table_def, fptu_ro &row);
+};
+
+/* Фильтры Блума уникальных вторичных индексов, см bloom.cxx.
+ *
+ * Имя таблицы фильтра производится от имен таблицы и колонки. */
+static __inline fpta_shove_t fpta_bloom_shove(const fpta_shove_t table_shove,
+                                              const fpta_shove_t column_shove) {
+  const fpta_shove_t mask = ~fpta_shove_t((1u << fpta_name_hash_shift) - 1);
+  const fpta_shove_t hash =
+      (table_shove ^ (column_shove & mask) * UINT64_C(0x9E3779B97F4A7C15)) &
+      mask;
+  /* номер индекса вне допустимого диапазона исключает совпадение с именами
+   * таблиц индексов, а также с первичными индексами (см cmp_rows) */
+  return hash | (fpta_max_indexes - 1);
+}
+
+int fpta_bloom_open(fpta_txn *txn, const fpta_shove_t bloom_shove,
+                    MDBX_dbi &handle, bool create);
+int fpta_bloom_drop(fpta_txn *txn, const fpta_shove_t bloom_shove);
+/* Возвращает FPTA_NODATA если ключа в индексе заведомо нет, иначе
+ * FPTA_SUCCESS. Признак accounted взводится, если проверка выполнена по
+ * построенной копии фильтра и учтена в её статистике, только тогда
+ * последующий промах поиска следует учитывать посредством
+ * fpta_bloom_false_positive(). */
+int fpta_bloom_lookup(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column, const MDBX_val &key, bool &accounted);
+void fpta_bloom_false_positive(fpta_txn *txn,
+                               const fpta_table_schema *table_def,
+                               size_t column);
+int fpta_bloom_insert(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column, MDBX_dbi index_dbi, const MDBX_val &key);
+int fpta_bloom_rebuild(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, MDBX_dbi index_dbi);
+int fpta_bloom_stat(fpta_txn *txn, const fpta_table_schema *table_def,
+                    size_t column, fpta_table_stat *stat);
+void fpta_bloom_settle(fpta_db *db, bool committed);
+void fpta_bloom_reclaim(fpta_db *db, bool exclusive);
+void fpta_bloom_purge(fpta_db *db);
+
+/* Битовые индексы, см bitmap.cxx.
+ *
+ * Имя таблицы битовых множеств производится от имен таблицы и колонки
+ * аналогично фильтрам Блума, но с другим номером вне допустимого диапазона
+ * индексов. */
+static __inline fpta_shove_t fpta_bitmap_shove(const fpta_shove_t table_shove,
+                                               const fpta_shove_t column_shove) {
+  return fpta_bloom_shove(table_shove, column_shove) - 1;
+}
+
+/* Номер строки для битовых индексов, которым служит ключ PK. */
+static __inline uint64_t fpta_bitmap_rowid(const MDBX_val &pk_key) {
+  assert(pk_key.iov_len == 4 || pk_key.iov_len == 8);
+  if (pk_key.iov_len == 4) {
+    uint32_t rowid;
+    memcpy(&rowid, pk_key.iov_base, 4);
+    return rowid;
+  }
+  uint64_t rowid;
+  memcpy(&rowid, pk_key.iov_base, 8);
+  return rowid;
+}
+
+/* Множество номеров строк в виде сжатого битового массива (roaring bitmap):
+ * номера группируются по старшим 48 битам, а младшие 16 бит каждой группы
+ * хранятся упорядоченным массивом, либо битовой картой из 1024 слов
+ * при количестве элементов от fpta_bitmap_array_max. */
+class fpta_bitmap {
+public:
+  enum {
+    fpta_bitmap_words = 1024,
+    fpta_bitmap_array_max = 4096,
+    fpta_bitmap_bits_bytes = fpta_bitmap_words * sizeof(uint64_t)
+  };
+
+  struct container {
+    uint64_t high;
+    std::vector<uint16_t> array;
+    std::vector<uint64_t> bits /* пуст, если используется массив */;
+
+    bool dense() const { return !bits.empty(); }
+    bool empty() const { return !dense() && array.empty(); }
+    size_t cardinality() const;
+    bool test(unsigned low) const;
+    bool next(unsigned low, unsigned &found) const;
+    void set(unsigned low);
+    void clear(unsigned low);
+    void expand();
+    void normalize();
+    int load(const MDBX_val &data);
+    MDBX_val image() const;
+  };
+
+  /* Признак того, что множество в точности соответствует условию фильтра,
+   * а не является его надмножеством. */
+  bool exact;
+
+  fpta_bitmap() : exact(true) {}
+  bool test(uint64_t rowid) const;
+  bool next(uint64_t from, uint64_t &rowid) const;
+  uint64_t cardinality() const;
+  void unite(const fpta_bitmap &other);
+  void intersect(const fpta_bitmap &other);
+  void subtract(const fpta_bitmap &other);
+  int merge(uint64_t high, const MDBX_val &data);
+
+private:
+  std::vector<container> containers_ /* упорядочены по high */;
+};
+
+int fpta_bitmap_open(fpta_txn *txn, const fpta_shove_t bitmap_shove,
+                     MDBX_dbi &handle, bool create);
+int fpta_bitmap_drop(fpta_txn *txn, const fpta_shove_t bitmap_shove);
+int fpta_bitmap_clear(fpta_txn *txn, const fpta_table_schema *table_def,
+                      size_t column);
+int fpta_bitmap_update(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, const MDBX_val &value_key,
+                       uint64_t *rowids, size_t count, bool set);
+int fpta_bitmap_upsert(fpta_txn *txn, const fpta_table_schema *table_def,
+                       size_t column, const MDBX_val &old_pk_key,
+                       const fpta_row_keys &old_keys,
+                       const MDBX_val &new_pk_key,
+                       const fpta_row_keys &new_keys);
+int fpta_bitmap_stat(fpta_txn *txn, const fpta_table_schema *table_def,
+                     size_t column, fpta_table_stat *stat);
+int fpta_bitmap_select(fpta_txn *txn, const fpta_table_schema *table_def,
+                       const fpta_filter *filter, fpta_bitmap **presult);
+void fpta_bitmap_release(fpta_bitmap *bitmap);
+
+/* Многозначные индексы, см multivalued.cxx.
+ *
+ * Ключи всех различных значений колонки в строке, т.е. всех полей с тегом
+ * колонки, либо единственный ключ NIL для строки без таких полей.
+ * Ключи упорядочены побайтово, а не в порядке индекса, что достаточно
+ * для вычисления разницы между версиями строки. */
+class fpta_multivalued_keys {
+  enum { inplace_keys = 8 };
+  size_t count_, capacity_;
+  fpta_key *keys_;
+  MDBX_val *sorted_;
+  fpta_key inplace_keys_[inplace_keys];
+  MDBX_val inplace_sorted_[inplace_keys];
+
+public:
+  fpta_multivalued_keys()
+      : count_(0), capacity_(inplace_keys), keys_(inplace_keys_),
+        sorted_(inplace_sorted_) {}
+  fpta_multivalued_keys(const fpta_multivalued_keys &) = delete;
+  ~fpta_multivalued_keys() {
+    if (keys_ != inplace_keys_) {
+      free(keys_);
+      free(sorted_);
+    }
+  }
+
+  /* Ключи ссылаются на данные строки, которая должна оставаться
+   * неизменной до их использования. */
+  int build(const fpta_table_schema *table_def, size_t column,
+            const fptu_ro &row);
+  size_t size() const { return count_; }
+  const MDBX_val &operator[](size_t index) const {
+    assert(index < count_);
+    return sorted_[index];
+  }
+};
+
+/* Обновляет пары многозначного индекса по разнице значений версий строки,
+ * отсутствие old_row означает вставку, а отсутствие new_row удаление.
+ * Пара с ключом except не затрагивается, так как является текущей
+ * позицией курсора и обновляется им самим. */
+int fpta_multivalued_update(fpta_txn *txn, const fpta_table_schema *table_def,
+                            size_t column, MDBX_dbi dbi,
+                            const MDBX_val &old_pk_key, const fptu_ro *old_row,
+                            const MDBX_val &new_pk_key, const fptu_ro *new_row,
+                            const MDBX_val *except = nullptr);
+/* Ищет среди значений колонки в строке равное key и копирует его ключ. */
+int fpta_multivalued_lookup(const fpta_table_schema *table_def, size_t column,
+                            const fptu_ro &row, const MDBX_val &key,
+                            fpta_key &found);
+
+/* Создает таблицу добавленного вторичного индекса column и при fill
+ * заполняет её за один проход по строкам, см alter.cxx. */
+int fpta_index_build(fpta_txn *txn, fpta_table_schema *table_def,
+                     size_t column, bool fill);
+
+/* Объявляет в схеме пустой вторичный индекс, помеченный записью
+ * option_building, и снимает эту пометку после его заполнения,
+ * см fpta_index_add_online(). */
+int fpta_index_declare(fpta_txn *txn, const char *table_name,
+                       const char *column_name, fpta_index_type index_type);
+int fpta_index_publish(fpta_txn *txn, const char *table_name,
+                       const char *column_name);
+
 int fpta_dbicache_open(fpta_txn *txn, const fpta_shove_t shove,
                        MDBX_dbi &handle, const unsigned dbi_flags,
                        unsigned *const cache_hint);
@@ -0,0 +1,200 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Индексы по выражениям (вычисляемые колонки).
+ *
+ * Значение колонки-выражения не хранится в кортеже, а вычисляется по строке
+ * функцией, зарегистрированной в fpta_db под некоторым именем. В схеме
+ * таблицы сохраняется только shove этого имени, а сама функция разрешается
+ * при каждом вычислении, что позволяет регистрировать функции уже после
+ * загрузки схемы в кэш.
+ *
+ * Вычисленное значение размещается во временном кортеже в виде поля
+ * с номером и типом колонки, после чего ключи формируются тем же кодом,
+ * что и для хранимых колонок, в том числе в составе составных индексов. */
+
+int __cold fpta_db_register_key_function(fpta_db *db, const char *name,
+                                         fpta_key_function function,
+                                         void *context) {
+  if (unlikely(!fpta_db_validate(db) || function == nullptr))
+    return FPTA_EINVAL;
+
+  const fpta_shove_t shove = fpta_shove_name(name, fpta_column);
+  if (unlikely(!shove))
+    return FPTA_ENAME;
+
+  int rc = fpta_mutex_lock(&db->dbi_mutex);
+  if (unlikely(rc != 0))
+    return rc;
+
+  const unsigned count =
+      db->key_functions_count.load(std::memory_order_relaxed);
+  for (unsigned i = 0; i < count; ++i) {
+    if (fpta_shove_eq(db->key_functions[i].shove, shove)) {
+      rc = FPTA_EEXIST;
+      goto bailout;
+    }
+  }
+
+  if (unlikely(count >= fpta_max_key_functions)) {
+    rc = FPTA_TOOMANY;
+    goto bailout;
+  }
+
+  db->key_functions[count].shove = shove;
+  db->key_functions[count].function = function;
+  db->key_functions[count].context = context;
+  db->key_functions_count.store(count + 1, std::memory_order_release);
+
+bailout:
+  int err = fpta_mutex_unlock(&db->dbi_mutex);
+  assert(err == 0);
+  (void)err;
+  return rc;
+}
+
+//----------------------------------------------------------------------------
+
+int fpta_expression_field::compute(const fpta_table_schema *table_def,
+                                   size_t column, const fptu_ro &row,
+                                   const fptu_field *&field) {
+  field = nullptr;
+  const fpta_shove_t function = table_def->expression_function(column);
+  const fpta_db *const db = table_def->_expressions_db;
+  const unsigned count =
+      db->key_functions_count.load(std::memory_order_acquire);
+  const fpta_db::key_function_slot *slot = db->key_functions;
+  for (;; ++slot) {
+    if (unlikely(slot == db->key_functions + count))
+      return FPTA_ENOIMP;
+    if (fpta_shove_eq(slot->shove, function))
+      break;
+  }
+
+  fpta_value value;
+  value.type = fpta_null;
+  value.binary_length = 0;
+  value.binary_data = nullptr;
+  int rc = slot->function(row, &value, result_, slot->context);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (value.type == fpta_null)
+    return FPTA_SUCCESS;
+
+  const size_t data_bytes =
+      (value.type == fpta_string || value.type == fpta_binary)
+          ? value.binary_length + (size_t)fptu_unit_size
+          : sizeof(value.uint) * 4;
+  const size_t space = fptu_space(1, data_bytes);
+  if (space > capacity_) {
+    void *larger = malloc(space);
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    if (tuple_ != inplace_)
+      free(tuple_);
+    tuple_ = larger;
+    capacity_ = space;
+  }
+
+  fptu_rw *pt = fptu_init(tuple_, space, 1);
+  if (unlikely(pt == nullptr))
+    return FPTA_EOOPS;
+
+  const fpta_shove_t shove = table_def->column_shove(column);
+  rc = fpta_upsert_value(pt, (unsigned)column, shove, value,
+                         !FPTA_PROHIBIT_UPSERT_DENIL);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  field = fptu::lookup(fptu_take_noshrink(pt), (unsigned)column,
+                       fpta_shove2type(shove));
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+int __cold fpta_expression_column_validate(
+    const size_t column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t shove = columns_shoves[column];
+  if (unlikely(fpta_is_indexed(shove) && !fpta_index_is_secondary(shove)))
+    return FPTA_EFLAG;
+
+  const fptu_type data_type = fpta_shove2type(shove);
+  if (unlikely(data_type == /* composite */ fptu_null ||
+               data_type > fptu_opaque))
+    return FPTA_ETYPE;
+
+  /* для колонки допускается только одна функция */
+  if (unlikely(fpta_column_option_lookup(column,
+                                         fpta_table_schema::option_expression,
+                                         records_begin, records_end)))
+    return FPTA_EEXIST;
+
+  /* ключи вычисляемой колонки всегда копируются, поэтому их длина
+   * не может превышать fpta_max_keylen */
+  if (unlikely(fpta_column_option_lookup(column,
+                                         fpta_table_schema::option_keylen,
+                                         records_begin, records_end)))
+    return FPTA_EFLAG;
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_expression_column(const char *column_name,
+                                           fpta_column_set *column_set,
+                                           const char *function_name) {
+  if (unlikely(column_set == nullptr))
+    return FPTA_EINVAL;
+
+  const fpta_shove_t function = fpta_shove_name(function_name, fpta_column);
+  if (unlikely(!function))
+    return FPTA_ENAME;
+
+  size_t column;
+  int rc = fpta_column_set_lookup(column_set, column_name, column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи колонок-выражений следуют за списками составных колонок,
+   * вместе с записями покрывающих и частичных индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_expression_column_validate(column, column_set->shoves,
+                                       column_set->count, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* имя функции следует за видом свойства */
+  fpta_table_schema::composite_item_t
+      payload[1 + sizeof(function) / sizeof(*tail)];
+  payload[0] = fpta_table_schema::option_expression;
+  memcpy(payload + 1, &function, sizeof(function));
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::option_mark, column,
+                                payload, FPT_ARRAY_LENGTH(payload));
+}
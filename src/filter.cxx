@@ -353,6 +353,217 @@ tail_recursion:
   }
 }
 
+/* Проверяет, что фильтр может быть вычислен по кортежу-проекции
+ * покрывающего индекса, т.е. все задействованные в нём колонки входят
+ * в список покрываемых. Функции-предикаты для строки целиком (fnrow)
+ * требуют полную строку и никогда не считаются покрытыми. */
+bool fpta_filter_is_covered(const fpta_filter *filter,
+                            fpta_table_schema::composite_iter_t covered_begin,
+                            fpta_table_schema::composite_iter_t covered_end) {
+  unsigned column;
+
+tail_recursion:
+
+  if (!filter)
+    return true;
+
+  switch (filter->type) {
+  default:
+    return false;
+
+  case fpta_node_fncol:
+    column = filter->node_fncol.column_id->column.num;
+    break;
+
+  case fpta_node_not:
+    filter = filter->node_not;
+    goto tail_recursion;
+
+  case fpta_node_or:
+  case fpta_node_and:
+    if (!fpta_filter_is_covered(filter->node_and.a, covered_begin,
+                                covered_end))
+      return false;
+    filter = filter->node_and.b;
+    goto tail_recursion;
+
+  case fpta_node_lt:
+  case fpta_node_gt:
+  case fpta_node_le:
+  case fpta_node_ge:
+  case fpta_node_eq:
+  case fpta_node_ne:
+    column = filter->node_cmp.left_id->column.num;
+    break;
+  }
+
+  return std::find(covered_begin, covered_end, column) != covered_end;
+}
+
+/* Проверяет, что среди условий фильтра, объединенных "И" на верхнем
+ * уровне, есть вычисляемые по заданному списку колонок. */
+bool fpta_filter_has_covered(const fpta_filter *filter,
+                             fpta_table_schema::composite_iter_t covered_begin,
+                             fpta_table_schema::composite_iter_t covered_end) {
+tail_recursion:
+
+  if (!filter)
+    return false;
+
+  if (filter->type == fpta_node_and) {
+    if (fpta_filter_has_covered(filter->node_and.a, covered_begin,
+                                covered_end))
+      return true;
+    filter = filter->node_and.b;
+    goto tail_recursion;
+  }
+
+  return fpta_filter_is_covered(filter, covered_begin, covered_end);
+}
+
+/* Проверяет только те условия фильтра, объединенные "И" на верхнем уровне,
+ * которые вычисляемы по кортежу с колонками из заданного списка. Остальные
+ * условия считаются выполненными, поэтому false означает, что строка
+ * заведомо не подходит под фильтр. */
+bool fpta_filter_match_covered(
+    const fpta_filter *filter, fptu_ro tuple,
+    fpta_table_schema::composite_iter_t covered_begin,
+    fpta_table_schema::composite_iter_t covered_end) {
+tail_recursion:
+
+  if (!filter)
+    return true;
+
+  if (filter->type == fpta_node_and) {
+    if (!fpta_filter_match_covered(filter->node_and.a, tuple, covered_begin,
+                                   covered_end))
+      return false;
+    filter = filter->node_and.b;
+    goto tail_recursion;
+  }
+
+  return !fpta_filter_is_covered(filter, covered_begin, covered_end) ||
+         fpta_filter_match(filter, tuple);
+}
+
+//----------------------------------------------------------------------------
+
+/* Сравнивает константы из двух узлов-сравнений. Возвращает fptu_ic, если
+ * соотношение констант не позволяет судить о соотношении условий. */
+static fptu_lge fpta_filter_cmp_constants(const fpta_value &left,
+                                          const fpta_value &right) {
+  switch (left.type) {
+  case fpta_signed_int:
+    if (right.type == fpta_signed_int)
+      return fptu_cmp2lge(left.sint, right.sint);
+    if (right.type == fpta_unsigned_int)
+      return (left.sint < 0) ? fptu_lt
+                             : fptu_cmp2lge((uint64_t)left.sint, right.uint);
+    return fptu_ic;
+
+  case fpta_unsigned_int:
+    if (right.type == fpta_unsigned_int)
+      return fptu_cmp2lge(left.uint, right.uint);
+    if (right.type == fpta_signed_int)
+      return (right.sint < 0) ? fptu_gt
+                              : fptu_cmp2lge(left.uint, (uint64_t)right.sint);
+    return fptu_ic;
+
+  case fpta_float_point:
+    if (right.type != fpta_float_point || std::isnan(left.fp) ||
+        std::isnan(right.fp))
+      return fptu_ic;
+    return fptu_cmp2lge(left.fp, right.fp);
+
+  case fpta_datetime:
+    if (right.type != fpta_datetime)
+      return fptu_ic;
+    return fptu_cmp2lge(left.datetime.fixedpoint, right.datetime.fixedpoint);
+
+  case fpta_string:
+  case fpta_binary:
+    if (right.type != left.type)
+      return fptu_ic;
+    return fptu_cmp_binary(left.binary_data, left.binary_length,
+                           right.binary_data, right.binary_length);
+
+  default:
+    return fptu_ic;
+  }
+}
+
+/* Проверяет, что из условия "колонка filter_cmp константа" следует
+ * "колонка predicate_cmp константа" для одной и той же колонки. */
+static bool fpta_filter_cmp_implies(const fpta_filter *filter,
+                                    const fpta_filter *predicate) {
+  if (filter->node_cmp.left_id->column.num !=
+      predicate->node_cmp.left_id->column.num)
+    return false;
+
+  const fpta_value &f = filter->node_cmp.right_value;
+  const fpta_value &p = predicate->node_cmp.right_value;
+  if (f.type == fpta_null || p.type == fpta_null)
+    /* сравнение с null также выполняется для отсутствующих колонок,
+     * поэтому достаточно только точного совпадения условий */
+    return f.type == p.type && (filter->type & ~predicate->type) == 0;
+
+  /* Определяем возможные соотношения значения колонки с константой
+   * предиката, исходя из соотношения с константой фильтра. */
+  int possible;
+  switch (fpta_filter_cmp_constants(f, p)) {
+  case fptu_eq:
+    possible = filter->type;
+    break;
+  case fptu_lt:
+    possible = (filter->type & fptu_gt) ? (fptu_lt | fptu_eq | fptu_gt)
+                                        : (int)fptu_lt;
+    break;
+  case fptu_gt:
+    possible = (filter->type & fptu_lt) ? (fptu_lt | fptu_eq | fptu_gt)
+                                        : (int)fptu_gt;
+    break;
+  default:
+    return false;
+  }
+  return (possible & ~predicate->type) == 0;
+}
+
+static bool fpta_filter_is_cmp(const fpta_filter *node) {
+  return node->type > fpta_node_fnrow;
+}
+
+/* Консервативно проверяет, что из фильтра следует предикат, т.е. любая
+ * удовлетворяющая фильтру строка удовлетворяет и предикату. Ложный
+ * отрицательный результат допустим и означает лишь невозможность
+ * использования частичного индекса. */
+bool fpta_filter_implies(const fpta_filter *filter,
+                         const fpta_filter *predicate) {
+  if (predicate == nullptr)
+    return true;
+  if (filter == nullptr)
+    return false;
+
+  if (predicate->type == fpta_node_and)
+    return fpta_filter_implies(filter, predicate->node_and.a) &&
+           fpta_filter_implies(filter, predicate->node_and.b);
+  if (filter->type == fpta_node_or)
+    return fpta_filter_implies(filter->node_or.a, predicate) &&
+           fpta_filter_implies(filter->node_or.b, predicate);
+  if (filter->type == fpta_node_and &&
+      (fpta_filter_implies(filter->node_and.a, predicate) ||
+       fpta_filter_implies(filter->node_and.b, predicate)))
+    return true;
+  if (predicate->type == fpta_node_or)
+    return fpta_filter_implies(filter, predicate->node_or.a) ||
+           fpta_filter_implies(filter, predicate->node_or.b);
+
+  if (filter->type == fpta_node_not && predicate->type == fpta_node_not)
+    return fpta_filter_implies(predicate->node_not, filter->node_not);
+
+  return fpta_filter_is_cmp(filter) && fpta_filter_is_cmp(predicate) &&
+         fpta_filter_cmp_implies(filter, predicate);
+}
+
 //----------------------------------------------------------------------------
 
 int fpta_name_refresh_filter(fpta_txn *txn, fpta_name *table_id,
@@ -424,7 +635,9 @@ FPTA_API int fpta_estimate(fpta_txn *txn, unsigned items_count,
       continue;
     }
 
-    if (unlikely(!fpta_is_indexed(i->column_id->shove))) {
+    if (unlikely(!fpta_is_indexed(i->column_id->shove) ||
+                 i->column_id->column.table->table_schema->is_bitmap(
+                     i->column_id->column.num))) {
       i->error = FPTA_NO_INDEX;
       continue;
     }
@@ -455,7 +668,10 @@ FPTA_API int fpta_estimate(fpta_txn *txn, unsigned items_count,
       break;
 
     default:
-      err = fpta_index_value2key(i->column_id->shove, i->range_from, begin_key);
+      err = fpta_index_value2key(
+          i->column_id->shove, i->range_from, begin_key, false,
+          i->column_id->column.table->table_schema->key_limit(
+              i->column_id->column.num));
       if (unlikely(err != FPTA_SUCCESS)) {
         i->error = err;
         continue;
@@ -477,7 +693,10 @@ FPTA_API int fpta_estimate(fpta_txn *txn, unsigned items_count,
       break;
 
     default:
-      err = fpta_index_value2key(i->column_id->shove, i->range_to, end_key);
+      err = fpta_index_value2key(
+          i->column_id->shove, i->range_to, end_key, false,
+          i->column_id->column.table->table_schema->key_limit(
+              i->column_id->column.num));
       if (unlikely(err != FPTA_SUCCESS)) {
         i->error = err;
         continue;
@@ -21,7 +21,7 @@
 //----------------------------------------------------------------------------
 
 static __hot int fpta_normalize_key(const fpta_index_type index, fpta_key &key,
-                                    bool copy) {
+                                    bool copy, size_t limit) {
   static_assert(fpta_max_keylen % sizeof(uint64_t) == 0,
                 "wrong fpta_max_keylen");
 
@@ -106,6 +106,19 @@ static __hot int fpta_normalize_key(const fpta_index_type index, fpta_key &key,
     return FPTA_SUCCESS;
   }
 
+  if (unlikely(limit > fpta_max_keylen)) {
+    /* для индекса задан увеличенный лимит, ключ сохраняется целиком
+     * и точно сохраняет порядок, а более длинные значения отвергаются.
+     * Не помещающийся в place ключ при запросе копии переносится
+     * вызывающим кодом, см. fpta_key::is_inplace(). */
+    if (unlikely(key.mdbx.iov_len > limit))
+      return FPTA_DATALEN_MISMATCH;
+    if (copy && key.mdbx.iov_len <= sizeof(key.place))
+      key.mdbx.iov_base =
+          memcpy(&key.place, key.mdbx.iov_base, key.mdbx.iov_len);
+    return FPTA_SUCCESS;
+  }
+
   /* ключ слишком большой, сохраняем сколько допустимо остальное хэшируем */
   if (fpta_index_is_obverse(index)) {
     /* ключ сравнивается от головы к хвосту (как memcpy),
@@ -396,7 +409,7 @@ static int fpta_denil_key(const fpta_shove_t shove, fpta_key &key) {
 }
 
 int fpta_index_value2key(fpta_shove_t shove, const fpta_value &value,
-                         fpta_key &key, bool copy) {
+                         fpta_key &key, bool copy, size_t limit) {
   if (unlikely(value.type == fpta_begin || value.type == fpta_end))
     return FPTA_ETYPE;
 
@@ -623,12 +636,13 @@ int fpta_index_value2key(fpta_shove_t shove, const fpta_value &value,
     break;
   }
 
-  return fpta_normalize_key(index, key, copy);
+  return fpta_normalize_key(index, key, copy, limit);
 }
 
 //----------------------------------------------------------------------------
 
-int fpta_index_key2value(fpta_shove_t shove, MDBX_val mdbx, fpta_value &value) {
+int fpta_index_key2value(fpta_shove_t shove, MDBX_val mdbx, fpta_value &value,
+                         size_t limit) {
   const fptu_type type = fpta_shove2type(shove);
   const fpta_index_type index = fpta_shove2index(shove);
 
@@ -644,7 +658,8 @@ int fpta_index_key2value(fpta_shove_t shove, MDBX_val mdbx, fpta_value &value) {
   }
 
   if (type >= fptu_cstr) {
-    if (mdbx.iov_len > (unsigned)fpta_max_keylen) {
+    if (mdbx.iov_len > (unsigned)fpta_max_keylen &&
+        likely(limit <= fpta_max_keylen)) {
       if (unlikely(mdbx.iov_len != (unsigned)fpta_shoved_keylen))
         goto return_corrupted;
       value.type = fpta_shoved;
@@ -864,23 +879,97 @@ return_corrupted:
 
 //----------------------------------------------------------------------------
 
-__hot int fpta_index_row2key(const fpta_table_schema *const schema,
-                             size_t column, const fptu_ro &row, fpta_key &key,
-                             bool copy) {
-#ifndef NDEBUG
-  fpta_pollute(&key, sizeof(key), 0);
-#endif
+size_t fpta_index_ordinal_prefix(const MDBX_val &a, const MDBX_val &b,
+                                 unsigned dbi_flags) {
+  if (dbi_flags & MDBX_INTEGERKEY)
+    return 0;
+
+  /* общая часть должна оставлять место для 8 байт числа в fpta_key */
+  const size_t limit = std::min(std::min(a.iov_len, b.iov_len),
+                                size_t(fpta_max_keylen - sizeof(uint64_t)));
+  const uint8_t *const x = static_cast<const uint8_t *>(a.iov_base);
+  const uint8_t *const y = static_cast<const uint8_t *>(b.iov_base);
+  size_t prefix = 0;
+  if (dbi_flags & MDBX_REVERSEKEY) {
+    while (prefix < limit &&
+           x[a.iov_len - 1 - prefix] == y[b.iov_len - 1 - prefix])
+      ++prefix;
+  } else {
+    while (prefix < limit && x[prefix] == y[prefix])
+      ++prefix;
+  }
+  return prefix;
+}
 
-  assert(column < schema->column_count());
-  const fpta_shove_t shove = schema->column_shove(column);
-  const fptu_type type = fpta_shove2type(shove);
-  const fpta_index_type index = fpta_shove2index(shove);
-  if (unlikely(type == /* composite */ fptu_null)) {
-    /* composite pseudo-column */
-    return fpta_composite_row2key(schema, column, row, key);
+uint64_t fpta_index_key2ordinal(const MDBX_val &key, unsigned dbi_flags,
+                                size_t prefix) {
+  const uint8_t *const bytes = static_cast<const uint8_t *>(key.iov_base);
+  if (dbi_flags & MDBX_INTEGERKEY) {
+    if (key.iov_len == sizeof(uint32_t)) {
+      uint32_t u32;
+      memcpy(&u32, bytes, sizeof(u32));
+      return u32;
+    }
+    assert(key.iov_len == sizeof(uint64_t));
+    uint64_t u64;
+    memcpy(&u64, bytes, sizeof(u64));
+    return u64;
   }
 
-  const fptu_field *field = fptu::lookup(row, (unsigned)column, type);
+  /* для MDBX_REVERSEKEY байты сравниваются начиная с последнего */
+  assert(prefix <= key.iov_len);
+  uint64_t number = 0;
+  for (size_t i = prefix; i < prefix + sizeof(number); ++i) {
+    number <<= 8;
+    if (i < key.iov_len)
+      number |= (dbi_flags & MDBX_REVERSEKEY) ? bytes[key.iov_len - 1 - i]
+                                              : bytes[i];
+  }
+  return number;
+}
+
+void fpta_index_ordinal2key(uint64_t number, unsigned dbi_flags,
+                            const MDBX_val &base, size_t prefix,
+                            fpta_key &key) {
+  if (dbi_flags & MDBX_INTEGERKEY) {
+    if (base.iov_len == sizeof(uint32_t)) {
+      key.place.u32 = uint32_t(number);
+      key.mdbx.iov_base = &key.place.u32;
+      key.mdbx.iov_len = sizeof(key.place.u32);
+    } else {
+      key.place.u64 = number;
+      key.mdbx.iov_base = &key.place.u64;
+      key.mdbx.iov_len = sizeof(key.place.u64);
+    }
+    return;
+  }
+
+  assert(prefix <= base.iov_len &&
+         prefix + sizeof(number) <= sizeof(key.place));
+  uint8_t *const bytes = reinterpret_cast<uint8_t *>(&key.place);
+  const size_t length = prefix + sizeof(number);
+  const uint8_t *const source = static_cast<const uint8_t *>(base.iov_base);
+  if (dbi_flags & MDBX_REVERSEKEY)
+    memcpy(bytes + sizeof(number), source + base.iov_len - prefix, prefix);
+  else
+    memcpy(bytes, source, prefix);
+  for (size_t i = 0; i < sizeof(number); ++i) {
+    const uint8_t byte = uint8_t(number >> (56 - i * 8));
+    bytes[(dbi_flags & MDBX_REVERSEKEY) ? length - 1 - prefix - i
+                                        : prefix + i] = byte;
+  }
+  key.mdbx.iov_base = bytes;
+  key.mdbx.iov_len = length;
+}
+
+//----------------------------------------------------------------------------
+
+/* Формирует ключ из найденного поля кортежа (или его отсутствия). */
+__hot int fpta_index_field2key(const fpta_shove_t shove,
+                               const fptu_field *field, fpta_key &key,
+                               bool copy, size_t limit) {
+  const fptu_type type = fpta_shove2type(shove);
+  const fpta_index_type index = fpta_shove2index(shove);
   if (unlikely(field == nullptr)) {
     if (!fpta_is_indexed_and_nullable(index))
       return FPTA_COLUMN_MISSING;
@@ -981,7 +1070,155 @@ __hot int fpta_index_row2key(const fpta_table_schema *const schema,
     break;
   }
 
-  return fpta_normalize_key(index, key, copy);
+  return fpta_normalize_key(index, key, copy, limit);
+}
+
+__hot int fpta_index_row2key(const fpta_table_schema *const schema,
+                             size_t column, const fptu_ro &row, fpta_key &key,
+                             bool copy) {
+#ifndef NDEBUG
+  fpta_pollute(&key, sizeof(key), 0);
+#endif
+
+  assert(column < schema->column_count());
+  const fpta_shove_t shove = schema->column_shove(column);
+  const fptu_type type = fpta_shove2type(shove);
+  if (unlikely(type == /* composite */ fptu_null)) {
+    /* composite pseudo-column */
+    return fpta_composite_row2key(schema, column, row, key);
+  }
+
+  if (unlikely(schema->is_expression(column))) {
+    /* вычисленное поле временное, поэтому ключ всегда копируется */
+    fpta_expression_field expression;
+    const fptu_field *field;
+    int rc = expression.compute(schema, column, row, field);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    return fpta_index_field2key(shove, field, key, true, fpta_max_keylen);
+  }
+
+  const fptu_field *field = fptu::lookup(row, (unsigned)column, type);
+  return fpta_index_field2key(shove, field, key, copy,
+                              schema->key_limit(column));
+}
+
+//----------------------------------------------------------------------------
+
+__hot int fpta_row_keys::build(const fpta_table_schema *table_def,
+                               const fptu_ro &source, bool copy) {
+  count_ = 0;
+  fptu_ro row = source;
+  if (copy && unlikely(table_def->has_multivalued())) {
+    /* строка нужна для обновления многозначных индексов уже после
+     * изменения основной таблицы */
+    if (row.sys.iov_len > row_copy_capacity_) {
+      void *larger = malloc(row.sys.iov_len);
+      if (unlikely(larger == nullptr))
+        return FPTA_ENOMEM;
+      free(row_copy_);
+      row_copy_ = larger;
+      row_copy_capacity_ = row.sys.iov_len;
+    }
+    row.sys.iov_base = memcpy(row_copy_, row.sys.iov_base, row.sys.iov_len);
+  }
+  row_ = row;
+  const size_t count = table_def->index_span();
+
+  if (unlikely(count > capacity_)) {
+    fpta_key *keys = (fpta_key *)malloc(count * sizeof(fpta_key));
+    if (unlikely(keys == nullptr))
+      return FPTA_ENOMEM;
+    if (keys_ != inplace_)
+      free(keys_);
+    keys_ = keys;
+    capacity_ = count;
+  }
+
+  /* Один проход по полям кортежа, указатели на найденные поля временно
+   * сохраняются вместо значений ключей. Как и в fptu::lookup() берется
+   * первое поле с совпадающим тегом. */
+  for (size_t i = 0; i < count; ++i)
+    keys_[i].mdbx.iov_base = nullptr;
+  memset(excluded_, 0, (count + 63) / 64 * sizeof(excluded_[0]));
+  const fptu_field *const end = fptu::end(row);
+  for (const fptu_field *pf = fptu::begin(row); pf < end; ++pf) {
+    const unsigned column = pf->colnum();
+    if (column >= count || keys_[column].mdbx.iov_base)
+      continue;
+    const fptu_type type = fpta_shove2type(table_def->column_shove(column));
+    if (type != /* composite */ fptu_null &&
+        pf->tag == fptu::make_tag(column, type))
+      keys_[column].mdbx.iov_base = (void *)pf;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const fpta_shove_t shove = table_def->column_shove(i);
+    if (unlikely(!fpta_is_indexed(shove))) {
+      /* колонка между индексированными, см. index_span() */
+      keys_[i].mdbx.iov_base = &keys_[i].place;
+      keys_[i].mdbx.iov_len = 0;
+      excluded_[i / 64] |= UINT64_C(1) << (i % 64);
+      continue;
+    }
+    const fptu_field *field = (const fptu_field *)keys_[i].mdbx.iov_base;
+    int rc = (fpta_shove2type(shove) == /* composite */ fptu_null)
+                 ? fpta_composite_row2key(table_def, i, row, keys_[i])
+                 : unlikely(table_def->is_expression(i))
+                       ? fpta_index_row2key(table_def, i, row, keys_[i], true)
+                       : fpta_index_field2key(shove, field, keys_[i], copy,
+                                              table_def->key_limit(i));
+    if (unlikely(rc != FPTA_SUCCESS)) {
+      /* Ключи предыдущих индексов остаются доступными. */
+      count_ = i;
+      return rc;
+    }
+  }
+
+  if (copy && unlikely(table_def->has_key_limits())) {
+    /* длинные ключи не помещаются в fpta_key и копируются отдельно */
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; ++i)
+      if (!keys_[i].is_inplace())
+        bytes += keys_[i].mdbx.iov_len;
+    if (bytes > spill_capacity_) {
+      void *larger = malloc(bytes);
+      if (unlikely(larger == nullptr))
+        return FPTA_ENOMEM;
+      free(spill_);
+      spill_ = larger;
+      spill_capacity_ = bytes;
+    }
+    uint8_t *ptr = (uint8_t *)spill_;
+    for (size_t i = 0; i < count; ++i)
+      if (!keys_[i].is_inplace()) {
+        keys_[i].mdbx.iov_base =
+            memcpy(ptr, keys_[i].mdbx.iov_base, keys_[i].mdbx.iov_len);
+        ptr += keys_[i].mdbx.iov_len;
+      }
+  }
+
+  /* строки не удовлетворяющие предикату частичного индекса
+   * в него не попадают */
+  if (unlikely(table_def->has_partial())) {
+    for (size_t i = 1; i < count; ++i) {
+      const fpta_filter *predicate = table_def->partial_predicate(i);
+      if (predicate && !fpta_filter_match(predicate, row))
+        excluded_[i / 64] |= UINT64_C(1) << (i % 64);
+    }
+  }
+
+  count_ = count;
+  return FPTA_SUCCESS;
+}
+
+void fpta_row_keys::diff(const fpta_row_keys &old) {
+  assert(old.empty() || old.count_ == count_);
+  memset(changed_, 0, (count_ + 63) / 64 * sizeof(changed_[0]));
+  for (size_t i = 0; i < count_; ++i)
+    if (old.empty() || !fpta_is_same(old.keys_[i].mdbx, keys_[i].mdbx) ||
+        old.included(i) != included(i))
+      changed_[i / 64] |= UINT64_C(1) << (i % 64);
 }
 
 //----------------------------------------------------------------------------
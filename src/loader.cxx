@@ -0,0 +1,694 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+#include <new>
+
+/* Внешняя сортировка пар ключ-значение в порядке mdbx-таблицы.
+ *
+ * Пары накапливаются в памяти в пределах заданного бюджета, после чего
+ * упорядочиваются и сбрасываются во временный файл в виде очередной серии.
+ * При выгрузке серии сливаются, а при их отсутствии пары выдаются прямо
+ * из памяти. Формат записи в файле: длина ключа и длина значения
+ * (uint32_t), затем ключ и значение. */
+struct fpta_sorter {
+  struct item {
+    size_t offset;
+    uint32_t key_len, value_len;
+  };
+
+  struct run {
+    uint64_t begin, end;
+  };
+
+  MDBX_txn *txn;
+  MDBX_dbi dbi;
+  bool dupsort;
+  size_t budget;
+  const char *spill_dir;
+
+  char *arena;
+  size_t arena_used, arena_size;
+  item *items;
+  size_t items_count, items_capacity;
+  run *runs;
+  size_t runs_count, runs_capacity;
+
+  FILE *spill;
+  char *spill_path;
+  uint64_t spill_size;
+};
+
+struct fpta_sorter_reader {
+  uint64_t position, end;
+  char *buffer;
+  size_t capacity, head, tail;
+  MDBX_val key, value;
+};
+
+static int fpta_sorter_ioerror(void) {
+  const int err = errno;
+  return err ? err : (int)FPTA_EOOPS;
+}
+
+static __inline int fpta_sorter_cmp(const fpta_sorter *sorter,
+                                    const MDBX_val &a_key,
+                                    const MDBX_val &a_value,
+                                    const MDBX_val &b_key,
+                                    const MDBX_val &b_value) {
+  int cmp = mdbx_cmp(sorter->txn, sorter->dbi, &a_key, &b_key);
+  if (cmp == 0 && sorter->dupsort)
+    cmp = mdbx_dcmp(sorter->txn, sorter->dbi, &a_value, &b_value);
+  return cmp;
+}
+
+static __inline void fpta_sorter_item2val(const fpta_sorter *sorter,
+                                          const fpta_sorter::item &item,
+                                          MDBX_val &key, MDBX_val &value) {
+  key.iov_base = sorter->arena + item.offset;
+  key.iov_len = item.key_len;
+  value.iov_base = sorter->arena + item.offset + item.key_len;
+  value.iov_len = item.value_len;
+}
+
+static void fpta_sorter_init(fpta_sorter *sorter, MDBX_txn *txn, MDBX_dbi dbi,
+                             bool dupsort, size_t budget,
+                             const char *spill_dir) {
+  memset(sorter, 0, sizeof(fpta_sorter));
+  sorter->txn = txn;
+  sorter->dbi = dbi;
+  sorter->dupsort = dupsort;
+  sorter->budget = budget;
+  sorter->spill_dir = spill_dir;
+}
+
+static void fpta_sorter_destroy(fpta_sorter *sorter) {
+  if (sorter->spill) {
+    fclose(sorter->spill);
+    sorter->spill = nullptr;
+  }
+  if (sorter->spill_path) {
+    remove(sorter->spill_path);
+    free(sorter->spill_path);
+    sorter->spill_path = nullptr;
+  }
+  free(sorter->runs);
+  free(sorter->items);
+  free(sorter->arena);
+  sorter->runs = nullptr;
+  sorter->items = nullptr;
+  sorter->arena = nullptr;
+}
+
+static int fpta_sorter_open_spill(fpta_sorter *sorter) {
+  if (!sorter->spill_dir) {
+    sorter->spill = tmpfile();
+    return sorter->spill ? (int)FPTA_SUCCESS : fpta_sorter_ioerror();
+  }
+
+  const size_t len = strlen(sorter->spill_dir) + 64;
+  sorter->spill_path = (char *)malloc(len);
+  if (unlikely(sorter->spill_path == nullptr))
+    return FPTA_ENOMEM;
+
+  /* Имя уникально в пределах процесса за счет адреса сортировщика,
+   * а от коллизий с другими процессами защищает режим "x". */
+  for (unsigned attempt = 0; attempt < 42; ++attempt) {
+    snprintf(sorter->spill_path, len, "%s/fpta-%p-%u.spill",
+             sorter->spill_dir, (void *)sorter, attempt);
+    sorter->spill = fopen(sorter->spill_path, "w+bx");
+    if (sorter->spill)
+      return FPTA_SUCCESS;
+    if (errno != EEXIST)
+      break;
+  }
+
+  const int rc = fpta_sorter_ioerror();
+  free(sorter->spill_path);
+  sorter->spill_path = nullptr;
+  return rc;
+}
+
+/* Упорядочивает накопленные в памяти пары. */
+static void fpta_sorter_sort(fpta_sorter *sorter) {
+  std::sort(sorter->items, sorter->items + sorter->items_count,
+            [sorter](const fpta_sorter::item &a, const fpta_sorter::item &b) {
+              MDBX_val a_key, a_value, b_key, b_value;
+              fpta_sorter_item2val(sorter, a, a_key, a_value);
+              fpta_sorter_item2val(sorter, b, b_key, b_value);
+              return fpta_sorter_cmp(sorter, a_key, a_value, b_key,
+                                     b_value) < 0;
+            });
+}
+
+/* Сбрасывает накопленные пары во временный файл в виде серии. */
+static int fpta_sorter_spill(fpta_sorter *sorter) {
+  if (sorter->spill == nullptr) {
+    int rc = fpta_sorter_open_spill(sorter);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  if (sorter->runs_count == sorter->runs_capacity) {
+    const size_t capacity =
+        sorter->runs_capacity ? sorter->runs_capacity * 2 : 16;
+    void *larger = realloc(sorter->runs, capacity * sizeof(fpta_sorter::run));
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    sorter->runs = (fpta_sorter::run *)larger;
+    sorter->runs_capacity = capacity;
+  }
+
+  fpta_sorter_sort(sorter);
+  fpta_sorter::run &run = sorter->runs[sorter->runs_count];
+  run.begin = sorter->spill_size;
+  for (size_t i = 0; i < sorter->items_count; ++i) {
+    const fpta_sorter::item &item = sorter->items[i];
+    const uint32_t header[2] = {item.key_len, item.value_len};
+    const size_t bytes = (size_t)item.key_len + item.value_len;
+    if (unlikely(fwrite(header, sizeof(header), 1, sorter->spill) != 1 ||
+                 fwrite(sorter->arena + item.offset, 1, bytes,
+                        sorter->spill) != bytes))
+      return fpta_sorter_ioerror();
+    sorter->spill_size += sizeof(header) + bytes;
+  }
+  run.end = sorter->spill_size;
+  sorter->runs_count += 1;
+
+  sorter->items_count = 0;
+  sorter->arena_used = 0;
+  return FPTA_SUCCESS;
+}
+
+static int fpta_sorter_add(fpta_sorter *sorter, const MDBX_val &key,
+                           const MDBX_val &value) {
+  const size_t bytes = key.iov_len + value.iov_len;
+  if (sorter->arena_used + bytes > sorter->budget && sorter->items_count) {
+    int rc = fpta_sorter_spill(sorter);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  if (sorter->arena_used + bytes > sorter->arena_size) {
+    const size_t want = sorter->arena_used + bytes;
+    size_t size = sorter->arena_size ? sorter->arena_size
+                                     : (size_t)fpta_loader_readahead;
+    while (size < want)
+      size <<= 1;
+    if (size > sorter->budget && want <= sorter->budget)
+      size = sorter->budget;
+    void *larger = realloc(sorter->arena, size);
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    sorter->arena = (char *)larger;
+    sorter->arena_size = size;
+  }
+
+  if (sorter->items_count == sorter->items_capacity) {
+    const size_t capacity =
+        sorter->items_capacity ? sorter->items_capacity * 2 : 1024;
+    void *larger =
+        realloc(sorter->items, capacity * sizeof(fpta_sorter::item));
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    sorter->items = (fpta_sorter::item *)larger;
+    sorter->items_capacity = capacity;
+  }
+
+  fpta_sorter::item &item = sorter->items[sorter->items_count++];
+  item.offset = sorter->arena_used;
+  item.key_len = (uint32_t)key.iov_len;
+  item.value_len = (uint32_t)value.iov_len;
+  memcpy(sorter->arena + sorter->arena_used, key.iov_base, key.iov_len);
+  memcpy(sorter->arena + sorter->arena_used + key.iov_len, value.iov_base,
+         value.iov_len);
+  sorter->arena_used += bytes;
+  return FPTA_SUCCESS;
+}
+
+/* Подкачивает данные серии так, чтобы в буфере было не менее need байт. */
+static int fpta_sorter_fill(FILE *file, fpta_sorter_reader *reader,
+                            size_t need) {
+  const size_t left = reader->tail - reader->head;
+  if (left == 0 && reader->position == reader->end)
+    return MDBX_NOTFOUND;
+
+  memmove(reader->buffer, reader->buffer + reader->head, left);
+  reader->head = 0;
+  reader->tail = left;
+  if (need > reader->capacity) {
+    void *larger = realloc(reader->buffer, need);
+    if (unlikely(larger == nullptr))
+      return FPTA_ENOMEM;
+    reader->buffer = (char *)larger;
+    reader->capacity = need;
+  }
+
+  const size_t chunk = (size_t)std::min(
+      (uint64_t)(reader->capacity - left), reader->end - reader->position);
+  if (unlikely(left + chunk < need))
+    return FPTA_EOOPS;
+
+  int rc = fpta_fseek(file, reader->position);
+  if (unlikely(rc != 0))
+    return rc;
+  if (unlikely(fread(reader->buffer + left, 1, chunk, file) != chunk))
+    return fpta_sorter_ioerror();
+  reader->position += chunk;
+  reader->tail += chunk;
+  return FPTA_SUCCESS;
+}
+
+/* Переходит к следующей записи серии. */
+static int fpta_sorter_next(FILE *file, fpta_sorter_reader *reader) {
+  uint32_t header[2];
+  if (reader->tail - reader->head < sizeof(header)) {
+    int rc = fpta_sorter_fill(file, reader, sizeof(header));
+    if (rc != FPTA_SUCCESS)
+      return rc;
+  }
+
+  memcpy(header, reader->buffer + reader->head, sizeof(header));
+  const size_t need = sizeof(header) + (size_t)header[0] + header[1];
+  if (reader->tail - reader->head < need) {
+    int rc = fpta_sorter_fill(file, reader, need);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return (rc == MDBX_NOTFOUND) ? (int)FPTA_EOOPS : rc;
+  }
+
+  char *const record = reader->buffer + reader->head;
+  reader->key.iov_base = record + sizeof(header);
+  reader->key.iov_len = header[0];
+  reader->value.iov_base = record + sizeof(header) + header[0];
+  reader->value.iov_len = header[1];
+  reader->head += need;
+  return FPTA_SUCCESS;
+}
+
+static __inline int fpta_sorter_put(fpta_sorter *sorter,
+                                    fpta_appender &appender, unsigned flags,
+                                    MDBX_val &key, MDBX_val &value) {
+  const unsigned append = appender.flags(key, value);
+  int rc = mdbx_put(sorter->txn, sorter->dbi, &key, &value, flags | append);
+  if (likely(rc == MDBX_SUCCESS) && append)
+    appender.appended(key, value);
+  return rc;
+}
+
+/* Выгружает накопленные в памяти пары прямо в mdbx-таблицу. */
+static int fpta_sorter_flush(fpta_sorter *sorter, fpta_appender &appender,
+                             unsigned flags, bool need_sort) {
+  assert(sorter->runs_count == 0);
+  if (need_sort)
+    fpta_sorter_sort(sorter);
+  for (size_t i = 0; i < sorter->items_count; ++i) {
+    MDBX_val key, value;
+    fpta_sorter_item2val(sorter, sorter->items[i], key, value);
+    int rc = fpta_sorter_put(sorter, appender, flags, key, value);
+    if (unlikely(rc != MDBX_SUCCESS))
+      return rc;
+  }
+  sorter->items_count = 0;
+  sorter->arena_used = 0;
+  return FPTA_SUCCESS;
+}
+
+/* Выгружает все пары в mdbx-таблицу в порядке её ключей, при этом
+ * в конец таблицы пары добавляются в режиме MDBX_APPEND/MDBX_APPENDDUP. */
+static int fpta_sorter_drain(fpta_sorter *sorter, fpta_appender &appender,
+                             unsigned flags) {
+  int rc;
+  if (sorter->runs_count == 0)
+    return fpta_sorter_flush(sorter, appender, flags, true);
+
+  if (sorter->items_count) {
+    rc = fpta_sorter_spill(sorter);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  if (unlikely(fflush(sorter->spill) != 0))
+    return fpta_sorter_ioerror();
+
+  /* Память под сортировку больше не нужна. */
+  free(sorter->arena);
+  sorter->arena = nullptr;
+  sorter->arena_size = 0;
+
+  const size_t count = sorter->runs_count;
+  fpta_sorter_reader *readers =
+      (fpta_sorter_reader *)calloc(count, sizeof(fpta_sorter_reader));
+  unsigned *heap = (unsigned *)malloc(count * sizeof(unsigned));
+  size_t n = 0;
+  if (unlikely(readers == nullptr || heap == nullptr)) {
+    rc = FPTA_ENOMEM;
+    goto bailout;
+  }
+
+  {
+    /* min-heap, при равенстве меньший номер серии */
+    const auto greater = [sorter, readers](unsigned a, unsigned b) {
+      const int cmp =
+          fpta_sorter_cmp(sorter, readers[a].key, readers[a].value,
+                          readers[b].key, readers[b].value);
+      return cmp > 0 || (cmp == 0 && a > b);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+      fpta_sorter_reader *reader = &readers[i];
+      reader->position = sorter->runs[i].begin;
+      reader->end = sorter->runs[i].end;
+      reader->capacity = fpta_loader_readahead;
+      reader->buffer = (char *)malloc(reader->capacity);
+      if (unlikely(reader->buffer == nullptr)) {
+        rc = FPTA_ENOMEM;
+        goto bailout;
+      }
+      rc = fpta_sorter_next(sorter->spill, reader);
+      if (rc == MDBX_NOTFOUND)
+        continue;
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      heap[n++] = (unsigned)i;
+      std::push_heap(heap, heap + n, greater);
+    }
+
+    while (n > 0) {
+      std::pop_heap(heap, heap + n, greater);
+      fpta_sorter_reader *reader = &readers[heap[n - 1]];
+      rc = fpta_sorter_put(sorter, appender, flags, reader->key,
+                           reader->value);
+      if (unlikely(rc != MDBX_SUCCESS))
+        goto bailout;
+
+      rc = fpta_sorter_next(sorter->spill, reader);
+      if (rc == FPTA_SUCCESS)
+        std::push_heap(heap, heap + n, greater);
+      else if (rc == MDBX_NOTFOUND)
+        --n;
+      else
+        goto bailout;
+    }
+    rc = FPTA_SUCCESS;
+  }
+
+bailout:
+  if (readers) {
+    for (size_t i = 0; i < count; ++i)
+      free(readers[i].buffer);
+  }
+  free(heap);
+  free(readers);
+  return rc;
+}
+
+/* Интерфейс сортировщика для построения индексов, см fpta_index_add(). */
+
+int fpta_sorter_create(MDBX_txn *txn, MDBX_dbi dbi, bool dupsort,
+                       size_t budget, fpta_sorter **psorter) {
+  fpta_sorter *sorter = (fpta_sorter *)malloc(sizeof(fpta_sorter));
+  if (unlikely(sorter == nullptr))
+    return FPTA_ENOMEM;
+  fpta_sorter_init(sorter, txn, dbi, dupsort,
+                   budget ? budget : (size_t)fpta_loader_run_default, nullptr);
+  *psorter = sorter;
+  return FPTA_SUCCESS;
+}
+
+int fpta_sorter_push(fpta_sorter *sorter, const MDBX_val &key,
+                     const MDBX_val &value) {
+  return fpta_sorter_add(sorter, key, value);
+}
+
+int fpta_sorter_complete(fpta_sorter *sorter, unsigned flags) {
+  fpta_appender appender(sorter->txn, sorter->dbi, sorter->dupsort, true);
+  int rc = appender.init();
+  if (likely(rc == MDBX_SUCCESS))
+    rc = fpta_sorter_drain(sorter, appender, flags);
+  return rc;
+}
+
+void fpta_sorter_release(fpta_sorter *sorter) {
+  if (sorter) {
+    fpta_sorter_destroy(sorter);
+    free(sorter);
+  }
+}
+
+//----------------------------------------------------------------------------
+
+static __inline unsigned fpta_loader_pk_flags(const fpta_sorter *sorter) {
+  return sorter->dupsort ? MDBX_NODUPDATA : MDBX_NODUPDATA | MDBX_NOOVERWRITE;
+}
+
+struct fpta_loader {
+  fpta_loader(fpta_txn *txn, fpta_table_schema *table_def, MDBX_dbi pk_dbi,
+              bool pk_dupsort)
+      : txn(txn), table_def(table_def), indexes(0), status(FPTA_SUCCESS),
+        pk_direct(true), spill_dir(nullptr), sorters(nullptr), keys(nullptr),
+        pk_appender(txn->mdbx_txn, pk_dbi, pk_dupsort, true) {}
+
+  fpta_txn *const txn;
+  fpta_table_schema *const table_def;
+  size_t indexes /* первичный и все вторичные индексы */;
+  int status /* ошибка, после которой загрузка невозможна */;
+  bool pk_direct /* строки пока поступают по возрастанию ключа */;
+  char *spill_dir;
+  fpta_sorter *sorters;
+  fpta_key *keys;
+  fpta_appender pk_appender;
+};
+
+static void fpta_loader_free(fpta_loader *loader) {
+  if (loader->sorters) {
+    for (size_t i = 0; i < loader->indexes; ++i)
+      fpta_sorter_destroy(&loader->sorters[i]);
+    free(loader->sorters);
+  }
+  delete[] loader->keys;
+  free(loader->spill_dir);
+  delete loader;
+}
+
+int fpta_loader_begin(fpta_db *db, fpta_name *table_id, const char *spill_dir,
+                      size_t run_bytes, fpta_loader **ploader) {
+  if (unlikely(ploader == nullptr))
+    return FPTA_EINVAL;
+  *ploader = nullptr;
+  if (run_bytes == 0)
+    run_bytes = fpta_loader_run_default;
+
+  fpta_txn *txn = nullptr;
+  int rc = fpta_transaction_begin(db, fpta_write, &txn);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_loader *loader = nullptr;
+  fpta_table_schema *table_def;
+  MDBX_dbi dbi[fpta_max_indexes];
+  size_t indexes;
+  rc = fpta_name_refresh_couple(txn, table_id, nullptr);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+
+  table_def = table_id->table_schema;
+  rc = fpta_open_secondaries(txn, table_def, dbi);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+
+  loader = new (std::nothrow)
+      fpta_loader(txn, table_def, dbi[0],
+                  !fpta_index_is_unique(table_def->table_pk()));
+  if (unlikely(loader == nullptr)) {
+    rc = FPTA_ENOMEM;
+    goto bailout;
+  }
+
+  if (spill_dir) {
+    loader->spill_dir = strdup(spill_dir);
+    if (unlikely(loader->spill_dir == nullptr)) {
+      rc = FPTA_ENOMEM;
+      goto bailout;
+    }
+  }
+
+  indexes = table_def->index_span();
+
+  loader->sorters = (fpta_sorter *)calloc(indexes, sizeof(fpta_sorter));
+  loader->keys = new (std::nothrow) fpta_key[indexes];
+  if (unlikely(loader->sorters == nullptr || loader->keys == nullptr)) {
+    rc = FPTA_ENOMEM;
+    goto bailout;
+  }
+
+  loader->indexes = indexes;
+  for (size_t i = 0; i < indexes; ++i)
+    fpta_sorter_init(
+        &loader->sorters[i], txn->mdbx_txn, dbi[i],
+        !fpta_index_is_unique(fpta_shove2index(table_def->column_shove(i))),
+        run_bytes, loader->spill_dir);
+
+  rc = loader->pk_appender.init();
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+
+  *ploader = loader;
+  return FPTA_SUCCESS;
+
+bailout:
+  if (loader)
+    fpta_loader_free(loader);
+  fpta_transaction_end(txn, true);
+  return rc;
+}
+
+int fpta_loader_put(fpta_loader *loader, fptu_ro row) {
+  if (unlikely(loader == nullptr))
+    return FPTA_EINVAL;
+  if (unlikely(loader->status != FPTA_SUCCESS))
+    return loader->status;
+
+  const fpta_table_schema *table_def = loader->table_def;
+  int rc = fpta_check_nonnullable(table_def, row);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  /* Все ключи формируются до каких-либо изменений, с тем чтобы ошибки
+   * в данных отдельной строки не прерывали загрузку. */
+  fpta_key *const keys = loader->keys;
+  for (size_t i = 0; i < loader->indexes; ++i) {
+    if (!fpta_is_indexed(table_def->column_shove(i)))
+      continue;
+    rc = fpta_index_row2key(table_def, i, row, keys[i], false);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  /* Пока строки поступают в порядке возрастания первичного ключа, они
+   * по заполнению бюджета добавляются в конец таблицы без сброса серии
+   * на диск. Иначе все последующие строки сливаются при завершении. */
+  fpta_sorter *const pk_sorter = &loader->sorters[0];
+  if (loader->pk_direct) {
+    if (pk_sorter->items_count) {
+      MDBX_val last_key, last_value;
+      fpta_sorter_item2val(pk_sorter,
+                           pk_sorter->items[pk_sorter->items_count - 1],
+                           last_key, last_value);
+      loader->pk_direct = fpta_sorter_cmp(pk_sorter, keys[0].mdbx, row.sys,
+                                          last_key, last_value) > 0;
+    } else
+      loader->pk_direct =
+          loader->pk_appender.flags(keys[0].mdbx, row.sys) != 0;
+
+    if (loader->pk_direct &&
+        pk_sorter->arena_used + keys[0].mdbx.iov_len + row.sys.iov_len >
+            pk_sorter->budget) {
+      rc = fpta_sorter_flush(pk_sorter, loader->pk_appender,
+                             fpta_loader_pk_flags(pk_sorter), false);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+    }
+  }
+
+  rc = fpta_sorter_add(pk_sorter, keys[0].mdbx, row.sys);
+  if (unlikely(rc != FPTA_SUCCESS))
+    goto bailout;
+
+  for (size_t i = 1; i < loader->indexes; ++i) {
+    if (!fpta_is_indexed(table_def->column_shove(i)))
+      continue;
+    const fpta_filter *predicate = table_def->partial_predicate(i);
+    if (predicate && !fpta_filter_match(predicate, row))
+      /* строка не попадает в частичный индекс */
+      continue;
+
+    if (table_def->is_bitmap(i)) {
+      /* битовый индекс обновляется сразу, без сортировки */
+      uint64_t rowid = fpta_bitmap_rowid(keys[0].mdbx);
+      rc = fpta_bitmap_update(loader->txn, table_def, i, keys[i].mdbx, &rowid,
+                              1, true);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      continue;
+    }
+
+    if (table_def->is_multivalued(i)) {
+      /* в серию индекса попадает пара для каждого из значений строки */
+      fpta_multivalued_keys values;
+      rc = values.build(table_def, i, row);
+      if (unlikely(rc != FPTA_SUCCESS))
+        goto bailout;
+      for (size_t n = 0; n < values.size(); ++n) {
+        rc = fpta_sorter_add(&loader->sorters[i], values[n], keys[0].mdbx);
+        if (unlikely(rc != FPTA_SUCCESS))
+          goto bailout;
+      }
+      continue;
+    }
+
+    fpta_secondary_value se_value;
+    rc = se_value.build(table_def, i, row, keys[0].mdbx);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+    rc = fpta_sorter_add(&loader->sorters[i], keys[i].mdbx, se_value.value());
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+  }
+  return FPTA_SUCCESS;
+
+bailout:
+  loader->status = rc;
+  return rc;
+}
+
+int fpta_loader_end(fpta_loader *loader, bool abort) {
+  if (unlikely(loader == nullptr))
+    return FPTA_EINVAL;
+
+  int rc = loader->status;
+  if (!abort && rc == FPTA_SUCCESS) {
+    for (size_t i = 0; i < loader->indexes; ++i) {
+      fpta_sorter *const sorter = &loader->sorters[i];
+      if (!fpta_is_indexed(loader->table_def->column_shove(i)))
+        continue;
+      const unsigned flags = fpta_loader_pk_flags(sorter);
+      if (i == 0)
+        rc = fpta_sorter_drain(sorter, loader->pk_appender, flags);
+      else {
+        fpta_appender appender(sorter->txn, sorter->dbi, sorter->dupsort,
+                               true);
+        rc = appender.init();
+        if (likely(rc == MDBX_SUCCESS))
+          rc = fpta_sorter_drain(sorter, appender, flags);
+        if (likely(rc == FPTA_SUCCESS) && loader->table_def->bloom_bits(i))
+          /* фильтр Блума строится по уже заполненному индексу */
+          rc = fpta_bloom_rebuild(loader->txn, loader->table_def, i,
+                                  sorter->dbi);
+      }
+      /* Серии больше не нужны, освобождаем место как можно раньше. */
+      fpta_sorter_destroy(sorter);
+      if (unlikely(rc != FPTA_SUCCESS))
+        break;
+    }
+  }
+
+  int err = fpta_transaction_end(loader->txn, abort || rc != FPTA_SUCCESS);
+  if (rc == FPTA_SUCCESS)
+    rc = err;
+  fpta_loader_free(loader);
+  return rc;
+}
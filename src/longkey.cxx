@@ -0,0 +1,138 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Индексы с увеличенным лимитом длины ключа.
+ *
+ * По умолчанию длинные ключи упорядоченных индексов подрезаются до
+ * fpta_max_keylen и дополняются хэшем остатка, что нарушает порядок
+ * сортировки. Для отдельного индекса в схеме может быть задан больший
+ * лимит, в пределах которого ключи хранятся целиком.
+ *
+ * Такие ключи не помещаются в fpta_key::place, поэтому без запроса копии
+ * ссылаются на данные строки или fpta_value, а при необходимости копии
+ * (границы диапазона курсора, ключи предыдущей версии строки) переносятся
+ * в отдельно выделяемую память. Значения длиннее лимита отвергаются,
+ * что исключает смешивание полных и подрезанных ключей в одном индексе. */
+
+int __cold fpta_index_keylen_validate(
+    const size_t index_column, const size_t max_keylen,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  const fpta_index_type index = fpta_shove2index(index_shove);
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_ordered(index) ||
+               fpta_is_indexed_and_nullable(index)))
+    return FPTA_EFLAG;
+
+  const fptu_type data_type = fpta_shove2type(index_shove);
+  if (unlikely(data_type != fptu_cstr && data_type != fptu_opaque))
+    return FPTA_ETYPE;
+
+  if (unlikely(max_keylen <= fpta_max_keylen || max_keylen > UINT16_MAX))
+    return FPTA_EINVAL;
+
+  /* для индекса допускается только один лимит */
+  if (unlikely(fpta_column_option_lookup(index_column,
+                                         fpta_table_schema::option_keylen,
+                                         records_begin, records_end)))
+    return FPTA_EEXIST;
+
+  if (unlikely(fpta_column_option_lookup(
+          index_column, fpta_table_schema::option_expression, records_begin,
+          records_end)))
+    return FPTA_EFLAG;
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_index_keylen(const char *index_name,
+                                      fpta_column_set *column_set,
+                                      size_t max_keylen) {
+  if (unlikely(column_set == nullptr))
+    return FPTA_EINVAL;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи лимитов следуют за списками составных колонок,
+   * вместе с записями покрывающих и частичных индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_index_keylen_validate(index_column, max_keylen,
+                                  column_set->shoves, column_set->count,
+                                  records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  const fpta_table_schema::composite_item_t payload[] = {
+      fpta_table_schema::option_keylen,
+      (fpta_table_schema::composite_item_t)max_keylen};
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::option_mark, index_column,
+                                payload, FPT_ARRAY_LENGTH(payload));
+}
+
+//----------------------------------------------------------------------------
+
+int __cold fpta_index_keylen_check(
+    const fpta_db *db, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  const auto pk_record = fpta_column_option_lookup(
+      0, fpta_table_schema::option_keylen, records_begin, records_end);
+  const size_t pk_keylen = pk_record ? pk_record[3] : 0;
+
+  for (size_t i = 0; i < column_count; ++i) {
+    const fpta_shove_t shove = columns_shoves[i];
+    if (!fpta_is_indexed(shove))
+      continue;
+
+    const unsigned dbi_flags = fpta_dbi_flags(columns_shoves, i);
+    const auto record = fpta_column_option_lookup(
+        i, fpta_table_schema::option_keylen, records_begin, records_end);
+    if (record) {
+      const int max_keysize =
+          mdbx_env_get_maxkeysize_ex(db->mdbx_env, dbi_flags);
+      if (unlikely(max_keysize < 0 || (size_t)max_keysize < record[3]))
+        return FPTA_DATALEN_MISMATCH;
+    }
+
+    /* во вторичных индексах с дубликатами ключи PK хранятся
+     * как multi-значения, размер которых также ограничен */
+    if (i > 0 && pk_keylen && (dbi_flags & MDBX_DUPSORT)) {
+      const int max_valsize =
+          mdbx_env_get_maxvalsize_ex(db->mdbx_env, dbi_flags);
+      if (unlikely(max_valsize < 0 || (size_t)max_valsize < pk_keylen))
+        return FPTA_DATALEN_MISMATCH;
+    }
+  }
+
+  return FPTA_SUCCESS;
+}
@@ -51,6 +51,7 @@ static __cold const char *error2cp(int32_t errcode) {
   static_assert(FPTA_ENOENT == ERROR_NOT_FOUND, "error code mismatch");
   static_assert(FPTA_EPERM == ERROR_INVALID_FUNCTION, "error code mismatch");
   static_assert(FPTA_EBUSY == ERROR_BUSY, "error code mismatch");
+  static_assert(FPTA_ETIMEDOUT == ERROR_TIMEOUT, "error code mismatch");
   static_assert(FPTA_ENAME == ERROR_INVALID_NAME, "error code mismatch");
   static_assert(FPTA_EFLAG == ERROR_INVALID_FLAG_NUMBER, "error code mismatch");
 #endif /* static_asserts for Windows */
@@ -268,7 +269,8 @@ __cold ostream &operator<<(ostream &out, const fpta_filter_bits value) {
 FPTA_TOSTRING_IMP(const fpta_filter_bits);
 
 __cold ostream &operator<<(ostream &out, const fpta_cursor_options value) {
-  switch (value & ~(fpta_dont_fetch | fpta_zeroed_range_is_point)) {
+  switch (value & ~(fpta_dont_fetch | fpta_zeroed_range_is_point |
+                    fpta_batched_lookup)) {
   default:
     return invalid(out, "cursor_options", value);
   case fpta_unsorted:
@@ -285,6 +287,8 @@ __cold ostream &operator<<(ostream &out, const fpta_cursor_options value) {
     out << ".zeroed_range_is_point";
   if (value & fpta_dont_fetch)
     out << ".dont_fetch";
+  if (value & fpta_batched_lookup)
+    out << ".batched_lookup";
   return out;
 }
 FPTA_TOSTRING_IMP(const fpta_cursor_options);
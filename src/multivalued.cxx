@@ -0,0 +1,304 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Многозначные индексы.
+ *
+ * Колонка с многозначным индексом может содержать в строке несколько полей
+ * с одинаковым тегом (коллекцию в терминах libfptu), которые добавляются
+ * посредством fpta_insert_column(). Для каждого из различных значений
+ * во вторичный индекс помещается отдельная пара значение-PK, поэтому
+ * курсор по такому индексу находит все строки, содержащие заданное
+ * значение, а строка с несколькими подходящими значениями встречается
+ * в выборке несколько раз.
+ *
+ * Остальные функции (fpta_get_column(), фильтры, fpta_upsert_column() и т.п.)
+ * по-прежнему работают с первым полем колонки. При обновлении строки пары
+ * индекса изменяются только для добавленных и удаленных значений, а все
+ * пары заменяются лишь при изменении PK. */
+
+int __cold fpta_index_multivalued_validate(
+    const size_t index_column, const fpta_shove_t *const columns_shoves,
+    const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end,
+    const fpta_table_schema::composite_item_t *const self) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  const fpta_index_type index = fpta_shove2index(index_shove);
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(index) ||
+               fpta_index_is_unique(index)))
+    return FPTA_EFLAG;
+  if (unlikely(fpta_is_composite(index_shove)))
+    return FPTA_ETYPE;
+
+  /* многозначный индекс не может быть покрывающим, частичным, индексом
+   * колонки-выражения, с увеличенным лимитом длины ключа или битовым */
+  for (auto scan = records_begin;
+       scan < records_end && (*scan & fpta_table_schema::record_kind_mask);
+       scan += fpta_table_schema::record_length(*scan)) {
+    if (scan == self || scan[1] != index_column)
+      continue;
+    if ((*scan & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::option_mark &&
+        scan[2] == fpta_table_schema::option_multivalued)
+      return FPTA_EEXIST;
+    return FPTA_EFLAG;
+  }
+
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_index_multivalued(const char *index_name,
+                                           fpta_column_set *column_set) {
+  if (unlikely(column_set == nullptr))
+    return FPTA_EINVAL;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи многозначных индексов следуют за списками составных колонок,
+   * вместе с записями покрывающих и частичных индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_index_multivalued_validate(index_column, column_set->shoves,
+                                       column_set->count, records, tail,
+                                       nullptr);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  const fpta_table_schema::composite_item_t payload[] = {
+      fpta_table_schema::option_multivalued};
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::option_mark, index_column,
+                                payload, FPT_ARRAY_LENGTH(payload));
+}
+
+//----------------------------------------------------------------------------
+
+static __inline bool fpta_multivalued_less(const MDBX_val &a,
+                                           const MDBX_val &b) {
+  if (a.iov_len != b.iov_len)
+    return a.iov_len < b.iov_len;
+  return memcmp(a.iov_base, b.iov_base, a.iov_len) < 0;
+}
+
+__hot int fpta_multivalued_keys::build(const fpta_table_schema *table_def,
+                                       size_t column, const fptu_ro &row) {
+  count_ = 0;
+  const fpta_shove_t shove = table_def->column_shove(column);
+  const uint_fast16_t tag =
+      fptu::make_tag((unsigned)column, fpta_shove2type(shove));
+  const fptu_field *const begin = fptu::begin(row);
+  const fptu_field *const end = fptu::end(row);
+
+  size_t items = 0;
+  for (const fptu_field *pf = begin; pf < end; ++pf)
+    if (pf->tag == tag)
+      ++items;
+
+  if (unlikely(items > capacity_)) {
+    fpta_key *keys = (fpta_key *)malloc(items * sizeof(fpta_key));
+    MDBX_val *sorted = (MDBX_val *)malloc(items * sizeof(MDBX_val));
+    if (unlikely(keys == nullptr || sorted == nullptr)) {
+      free(keys);
+      free(sorted);
+      return FPTA_ENOMEM;
+    }
+    if (keys_ != inplace_keys_) {
+      free(keys_);
+      free(sorted_);
+    }
+    keys_ = keys;
+    sorted_ = sorted;
+    capacity_ = items;
+  }
+
+  const size_t limit = table_def->key_limit(column);
+  if (items == 0) {
+    /* строка без значений представлена в индексе так же, как и в обычном,
+     * т.е. ключом NIL, либо отвергается для не-nullable колонки */
+    int rc = fpta_index_field2key(shove, nullptr, keys_[0], false, limit);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    sorted_[0] = keys_[0].mdbx;
+    count_ = 1;
+    return FPTA_SUCCESS;
+  }
+
+  for (const fptu_field *pf = begin; pf < end; ++pf) {
+    if (pf->tag != tag)
+      continue;
+    int rc = fpta_index_field2key(shove, pf, keys_[count_], false, limit);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    sorted_[count_] = keys_[count_].mdbx;
+    ++count_;
+  }
+
+  std::sort(sorted_, sorted_ + count_, fpta_multivalued_less);
+  count_ = std::unique(sorted_, sorted_ + count_, fpta_is_same) - sorted_;
+  return FPTA_SUCCESS;
+}
+
+int fpta_multivalued_update(fpta_txn *txn, const fpta_table_schema *table_def,
+                            size_t column, MDBX_dbi dbi,
+                            const MDBX_val &old_pk_key, const fptu_ro *old_row,
+                            const MDBX_val &new_pk_key, const fptu_ro *new_row,
+                            const MDBX_val *except) {
+  assert(table_def->is_multivalued(column));
+  fpta_multivalued_keys old_keys, new_keys;
+  if (old_row) {
+    int rc = old_keys.build(table_def, column, *old_row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  if (new_row) {
+    int rc = new_keys.build(table_def, column, *new_row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+
+  /* При изменении PK заменяются пары для всех значений, иначе только
+   * для отсутствующих в одной из версий строки. Слияние упорядоченных
+   * последовательностей ключей дает разницу за один проход. */
+  const bool pk_changed =
+      old_row && new_row && !fpta_is_same(old_pk_key, new_pk_key);
+  size_t o = 0, n = 0;
+  while (o < old_keys.size() || n < new_keys.size()) {
+    int order;
+    if (o == old_keys.size())
+      order = 1;
+    else if (n == new_keys.size())
+      order = -1;
+    else
+      order = fpta_multivalued_less(old_keys[o], new_keys[n])
+                  ? -1
+                  : fpta_multivalued_less(new_keys[n], old_keys[o]) ? 1 : 0;
+
+    if (order <= 0) {
+      const MDBX_val &se_key = old_keys[o++];
+      if ((order < 0 || pk_changed) &&
+          !(except && fpta_is_same(se_key, *except))) {
+        int rc = mdbx_del(txn->mdbx_txn, dbi, &se_key, &old_pk_key);
+        if (unlikely(rc != MDBX_SUCCESS))
+          return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+      }
+    }
+    if (order >= 0) {
+      const MDBX_val &se_key = new_keys[n++];
+      if ((order > 0 || pk_changed) &&
+          !(except && fpta_is_same(se_key, *except))) {
+        MDBX_val pk_key = new_pk_key;
+        int rc = mdbx_put(txn->mdbx_txn, dbi, &se_key, &pk_key,
+                          MDBX_NODUPDATA);
+        if (unlikely(rc != MDBX_SUCCESS))
+          return rc;
+      }
+    }
+  }
+
+  return FPTA_SUCCESS;
+}
+
+int fpta_multivalued_lookup(const fpta_table_schema *table_def, size_t column,
+                            const fptu_ro &row, const MDBX_val &key,
+                            fpta_key &found) {
+  const fpta_shove_t shove = table_def->column_shove(column);
+  const uint_fast16_t tag =
+      fptu::make_tag((unsigned)column, fpta_shove2type(shove));
+  const size_t limit = table_def->key_limit(column);
+  const fptu_field *const end = fptu::end(row);
+  bool empty = true;
+  for (const fptu_field *pf = fptu::begin(row); pf < end; ++pf) {
+    if (pf->tag != tag)
+      continue;
+    empty = false;
+    int rc = fpta_index_field2key(shove, pf, found, true, limit);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    if (fpta_is_same(found.mdbx, key))
+      return FPTA_SUCCESS;
+  }
+
+  if (empty) {
+    int rc = fpta_index_field2key(shove, nullptr, found, true, limit);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    if (fpta_is_same(found.mdbx, key))
+      return FPTA_SUCCESS;
+  }
+  return FPTA_KEY_MISMATCH;
+}
+
+//----------------------------------------------------------------------------
+
+int fpta_insert_column(fptu_rw *pt, const fpta_name *column_id,
+                       fpta_value value) {
+  if (unlikely(!pt))
+    return FPTA_EINVAL;
+  int rc = fpta_id_validate(column_id, fpta_column_with_schema);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  const unsigned colnum = column_id->column.num;
+  if (unlikely(
+          !column_id->column.table->table_schema->is_multivalued(colnum)))
+    return FPTA_EFLAG;
+  if (unlikely(value.type == fpta_null))
+    return FPTA_EVALUE;
+
+  /* Значение проверяется и преобразуется так же, как в fpta_upsert_column(),
+   * но в поле временного кортежа, копия которого затем добавляется в строку
+   * ещё одним полем колонки. */
+  const size_t data_bytes =
+      (value.type >= fpta_string && value.type <= fpta_shoved)
+          ? value.binary_length + sizeof(uint64_t)
+          : 256 / 8;
+  const size_t bytes = fptu_space(1, data_bytes);
+  uint64_t inplace[64];
+  void *const buffer = (bytes > sizeof(inplace)) ? malloc(bytes) : inplace;
+  if (unlikely(buffer == nullptr))
+    return FPTA_ENOMEM;
+
+  fptu_rw *scratch = fptu_init(buffer, bytes, 1);
+  if (unlikely(scratch == nullptr)) {
+    rc = FPTA_EOOPS;
+    goto bailout;
+  }
+
+  rc = fpta_upsert_value(scratch, colnum, column_id->shove, value, false);
+  if (likely(rc == FPTA_SUCCESS)) {
+    const fptu_field *pf = fptu::lookup(fptu_take_noshrink(scratch), colnum,
+                                        fpta_shove2type(column_id->shove));
+    rc = pf ? fpta_covering_copy(pt, pf) : (int)FPTA_EOOPS;
+  }
+
+bailout:
+  if (buffer != inplace)
+    free(buffer);
+  return rc;
+}
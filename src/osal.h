@@ -19,6 +19,9 @@
 #include "fast_positive/config.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined(_MSC_VER) && defined(_ASSERTE)
 #undef assert
 #define assert _ASSERTE
@@ -38,7 +41,12 @@
 /* Threads */
 
 #ifdef CMAKE_HAVE_PTHREAD_H
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+static void __inline fpta_yield(void) { sched_yield(); }
 
 typedef struct fpta_rwl {
   pthread_rwlock_t prwl;
@@ -88,6 +96,68 @@ static int __inline fpta_mutex_destroy(fpta_mutex_t *mutex) {
   return pthread_mutex_destroy(&mutex->ptmx);
 }
 
+typedef struct fpta_cond {
+  pthread_cond_t ptcv;
+} fpta_cond_t;
+
+static int __inline fpta_cond_init(fpta_cond_t *cond) {
+  return pthread_cond_init(&cond->ptcv, NULL);
+}
+
+static int __inline fpta_cond_wait(fpta_cond_t *cond, fpta_mutex_t *mutex) {
+  return pthread_cond_wait(&cond->ptcv, &mutex->ptmx);
+}
+
+static int __inline fpta_cond_broadcast(fpta_cond_t *cond) {
+  return pthread_cond_broadcast(&cond->ptcv);
+}
+
+static int __inline fpta_cond_timedwait(fpta_cond_t *cond,
+                                        fpta_mutex_t *mutex,
+                                        unsigned timeout_ms) {
+  struct timespec abstime;
+  int rc = clock_gettime(CLOCK_REALTIME, &abstime);
+  if (rc != 0)
+    return errno;
+  abstime.tv_sec += timeout_ms / 1000;
+  abstime.tv_nsec += (long)(timeout_ms % 1000) * 1000000l;
+  if (abstime.tv_nsec >= 1000000000l) {
+    abstime.tv_sec += 1;
+    abstime.tv_nsec -= 1000000000l;
+  }
+  return pthread_cond_timedwait(&cond->ptcv, &mutex->ptmx, &abstime);
+}
+
+static int __inline fpta_cond_destroy(fpta_cond_t *cond) {
+  return pthread_cond_destroy(&cond->ptcv);
+}
+
+typedef struct fpta_thread {
+  pthread_t ptid;
+} fpta_thread_t;
+
+static int __inline fpta_thread_create(fpta_thread_t *thread,
+                                       void *(*proc)(void *), void *arg) {
+  return pthread_create(&thread->ptid, NULL, proc, arg);
+}
+
+static int __inline fpta_thread_join(fpta_thread_t *thread) {
+  return pthread_join(thread->ptid, NULL);
+}
+
+static int __inline fpta_fseek(FILE *file, uint64_t offset) {
+  return fseeko(file, (off_t)offset, SEEK_SET) ? errno : 0;
+}
+
+static __inline void *fpta_aligned_calloc(size_t bytes, size_t alignment) {
+  void *ptr;
+  if (posix_memalign(&ptr, alignment, bytes) != 0)
+    return NULL;
+  return memset(ptr, 0, bytes);
+}
+
+static __inline void fpta_aligned_free(void *ptr) { free(ptr); }
+
 #else
 
 #ifdef _MSC_VER
@@ -112,6 +182,8 @@ static int __inline fpta_mutex_destroy(fpta_mutex_t *mutex) {
 #pragma warning(pop)
 #endif
 
+static void __inline fpta_yield(void) { SwitchToThread(); }
+
 enum fpta_rwl_state : ptrdiff_t {
   SRWL_FREE = (ptrdiff_t)0xF08EE00Fl,
   SRWL_RDLC = (ptrdiff_t)0xF0008D1Cl,
@@ -230,4 +302,243 @@ static int __inline fpta_mutex_destroy(fpta_mutex_t *mutex) {
   return FPTA_SUCCESS;
 }
 
+typedef struct fpta_cond {
+  CONDITION_VARIABLE cv;
+} fpta_cond_t;
+
+static int __inline fpta_cond_init(fpta_cond_t *cond) {
+  if (!cond)
+    return FPTA_EINVAL;
+  InitializeConditionVariable(&cond->cv);
+  return FPTA_SUCCESS;
+}
+
+static int __inline fpta_cond_wait(fpta_cond_t *cond, fpta_mutex_t *mutex) {
+  if (!cond || !mutex)
+    return FPTA_EINVAL;
+  return SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE)
+             ? FPTA_SUCCESS
+             : (int)GetLastError();
+}
+
+static int __inline fpta_cond_broadcast(fpta_cond_t *cond) {
+  if (!cond)
+    return FPTA_EINVAL;
+  WakeAllConditionVariable(&cond->cv);
+  return FPTA_SUCCESS;
+}
+
+static int __inline fpta_cond_timedwait(fpta_cond_t *cond,
+                                        fpta_mutex_t *mutex,
+                                        unsigned timeout_ms) {
+  if (!cond || !mutex)
+    return FPTA_EINVAL;
+  return SleepConditionVariableCS(&cond->cv, &mutex->cs, timeout_ms)
+             ? FPTA_SUCCESS
+             : (int)GetLastError() /* ERROR_TIMEOUT == FPTA_ETIMEDOUT */;
+}
+
+static int __inline fpta_cond_destroy(fpta_cond_t *cond) {
+  if (!cond)
+    return FPTA_EINVAL;
+  /* CONDITION_VARIABLE не требует освобождения */
+  return FPTA_SUCCESS;
+}
+
+typedef struct fpta_thread {
+  HANDLE handle;
+  void *(*proc)(void *);
+  void *arg;
+} fpta_thread_t;
+
+static DWORD WINAPI __fpta_thread_trampoline(LPVOID param) {
+  fpta_thread_t *thread = (fpta_thread_t *)param;
+  thread->proc(thread->arg);
+  return 0;
+}
+
+static int __inline fpta_thread_create(fpta_thread_t *thread,
+                                       void *(*proc)(void *), void *arg) {
+  if (!thread || !proc)
+    return FPTA_EINVAL;
+  thread->proc = proc;
+  thread->arg = arg;
+  thread->handle =
+      CreateThread(NULL, 0, __fpta_thread_trampoline, thread, 0, NULL);
+  return thread->handle ? FPTA_SUCCESS : (int)GetLastError();
+}
+
+static int __inline fpta_thread_join(fpta_thread_t *thread) {
+  if (!thread)
+    return FPTA_EINVAL;
+  if (WaitForSingleObject(thread->handle, INFINITE) != WAIT_OBJECT_0)
+    return (int)GetLastError();
+  CloseHandle(thread->handle);
+  thread->handle = NULL;
+  return FPTA_SUCCESS;
+}
+
+static int __inline fpta_fseek(FILE *file, uint64_t offset) {
+  return _fseeki64(file, (__int64)offset, SEEK_SET) ? errno : 0;
+}
+
+static __inline void *fpta_aligned_calloc(size_t bytes, size_t alignment) {
+  void *ptr = _aligned_malloc(bytes, alignment);
+  return ptr ? memset(ptr, 0, bytes) : NULL;
+}
+
+static __inline void fpta_aligned_free(void *ptr) { _aligned_free(ptr); }
+
 #endif /* CMAKE_HAVE_PTHREAD_H */
+
+/*----------------------------------------------------------------------------*/
+/* Разделяемая блокировка для редких писателей (aka big-reader lock).
+ *
+ * Читатели отмечаются в одном из распределенных по кэш-линиям счетчиков
+ * и не конкурируют между собой за общую кэш-линию. Писатель выставляет
+ * флажок и дожидается обнуления всех счетчиков, а для ожидания завершения
+ * писателя читатели используют штатную fpta_rwl_t.
+ *
+ * Писатель недолго ожидает обнуления счетчика уступая процессор, а затем
+ * засыпает на условной переменной. Читатель, обнуливший счетчик при
+ * выставленном флажке писателя, пробуждает его. Благодаря seq_cst-порядку
+ * операций над счетчиком и флажком либо писатель увидит нулевой счетчик,
+ * либо читатель увидит флажок, а захват мьютекса перед пробуждением
+ * исключает потерю сигнала.
+ *
+ * Структура содержит выравненные по кэш-линии поля, поэтому её владелец
+ * должен размещаться посредством fpta_aligned_calloc(). */
+
+#include <atomic>
+
+#define FPTA_BRWL_SHARDS 64
+#define FPTA_BRWL_SPINS 16
+
+typedef struct fpta_brwl {
+  struct alignas(64) shard {
+    std::atomic<intptr_t> readers;
+  } shards[FPTA_BRWL_SHARDS];
+  std::atomic<bool> writer;
+  fpta_rwl_t rwl;
+  fpta_mutex_t drain_mutex;
+  fpta_cond_t drain_cond;
+} fpta_brwl_t;
+
+static int __inline fpta_brwl_init(fpta_brwl_t *brwl) {
+  for (size_t i = 0; i < FPTA_BRWL_SHARDS; ++i)
+    brwl->shards[i].readers.store(0, std::memory_order_relaxed);
+  brwl->writer.store(false, std::memory_order_relaxed);
+  int rc = fpta_mutex_init(&brwl->drain_mutex);
+  if (rc != 0)
+    return rc;
+  rc = fpta_cond_init(&brwl->drain_cond);
+  if (rc != 0)
+    goto bailout_mutex;
+  rc = fpta_rwl_init(&brwl->rwl);
+  if (rc == 0)
+    return 0;
+
+  fpta_cond_destroy(&brwl->drain_cond);
+bailout_mutex:
+  fpta_mutex_destroy(&brwl->drain_mutex);
+  return rc;
+}
+
+/* Снимает отметку читателя и пробуждает ожидающего писателя,
+ * если счетчик обнулился. */
+static int __inline fpta_brwl_leave(fpta_brwl_t *brwl, unsigned shard) {
+  const intptr_t before =
+      brwl->shards[shard].readers.fetch_sub(1, std::memory_order_seq_cst);
+  assert(before > 0);
+  if (before > 1 || !brwl->writer.load(std::memory_order_seq_cst))
+    return 0;
+
+  int rc = fpta_mutex_lock(&brwl->drain_mutex);
+  if (rc != 0)
+    return rc;
+  rc = fpta_cond_broadcast(&brwl->drain_cond);
+  int err = fpta_mutex_unlock(&brwl->drain_mutex);
+  return rc ? rc : err;
+}
+
+static int __inline fpta_brwl_sharedlock(fpta_brwl_t *brwl, unsigned shard) {
+  assert(shard < FPTA_BRWL_SHARDS);
+  std::atomic<intptr_t> &readers = brwl->shards[shard].readers;
+  for (;;) {
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!brwl->writer.load(std::memory_order_seq_cst))
+      return 0;
+
+    /* писатель активен или ожидает, уступаем и ждем его завершения */
+    int rc = fpta_brwl_leave(brwl, shard);
+    if (rc != 0)
+      return rc;
+    rc = fpta_rwl_sharedlock(&brwl->rwl);
+    if (rc != 0)
+      return rc;
+    rc = fpta_rwl_unlock(&brwl->rwl);
+    if (rc != 0)
+      return rc;
+  }
+}
+
+/* Повторный захват разделяемой блокировки, которая уже удерживается тем же
+ * логическим читателем (например, из вспомогательного потока). Писатель не
+ * может получить блокировку до её освобождения, поэтому уступать ему не нужно
+ * и, более того, нельзя во избежание взаимоблокировки. */
+static int __inline fpta_brwl_sharedlock_nested(fpta_brwl_t *brwl,
+                                                unsigned shard) {
+  assert(shard < FPTA_BRWL_SHARDS);
+  brwl->shards[shard].readers.fetch_add(1, std::memory_order_seq_cst);
+  return 0;
+}
+
+static int __inline fpta_brwl_sharedunlock(fpta_brwl_t *brwl,
+                                           unsigned shard) {
+  assert(shard < FPTA_BRWL_SHARDS);
+  return fpta_brwl_leave(brwl, shard);
+}
+
+static int __inline fpta_brwl_exclusivelock(fpta_brwl_t *brwl) {
+  int rc = fpta_rwl_exclusivelock(&brwl->rwl);
+  if (rc != 0)
+    return rc;
+
+  brwl->writer.store(true, std::memory_order_seq_cst);
+  for (size_t i = 0; i < FPTA_BRWL_SHARDS; ++i) {
+    std::atomic<intptr_t> &readers = brwl->shards[i].readers;
+    for (unsigned spin = 0;
+         readers.load(std::memory_order_seq_cst) != 0 && spin < FPTA_BRWL_SPINS;
+         ++spin)
+      fpta_yield();
+    if (readers.load(std::memory_order_seq_cst) == 0)
+      continue;
+
+    rc = fpta_mutex_lock(&brwl->drain_mutex);
+    while (rc == 0 && readers.load(std::memory_order_seq_cst) != 0)
+      rc = fpta_cond_wait(&brwl->drain_cond, &brwl->drain_mutex);
+    int err = fpta_mutex_unlock(&brwl->drain_mutex);
+    if (rc == 0)
+      rc = err;
+    if (rc != 0) {
+      brwl->writer.store(false, std::memory_order_seq_cst);
+      fpta_rwl_unlock(&brwl->rwl);
+      return rc;
+    }
+  }
+  return 0;
+}
+
+static int __inline fpta_brwl_exclusiveunlock(fpta_brwl_t *brwl) {
+  brwl->writer.store(false, std::memory_order_seq_cst);
+  return fpta_rwl_unlock(&brwl->rwl);
+}
+
+static int __inline fpta_brwl_destroy(fpta_brwl_t *brwl) {
+  int rc = fpta_rwl_destroy(&brwl->rwl);
+  int err = fpta_cond_destroy(&brwl->drain_cond);
+  if (rc == 0)
+    rc = err;
+  err = fpta_mutex_destroy(&brwl->drain_mutex);
+  return rc ? rc : err;
+}
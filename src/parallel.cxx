@@ -0,0 +1,344 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+#include <string>
+#include <system_error>
+#include <thread>
+
+/* Параллельный просмотр выборки, см fpta_apply_visitor_parallel().
+ *
+ * Границы частей выбираются среди существующих ключей индекса: для каждой
+ * границы бинарным поиском подбирается ключ, количество строк до которого
+ * по оценке mdbx_estimate_range() составляет нужную долю выборки. Для такого
+ * поиска ключи отображаются на 64-битные числа с сохранением порядка (для
+ * строк и бинарных ключей используются первые 8 байт), поэтому ключи
+ * с длинным общим префиксом могут попасть в одну часть.
+ *
+ * Каждая часть обрабатывается отдельным курсором. Вспомогательные потоки
+ * используют собственные читающие транзакции и берут части на обработку
+ * только если их снимок БД совпадает со снимком исходной транзакции.
+ * Иначе (например, если между стартом исходной транзакции и потока была
+ * зафиксирована пишущая транзакция) поток завершается, а части остаются
+ * вызывающему потоку, который обрабатывает их в рамках исходной транзакции.
+ * Таким образом все строки выбираются из одного снимка. */
+
+struct fpta_parallel_part {
+  fpta_value from, to;
+  size_t count;
+};
+
+struct fpta_parallel_scan {
+  fpta_txn *txn;
+  fpta_name *column_id;
+  fpta_filter *filter;
+  fpta_cursor_options options;
+  int (*visitor)(const fptu_ro *row, void *context, void *arg);
+  void **contexts;
+  void *arg;
+  fpta_parallel_part *parts;
+  size_t parts_count;
+  std::atomic<size_t> next;
+  std::atomic<int> rc;
+};
+
+//----------------------------------------------------------------------------
+
+/* Позиционирует курсор на первый ключ не меньше заданного числом и оценивает
+ * количество строк от начала диапазона до этого ключа. */
+static int fpta_parallel_probe(fpta_cursor *cursor, MDBX_val *begin,
+                               unsigned dbi_flags, const MDBX_val &base,
+                               size_t prefix, uint64_t number,
+                               MDBX_val &found, ptrdiff_t &estimated) {
+  fpta_key probe;
+  fpta_index_ordinal2key(number, dbi_flags, base, prefix, probe);
+  found = probe.mdbx;
+  MDBX_val data;
+  int rc = mdbx_cursor_get(cursor->mdbx_cursor, &found, &data, MDBX_SET_RANGE);
+  if (rc == MDBX_NOTFOUND) {
+    found.iov_base = nullptr;
+    estimated = PTRDIFF_MAX;
+    return FPTA_SUCCESS;
+  }
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  return mdbx_estimate_range(cursor->txn->mdbx_txn, cursor->idx_handle, begin,
+                             nullptr, &found, nullptr, &estimated);
+}
+
+/* Подбирает до partitions - 1 ключей-границ, разделяющих диапазон курсора
+ * на части примерно равного размера. */
+static int fpta_parallel_split(fpta_cursor *cursor, size_t partitions,
+                               std::vector<std::string> &bounds) {
+  MDBX_txn *const txn = cursor->txn->mdbx_txn;
+  MDBX_val *const begin =
+      (cursor->seek_range_flags & fpta_cursor::need_cmp_range_from)
+          ? &cursor->range_from_key.mdbx
+          : nullptr;
+  MDBX_val *const end =
+      (cursor->seek_range_flags & fpta_cursor::need_cmp_range_to)
+          ? &cursor->range_to_key.mdbx
+          : nullptr;
+
+  ptrdiff_t total;
+  int rc = mdbx_estimate_range(txn, cursor->idx_handle, begin, nullptr, end,
+                               nullptr, &total);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  if (total < 2)
+    return FPTA_SUCCESS;
+  if (partitions > size_t(total))
+    partitions = size_t(total);
+
+  unsigned dbi_flags;
+  rc = mdbx_dbi_flags(txn, cursor->idx_handle, &dbi_flags);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  MDBX_val key, data;
+  if (begin) {
+    key = *begin;
+    rc = mdbx_cursor_get(cursor->mdbx_cursor, &key, &data, MDBX_SET_RANGE);
+  } else
+    rc = mdbx_cursor_get(cursor->mdbx_cursor, &key, &data, MDBX_FIRST);
+  if (rc == MDBX_NOTFOUND)
+    return FPTA_SUCCESS;
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+  std::string prev(static_cast<const char *>(key.iov_base), key.iov_len);
+
+  rc = MDBX_NOTFOUND;
+  if (end) {
+    key = *end;
+    rc = mdbx_cursor_get(cursor->mdbx_cursor, &key, &data, MDBX_SET_RANGE);
+    if (rc == MDBX_SUCCESS)
+      rc = mdbx_cursor_get(cursor->mdbx_cursor, &key, &data, MDBX_PREV);
+  }
+  if (rc == MDBX_NOTFOUND)
+    rc = mdbx_cursor_get(cursor->mdbx_cursor, &key, &data, MDBX_LAST);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return rc;
+
+  /* общий префикс крайних ключей не влияет на порядок внутри диапазона */
+  const std::string tail(static_cast<const char *>(key.iov_base), key.iov_len);
+  const MDBX_val first = {const_cast<char *>(prev.data()), prev.size()};
+  const MDBX_val base = {const_cast<char *>(tail.data()), tail.size()};
+  const size_t prefix = fpta_index_ordinal_prefix(first, base, dbi_flags);
+  uint64_t lo = fpta_index_key2ordinal(first, dbi_flags, prefix);
+  const uint64_t hi = fpta_index_key2ordinal(base, dbi_flags, prefix);
+
+  for (size_t i = 1; i < partitions; ++i) {
+    const ptrdiff_t target = ptrdiff_t(total * i / partitions);
+    MDBX_val found;
+    ptrdiff_t estimated;
+    for (uint64_t upper = hi; lo < upper;) {
+      const uint64_t middle = lo + (upper - lo) / 2;
+      rc = fpta_parallel_probe(cursor, begin, dbi_flags, base, prefix, middle,
+                               found, estimated);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      if (estimated < target)
+        lo = middle + 1;
+      else
+        upper = middle;
+    }
+
+    rc = fpta_parallel_probe(cursor, begin, dbi_flags, base, prefix, lo, found,
+                             estimated);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    if (!found.iov_base ||
+        (end && mdbx_cmp(txn, cursor->idx_handle, &found, end) >= 0))
+      break;
+
+    const MDBX_val last = {const_cast<char *>(prev.data()), prev.size()};
+    if (mdbx_cmp(txn, cursor->idx_handle, &found, &last) <= 0)
+      /* ключи с общим префиксом неразличимы для поиска, объединяем части */
+      continue;
+    prev.assign(static_cast<const char *>(found.iov_base), found.iov_len);
+    bounds.push_back(prev);
+  }
+
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+static int fpta_parallel_visit(fpta_parallel_scan *scan, fpta_txn *txn,
+                               size_t i) {
+  fpta_parallel_part &part = scan->parts[i];
+  fpta_cursor_storage storage;
+  fpta_cursor *cursor = nullptr;
+  int rc = fpta_cursor_open_external(txn, scan->column_id, part.from, part.to,
+                                     scan->filter, scan->options, &storage,
+                                     &cursor);
+
+  while (likely(rc == FPTA_SUCCESS) &&
+         likely(scan->rc.load(std::memory_order_relaxed) == FPTA_SUCCESS)) {
+    fptu_ro row;
+    rc = fpta_cursor_get(cursor, &row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      break;
+    rc = scan->visitor(&row, scan->contexts[i], scan->arg);
+    if (unlikely(rc != FPTA_SUCCESS))
+      break;
+    part.count += 1;
+    rc = fpta_cursor_move(cursor, fpta_next);
+  }
+
+  if (cursor) {
+    int err = fpta_cursor_close(cursor);
+    assert(err == FPTA_SUCCESS);
+    if (unlikely(err != FPTA_SUCCESS) && (rc == FPTA_NODATA))
+      rc = err;
+  }
+  if (rc == FPTA_NODATA)
+    rc = FPTA_SUCCESS;
+  return rc;
+}
+
+static void fpta_parallel_loop(fpta_parallel_scan *scan, fpta_txn *txn) {
+  for (;;) {
+    const size_t i = scan->next.fetch_add(1, std::memory_order_relaxed);
+    if (i >= scan->parts_count ||
+        scan->rc.load(std::memory_order_relaxed) != FPTA_SUCCESS)
+      return;
+
+    int rc = fpta_parallel_visit(scan, txn, i);
+    if (unlikely(rc != FPTA_SUCCESS)) {
+      int expected = FPTA_SUCCESS;
+      scan->rc.compare_exchange_strong(expected, rc);
+      return;
+    }
+  }
+}
+
+static void fpta_parallel_worker(fpta_parallel_scan *scan) {
+  fpta_txn *sibling;
+  int rc = fpta_transaction_sibling(scan->txn, &sibling);
+  if (unlikely(rc != FPTA_SUCCESS))
+    /* части будут обработаны вызывающим потоком */
+    return;
+
+  if (likely(sibling->db_version == scan->txn->db_version))
+    fpta_parallel_loop(scan, sibling);
+
+  rc = fpta_transaction_end(sibling, false);
+  assert(rc == FPTA_SUCCESS);
+  (void)rc;
+}
+
+//----------------------------------------------------------------------------
+
+int fpta_apply_visitor_parallel(
+    fpta_txn *txn, fpta_name *column_id, fpta_value range_from,
+    fpta_value range_to, fpta_filter *filter, fpta_cursor_options op,
+    unsigned partitions, void **partition_contexts, size_t *count,
+    int (*visitor)(const fptu_ro *row, void *context, void *arg),
+    int (*combiner)(void *result, void *context, void *arg), void *result,
+    void *arg) {
+
+  if (unlikely(partitions < 1 || partitions > fpta_parallel_partitions_max ||
+               !partition_contexts || !visitor || !combiner))
+    return FPTA_EINVAL;
+
+  /* курсор открывается для проверки аргументов и подбора границ частей */
+  fpta_cursor_storage storage;
+  fpta_cursor *cursor = nullptr;
+  int rc = fpta_cursor_open_external(
+      txn, column_id, range_from, range_to, filter,
+      (fpta_cursor_options)(op | fpta_dont_fetch), &storage, &cursor);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  std::vector<std::string> bounds;
+  if (partitions > 1 && fpta_index_is_ordered(cursor->index_shove()) &&
+      (cursor->options & fpta_zeroed_range_is_point) == 0)
+    rc = fpta_parallel_split(cursor, partitions, bounds);
+
+  std::vector<fpta_parallel_part> parts(bounds.size() + 1);
+  parts.front().from = range_from;
+  parts.back().to = range_to;
+  for (size_t i = 0; rc == FPTA_SUCCESS && i < bounds.size(); ++i) {
+    const MDBX_val key = {const_cast<char *>(bounds[i].data()),
+                          bounds[i].size()};
+    rc = fpta_index_key2value(
+        cursor->index_shove(), key, parts[i + 1].from,
+        cursor->table_schema()->key_limit(cursor->column_number));
+    parts[i].to = parts[i + 1].from;
+  }
+
+  int err = fpta_cursor_close(cursor);
+  assert(err == FPTA_SUCCESS);
+  if (unlikely(err != FPTA_SUCCESS) && rc == FPTA_SUCCESS)
+    rc = err;
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+
+  fpta_parallel_scan scan;
+  scan.txn = txn;
+  scan.column_id = column_id;
+  scan.filter = filter;
+  scan.options = (fpta_cursor_options)(op & ~fpta_dont_fetch);
+  scan.visitor = visitor;
+  scan.contexts = partition_contexts;
+  scan.arg = arg;
+  scan.parts = parts.data();
+  scan.parts_count = parts.size();
+  scan.next.store(0, std::memory_order_relaxed);
+  scan.rc.store(FPTA_SUCCESS, std::memory_order_relaxed);
+  for (auto &part : parts)
+    part.count = 0;
+
+  /* изменения пишущей транзакции видны только ей самой */
+  std::vector<std::thread> workers;
+  if (txn->level == fpta_read && parts.size() > 1) {
+    /* хотя бы один вспомогательный поток даже на одном ядре, так как
+     * просмотр часто упирается в чтение страниц БД с диска */
+    const size_t cores = std::thread::hardware_concurrency();
+    const size_t limit = std::min(parts.size(), std::max(cores, size_t(2))) - 1;
+    workers.reserve(limit);
+    for (size_t i = 0; i < limit; ++i) {
+      try {
+        workers.emplace_back(fpta_parallel_worker, &scan);
+      } catch (const std::system_error &) {
+        /* оставшиеся части обработает вызывающий поток */
+        break;
+      }
+    }
+  }
+
+  fpta_parallel_loop(&scan, txn);
+  for (auto &worker : workers)
+    worker.join();
+
+  rc = scan.rc.load(std::memory_order_relaxed);
+  size_t total = 0;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    total += parts[i].count;
+    if (rc != FPTA_SUCCESS)
+      continue;
+    const size_t n = fpta_cursor_is_descending(op) ? parts.size() - 1 - i : i;
+    rc = combiner(result, partition_contexts[n], arg);
+  }
+
+  if (count)
+    *count = total;
+  return rc;
+}
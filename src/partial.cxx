@@ -0,0 +1,295 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "details.h"
+
+/* Частичные (фильтрованные) вторичные индексы.
+ *
+ * К вторичному индексу может быть привязан предикат из узлов fpta_filter,
+ * сравнивающих колонки с константами. Во вторичную таблицу попадают только
+ * строки удовлетворяющие предикату, что уменьшает её объем и стоимость
+ * обновлений для "разреженных" выборок.
+ *
+ * Предикат хранится в схеме в виде префиксной записи (см. описание
+ * fpta_partial_layout) и раскодируется в узлы fpta_filter при загрузке
+ * схемы, что позволяет проверять вхождение строки посредством
+ * fpta_filter_match(). Функторы (fncol и fnrow) не могут быть сохранены
+ * в схеме и поэтому не допускаются. */
+
+static cxx11_constexpr bool fpta_partial_node_valid(int type) {
+  return type == fpta_node_not || type == fpta_node_or ||
+         type == fpta_node_and || type == fpta_node_lt ||
+         type == fpta_node_gt || type == fpta_node_le || type == fpta_node_ge ||
+         type == fpta_node_eq || type == fpta_node_ne;
+}
+
+static size_t fpta_partial_value_bytes(const fpta_value &value) {
+  switch (value.type) {
+  case fpta_null:
+    return 0;
+  case fpta_signed_int:
+  case fpta_unsigned_int:
+  case fpta_datetime:
+  case fpta_float_point:
+    return sizeof(value.uint);
+  default:
+    return value.binary_length;
+  }
+}
+
+int __cold fpta_partial_predicate_decode(
+    fpta_table_schema::composite_iter_t &scan,
+    const fpta_table_schema::composite_iter_t end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    fpta_partial_arena &arena, const fpta_filter **result) {
+  if (unlikely(scan >= end))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const int type = (int16_t)*scan;
+  if (unlikely(!fpta_partial_node_valid(type)))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  fpta_filter *const node =
+      arena.nodes ? &arena.nodes[arena.nodes_used] : nullptr;
+  arena.nodes_used += 1;
+  if (node) {
+    node->type = (fpta_filter_bits)type;
+    *result = node;
+  }
+
+  switch (type) {
+  case fpta_node_not:
+    ++scan;
+    return fpta_partial_predicate_decode(
+        scan, end, columns_shoves, column_count, arena,
+        node ? (const fpta_filter **)&node->node_not : nullptr);
+
+  case fpta_node_or:
+  case fpta_node_and: {
+    ++scan;
+    int rc = fpta_partial_predicate_decode(
+        scan, end, columns_shoves, column_count, arena,
+        node ? (const fpta_filter **)&node->node_and.a : nullptr);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    return fpta_partial_predicate_decode(
+        scan, end, columns_shoves, column_count, arena,
+        node ? (const fpta_filter **)&node->node_and.b : nullptr);
+  }
+
+  default:
+    break;
+  }
+
+  if (unlikely(end - scan < fpta_partial_cmp_header))
+    return FPTA_SCHEMA_CORRUPTED;
+  const size_t column = scan[1];
+  const fpta_value_type value_type = (fpta_value_type)scan[2];
+  const size_t length = scan[3];
+  const auto data = scan + fpta_partial_cmp_header;
+  if (unlikely(column >= column_count || value_type >= fpta_shoved ||
+               data + (length + 1) / 2 > end))
+    return FPTA_SCHEMA_CORRUPTED;
+  if (unlikely(fpta_shove2type(columns_shoves[column]) ==
+               /* composite */ fptu_null))
+    return FPTA_ETYPE;
+
+  fpta_value value;
+  value.type = value_type;
+  value.binary_length = (unsigned)length;
+  if (unlikely(fpta_partial_value_bytes(value) != length))
+    return FPTA_SCHEMA_CORRUPTED;
+  scan = data + (length + 1) / 2;
+
+  fpta_name *const name =
+      arena.names ? &arena.names[arena.names_used] : nullptr;
+  arena.names_used += 1;
+  if (node) {
+    assert(name != nullptr);
+    memset(name, 0, sizeof(fpta_name));
+    name->shove = columns_shoves[column];
+    name->column.num = (unsigned)column;
+    node->node_cmp.left_id = name;
+
+    switch (value_type) {
+    case fpta_null:
+      value.binary_data = nullptr;
+      break;
+    case fpta_string:
+    case fpta_binary:
+      /* константа остается в копии схемы, на которую и ссылается узел */
+      value.binary_data = (void *)data;
+      break;
+    default:
+      memcpy(&value.uint, data, sizeof(value.uint));
+      break;
+    }
+    node->node_cmp.right_value = value;
+  }
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_partial_index_validate(
+    const size_t index_column,
+    const fpta_table_schema::composite_item_t *const items_begin,
+    const fpta_table_schema::composite_item_t *const items_end,
+    const fpta_shove_t *const columns_shoves, const size_t column_count,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  if (unlikely(index_column >= column_count))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  const fpta_shove_t index_shove = columns_shoves[index_column];
+  if (unlikely(!fpta_is_indexed(index_shove) ||
+               !fpta_index_is_secondary(index_shove)))
+    return FPTA_EFLAG;
+
+  fpta_table_schema::composite_iter_t scan = items_begin;
+  fpta_partial_arena counter = {nullptr, nullptr, 0, 0};
+  int rc = fpta_partial_predicate_decode(scan, items_end, columns_shoves,
+                                         column_count, counter, nullptr);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (unlikely(scan != items_end))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  /* для индекса допускается только один предикат */
+  for (auto record = records_begin; record < records_end;
+       record += fpta_table_schema::record_length(*record)) {
+    if (unlikely(!(*record & fpta_table_schema::record_kind_mask)))
+      return FPTA_SCHEMA_CORRUPTED;
+    if ((*record & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::partial_mark &&
+        record[1] == index_column)
+      return FPTA_EEXIST;
+  }
+
+  return FPTA_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+
+static int fpta_partial_encode(
+    const fpta_filter *node, const fpta_column_set *column_set,
+    std::vector<fpta_table_schema::composite_item_t> &words) {
+  if (unlikely(node == nullptr))
+    return FPTA_EINVAL;
+
+  switch (node->type) {
+  default:
+    /* функторы не могут быть сохранены в схеме */
+    return FPTA_EINVAL;
+
+  case fpta_node_not:
+    words.push_back((fpta_table_schema::composite_item_t)node->type);
+    return fpta_partial_encode(node->node_not, column_set, words);
+
+  case fpta_node_or:
+  case fpta_node_and: {
+    words.push_back((fpta_table_schema::composite_item_t)node->type);
+    int rc = fpta_partial_encode(node->node_and.a, column_set, words);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+    return fpta_partial_encode(node->node_and.b, column_set, words);
+  }
+
+  case fpta_node_lt:
+  case fpta_node_gt:
+  case fpta_node_le:
+  case fpta_node_ge:
+  case fpta_node_eq:
+  case fpta_node_ne:
+    break;
+  }
+
+  if (unlikely(node->node_cmp.left_id == nullptr))
+    return FPTA_EINVAL;
+
+  size_t column = 0;
+  for (;; ++column) {
+    if (column == column_set->count)
+      return FPTA_COLUMN_MISSING;
+    const fpta_shove_t column_shove = column_set->shoves[column];
+    if (column_shove == 0 && column == 0)
+      /* zero slot is empty while PK undefined */
+      continue;
+    if (fpta_shove_eq(column_shove, node->node_cmp.left_id->shove))
+      break;
+  }
+  if (unlikely(fpta_shove2type(column_set->shoves[column]) ==
+               /* composite */ fptu_null))
+    return FPTA_ETYPE;
+
+  const fpta_value &value = node->node_cmp.right_value;
+  if (unlikely(value.type >= fpta_shoved))
+    return FPTA_ETYPE;
+  const size_t length = fpta_partial_value_bytes(value);
+  if (unlikely(length > fpta_max_cols * sizeof(words[0])))
+    return FPTA_TOOMANY;
+
+  const uint8_t *const data =
+      (value.type == fpta_string || value.type == fpta_binary)
+          ? (const uint8_t *)value.binary_data
+          : (const uint8_t *)&value.uint;
+  if (unlikely(length > 0 && data == nullptr))
+    return FPTA_EINVAL;
+
+  words.push_back((fpta_table_schema::composite_item_t)node->type);
+  words.push_back((fpta_table_schema::composite_item_t)column);
+  words.push_back((fpta_table_schema::composite_item_t)value.type);
+  words.push_back((fpta_table_schema::composite_item_t)length);
+  const size_t offset = words.size();
+  words.resize(offset + (length + 1) / 2, 0);
+  if (length)
+    memcpy(&words[offset], data, length);
+  return FPTA_SUCCESS;
+}
+
+int __cold fpta_describe_partial_index(const char *index_name,
+                                       fpta_column_set *column_set,
+                                       const fpta_filter *predicate) {
+  if (unlikely(column_set == nullptr || predicate == nullptr))
+    return FPTA_EINVAL;
+
+  size_t index_column;
+  int rc = fpta_column_set_lookup(column_set, index_name, index_column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  std::vector<fpta_table_schema::composite_item_t> words;
+  rc = fpta_partial_encode(predicate, column_set, words);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* записи частичных индексов следуют за списками составных колонок,
+   * вместе с записями покрывающих индексов */
+  fpta_table_schema::composite_item_t *records, *tail;
+  rc = fpta_column_set_records(column_set, records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  rc = fpta_partial_index_validate(index_column, words.data(),
+                                   words.data() + words.size(),
+                                   column_set->shoves, column_set->count,
+                                   records, tail);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  return fpta_column_set_append(column_set, tail,
+                                fpta_table_schema::partial_mark, index_column,
+                                words.data(), words.size());
+}
@@ -315,6 +315,17 @@ static cxx14_constexpr bool shove_index_compare(const fpta_shove_t &left,
   return left_prio < rigth_prio || (left_prio == rigth_prio && left < right);
 }
 
+/* Порядок колонок в хранимой схеме. Не-индексируемые nullable колонки
+ * могут добавляться в конец списка без перенумерации остальных (см.
+ * fpta_column_add), поэтому их взаимный порядок не проверяется. */
+static cxx14_constexpr bool shove_layout_compare(const fpta_shove_t &left,
+                                                 const fpta_shove_t &right) {
+  const auto left_prio = index2prio(left);
+  const auto rigth_prio = index2prio(right);
+  return left_prio < rigth_prio ||
+         (left_prio == rigth_prio && left_prio < 3 && left < right);
+}
+
 //----------------------------------------------------------------------------
 
 static size_t fpta_schema_stored_size(fpta_column_set *column_set,
@@ -338,7 +349,7 @@ static void fpta_schema_free(fpta_table_schema *def) {
   }
 }
 
-static int fpta_schema_clone(const fpta_shove_t schema_key,
+static int fpta_schema_clone(const fpta_db *db, const fpta_shove_t schema_key,
                              const MDBX_val &schema_data,
                              fpta_table_schema **ptrdef) {
   assert(ptrdef != nullptr);
@@ -349,7 +360,7 @@ static int fpta_schema_clone(const fpta_shove_t schema_key,
   const size_t bytes =
       sizeof(fpta_table_schema) - sizeof(fpta_table_stored_schema::columns) +
       payload_size +
-      stored->count * sizeof(fpta_table_schema::composite_item_t);
+      stored->count * sizeof(fpta_table_schema::composite_item_t) * 2;
 
   fpta_table_schema *schema = (fpta_table_schema *)realloc(*ptrdef, bytes);
   if (unlikely(schema == nullptr))
@@ -360,9 +371,22 @@ static int fpta_schema_clone(const fpta_shove_t schema_key,
   memcpy(&schema->_stored, schema_data.iov_base, schema_data.iov_len);
   fpta_table_schema::composite_item_t *const offsets =
       (fpta_table_schema::composite_item_t *)((uint8_t *)schema + bytes) -
-      schema->_stored.count;
+      schema->_stored.count * 2;
+  fpta_table_schema::composite_item_t *const covering_offsets =
+      offsets + schema->_stored.count;
   schema->_key = schema_key;
   schema->_composite_offsets = offsets;
+  schema->_covering_offsets = covering_offsets;
+  schema->_partial_predicates = nullptr;
+  schema->_expressions = nullptr;
+  schema->_expressions_db = db;
+  schema->_key_limits = nullptr;
+  schema->_dropped = nullptr;
+  schema->_building = nullptr;
+  schema->_index_span = 1;
+  schema->_bloom = nullptr;
+  schema->_bitmap = nullptr;
+  schema->_multivalued = nullptr;
 
   const auto composites_begin =
       (const fpta_table_schema::composite_item_t *)&schema->_stored
@@ -372,7 +396,8 @@ static int fpta_schema_clone(const fpta_shove_t schema_key,
   for (size_t i = 0; i < schema->_stored.count; ++i) {
     const fpta_shove_t column_shove = schema->_stored.columns[i];
     if (!fpta_is_indexed(column_shove))
-      break;
+      continue;
+    schema->_index_span = unsigned(i + 1);
     if (!fpta_is_composite(column_shove))
       continue;
     if (unlikely(composites >= composites_end || *composites == 0))
@@ -388,6 +413,218 @@ static int fpta_schema_clone(const fpta_shove_t schema_key,
     offsets[i] = (fpta_table_schema::composite_item_t)distance;
     composites = last;
   }
+
+  /* записи покрывающих, частичных индексов и свойств колонок следуют
+   * за списками составных, для остальных колонок смещения остаются
+   * равными record_none */
+  const auto records_begin = composites;
+  fpta_partial_arena arena = {nullptr, nullptr, 0, 0};
+  size_t expressions = 0, key_limits = 0, dropped = 0, building = 0,
+         bloom = 0, bitmap = 0, multivalued = 0;
+  while (composites < composites_end &&
+         (*composites & fpta_table_schema::record_kind_mask)) {
+    const auto last =
+        composites + fpta_table_schema::record_length(*composites);
+    if (unlikely(last > composites_end ||
+                 composites[1] >= schema->_stored.count))
+      return FPTA_EOOPS;
+
+    switch (*composites & fpta_table_schema::record_kind_mask) {
+    case fpta_table_schema::partial_mark: {
+      /* пока только подсчитываем требуемое для предикатов место */
+      fpta_table_schema::composite_iter_t scan = composites + 2;
+      int rc = fpta_partial_predicate_decode(
+          scan, last, schema->_stored.columns, schema->_stored.count, arena,
+          nullptr);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+    } break;
+    case fpta_table_schema::option_mark:
+      if (unlikely(last == composites + 2))
+        return FPTA_SCHEMA_CORRUPTED;
+      if (composites[2] == fpta_table_schema::option_expression)
+        expressions += 1;
+      else if (composites[2] == fpta_table_schema::option_keylen)
+        key_limits += 1;
+      else if (composites[2] == fpta_table_schema::option_building)
+        building += 1;
+      else if (composites[2] == fpta_table_schema::option_dropped)
+        dropped += 1;
+      else if (composites[2] == fpta_table_schema::option_bloom)
+        bloom += 1;
+      else if (composites[2] == fpta_table_schema::option_bitmap)
+        bitmap += 1;
+      else if (composites[2] == fpta_table_schema::option_multivalued)
+        multivalued += 1;
+      break;
+    default: {
+      const ptrdiff_t distance = composites - composites_begin;
+      assert(distance >= 0 && distance < fpta_max_cols * 2);
+      covering_offsets[composites[1]] =
+          (fpta_table_schema::composite_item_t)distance;
+    }
+    }
+    composites = last;
+  }
+  /* расширенная сигнатура также требуется при добавленных в конец колонках
+   * и нарушенном после изменения индексов порядке колонок, когда
+   * дополнительных записей может не быть */
+  if (unlikely(composites != records_begin &&
+               schema->signature() != FTPA_SCHEMA_SIGNATURE_EXTENDED))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  if (arena.nodes_used == 0 && expressions == 0 && key_limits == 0 &&
+      dropped == 0 && building == 0 && bloom == 0 && bitmap == 0 &&
+      multivalued == 0)
+    return FPTA_SUCCESS;
+
+  /* Предикаты частичных индексов раскодируются в узлы fpta_filter,
+   * размещаемые после смещений вместе с массивом указателей на них,
+   * а за ними следуют привязки колонок-выражений, лимиты длины ключей,
+   * признаки удаленных колонок и заполняемых индексов, параметры фильтров
+   * Блума и признаки битовых и многозначных индексов. */
+  const size_t count = schema->_stored.count;
+  const ptrdiff_t records_offset = records_begin - composites_begin;
+  const size_t predicates_offset = FPT_ALIGN_CEIL(bytes, sizeof(uint64_t));
+  const size_t expressions_offset =
+      predicates_offset +
+      (arena.nodes_used ? count * sizeof(const fpta_filter *) +
+                              arena.nodes_used * sizeof(fpta_filter) +
+                              arena.names_used * sizeof(fpta_name)
+                        : 0);
+  const size_t key_limits_offset =
+      expressions_offset + (expressions ? count * sizeof(fpta_shove_t) : 0);
+  const size_t dropped_offset =
+      key_limits_offset +
+      (key_limits ? count * sizeof(fpta_table_schema::composite_item_t) : 0);
+  const size_t building_offset =
+      dropped_offset + (dropped ? count * sizeof(bool) : 0);
+  const size_t bloom_offset =
+      building_offset + (building ? count * sizeof(bool) : 0);
+  const size_t bitmap_offset =
+      bloom_offset + (bloom ? count * sizeof(uint8_t) : 0);
+  const size_t multivalued_offset =
+      bitmap_offset + (bitmap ? count * sizeof(bool) : 0);
+  const size_t extended_bytes =
+      multivalued_offset + (multivalued ? count * sizeof(bool) : 0);
+  schema = (fpta_table_schema *)realloc(schema, extended_bytes);
+  if (unlikely(schema == nullptr))
+    return FPTA_ENOMEM;
+
+  *ptrdef = schema;
+  schema->_composite_offsets =
+      (fpta_table_schema::composite_item_t *)((uint8_t *)schema + bytes) -
+      count * 2;
+  schema->_covering_offsets = schema->_composite_offsets + count;
+  const fpta_filter **const predicates =
+      (const fpta_filter **)((uint8_t *)schema + predicates_offset);
+  if (arena.nodes_used) {
+    std::fill(predicates, predicates + count, nullptr);
+    arena.nodes = (fpta_filter *)(predicates + count);
+    arena.names = (fpta_name *)(arena.nodes + arena.nodes_used);
+    arena.nodes_used = arena.names_used = 0;
+  }
+  fpta_shove_t *const functions =
+      (fpta_shove_t *)((uint8_t *)schema + expressions_offset);
+  if (expressions)
+    std::fill(functions, functions + count, 0);
+  fpta_table_schema::composite_item_t *const limits =
+      (fpta_table_schema::composite_item_t *)((uint8_t *)schema +
+                                              key_limits_offset);
+  if (key_limits)
+    std::fill(limits, limits + count,
+              (fpta_table_schema::composite_item_t)fpta_max_keylen);
+  bool *const building_flags = (bool *)((uint8_t *)schema + building_offset);
+  if (building)
+    std::fill(building_flags, building_flags + count, false);
+  bool *const dropped_flags = (bool *)((uint8_t *)schema + dropped_offset);
+  if (dropped)
+    std::fill(dropped_flags, dropped_flags + count, false);
+  uint8_t *const bloom_bits = (uint8_t *)schema + bloom_offset;
+  if (bloom)
+    std::fill(bloom_bits, bloom_bits + count, uint8_t(0));
+  bool *const bitmap_flags = (bool *)((uint8_t *)schema + bitmap_offset);
+  if (bitmap)
+    std::fill(bitmap_flags, bitmap_flags + count, false);
+  bool *const multivalued_flags =
+      (bool *)((uint8_t *)schema + multivalued_offset);
+  if (multivalued)
+    std::fill(multivalued_flags, multivalued_flags + count, false);
+
+  for (composites = schema->composites_begin() + records_offset;
+       composites < schema->composites_end() &&
+       (*composites & fpta_table_schema::record_kind_mask);
+       composites += fpta_table_schema::record_length(*composites)) {
+    switch (*composites & fpta_table_schema::record_kind_mask) {
+    case fpta_table_schema::partial_mark: {
+      fpta_table_schema::composite_iter_t scan = composites + 2;
+      int rc = fpta_partial_predicate_decode(
+          scan,
+          composites + fpta_table_schema::record_length(*composites),
+          schema->_stored.columns, count, arena, &predicates[composites[1]]);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+    } break;
+    case fpta_table_schema::option_mark:
+      if (composites[2] == fpta_table_schema::option_expression) {
+        fpta_shove_t function;
+        if (unlikely(fpta_table_schema::record_length(*composites) !=
+                     3 + sizeof(function) / sizeof(*composites)))
+          return FPTA_SCHEMA_CORRUPTED;
+        memcpy(&function, composites + 3, sizeof(function));
+        if (unlikely(function == 0))
+          return FPTA_SCHEMA_CORRUPTED;
+        functions[composites[1]] = function;
+      } else if (composites[2] == fpta_table_schema::option_keylen) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 4 ||
+                     composites[3] <= fpta_max_keylen))
+          return FPTA_SCHEMA_CORRUPTED;
+        limits[composites[1]] = composites[3];
+      } else if (composites[2] == fpta_table_schema::option_building) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 3))
+          return FPTA_SCHEMA_CORRUPTED;
+        building_flags[composites[1]] = true;
+      } else if (composites[2] == fpta_table_schema::option_dropped) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 3))
+          return FPTA_SCHEMA_CORRUPTED;
+        dropped_flags[composites[1]] = true;
+      } else if (composites[2] == fpta_table_schema::option_bloom) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 4 ||
+                     composites[3] < fpta_bloom_bits_min ||
+                     composites[3] > fpta_bloom_bits_max))
+          return FPTA_SCHEMA_CORRUPTED;
+        bloom_bits[composites[1]] = (uint8_t)composites[3];
+      } else if (composites[2] == fpta_table_schema::option_bitmap) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 3))
+          return FPTA_SCHEMA_CORRUPTED;
+        bitmap_flags[composites[1]] = true;
+      } else if (composites[2] == fpta_table_schema::option_multivalued) {
+        if (unlikely(fpta_table_schema::record_length(*composites) != 3))
+          return FPTA_SCHEMA_CORRUPTED;
+        multivalued_flags[composites[1]] = true;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  if (arena.nodes_used)
+    schema->_partial_predicates = predicates;
+  if (expressions)
+    schema->_expressions = functions;
+  if (key_limits)
+    schema->_key_limits = limits;
+  if (building)
+    schema->_building = building_flags;
+  if (dropped)
+    schema->_dropped = dropped_flags;
+  if (bloom)
+    schema->_bloom = bloom_bits;
+  if (bitmap)
+    schema->_bitmap = bitmap_flags;
+  if (multivalued)
+    schema->_multivalued = multivalued_flags;
+
   return FPTA_SUCCESS;
 }
 
@@ -439,6 +676,20 @@ bool fpta_index_is_valid(const fpta_index_type index_type) {
   }
 }
 
+const fpta_table_schema::composite_item_t *fpta_column_option_lookup(
+    const size_t column, const fpta_table_schema::composite_item_t option,
+    const fpta_table_schema::composite_item_t *const records_begin,
+    const fpta_table_schema::composite_item_t *const records_end) {
+  for (auto record = records_begin; record < records_end;
+       record += fpta_table_schema::record_length(*record)) {
+    if ((*record & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::option_mark &&
+        record[1] == column && record[2] == option)
+      return record;
+  }
+  return nullptr;
+}
+
 static int fpta_columns_description_validate(
     const fpta_shove_t *shoves, size_t shoves_count,
     const fpta_table_schema::composite_item_t *const composites_begin,
@@ -517,6 +768,74 @@ static int fpta_columns_description_validate(
         return FPTA_EEXIST;
   }
 
+  /* записи покрывающих, частичных индексов и свойств колонок следуют
+   * за списками составных */
+  const auto records_begin = composites;
+  while (composites < composites_detent &&
+         (*composites & fpta_table_schema::record_kind_mask)) {
+    const auto first = composites + 2;
+    const auto last =
+        composites + fpta_table_schema::record_length(*composites);
+    if (unlikely(first > composites_detent || last > composites_detent))
+      return FPTA_SCHEMA_CORRUPTED;
+
+    int rc;
+    switch (*composites & fpta_table_schema::record_kind_mask) {
+    case fpta_table_schema::covering_mark:
+      rc = fpta_covering_index_validate(composites[1], first, last, shoves,
+                                        shoves_count, records_begin,
+                                        composites);
+      break;
+    case fpta_table_schema::partial_mark:
+      rc = fpta_partial_index_validate(composites[1], first, last, shoves,
+                                       shoves_count, records_begin,
+                                       composites);
+      break;
+    case fpta_table_schema::option_mark:
+      rc = FPTA_SCHEMA_CORRUPTED;
+      if (first[0] == fpta_table_schema::option_expression &&
+          last - first == 1 + sizeof(fpta_shove_t) / sizeof(*first))
+        rc = fpta_expression_column_validate(composites[1], shoves,
+                                             shoves_count, records_begin,
+                                             composites);
+      else if (first[0] == fpta_table_schema::option_keylen &&
+               last - first == 2)
+        rc = fpta_index_keylen_validate(composites[1], first[1], shoves,
+                                        shoves_count, records_begin,
+                                        composites);
+      else if (first[0] == fpta_table_schema::option_building &&
+               last - first == 1)
+        rc = fpta_index_building_validate(composites[1], shoves,
+                                          shoves_count, records_begin,
+                                          composites);
+      else if (first[0] == fpta_table_schema::option_dropped &&
+               last - first == 1)
+        rc = fpta_column_dropped_validate(composites[1], shoves, shoves_count,
+                                          records_begin, composites);
+      else if (first[0] == fpta_table_schema::option_bloom &&
+               last - first == 2)
+        rc = fpta_index_bloom_validate(composites[1], first[1], shoves,
+                                       shoves_count, records_begin,
+                                       composites);
+      else if (first[0] == fpta_table_schema::option_bitmap &&
+               last - first == 1)
+        rc = fpta_index_bitmap_validate(composites[1], shoves, shoves_count,
+                                        records_begin, composites_detent,
+                                        composites);
+      else if (first[0] == fpta_table_schema::option_multivalued &&
+               last - first == 1)
+        rc = fpta_index_multivalued_validate(composites[1], shoves,
+                                             shoves_count, records_begin,
+                                             composites_detent, composites);
+      break;
+    default:
+      rc = FPTA_SCHEMA_CORRUPTED;
+    }
+    if (rc != FPTA_SUCCESS)
+      return rc;
+    composites = last;
+  }
+
   if (composites_eof)
     *composites_eof = composites;
 
@@ -577,6 +896,55 @@ static int fpta_column_set_sort(fpta_column_set *column_set) {
     }
   }
 
+  /* fixup coverings, partials and options,
+   * which are follows the composites */
+  const auto renumber = [&](size_t column_number) {
+    return std::distance(sorted.begin(),
+                         std::find(sorted.begin(), sorted.end(),
+                                   column_set->shoves[column_number]));
+  };
+  while (composites < FPT_ARRAY_END(column_set->composites) &&
+         (*composites & fpta_table_schema::record_kind_mask)) {
+    const auto first = composites + 1;
+    const auto last =
+        composites + fpta_table_schema::record_length(*composites);
+    if (unlikely(last > FPT_ARRAY_END(column_set->composites)))
+      return FPTA_SCHEMA_CORRUPTED;
+
+    fixup.push_back(*composites);
+    const size_t fixup_begin = fixup.size();
+    fixup.insert(fixup.end(), first, last);
+    composites = last;
+
+    bool failed = false;
+    const auto fix = [&](fpta_table_schema::composite_item_t &item) {
+      const auto renum = (item < column_set->count) ? renumber(item) : -1;
+      if (unlikely(renum < 0 || (unsigned)renum >= column_set->count))
+        failed = true;
+      else
+        item = static_cast<fpta_table_schema::composite_item_t>(renum);
+    };
+    fix(fixup[fixup_begin]);
+    switch (fixup[fixup_begin - 1] & fpta_table_schema::record_kind_mask) {
+    case fpta_table_schema::partial_mark:
+      /* в предикате перенумеровываются только ссылки на колонки */
+      if (unlikely(!fpta_partial_foreach_column(
+              fixup.data() + fixup_begin + 1, fixup.data() + fixup.size(),
+              fix)))
+        return FPTA_SCHEMA_CORRUPTED;
+      break;
+    case fpta_table_schema::option_mark:
+      /* за номером колонки следует вид и значение свойства */
+      break;
+    default:
+      std::for_each(fixup.begin() + fixup_begin + 1, fixup.end(), fix);
+    }
+    if (unlikely(failed))
+      return FPTA_SCHEMA_CORRUPTED;
+  }
+  if (unlikely(fixup.size() > fpta_max_cols))
+    return FPTA_TOOMANY;
+
   /* put sorted arrays */
   memset(column_set->shoves, 0, sizeof(column_set->shoves));
   memset(column_set->composites, 0, sizeof(column_set->composites));
@@ -661,7 +1029,7 @@ fpta_schema_image_validate(const fpta_shove_t schema_key,
 
   const fpta_table_stored_schema *schema =
       (const fpta_table_stored_schema *)schema_data.iov_base;
-  if (unlikely(schema->signature != FTPA_SCHEMA_SIGNATURE))
+  if (unlikely(!fpta_schema_signature_valid(schema->signature)))
     return nullptr;
 
   if (unlikely(schema->count < 1 || schema->count > fpta_max_cols))
@@ -694,9 +1062,12 @@ fpta_schema_image_validate(const fpta_shove_t schema_key,
           (const fpta_table_schema::composite_item_t *)composites_end))
     return nullptr;
 
-  if (!std::is_sorted(schema->columns, schema->columns + schema->count,
+  /* в расширенной схеме порядок колонок может быть произвольным, так как
+   * добавление и удаление вторичных индексов не меняет их номеров */
+  if (schema->signature != FTPA_SCHEMA_SIGNATURE_EXTENDED &&
+      !std::is_sorted(schema->columns, schema->columns + schema->count,
                       [](const fpta_shove_t &left, const fpta_shove_t &right) {
-                        return shove_index_compare(left, right);
+                        return shove_layout_compare(left, right);
                       }))
     return nullptr;
 
@@ -759,7 +1130,7 @@ static int fpta_schema_read(fpta_txn *txn, fpta_shove_t schema_key,
           !fpta_schema_image_validate(schema_key, schema_data, schema_dict)))
     return FPTA_SCHEMA_CORRUPTED;
 
-  return fpta_schema_clone(schema_key, schema_data, def);
+  return fpta_schema_clone(db, schema_key, schema_data, def);
 }
 
 //----------------------------------------------------------------------------
@@ -846,6 +1217,69 @@ int fpta_column_set_validate(fpta_column_set *column_set) {
       FPT_ARRAY_END(column_set->composites));
 }
 
+/* Ищет колонку по имени в описании таблицы. */
+int fpta_column_set_lookup(const fpta_column_set *column_set,
+                           const char *column_name, size_t &column) {
+  const fpta_shove_t shove = fpta_shove_name(column_name, fpta_column);
+  if (unlikely(!shove))
+    return FPTA_ENAME;
+
+  for (column = 0; column < column_set->count; ++column) {
+    const fpta_shove_t column_shove = column_set->shoves[column];
+    if (column_shove == 0 && column == 0)
+      /* zero slot is empty while PK undefined,
+       * skip it in such case */
+      continue;
+    if (fpta_shove_eq(column_shove, shove))
+      return FPTA_SUCCESS;
+  }
+  return FPTA_COLUMN_MISSING;
+}
+
+/* Находит в описании таблицы дополнительные записи, следующие за списками
+ * составных колонок, и конец занятой ими части. */
+int fpta_column_set_records(fpta_column_set *column_set,
+                            fpta_table_schema::composite_item_t *&records,
+                            fpta_table_schema::composite_item_t *&tail) {
+  fpta_table_schema::composite_item_t *const end =
+      FPT_ARRAY_END(column_set->composites);
+  for (tail = column_set->composites;
+       *tail && !(*tail & fpta_table_schema::record_kind_mask);) {
+    tail += *tail + 1;
+    if (unlikely(tail >= end))
+      return (tail == end) ? FPTA_TOOMANY : FPTA_SCHEMA_CORRUPTED;
+  }
+  for (records = tail; *tail;) {
+    tail += fpta_table_schema::record_length(*tail);
+    if (unlikely(tail >= end))
+      return (tail == end) ? FPTA_TOOMANY : FPTA_SCHEMA_CORRUPTED;
+  }
+  return FPTA_SUCCESS;
+}
+
+/* Добавляет в конец записей описания таблицы запись вида
+ * { mark | length, column, payload[length] }. */
+int fpta_column_set_append(
+    fpta_column_set *column_set, fpta_table_schema::composite_item_t *tail,
+    const unsigned mark, const size_t column,
+    const fpta_table_schema::composite_item_t *const payload,
+    const size_t length) {
+  fpta_table_schema::composite_item_t *const end =
+      FPT_ARRAY_END(column_set->composites);
+  assert(tail >= column_set->composites && tail < end && *tail == 0);
+  if (end - tail <= (ptrdiff_t)length + 1)
+    return FPTA_TOOMANY;
+
+  *tail++ = (fpta_table_schema::composite_item_t)(mark | length);
+  *tail++ = (fpta_table_schema::composite_item_t)column;
+  for (size_t i = 0; i < length; ++i)
+    *tail++ = payload[i];
+  assert(tail <= end);
+  if (tail < end)
+    *tail = 0;
+  return FPTA_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 
 static cxx11_constexpr_var unsigned schema_info_signature = 1543147811;
@@ -934,7 +1368,7 @@ int fpta_schema_fetch(fpta_txn *txn, fpta_schema_info *info) {
         break;
       }
 
-      rc = fpta_schema_clone(shove, data, &id->table_schema);
+      rc = fpta_schema_clone(txn->db, shove, data, &id->table_schema);
       if (unlikely(rc != FPTA_SUCCESS))
         break;
       id->version_tsn = txn->schema_tsn();
@@ -1092,8 +1526,10 @@ int fpta_name_refresh_couple(fpta_txn *txn, fpta_name *table_id,
     return FPTA_NOTFOUND;
 
   fpta_table_schema *schema = table_id->table_schema;
-  if (unlikely(schema->signature() != FTPA_SCHEMA_SIGNATURE))
+  if (unlikely(!fpta_schema_signature_valid(schema->signature())))
     return FPTA_SCHEMA_CORRUPTED;
+  if (unlikely(schema->has_expressions()))
+    schema->_expressions_db = txn->db;
 
   assert(fpta_shove2index(table_id->shove) == (fpta_index_type)fpta_flag_table);
   if (unlikely(schema->table_shove() != table_id->shove))
@@ -1119,6 +1555,9 @@ int fpta_name_refresh_couple(fpta_txn *txn, fpta_name *table_id,
     column_id->column.num = ~0u;
     for (size_t i = 0; i < schema->column_count(); ++i) {
       if (fpta_shove_eq(column_id->shove, schema->column_shove(i))) {
+        if (unlikely(schema->is_dropped(i)))
+          /* удаленная колонка недоступна, хотя имя остается занятым */
+          break;
         column_id->shove = schema->column_shove(i);
         column_id->column.num = (unsigned)i;
         break;
@@ -1134,6 +1573,103 @@ int fpta_name_refresh_couple(fpta_txn *txn, fpta_name *table_id,
 
 //----------------------------------------------------------------------------
 
+/* Проверяет, что вторичные индексы не слишком дороги для не-ординального
+ * первичного ключа. Просматриваются колонки до первой не-индексированной. */
+static int fpta_column_set_clumsy_check(fpta_txn *txn,
+                                        const fpta_shove_t *shoves,
+                                        size_t count) {
+  if ((txn->db->regime_flags & fpta_madness4testing) == 0) {
+    if (!fpta_index_is_ordinal(shoves[0])) {
+      unsigned clumsy_count = 0;
+      for (size_t i = 1; i < count; ++i) {
+        const auto shove = shoves[i];
+        if (!fpta_is_indexed(shove))
+          break;
+        if (fpta_index_is_ordinal(shove) && !fpta_column_is_nullable(shove)) {
+          if (fpta_index_is_unique(shove))
+            /* primary index costly than secondary */
+            return FPTA_CLUMSY_INDEX;
+        } else if (++clumsy_count > 1)
+          /* too costly, ordinary PK should be used */
+          return FPTA_CLUMSY_INDEX;
+      }
+    }
+  }
+  return FPTA_SUCCESS;
+}
+
+/* Подсчитывает таблицы и связанные с ними dbi, включая вторичные индексы. */
+static int fpta_schema_dbi_count(fpta_txn *txn, unsigned &tables_count,
+                                 unsigned &dbi_count) {
+  fpta_schema_info schema_info;
+  int rc = fpta_schema_fetch(txn, &schema_info);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  tables_count = dbi_count = schema_info.tables_count;
+  for (size_t n = 0; n < schema_info.tables_count; ++n) {
+    struct fpta_table_schema *table_schema =
+        schema_info.tables_names[n].table_schema;
+    for (unsigned i = 1; i < table_schema->index_span(); ++i) {
+      if (!fpta_is_indexed(table_schema->column_shove(i)))
+        continue;
+      dbi_count +=
+          (table_schema->bloom_bits(i) || table_schema->is_bitmap(i)) ? 2 : 1;
+    }
+  }
+  fpta_schema_destroy(&schema_info);
+  return FPTA_SUCCESS;
+}
+
+/* Сохраняет описание таблицы в схеме. */
+static int fpta_schema_store(fpta_txn *txn, const fpta_shove_t table_shove,
+                             fpta_column_set *column_set,
+                             const void *records, const void *composites_eof,
+                             unsigned flags, MDBX_val &data) {
+  const size_t bytes = fpta_schema_stored_size(column_set, composites_eof);
+  MDBX_val key;
+  key.iov_len = sizeof(table_shove);
+  key.iov_base = (void *)&table_shove;
+  data.iov_base = nullptr;
+  data.iov_len = bytes;
+  int rc = mdbx_put(txn->mdbx_txn, txn->db->schema_dbi, &key, &data,
+                    flags | MDBX_RESERVE);
+  if (rc != MDBX_SUCCESS)
+    return rc;
+
+  fpta_table_stored_schema *const record =
+      (fpta_table_stored_schema *)data.iov_base;
+  /* схему с покрывающими, частичными индексами, свойствами колонок или
+   * добавленными в конец колонками, а также с нарушенным после изменения
+   * индексов порядком колонок помечаем отдельной сигнатурой, чтобы её не
+   * могли использовать старые версии библиотеки */
+  record->signature =
+      (records < composites_eof ||
+       !std::is_sorted(column_set->shoves,
+                       column_set->shoves + column_set->count,
+                       [](const fpta_shove_t &left, const fpta_shove_t &right) {
+                         return shove_index_compare(left, right);
+                       }))
+          ? FTPA_SCHEMA_SIGNATURE_EXTENDED
+          : FTPA_SCHEMA_SIGNATURE;
+  record->count = column_set->count;
+  record->version_tsn = txn->db_version;
+  memcpy(record->columns, column_set->shoves,
+         sizeof(fpta_shove_t) * record->count);
+
+  fpta_table_schema::composite_item_t *ptr =
+      (fpta_table_schema::composite_item_t *)&record->columns[record->count];
+  const size_t composites_bytes =
+      (uintptr_t)composites_eof - (uintptr_t)&column_set->composites[0];
+  memcpy(ptr, column_set->composites, composites_bytes);
+  assert((uint8_t *)ptr + composites_bytes == (uint8_t *)record + bytes);
+
+  record->checksum =
+      t1ha2_atonce(&record->signature, bytes - sizeof(record->checksum),
+                   FTPA_SCHEMA_CHECKSEED);
+  return MDBX_SUCCESS;
+}
+
 int fpta_table_create(fpta_txn *txn, const char *table_name,
                       fpta_column_set *column_set) {
   int rc = fpta_txn_validate(txn, fpta_schema);
@@ -1150,25 +1686,11 @@ int fpta_table_create(fpta_txn *txn, const char *table_name,
   if (rc != FPTA_SUCCESS)
     return rc;
 
-  if ((txn->db->regime_flags & fpta_madness4testing) == 0) {
-    if (!fpta_index_is_ordinal(column_set->shoves[0])) {
-      unsigned clumsy_count = 0;
-      for (size_t i = 1; i < column_set->count; ++i) {
-        const auto shove = column_set->shoves[i];
-        if (!fpta_is_indexed(shove))
-          break;
-        if (fpta_index_is_ordinal(shove) && !fpta_column_is_nullable(shove)) {
-          if (fpta_index_is_unique(shove))
-            /* primary index costly than secondary */
-            return FPTA_CLUMSY_INDEX;
-        } else if (++clumsy_count > 1)
-          /* too costly, ordinary PK should be used */
-          return FPTA_CLUMSY_INDEX;
-      }
-    }
-  }
+  rc = fpta_column_set_clumsy_check(txn, column_set->shoves,
+                                    column_set->count);
+  if (rc != FPTA_SUCCESS)
+    return rc;
 
-  const size_t bytes = fpta_schema_stored_size(column_set, composites_eof);
   rc = fpta_column_set_sort(column_set);
   if (rc != FPTA_SUCCESS)
     return rc;
@@ -1176,26 +1698,23 @@ int fpta_table_create(fpta_txn *txn, const char *table_name,
   fpta_db *db = txn->db;
   assert(db->schema_dbi > 1);
 
-  fpta_schema_info schema_info;
-  rc = fpta_schema_fetch(txn, &schema_info);
+  /* записи покрывающих, частичных индексов и свойств колонок
+   * следуют за списками составных */
+  fpta_table_schema::composite_iter_t records = column_set->composites;
+  while (records < composites_eof &&
+         !(*records & fpta_table_schema::record_kind_mask))
+    records += *records + 1;
+  rc = fpta_index_keylen_check(
+      db, column_set->shoves, column_set->count, records,
+      (fpta_table_schema::composite_iter_t)composites_eof);
   if (rc != FPTA_SUCCESS)
     return rc;
-  if (schema_info.tables_count >= fpta_tables_max) {
-    fpta_schema_destroy(&schema_info);
-    return FPTA_TOOMANY;
-  }
-  unsigned dbi_count = schema_info.tables_count;
-  for (size_t n = 0; n < schema_info.tables_count; ++n) {
-    struct fpta_table_schema *table_schema =
-        schema_info.tables_names[n].table_schema;
-    for (unsigned i = 1; i < table_schema->column_count(); ++i) {
-      if (!fpta_is_indexed(table_schema->column_shove(i)))
-        break;
-      dbi_count += 1;
-    }
-  }
-  fpta_schema_destroy(&schema_info);
-  if (dbi_count >= fpta_max_indexes)
+
+  unsigned tables_count, dbi_count;
+  rc = fpta_schema_dbi_count(txn, tables_count, dbi_count);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+  if (tables_count >= fpta_tables_max || dbi_count >= fpta_max_indexes)
     return FPTA_TOOMANY;
 
   MDBX_dbi dbi[fpta_max_indexes];
@@ -1216,6 +1735,29 @@ int fpta_table_create(fpta_txn *txn, const char *table_name,
       return (err == MDBX_SUCCESS) ? (int)FPTA_EEXIST : err;
   }
 
+  /* фильтры Блума и таблицы битовых индексов создаются вместе
+   * с индексами */
+  fpta_shove_t bloom_shoves[fpta_max_indexes];
+  fpta_shove_t bitmap_shoves[fpta_max_indexes];
+  size_t bloom_count = 0, bitmap_count = 0;
+  for (const fpta_table_schema::composite_item_t *scan = records;
+       scan < composites_eof;
+       scan += fpta_table_schema::record_length(*scan)) {
+    if ((*scan & fpta_table_schema::record_kind_mask) ==
+            fpta_table_schema::option_mark &&
+        (scan[2] == fpta_table_schema::option_bloom ||
+         scan[2] == fpta_table_schema::option_bitmap)) {
+      if (++dbi_count >= fpta_max_indexes)
+        return FPTA_TOOMANY;
+      if (scan[2] == fpta_table_schema::option_bloom)
+        bloom_shoves[bloom_count++] =
+            fpta_bloom_shove(table_shove, column_set->shoves[scan[1]]);
+      else
+        bitmap_shoves[bitmap_count++] =
+            fpta_bitmap_shove(table_shove, column_set->shoves[scan[1]]);
+    }
+  }
+
 #ifndef NDEBUG
   std::string dict_string;
 #endif
@@ -1261,31 +1803,22 @@ int fpta_table_create(fpta_txn *txn, const char *table_name,
       goto bailout;
   }
 
-  key.iov_len = sizeof(table_shove);
-  key.iov_base = (void *)&table_shove;
-  data.iov_base = nullptr;
-  data.iov_len = bytes;
-  rc = mdbx_put(txn->mdbx_txn, db->schema_dbi, &key, &data,
-                MDBX_NOOVERWRITE | MDBX_RESERVE);
+  for (size_t i = 0; i < bloom_count; ++i) {
+    MDBX_dbi bloom_dbi;
+    rc = fpta_bloom_open(txn, bloom_shoves[i], bloom_dbi, true);
+    if (rc != MDBX_SUCCESS)
+      goto bailout;
+  }
+  for (size_t i = 0; i < bitmap_count; ++i) {
+    MDBX_dbi bitmap_dbi;
+    rc = fpta_bitmap_open(txn, bitmap_shoves[i], bitmap_dbi, true);
+    if (rc != MDBX_SUCCESS)
+      goto bailout;
+  }
+
+  rc = fpta_schema_store(txn, table_shove, column_set, records,
+                         composites_eof, MDBX_NOOVERWRITE, data);
   if (rc == MDBX_SUCCESS) {
-    fpta_table_stored_schema *const record =
-        (fpta_table_stored_schema *)data.iov_base;
-    record->signature = FTPA_SCHEMA_SIGNATURE;
-    record->count = column_set->count;
-    record->version_tsn = txn->db_version;
-    memcpy(record->columns, column_set->shoves,
-           sizeof(fpta_shove_t) * record->count);
-
-    fpta_table_schema::composite_item_t *ptr =
-        (fpta_table_schema::composite_item_t *)&record->columns[record->count];
-    const size_t composites_bytes =
-        (uintptr_t)composites_eof - (uintptr_t)&column_set->composites[0];
-    memcpy(ptr, column_set->composites, composites_bytes);
-    assert((uint8_t *)ptr + composites_bytes == (uint8_t *)record + bytes);
-
-    record->checksum =
-        t1ha2_atonce(&record->signature, bytes - sizeof(record->checksum),
-                     FTPA_SCHEMA_CHECKSEED);
 #ifndef NDEBUG
     MDBX_val dict_data = {(void *)dict_string.data(), dict_string.length()};
     assert(fpta_schema_image_validate(table_shove, data, dict_data));
@@ -1374,7 +1907,7 @@ int fpta_table_drop(fpta_txn *txn, const char *table_name) {
   for (size_t i = 0; i < table_schema->count; ++i) {
     const auto shove = table_schema->columns[i];
     if (!fpta_is_indexed(shove))
-      break;
+      continue;
     assert(i < fpta_max_indexes);
 
     const unsigned dbi_flags = fpta_dbi_flags(table_schema->columns, i);
@@ -1412,6 +1945,18 @@ int fpta_table_drop(fpta_txn *txn, const char *table_name) {
     }
   }
 
+  // удаляем фильтры Блума уникальных и таблицы битовых индексов
+  for (size_t i = 1; i < table_schema->count; ++i) {
+    const auto shove = table_schema->columns[i];
+    if (!fpta_is_indexed(shove))
+      continue;
+    rc = fpta_index_is_unique(shove)
+             ? fpta_bloom_drop(txn, fpta_bloom_shove(table_shove, shove))
+             : fpta_bitmap_drop(txn, fpta_bitmap_shove(table_shove, shove));
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+  }
+
   // увеличиваем номер ревизии схемы
   rc = mdbx_dbi_sequence(txn->mdbx_txn, txn->db->schema_dbi, nullptr, 1);
   if (unlikely(rc != MDBX_SUCCESS))
@@ -1423,6 +1968,488 @@ bailout:
   return fpta_internal_abort(txn, rc);
 }
 
+/* Копирует хранимое описание таблицы в column_set для последующего
+ * изменения и перезаписи. */
+static int fpta_schema_fetch(fpta_txn *txn, const fpta_shove_t table_shove,
+                             fpta_column_set &column_set,
+                             size_t &composites_bytes, uint64_t &version_tsn) {
+  assert(txn->db->schema_dbi > 1);
+  MDBX_val key, data;
+  key.iov_len = sizeof(table_shove);
+  key.iov_base = (void *)&table_shove;
+  int rc = mdbx_get(txn->mdbx_txn, txn->db->schema_dbi, &key, &data);
+  if (rc != MDBX_SUCCESS)
+    return rc;
+  const fpta_table_stored_schema *const stored =
+      fpta_schema_image_validate(table_shove, data);
+  if (unlikely(!stored))
+    return FPTA_SCHEMA_CORRUPTED;
+
+  /* описание таблицы будет перезаписано, поэтому копируем его */
+  const size_t count = stored->count;
+  composites_bytes = data.iov_len - fpta_table_schema::header_size() -
+                     sizeof(fpta_shove_t) * count;
+  if (unlikely(composites_bytes > sizeof(column_set.composites)))
+    return FPTA_SCHEMA_CORRUPTED;
+  memset(&column_set, 0, sizeof(column_set));
+  column_set.count = (unsigned)count;
+  memcpy(column_set.shoves, stored->columns, sizeof(fpta_shove_t) * count);
+  memcpy(column_set.composites, &stored->columns[count], composites_bytes);
+  version_tsn = stored->version_tsn;
+  return FPTA_SUCCESS;
+}
+
+/* Возвращает начало дополнительных записей, следующих за списками
+ * составных колонок. */
+static fpta_table_schema::composite_item_t *
+fpta_schema_records(fpta_column_set &column_set, size_t composites_bytes) {
+  fpta_table_schema::composite_item_t *const end =
+      column_set.composites +
+      composites_bytes / sizeof(fpta_table_schema::composite_item_t);
+  fpta_table_schema::composite_item_t *scan = column_set.composites;
+  while (scan < end && *scan && !(*scan & fpta_table_schema::record_kind_mask))
+    scan += *scan + 1;
+  return std::min(scan, end);
+}
+
+/* Ищет колонку по имени среди не удаленных. */
+static int fpta_schema_column_lookup(fpta_column_set &column_set,
+                                     size_t composites_bytes,
+                                     const fpta_shove_t column_shove,
+                                     size_t &column) {
+  for (column = 0; column < column_set.count; ++column)
+    if (fpta_shove_eq(column_set.shoves[column], column_shove))
+      break;
+  if (column == column_set.count ||
+      fpta_column_option_lookup(
+          column, fpta_table_schema::option_dropped,
+          fpta_schema_records(column_set, composites_bytes),
+          column_set.composites +
+              composites_bytes / sizeof(fpta_table_schema::composite_item_t)))
+    return FPTA_COLUMN_MISSING;
+  return FPTA_SUCCESS;
+}
+
+/* Удаляет дополнительные записи описания таблицы, для которых bound
+ * возвращает true, подсчитывая их в removed. */
+template <typename PREDICATE>
+static int fpta_schema_records_remove(fpta_column_set &column_set,
+                                      size_t composites_bytes,
+                                      PREDICATE bound, size_t &removed) {
+  fpta_table_schema::composite_item_t *const end =
+      column_set.composites +
+      composites_bytes / sizeof(fpta_table_schema::composite_item_t);
+  fpta_table_schema::composite_item_t *scan =
+      fpta_schema_records(column_set, composites_bytes);
+  fpta_table_schema::composite_item_t *tail = scan;
+  removed = 0;
+  while (scan < end) {
+    const size_t length = fpta_table_schema::record_length(*scan);
+    if (unlikely(scan + length > end))
+      return FPTA_SCHEMA_CORRUPTED;
+    if (bound(scan))
+      removed += 1;
+    else {
+      memmove(tail, scan, length * sizeof(*scan));
+      tail += length;
+    }
+    scan += length;
+  }
+  std::fill(tail, end, 0);
+  return FPTA_SUCCESS;
+}
+
+/* Добавляет или удаляет вторичный индекс колонки с перезаписью схемы.
+ * Номера колонок при этом не меняются, поэтому данные таблицы остаются
+ * прежними. Добавляемый индекс заполняется здесь же, либо при online
+ * только объявляется пустым с пометкой option_building. */
+static int fpta_table_alter_index(fpta_txn *txn, const char *table_name,
+                                  const char *column_name, bool add,
+                                  fpta_index_type index_type, bool online) {
+  int rc = fpta_txn_validate(txn, fpta_schema);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  const fpta_shove_t table_shove = fpta_shove_name(table_name, fpta_table);
+  const fpta_shove_t column_shove = fpta_shove_name(column_name, fpta_column);
+  if (unlikely(!table_shove || !column_shove))
+    return FPTA_ENAME;
+  if (add && unlikely(!fpta_index_is_valid(index_type) ||
+                      !fpta_is_indexed(index_type) ||
+                      !fpta_index_is_secondary(index_type)))
+    return FPTA_EFLAG;
+
+  fpta_db *db = txn->db;
+  fpta_column_set column_set;
+  size_t composites_bytes;
+  uint64_t version_tsn;
+  rc = fpta_schema_fetch(txn, table_shove, column_set, composites_bytes,
+                         version_tsn);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+  if (unlikely(version_tsn == txn->db_version))
+    /* таблица создана или изменена в этой же транзакции, а mdbx
+     * не освобождает имена созданных в текущей транзакции таблиц
+     * при их удалении, поэтому повторно занять их нельзя */
+    return FPTA_EBUSY;
+
+  size_t column;
+  rc = fpta_schema_column_lookup(column_set, composites_bytes, column_shove,
+                                 column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  const fpta_shove_t shove = column_set.shoves[column];
+  const fptu_type data_type = fpta_shove2type(shove);
+  if (unlikely(fpta_is_composite(shove)))
+    /* составные колонки существуют только как индексы */
+    return FPTA_EFLAG;
+  const fpta_shove_t name_shove =
+      shove & ~fpta_shove_t(fpta_column_typeid_mask | fpta_column_index_mask);
+  const unsigned old_dbi_flags = fpta_dbi_flags(column_set.shoves, column);
+
+  if (add) {
+    if (unlikely(fpta_is_indexed(shove)))
+      return FPTA_EEXIST;
+    column_set.shoves[column] =
+        fpta_column_shove(name_shove, data_type, index_type);
+    if (online) {
+      const fpta_table_schema::composite_item_t payload[] = {
+          fpta_table_schema::option_building};
+      rc = fpta_column_set_append(
+          &column_set,
+          column_set.composites +
+              composites_bytes / sizeof(fpta_table_schema::composite_item_t),
+          fpta_table_schema::option_mark, column, payload,
+          FPT_ARRAY_LENGTH(payload));
+      if (rc != FPTA_SUCCESS)
+        return rc;
+    }
+  } else {
+    if (unlikely(!fpta_is_indexed(shove) || !fpta_index_is_secondary(shove)))
+      return FPTA_EFLAG;
+    column_set.shoves[column] = fpta_column_shove(
+        name_shove, data_type,
+        fpta_column_is_nullable(shove) ? fpta_noindex_nullable
+                                       : fpta_index_none);
+
+    /* удаляем записи, относящиеся к самому индексу: списки покрываемых
+     * колонок, предикат частичного индекса, лимит длины ключей и т.д. */
+    size_t removed;
+    rc = fpta_schema_records_remove(
+        column_set, composites_bytes,
+        [column](fpta_table_schema::composite_iter_t record) {
+          return record[1] == column &&
+                 ((*record & fpta_table_schema::record_kind_mask) !=
+                      fpta_table_schema::option_mark ||
+                  record[2] == fpta_table_schema::option_keylen ||
+                  record[2] == fpta_table_schema::option_building ||
+                  record[2] == fpta_table_schema::option_bloom ||
+                  record[2] == fpta_table_schema::option_bitmap ||
+                  record[2] == fpta_table_schema::option_multivalued);
+        },
+        removed);
+    if (rc != FPTA_SUCCESS)
+      return rc;
+  }
+
+  const void *composites_eof = nullptr;
+  rc = fpta_columns_description_validate(
+      column_set.shoves, column_set.count, column_set.composites,
+      FPT_ARRAY_END(column_set.composites), &composites_eof);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  fpta_table_schema::composite_iter_t records = column_set.composites;
+  while (records < composites_eof &&
+         !(*records & fpta_table_schema::record_kind_mask))
+    records += *records + 1;
+  if (add) {
+    /* индексированные колонки могут чередоваться с остальными */
+    fpta_shove_t indexed[fpta_max_cols];
+    size_t indexed_count = 0;
+    for (size_t i = 0; i < column_set.count; ++i)
+      if (fpta_is_indexed(column_set.shoves[i]))
+        indexed[indexed_count++] = column_set.shoves[i];
+    rc = fpta_column_set_clumsy_check(txn, indexed, indexed_count);
+    if (rc != FPTA_SUCCESS)
+      return rc;
+    rc = fpta_index_keylen_check(
+        db, column_set.shoves, column_set.count, records,
+        (fpta_table_schema::composite_iter_t)composites_eof);
+    if (rc != FPTA_SUCCESS)
+      return rc;
+
+    unsigned tables_count, dbi_count;
+    rc = fpta_schema_dbi_count(txn, tables_count, dbi_count);
+    if (rc != FPTA_SUCCESS)
+      return rc;
+    if (dbi_count + 1 >= fpta_max_indexes)
+      return FPTA_TOOMANY;
+  }
+
+  MDBX_val data;
+  rc = fpta_schema_store(txn, table_shove, &column_set, records,
+                         composites_eof, 0, data);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+
+  if (add) {
+    fpta_table_schema *table_def = nullptr;
+    rc = fpta_schema_read(txn, table_shove, &table_def);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+    rc = fpta_index_build(txn, table_def, column, !online);
+    fpta_schema_free(table_def);
+    if (unlikely(rc != FPTA_SUCCESS))
+      goto bailout;
+  } else {
+    const fpta_shove_t dbi_shove = fpta_dbi_shove(table_shove, column);
+    MDBX_dbi dbi;
+    rc = fpta_dbi_open(txn, dbi_shove, dbi, old_dbi_flags);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+    fpta_dbicache_remove(db, dbi_shove);
+    rc = mdbx_drop(txn->mdbx_txn, dbi, true);
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+    rc = fpta_index_is_unique(shove)
+             ? fpta_bloom_drop(txn, fpta_bloom_shove(table_shove, shove))
+             : fpta_bitmap_drop(txn, fpta_bitmap_shove(table_shove, shove));
+    if (unlikely(rc != MDBX_SUCCESS))
+      goto bailout;
+  }
+
+  // увеличиваем номер ревизии схемы
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, txn->db->schema_dbi, nullptr, 1);
+  if (unlikely(rc != MDBX_SUCCESS))
+    goto bailout;
+  txn->schema_tsn() = txn->db_version;
+  return FPTA_SUCCESS;
+
+bailout:
+  return fpta_internal_abort(txn, rc);
+}
+
+int fpta_index_add(fpta_txn *txn, const char *table_name,
+                   const char *column_name, fpta_index_type index_type) {
+  return fpta_table_alter_index(txn, table_name, column_name, true,
+                                index_type, false);
+}
+
+int fpta_index_drop(fpta_txn *txn, const char *table_name,
+                    const char *column_name) {
+  return fpta_table_alter_index(txn, table_name, column_name, false,
+                                fpta_index_none, false);
+}
+
+int fpta_index_declare(fpta_txn *txn, const char *table_name,
+                       const char *column_name, fpta_index_type index_type) {
+  return fpta_table_alter_index(txn, table_name, column_name, true,
+                                index_type, true);
+}
+
+/* Перезаписывает измененное описание таблицы без перестроения её данных. */
+static int fpta_schema_rewrite(fpta_txn *txn, const fpta_shove_t table_shove,
+                               fpta_column_set &column_set) {
+  const void *composites_eof = nullptr;
+  int rc = fpta_columns_description_validate(
+      column_set.shoves, column_set.count, column_set.composites,
+      FPT_ARRAY_END(column_set.composites), &composites_eof);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  MDBX_val data;
+  const auto records =
+      fpta_schema_records(column_set, sizeof(column_set.composites));
+  rc = fpta_schema_store(txn, table_shove, &column_set, records,
+                         composites_eof, 0, data);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return fpta_internal_abort(txn, rc);
+
+  // увеличиваем номер ревизии схемы
+  rc = mdbx_dbi_sequence(txn->mdbx_txn, txn->db->schema_dbi, nullptr, 1);
+  if (unlikely(rc != MDBX_SUCCESS))
+    return fpta_internal_abort(txn, rc);
+  txn->schema_tsn() = txn->db_version;
+  return FPTA_SUCCESS;
+}
+
+int fpta_index_publish(fpta_txn *txn, const char *table_name,
+                       const char *column_name) {
+  int rc = fpta_txn_validate(txn, fpta_schema);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  const fpta_shove_t table_shove = fpta_shove_name(table_name, fpta_table);
+  const fpta_shove_t column_shove = fpta_shove_name(column_name, fpta_column);
+  if (unlikely(!table_shove || !column_shove))
+    return FPTA_ENAME;
+
+  fpta_column_set column_set;
+  size_t composites_bytes;
+  uint64_t version_tsn;
+  rc = fpta_schema_fetch(txn, table_shove, column_set, composites_bytes,
+                         version_tsn);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  size_t column;
+  rc = fpta_schema_column_lookup(column_set, composites_bytes, column_shove,
+                                 column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* индекс уже заполнен, поэтому достаточно снять пометку */
+  size_t removed;
+  rc = fpta_schema_records_remove(
+      column_set, composites_bytes,
+      [column](fpta_table_schema::composite_iter_t record) {
+        return record[1] == column &&
+               (*record & fpta_table_schema::record_kind_mask) ==
+                   fpta_table_schema::option_mark &&
+               record[2] == fpta_table_schema::option_building;
+      },
+      removed);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+  if (unlikely(removed == 0))
+    return FPTA_EFLAG;
+
+  return fpta_schema_rewrite(txn, table_shove, column_set);
+}
+
+int fpta_column_add(fpta_txn *txn, const char *table_name,
+                    const char *column_name, fptu_type data_type) {
+  int rc = fpta_txn_validate(txn, fpta_schema);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  const fpta_shove_t table_shove = fpta_shove_name(table_name, fpta_table);
+  const fpta_shove_t column_shove = fpta_shove_name(column_name, fpta_column);
+  if (unlikely(!table_shove || !column_shove))
+    return FPTA_ENAME;
+  if (unlikely(data_type < fptu_uint16 || data_type > fptu_nested))
+    return FPTA_ETYPE;
+
+  fpta_column_set column_set;
+  size_t composites_bytes;
+  uint64_t version_tsn;
+  rc = fpta_schema_fetch(txn, table_shove, column_set, composites_bytes,
+                         version_tsn);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  /* имена удаленных колонок также остаются занятыми */
+  for (size_t i = 0; i < column_set.count; ++i)
+    if (fpta_shove_eq(column_set.shoves[i], column_shove))
+      return FPTA_EEXIST;
+  if (unlikely(column_set.count >= fpta_max_cols))
+    return FPTA_TOOMANY;
+
+  /* новая колонка добавляется в конец списка, поэтому номера остальных
+   * не изменяются, а в ранее записанных строках её значения отсутствуют,
+   * т.е. равны NULL */
+  column_set.shoves[column_set.count++] =
+      fpta_column_shove(column_shove, data_type, fpta_noindex_nullable);
+
+  /* имя колонки добавляется в словарь схемы */
+  trivial_dict dict;
+  MDBX_val key, data;
+  key.iov_len = sizeof(dict_key);
+  key.iov_base = (void *)&dict_key;
+  rc = mdbx_get(txn->mdbx_txn, txn->db->schema_dbi, &key, &data);
+  if (rc == MDBX_SUCCESS) {
+    if (!dict.fetch(data))
+      return FPTA_SCHEMA_CORRUPTED;
+  } else if (rc != MDBX_NOTFOUND)
+    return rc;
+  if (dict.merge(fpta::string_view(column_name), fpta::string_view())) {
+    const std::string dict_string = dict.string();
+    data.iov_base = (void *)dict_string.data();
+    data.iov_len = dict_string.length();
+    rc = mdbx_put(txn->mdbx_txn, txn->db->schema_dbi, &key, &data,
+                  MDBX_NODUPDATA);
+    if (rc != MDBX_SUCCESS)
+      return fpta_internal_abort(txn, rc);
+  }
+
+  return fpta_schema_rewrite(txn, table_shove, column_set);
+}
+
+int fpta_column_drop(fpta_txn *txn, const char *table_name,
+                     const char *column_name) {
+  int rc = fpta_txn_validate(txn, fpta_schema);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  const fpta_shove_t table_shove = fpta_shove_name(table_name, fpta_table);
+  const fpta_shove_t column_shove = fpta_shove_name(column_name, fpta_column);
+  if (unlikely(!table_shove || !column_shove))
+    return FPTA_ENAME;
+
+  fpta_column_set column_set;
+  size_t composites_bytes;
+  uint64_t version_tsn;
+  rc = fpta_schema_fetch(txn, table_shove, column_set, composites_bytes,
+                         version_tsn);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+
+  size_t column;
+  rc = fpta_schema_column_lookup(column_set, composites_bytes, column_shove,
+                                 column);
+  if (rc != FPTA_SUCCESS)
+    return rc;
+  const fpta_shove_t shove = column_set.shoves[column];
+  if (unlikely(fpta_is_indexed(shove) || !fpta_column_is_nullable(shove)))
+    /* удаление индексированной или обязательной колонки требует
+     * перестроения таблицы */
+    return FPTA_EFLAG;
+
+  /* колонка не должна использоваться составными, покрывающими
+   * и частичными индексами */
+  fpta_table_schema::composite_item_t *const end =
+      column_set.composites +
+      composites_bytes / sizeof(fpta_table_schema::composite_item_t);
+  fpta_table_schema::composite_item_t *const records =
+      fpta_schema_records(column_set, composites_bytes);
+  bool used = false;
+  for (auto list = column_set.composites; list < records; list += *list + 1)
+    used |= std::find(list + 1, list + *list + 1, column) != list + *list + 1;
+  fpta_table_schema::composite_item_t *scan = records;
+  while (scan < end && !used) {
+    const size_t length = fpta_table_schema::record_length(*scan);
+    if (unlikely(scan + length > end))
+      return FPTA_SCHEMA_CORRUPTED;
+    switch (*scan & fpta_table_schema::record_kind_mask) {
+    case fpta_table_schema::covering_mark:
+      used = std::find(scan + 2, scan + length, column) != scan + length;
+      break;
+    case fpta_table_schema::partial_mark:
+      if (unlikely(!fpta_partial_foreach_column(
+              scan + 2, scan + length,
+              [&](fpta_table_schema::composite_item_t &item) {
+                used |= item == column;
+              })))
+        return FPTA_SCHEMA_CORRUPTED;
+      break;
+    default:
+      break;
+    }
+    scan += length;
+  }
+  if (unlikely(used))
+    return FPTA_EBUSY;
+
+  /* колонка только помечается удаленной, её поля удаляются из строк
+   * при их последующих обновлениях */
+  if (unlikely(end + 3 > FPT_ARRAY_END(column_set.composites)))
+    return FPTA_TOOMANY;
+  scan[0] = (fpta_table_schema::composite_item_t)(
+      fpta_table_schema::option_mark | 1);
+  scan[1] = (fpta_table_schema::composite_item_t)column;
+  scan[2] = fpta_table_schema::option_dropped;
+
+  return fpta_schema_rewrite(txn, table_shove, column_set);
+}
+
 //----------------------------------------------------------------------------
 
 int fpta_table_column_count_ex(const fpta_name *table_id,
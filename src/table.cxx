@@ -30,22 +30,8 @@ __hot int fpta_check_nonnullable(const fpta_table_schema *table_def,
     const auto shove = table_def->column_shove(i);
     const auto index = fpta_shove2index(shove);
 
-    if (index & fpta_index_fnullable) {
-      if (!fpta_is_indexed(index)) {
-/* при сортировке колонок по типам/флажкам индексов не-индексируемые
- * nullable колонки идут последними, т.е. дальше проверять нечего */
-#ifndef NDEBUG
-        while (++i < table_def->column_count()) {
-          const auto chk_shove = table_def->column_shove(i);
-          const auto chk_index = fpta_shove2index(chk_shove);
-          assert(!fpta_is_indexed(chk_index));
-          assert(chk_index & fpta_index_fnullable);
-        }
-#endif
-        break;
-      }
+    if (index & fpta_index_fnullable)
       continue;
-    }
 
     if (index & fpta_index_funique) {
       /* колонки с контролем уникальности
@@ -55,7 +41,9 @@ __hot int fpta_check_nonnullable(const fpta_table_schema *table_def,
     }
 
     const fptu_type type = fpta_shove2type(shove);
-    if (type == /* composite */ fptu_null)
+    if (type == /* composite */ fptu_null ||
+        /* значения вычисляются при формировании ключей */
+        table_def->is_expression(i))
       continue;
 
     const fptu_field *field = fptu::lookup(row, (unsigned)i, type);
@@ -65,102 +53,171 @@ __hot int fpta_check_nonnullable(const fpta_table_schema *table_def,
   return FPTA_SUCCESS;
 }
 
-__hot int fpta_check_secondary_uniq(fpta_txn *txn, fpta_table_schema *table_def,
-                                    const fptu_ro &old_row,
-                                    const fptu_ro &new_row,
-                                    const unsigned stepover) {
+__hot int fpta_check_secondary_uniq(fpta_txn *txn,
+                                    fpta_table_schema *table_def,
+                                    const fpta_row_keys &new_keys,
+                                    const unsigned stepover,
+                                    size_t *filtered) {
   MDBX_dbi dbi[fpta_max_indexes];
   int rc = fpta_open_secondaries(txn, table_def, dbi);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  for (size_t i = 1; i < table_def->column_count(); ++i) {
-    const auto shove = table_def->column_shove(i);
-    const auto index = fpta_shove2index(shove);
-    assert(i < fpta_max_indexes);
-    if (!fpta_index_is_secondary(index))
-      break;
-    if (i == stepover || !fpta_index_is_unique(index))
+  for (size_t i = 1; i < new_keys.count(); ++i) {
+    const auto index = fpta_shove2index(table_def->column_shove(i));
+    assert(fpta_index_is_secondary(index) || !new_keys.included(i));
+    if (i == stepover || !fpta_index_is_unique(index) ||
+        !new_keys.changed(i) || !new_keys.included(i))
       continue;
 
-    fpta_key new_se_key;
-    rc = fpta_index_row2key(table_def, i, new_row, new_se_key, false);
-    if (unlikely(rc != MDBX_SUCCESS))
-      return rc;
-
-    if (old_row.sys.iov_base) {
-      fpta_key old_se_key;
-      rc = fpta_index_row2key(table_def, i, old_row, old_se_key, false);
-      if (unlikely(rc != MDBX_SUCCESS))
-        return rc;
-      if (fpta_is_same(old_se_key.mdbx, new_se_key.mdbx))
+    bool accounted = false;
+    if (table_def->bloom_bits(i) != 0) {
+      /* фильтр Блума позволяет обойтись без поиска в индексе,
+       * если ключа там заведомо нет */
+      rc = fpta_bloom_lookup(txn, table_def, i, new_keys[i], accounted);
+      if (rc == FPTA_NODATA) {
+        if (filtered)
+          *filtered += 1;
         continue;
+      }
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
     }
 
     MDBX_val pk_exist;
-    rc = mdbx_get(txn->mdbx_txn, dbi[i], &new_se_key.mdbx, &pk_exist);
+    rc = mdbx_get(txn->mdbx_txn, dbi[i], const_cast<MDBX_val *>(&new_keys[i]),
+                  &pk_exist);
     if (unlikely(rc != MDBX_NOTFOUND))
       return (rc == MDBX_SUCCESS) ? MDBX_KEYEXIST : rc;
+    if (accounted)
+      fpta_bloom_false_positive(txn, table_def, i);
   }
 
   return FPTA_SUCCESS;
 }
 
+int fpta_check_secondary_uniq(fpta_txn *txn, fpta_table_schema *table_def,
+                              const fptu_ro &old_row, const fptu_ro &new_row,
+                              const unsigned stepover, size_t *filtered) {
+  fpta_row_keys old_keys, new_keys;
+  int rc = new_keys.build(table_def, new_row);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (old_row.sys.iov_base) {
+    rc = old_keys.build(table_def, old_row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  new_keys.diff(old_keys);
+  return fpta_check_secondary_uniq(txn, table_def, new_keys, stepover,
+                                   filtered);
+}
+
 int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
-                          MDBX_val old_pk_key, const fptu_ro &old_row,
-                          MDBX_val new_pk_key, const fptu_ro &new_row,
+                          MDBX_val old_pk_key, const fpta_row_keys &old_keys,
+                          MDBX_val new_pk_key, const fpta_row_keys &new_keys,
                           const unsigned stepover) {
   MDBX_dbi dbi[fpta_max_indexes];
   int rc = fpta_open_secondaries(txn, table_def, dbi);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  for (size_t i = 1; i < table_def->column_count(); ++i) {
-    const auto shove = table_def->column_shove(i);
-    const auto index = fpta_shove2index(shove);
-    assert(i < fpta_max_indexes);
-    if (!fpta_index_is_secondary(index))
-      break;
-    if (i == stepover)
+  fpta_secondary_value se_value;
+  for (size_t i = 1; i < new_keys.count(); ++i) {
+    const auto index = fpta_shove2index(table_def->column_shove(i));
+    if (i == stepover || !fpta_is_indexed(index))
       continue;
 
-    fpta_key new_se_key;
-    rc = fpta_index_row2key(table_def, i, new_row, new_se_key, false);
-    if (unlikely(rc != MDBX_SUCCESS))
-      return rc;
+    if (table_def->is_bitmap(i)) {
+      /* битовый индекс не бывает частичным или покрывающим */
+      rc = fpta_bitmap_upsert(txn, table_def, i, old_pk_key, old_keys,
+                              new_pk_key, new_keys);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      continue;
+    }
+
+    if (table_def->is_multivalued(i)) {
+      /* многозначный индекс не бывает частичным или покрывающим */
+      rc = fpta_multivalued_update(
+          txn, table_def, i, dbi[i], old_pk_key,
+          old_keys.empty() ? nullptr : &old_keys.row(), new_pk_key,
+          &new_keys.row());
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      continue;
+    }
+
+    const bool included = new_keys.included(i);
+    if (!included && (old_keys.empty() || !new_keys.changed(i)))
+      /* строка не попадает в частичный индекс и ранее в нём не была */
+      continue;
 
-    if (old_row.sys.iov_base == nullptr) {
+    MDBX_val new_se_key = new_keys[i];
+    MDBX_val new_se_value = new_pk_key;
+    const bool covering = table_def->is_covering(i);
+    if (covering && included) {
+      rc = se_value.build(table_def, i, new_keys.row(), new_pk_key);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      new_se_value = se_value.value();
+    }
+
+    if (old_keys.empty()) {
       /* Старой версии нет, выполняется добавление новой строки */
       assert(old_pk_key.iov_base == new_pk_key.iov_base);
       /* Вставляем новую пару в secondary индекс */
-      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key.mdbx, &new_pk_key,
+      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key, &new_se_value,
                     fpta_index_is_unique(index)
                         ? MDBX_NODUPDATA | MDBX_NOOVERWRITE
                         : MDBX_NODUPDATA);
       if (unlikely(rc != MDBX_SUCCESS))
         return rc;
-
+      if (table_def->bloom_bits(i)) {
+        rc = fpta_bloom_insert(txn, table_def, i, dbi[i], new_se_key);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
       continue;
     }
     /* else: Выполняется обновление существующей строки */
 
-    fpta_key old_se_key;
-    rc = fpta_index_row2key(table_def, i, old_row, old_se_key, false);
-    if (unlikely(rc != MDBX_SUCCESS))
-      return rc;
-
-    if (!fpta_is_same(old_se_key.mdbx, new_se_key.mdbx)) {
-      /* Изменилось значение индексированного поля, выполняем удаление
-       * из индекса пары со старым значением и добавляем пару с новым. */
-      rc = mdbx_del(txn->mdbx_txn, dbi[i], &old_se_key.mdbx, &old_pk_key);
-      if (unlikely(rc != MDBX_SUCCESS))
-        return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
-      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key.mdbx, &new_pk_key,
+    if (new_keys.changed(i)) {
+      /* Изменилось значение индексированного поля, либо вхождение строки
+       * в частичный индекс. Выполняем удаление из индекса пары со старым
+       * значением и добавляем пару с новым. */
+      if (old_keys.included(i)) {
+        MDBX_val old_se_key = old_keys[i];
+        rc = mdbx_del(txn->mdbx_txn, dbi[i], &old_se_key,
+                      covering ? nullptr : &old_pk_key);
+        if (unlikely(rc != MDBX_SUCCESS) &&
+            /* в заполняемый индекс строка могла еще не попасть */
+            (rc != MDBX_NOTFOUND || !table_def->is_building(i)))
+          return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
+      }
+      if (!included)
+        continue;
+      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key, &new_se_value,
                     fpta_index_is_unique(index)
                         ? MDBX_NODUPDATA | MDBX_NOOVERWRITE
                         : MDBX_NODUPDATA);
       if (unlikely(rc != MDBX_SUCCESS))
         return rc;
+      if (table_def->bloom_bits(i)) {
+        rc = fpta_bloom_insert(txn, table_def, i, dbi[i], new_se_key);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return rc;
+      }
+      continue;
+    }
+
+    if (covering) {
+      /* Покрывающий индекс уникален, поэтому достаточно заменить значение,
+       * так как могли измениться как PK, так и копии покрываемых колонок. */
+      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key, &new_se_value,
+                    MDBX_CURRENT);
+      if (unlikely(rc != MDBX_SUCCESS))
+        return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
       continue;
     }
 
@@ -175,11 +232,18 @@ int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
      * старого значения PK на новое, даже если для индексируемого поля
      * разрешены не уникальные значения. */
     MDBX_val old_pk_key_clone = old_pk_key;
-    rc = mdbx_replace(txn->mdbx_txn, dbi[i], &new_se_key.mdbx, &new_pk_key,
+    rc = mdbx_replace(txn->mdbx_txn, dbi[i], &new_se_key, &new_pk_key,
                       &old_pk_key_clone,
                       fpta_index_is_unique(index)
                           ? MDBX_CURRENT | MDBX_NODUPDATA
                           : MDBX_CURRENT | MDBX_NODUPDATA | MDBX_NOOVERWRITE);
+    if (unlikely(rc == MDBX_NOTFOUND) && table_def->is_building(i))
+      /* Строка еще не попала в заполняемый индекс, а заполнение может
+       * уже пройти новое значение PK, поэтому пара добавляется здесь. */
+      rc = mdbx_put(txn->mdbx_txn, dbi[i], &new_se_key, &new_pk_key,
+                    fpta_index_is_unique(index)
+                        ? MDBX_NODUPDATA | MDBX_NOOVERWRITE
+                        : MDBX_NODUPDATA);
     if (unlikely(rc != MDBX_SUCCESS))
       return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
   }
@@ -187,36 +251,74 @@ int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
   return FPTA_SUCCESS;
 }
 
+int fpta_secondary_upsert(fpta_txn *txn, fpta_table_schema *table_def,
+                          MDBX_val old_pk_key, const fptu_ro &old_row,
+                          MDBX_val new_pk_key, const fptu_ro &new_row,
+                          const unsigned stepover) {
+  fpta_row_keys old_keys, new_keys;
+  int rc = new_keys.build(table_def, new_row);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  if (old_row.sys.iov_base) {
+    rc = old_keys.build(table_def, old_row);
+    if (unlikely(rc != FPTA_SUCCESS))
+      return rc;
+  }
+  new_keys.diff(old_keys);
+  return fpta_secondary_upsert(txn, table_def, old_pk_key, old_keys,
+                               new_pk_key, new_keys, stepover);
+}
+
 int fpta_secondary_remove(fpta_txn *txn, fpta_table_schema *table_def,
-                          MDBX_val &pk_key, const fptu_ro &row,
+                          MDBX_val &pk_key, const fpta_row_keys &keys,
                           const unsigned stepover) {
   MDBX_dbi dbi[fpta_max_indexes];
   int rc = fpta_open_secondaries(txn, table_def, dbi);
   if (unlikely(rc != FPTA_SUCCESS))
     return rc;
 
-  for (size_t i = 1; i < table_def->column_count(); ++i) {
-    const auto shove = table_def->column_shove(i);
-    const auto index = fpta_shove2index(shove);
-    assert(i < fpta_max_indexes);
-    if (!fpta_index_is_secondary(index))
-      break;
-    if (i == stepover)
+  for (size_t i = 1; i < keys.count(); ++i) {
+    assert(fpta_index_is_secondary(
+               fpta_shove2index(table_def->column_shove(i))) ||
+           !keys.included(i));
+    if (i == stepover || !keys.included(i))
       continue;
 
-    fpta_key se_key;
-    rc = fpta_index_row2key(table_def, i, row, se_key, false);
-    if (unlikely(rc != MDBX_SUCCESS))
-      return rc;
-
-    rc = mdbx_del(txn->mdbx_txn, dbi[i], &se_key.mdbx, &pk_key);
-    if (unlikely(rc != MDBX_SUCCESS))
+    MDBX_val se_key = keys[i];
+    if (table_def->is_bitmap(i)) {
+      uint64_t rowid = fpta_bitmap_rowid(pk_key);
+      rc = fpta_bitmap_update(txn, table_def, i, se_key, &rowid, 1, false);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      continue;
+    }
+    if (table_def->is_multivalued(i)) {
+      rc = fpta_multivalued_update(txn, table_def, i, dbi[i], pk_key,
+                                   &keys.row(), pk_key, nullptr);
+      if (unlikely(rc != FPTA_SUCCESS))
+        return rc;
+      continue;
+    }
+    rc = mdbx_del(txn->mdbx_txn, dbi[i], &se_key,
+                  table_def->is_covering(i) ? nullptr : &pk_key);
+    if (unlikely(rc != MDBX_SUCCESS) &&
+        (rc != MDBX_NOTFOUND || !table_def->is_building(i)))
       return (rc != MDBX_NOTFOUND) ? rc : (int)FPTA_INDEX_CORRUPTED;
   }
 
   return FPTA_SUCCESS;
 }
 
+int fpta_secondary_remove(fpta_txn *txn, fpta_table_schema *table_def,
+                          MDBX_val &pk_key, const fptu_ro &row,
+                          const unsigned stepover) {
+  fpta_row_keys keys;
+  int rc = keys.build(table_def, row);
+  if (unlikely(rc != FPTA_SUCCESS))
+    return rc;
+  return fpta_secondary_remove(txn, table_def, pk_key, keys, stepover);
+}
+
 //----------------------------------------------------------------------------
 
 int fpta_table_info(fpta_txn *txn, fpta_name *table_id, size_t *row_count,
@@ -330,6 +432,12 @@ int fpta_table_info_ex(fpta_txn *txn, fpta_name *table_id, size_t *row_count,
     unsigned uniq_trees = 0;
     unsigned uniq_branch_height = 0;
 
+    stat->bloom_bytes = 0;
+    stat->bloom_lookups = 0;
+    stat->bloom_negatives = 0;
+    stat->bloom_false_positives = 0;
+    stat->bitmap_bytes = 0;
+
     unsigned overall_branch_height = stat->btree_depth - 1;
     unsigned overall_trees = 1;
     if (table_id->table_schema->has_secondary()) {
@@ -337,10 +445,10 @@ int fpta_table_info_ex(fpta_txn *txn, fpta_name *table_id, size_t *row_count,
       rc = fpta_open_secondaries(txn, table_id->table_schema, dbi);
       if (unlikely(rc != FPTA_SUCCESS))
         return rc;
-      for (unsigned i = 1; i < table_id->table_schema->column_count(); ++i) {
+      for (unsigned i = 1; i < table_id->table_schema->index_span(); ++i) {
         const auto shove = table_id->table_schema->column_shove(i);
         if (!fpta_is_indexed(shove))
-          break;
+          continue;
 
         rc =
             mdbx_dbi_stat(txn->mdbx_txn, dbi[i], &mdbx_stat, sizeof(mdbx_stat));
@@ -354,6 +462,15 @@ int fpta_table_info_ex(fpta_txn *txn, fpta_name *table_id, size_t *row_count,
           uniq_leaf_pages += size_t(mdbx_stat.ms_leaf_pages);
           uniq_branch_pages += size_t(mdbx_stat.ms_branch_pages);
           uniq_large_pages += size_t(mdbx_stat.ms_overflow_pages);
+          if (table_id->table_schema->bloom_bits(i)) {
+            rc = fpta_bloom_stat(txn, table_id->table_schema, i, stat);
+            if (unlikely(rc != FPTA_SUCCESS))
+              return rc;
+          }
+        } else if (table_id->table_schema->is_bitmap(i)) {
+          rc = fpta_bitmap_stat(txn, table_id->table_schema, i, stat);
+          if (unlikely(rc != FPTA_SUCCESS))
+            return rc;
         }
 
         stat->total_items += size_t(mdbx_stat.ms_entries);
@@ -468,13 +585,24 @@ int fpta_table_clear(fpta_txn *txn, fpta_name *table_id, bool reset_sequence) {
     return rc;
 
   if (table_def->has_secondary()) {
-    for (size_t i = 1; i < table_def->column_count(); ++i) {
+    for (size_t i = 1; i < table_def->index_span(); ++i) {
       const fpta_shove_t shove = table_def->column_shove(i);
       if (!fpta_is_indexed(shove))
-        break;
+        continue;
       rc = mdbx_drop(txn->mdbx_txn, dbi[i], 0);
       if (unlikely(rc != MDBX_SUCCESS))
         return fpta_internal_abort(txn, rc);
+      if (table_def->bloom_bits(i)) {
+        /* пустой фильтр минимального размера */
+        rc = fpta_bloom_rebuild(txn, table_def, i, dbi[i]);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return fpta_internal_abort(txn, rc);
+      }
+      if (table_def->is_bitmap(i)) {
+        rc = fpta_bitmap_clear(txn, table_def, i);
+        if (unlikely(rc != FPTA_SUCCESS))
+          return fpta_internal_abort(txn, rc);
+      }
     }
   }
 
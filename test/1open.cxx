@@ -85,6 +85,7 @@ TEST(Open, SingleProcess_ChangeDbSize) {
   ASSERT_NE(nullptr, db);
   ASSERT_EQ(FPTA_OK, fpta_db_info(db, nullptr, &stat));
   EXPECT_EQ(stat.geo.current, 1u * 1024 * 1024);
+  EXPECT_EQ(0u, stat.dbi_cache_overflows);
   EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
 
   ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
@@ -0,0 +1,237 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_schema_column.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_schema_column.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Schema, ColumnAddDrop) {
+  /* Smoke-проверка добавления и удаления не-индексируемых колонок
+   * без перезаписи строк таблицы.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с nullable-колонкой Note и вставляем
+   *     10 строк, в половине из которых задано значение Note.
+   *
+   *  2. Добавляем колонку Age и проверяем, что в прежних строках её
+   *     значение отсутствует, а после обновления строки доступно.
+   *
+   *  3. Удаляем колонку Note и проверяем, что она недоступна, а её поле
+   *     сохраняется в строке только до следующего обновления.
+   *
+   *  4. Повторно открываем базу, добавляем индекс по Age и проверяем
+   *     данные.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Name", fptu_cstr, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Note", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "people", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_name, col_note, col_age;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "people"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_note, "Note"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_age, "Age"));
+
+  fptu_rw *pt = fptu_alloc(4, 256);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_note));
+  EXPECT_EQ(FPTA_ENOENT, fpta_name_refresh(txn, &col_age));
+  const unsigned note_colnum = col_note.column.num;
+  for (unsigned id = 0; id < 10; ++id) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    const std::string name = "name-" + std::to_string(id);
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_name, fpta_value_str(name)));
+    if (id % 2 == 0) {
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &col_note, fpta_value_cstr("note")));
+    }
+    EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(pt)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // добавляем колонку
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_EEXIST, fpta_column_add(txn, "people", "Name", fptu_int32));
+  EXPECT_EQ(FPTA_ETYPE, fpta_column_add(txn, "people", "Age", fptu_null));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_column_add(txn, "nobody", "Age", fptu_int32));
+  ASSERT_EQ(FPTA_OK, fpta_column_add(txn, "people", "Age", fptu_int32));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fptu_ro row;
+  fpta_value value;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_age));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_note));
+  // номера прежних колонок не изменились
+  EXPECT_EQ(note_colnum, col_note.column.num);
+  value = fpta_value_uint(3);
+  ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+  EXPECT_EQ(FPTA_NODATA, fpta_get_column(row, &col_age, &value));
+  ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(3)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_upsert_column(pt, &col_name, fpta_value_cstr("name-3")));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_age, fpta_value_sint(42)));
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table, fptu_take_noshrink(pt)));
+  value = fpta_value_uint(3);
+  ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_age, &value));
+  EXPECT_EQ(42, value.sint);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // удаляем колонку
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_COLUMN_MISSING, fpta_column_drop(txn, "people", "Nothing"));
+  EXPECT_EQ(FPTA_EFLAG, fpta_column_drop(txn, "people", "Id"));
+  EXPECT_EQ(FPTA_EFLAG, fpta_column_drop(txn, "people", "Name"));
+  ASSERT_EQ(FPTA_OK, fpta_column_drop(txn, "people", "Note"));
+  EXPECT_EQ(FPTA_COLUMN_MISSING, fpta_column_drop(txn, "people", "Note"));
+  EXPECT_EQ(FPTA_EEXIST, fpta_column_add(txn, "people", "Note", fptu_cstr));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_age));
+  EXPECT_EQ(FPTA_ENOENT, fpta_name_refresh(txn, &col_note));
+  EXPECT_EQ(10u, count_rows(txn, &col_id));
+  value = fpta_value_uint(4);
+  ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+  // поле удаленной колонки остается до обновления строки
+  EXPECT_NE(nullptr, fptu::lookup(row, note_colnum, fptu_cstr));
+  ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+  ASSERT_NE(nullptr, fptu_fetch(row, pt, fptu_space(4, 256), 1));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_age, fpta_value_sint(7)));
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table, fptu_take_noshrink(pt)));
+  value = fpta_value_uint(4);
+  ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+  EXPECT_EQ(nullptr, fptu::lookup(row, note_colnum, fptu_cstr));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_age, &value));
+  EXPECT_EQ(7, value.sint);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // изменения сохраняются в схеме, а индекс может быть добавлен
+  // и по колонке, добавленной в конец списка
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_index_add(txn, "people", "Note",
+                           fpta_secondary_withdups_ordered_obverse_nullable));
+  ASSERT_EQ(FPTA_OK,
+            fpta_index_add(txn, "people", "Age",
+                           fpta_secondary_withdups_ordered_obverse_nullable));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_age));
+  EXPECT_EQ(FPTA_ENOENT, fpta_name_refresh(txn, &col_note));
+  EXPECT_EQ(10u, count_rows(txn, &col_age));
+  value = fpta_value_uint(3);
+  ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_age, &value));
+  EXPECT_EQ(42, value.sint);
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_name, &value));
+  EXPECT_STREQ("name-3", value.str);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_note);
+  fpta_name_destroy(&col_age);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
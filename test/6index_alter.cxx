@@ -0,0 +1,598 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+#include <atomic>
+#include <thread>
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_alter.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_alter.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Index, AddDrop) {
+  /* Smoke-проверка добавления и удаления вторичных индексов
+   * заполненной таблицы.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу, в которой уникальный вторичный индекс
+   *     по Code покрывает колонки Name и Score, и вставляем 100 строк.
+   *
+   *  2. Добавляем индексы по Score и nullable-колонке Tag, при этом номера
+   *     колонок не меняются. Попутно проверяем отказы для отсутствующих,
+   *     уже индексированных и не-индексированных колонок.
+   *
+   *  3. Проверяем новые индексы, значения в строках и проекциях
+   *     покрывающего индекса, а также обновление индексов при последующих
+   *     изменениях строк.
+   *
+   *  4. Пробуем добавить уникальный индекс по колонке с повторами и
+   *     проверяем отмену транзакции. Удаляем индексы по Code и Score,
+   *     повторно открываем базу и проверяем данные.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Code", fptu_uint32,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Name", fptu_cstr, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Score", fptu_int64, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Tag", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+  const char *const covered[] = {"Name", "Score"};
+  EXPECT_EQ(FPTA_OK, fpta_describe_covering_index("Code", &def, covered, 2));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "items", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_code, col_name, col_score, col_tag;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "items"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_code, "Code"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_score, "Score"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_tag, "Tag"));
+
+  const auto refresh = [&]() {
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_code));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_score));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_tag));
+  };
+
+  fptu_rw *pt = fptu_alloc(5, 1024);
+  ASSERT_NE(nullptr, pt);
+  const auto make_row = [&](unsigned id, int64_t score) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_code, fpta_value_uint(1000 + id)));
+    const std::string name = "name-" + std::to_string(id);
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_name, fpta_value_str(name)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_score, fpta_value_sint(score)));
+    if (id % 2 == 0) {
+      const std::string tag = "tag-" + std::to_string(id);
+      EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_tag, fpta_value_str(tag)));
+    }
+    return fptu_take_noshrink(pt);
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  for (unsigned id = 0; id < 100; ++id)
+    EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table, make_row(id, id % 10)));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  const unsigned score_num = col_score.column.num;
+  const unsigned tag_num = col_tag.column.num;
+
+  //--------------------------------------------------------------------------
+  // добавляем индексы
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_index_add(txn, "items", "Nothing",
+                           fpta_secondary_withdups_ordered_obverse));
+  EXPECT_EQ(FPTA_EEXIST,
+            fpta_index_add(txn, "items", "Code",
+                           fpta_secondary_withdups_ordered_obverse));
+  EXPECT_EQ(FPTA_EFLAG, fpta_index_add(txn, "items", "Score",
+                                       fpta_primary_unique_ordered_obverse));
+  EXPECT_EQ(FPTA_EFLAG, fpta_index_drop(txn, "items", "Id"));
+  EXPECT_EQ(FPTA_EFLAG, fpta_index_drop(txn, "items", "Name"));
+  ASSERT_EQ(FPTA_OK, fpta_index_add(txn, "items", "Score",
+                                    fpta_secondary_withdups_ordered_obverse));
+  // повторное изменение индексов таблицы в той же транзакции
+  EXPECT_EQ(FPTA_EBUSY,
+            fpta_index_add(txn, "items", "Tag",
+                           fpta_secondary_withdups_ordered_obverse_nullable));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK,
+            fpta_index_add(txn, "items", "Tag",
+                           fpta_secondary_withdups_ordered_obverse_nullable));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  const auto count_range = [&](fpta_name *column, fpta_value from,
+                               fpta_value to) {
+    fpta_cursor *cursor = nullptr;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, column, from, to, nullptr,
+                                        fpta_unsorted_dont_fetch, &cursor));
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    return count;
+  };
+
+  const auto check_row = [&](unsigned id, int64_t score) {
+    fpta_value value = fpta_value_uint(1000 + id);
+    fptu_ro row;
+    ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_code, &value, &row));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &value));
+    EXPECT_EQ(id, value.uint);
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_name, &value));
+    EXPECT_EQ("name-" + std::to_string(id),
+              std::string(value.str, value.binary_length));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_score, &value));
+    EXPECT_EQ(score, value.sint);
+    EXPECT_EQ((id % 2) ? FPTA_NODATA : FPTA_OK,
+              fpta_get_column(row, &col_tag, &value));
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  // строки не перезаписывались, так как номера колонок прежние
+  EXPECT_EQ(score_num, col_score.column.num);
+  EXPECT_EQ(tag_num, col_tag.column.num);
+  EXPECT_EQ(100u, count_rows(txn, &col_score));
+  EXPECT_EQ(100u, count_rows(txn, &col_tag));
+  EXPECT_EQ(10u, count_range(&col_score, fpta_value_sint(3),
+                             fpta_value_sint(4)));
+  EXPECT_EQ(1u, count_range(&col_tag, fpta_value_cstr("tag-40"),
+                            fpta_value_cstr("tag-41")));
+  check_row(42, 2);
+  check_row(7, 7);
+
+  // проекции покрывающего индекса остались прежними
+  fpta_filter filter;
+  filter.type = fpta_node_eq;
+  filter.node_cmp.left_id = &col_score;
+  filter.node_cmp.right_value = fpta_value_sint(7);
+  size_t pk_lookups = ~size_t(0);
+  EXPECT_EQ(10u, count_covered(txn, &col_code, &filter, &pk_lookups));
+  EXPECT_EQ(0u, pk_lookups);
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_code, fpta_value_uint(1042),
+                                      fpta_value_epsilon(), nullptr,
+                                      fpta_unsorted, &cursor));
+  fptu_ro projection;
+  fpta_value value;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_get_covered(cursor, &projection));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(projection, &col_score, &value));
+  EXPECT_EQ(2, value.sint);
+  EXPECT_EQ(FPTA_OK, fpta_get_column(projection, &col_name, &value));
+  EXPECT_STREQ("name-42", value.str);
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // новые индексы обновляются вместе со строками
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table, make_row(13, 42)));
+  EXPECT_EQ(FPTA_OK, fpta_delete(txn, &table, make_row(40, 0)));
+  EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table, make_row(100, 3)));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  /* 3..93 без 13, а также 100 */
+  EXPECT_EQ(10u, count_range(&col_score, fpta_value_sint(3),
+                             fpta_value_sint(4)));
+  EXPECT_EQ(1u, count_range(&col_score, fpta_value_sint(42),
+                            fpta_value_end()));
+  EXPECT_EQ(0u, count_range(&col_tag, fpta_value_cstr("tag-40"),
+                            fpta_value_cstr("tag-41")));
+  EXPECT_EQ(100u, count_rows(txn, &col_tag));
+  check_row(13, 42);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // удаляем индексы, в том числе покрывающий
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_index_drop(txn, "items", "Score"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // уникальный индекс по колонке с повторами не может быть построен
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_index_add(txn, "items", "Score",
+                           fpta_secondary_unique_ordered_obverse));
+  EXPECT_EQ(FPTA_TXN_CANCELLED, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_index_drop(txn, "items", "Code"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  const auto check = [&]() {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+    EXPECT_EQ(FPTA_NO_INDEX,
+              fpta_cursor_open(txn, &col_score, fpta_value_begin(),
+                               fpta_value_end(), nullptr,
+                               fpta_unsorted_dont_fetch, &cursor));
+    EXPECT_EQ(100u, count_rows(txn, &col_id));
+    EXPECT_EQ(100u, count_rows(txn, &col_tag));
+    EXPECT_EQ(1u, count_range(&col_tag, fpta_value_cstr("tag-42"),
+                              fpta_value_cstr("tag-43")));
+
+    fptu_ro row;
+    value = fpta_value_uint(13);
+    ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_id, &value, &row));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_code, &value));
+    EXPECT_EQ(1013u, value.uint);
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_score, &value));
+    EXPECT_EQ(42, value.sint);
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_name, &value));
+    EXPECT_STREQ("name-13", value.str);
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  };
+  check();
+
+  // изменения сохраняются в схеме
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, false, &db));
+  ASSERT_NE(nullptr, db);
+  check();
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_code);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_score);
+  fpta_name_destroy(&col_tag);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+TEST(Index, AddOnline) {
+  /* Smoke-проверка заполнения вторичного индекса порциями, параллельно
+   * с изменениями строк в транзакциях другого потока.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с первичным индексом по Id, уникальным
+   *     вторичным по Code и не-индексированными колонками Score и Group,
+   *     вставляем 1000 строк.
+   *
+   *  2. Запускаем поток-писатель, который в каждой транзакции обновляет
+   *     Score, изменяет первичный ключ через курсор по Code, удаляет и
+   *     вставляет строки. Параллельно добавляем индекс по Score порциями
+   *     по 3 строки посредством fpta_index_add_online().
+   *
+   *  3. Проверяем, что индекс содержит ровно все строки таблицы с
+   *     актуальными значениями Score, а номер колонки не изменился.
+   *
+   *  4. Проверяем отказы при повторном добавлении и при нарушении
+   *     уникальности, после которого индекс удаляется.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  16, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Code", fptu_uint32,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Score", fptu_int64, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Group", fptu_uint32, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "online", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  struct names {
+    fpta_name table, id, code, score, group;
+    names() {
+      EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "online"));
+      EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &id, "Id"));
+      EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &code, "Code"));
+      EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &score, "Score"));
+      EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &group, "Group"));
+    }
+    ~names() {
+      fpta_name_destroy(&table);
+      fpta_name_destroy(&id);
+      fpta_name_destroy(&code);
+      fpta_name_destroy(&score);
+      fpta_name_destroy(&group);
+    }
+    void refresh(fpta_txn *txn) {
+      ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &id));
+      ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &code));
+      ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &score));
+      ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &group));
+    }
+    fptu_ro make_row(fptu_rw *pt, unsigned id_value, unsigned code_value,
+                     int64_t score_value) {
+      EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &id, fpta_value_uint(id_value)));
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &code, fpta_value_uint(code_value)));
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &score, fpta_value_sint(score_value)));
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &group, fpta_value_uint(id_value % 7)));
+      return fptu_take_noshrink(pt);
+    }
+  };
+
+  names local;
+  fptu_rw *pt = fptu_alloc(4, 256);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  local.refresh(txn);
+  for (unsigned id = 0; id < 1000; ++id)
+    EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &local.table,
+                                       local.make_row(pt, id, id, id % 10)));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  const unsigned score_num = local.score.column.num;
+
+  //--------------------------------------------------------------------------
+  // заполняем индекс параллельно с изменениями строк
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    names own;
+    fptu_rw *wpt = fptu_alloc(4, 256);
+    ASSERT_NE(nullptr, wpt);
+    for (unsigned i = 0; !done || i < 64; ++i) {
+      fpta_txn *wtxn = nullptr;
+      EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &wtxn));
+      ASSERT_NE(nullptr, wtxn);
+      own.refresh(wtxn);
+
+      // изменяем значение Score
+      fpta_cursor *cursor = nullptr;
+      fptu_ro row;
+      fpta_value value;
+      const unsigned id = (i * 37) % 1000;
+      int rc = fpta_cursor_open(wtxn, &own.id, fpta_value_uint(id),
+                                fpta_value_epsilon(), nullptr, fpta_unsorted,
+                                &cursor);
+      EXPECT_TRUE(rc == FPTA_OK || rc == FPTA_NODATA);
+      if (rc == FPTA_OK) {
+        EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+        EXPECT_EQ(FPTA_OK, fpta_get_column(row, &own.code, &value));
+        EXPECT_EQ(FPTA_OK,
+                  fpta_cursor_update(cursor, own.make_row(wpt, id, value.uint,
+                                                          i % 13)));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+
+      // изменяем первичный ключ строки, найденной по Code
+      const unsigned code = (i * 53 + 11) % 1000;
+      rc = fpta_cursor_open(wtxn, &own.code, fpta_value_uint(code),
+                            fpta_value_epsilon(), nullptr, fpta_unsorted,
+                            &cursor);
+      EXPECT_TRUE(rc == FPTA_OK || rc == FPTA_NODATA);
+      if (rc == FPTA_OK) {
+        EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+        EXPECT_EQ(FPTA_OK, fpta_get_column(row, &own.score, &value));
+        EXPECT_EQ(FPTA_OK,
+                  fpta_cursor_update(cursor, own.make_row(wpt, 10000 + i, code,
+                                                          value.sint)));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+
+      // удаляем и вставляем строки
+      const fpta_value victim = fpta_value_uint((i * 71 + 5) % 1000);
+      rc = fpta_delete_by_key(wtxn, &own.id, &victim);
+      EXPECT_TRUE(rc == FPTA_OK || rc == FPTA_NOTFOUND);
+      const fptu_ro fresh = own.make_row(wpt, 20000 + i, 20000 + i, i % 5);
+      EXPECT_EQ(FPTA_OK, fpta_insert_row(wtxn, &own.table, fresh));
+
+      // до публикации индекс не доступен для выборок
+      rc = fpta_cursor_open(wtxn, &own.score, fpta_value_begin(),
+                            fpta_value_end(), nullptr,
+                            fpta_unsorted_dont_fetch, &cursor);
+      EXPECT_TRUE(rc == FPTA_NO_INDEX || rc == FPTA_OK);
+      if (rc == FPTA_OK) {
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+      EXPECT_EQ(FPTA_OK, fpta_transaction_end(wtxn, false));
+    }
+    free(wpt);
+  });
+
+  EXPECT_EQ(FPTA_OK,
+            fpta_index_add_online(db, "online", "Score",
+                                  fpta_secondary_withdups_ordered_obverse, 3));
+  done = true;
+  writer.join();
+
+  const auto count_filtered = [&](fpta_name *column, int64_t score) {
+    fpta_filter filter;
+    filter.type = fpta_node_eq;
+    filter.node_cmp.left_id = column;
+    filter.node_cmp.right_value = fpta_value_sint(score);
+    fpta_cursor *cursor = nullptr;
+    EXPECT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, &local.id, fpta_value_begin(),
+                               fpta_value_end(), &filter,
+                               fpta_unsorted_dont_fetch, &cursor));
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    return count;
+  };
+
+  const auto count_range = [&](fpta_name *column, int64_t score) {
+    fpta_cursor *cursor = nullptr;
+    EXPECT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, column, fpta_value_sint(score),
+                               fpta_value_sint(score + 1), nullptr,
+                               fpta_unsorted_dont_fetch, &cursor));
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    return count;
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  local.refresh(txn);
+  EXPECT_EQ(score_num, local.score.column.num);
+  EXPECT_EQ(count_rows(txn, &local.id),
+            count_rows(txn, &local.score));
+  for (int64_t score = 0; score < 13; ++score)
+    EXPECT_EQ(count_filtered(&local.score, score),
+              count_range(&local.score, score));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // индекс уже существует
+  EXPECT_EQ(FPTA_EEXIST,
+            fpta_index_add_online(db, "online", "Score",
+                                  fpta_secondary_withdups_ordered_obverse, 0));
+
+  // при нарушении уникальности частично заполненный индекс удаляется
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_index_add_online(db, "online", "Group",
+                                  fpta_secondary_unique_ordered_obverse, 100));
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  local.refresh(txn);
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_NO_INDEX,
+            fpta_cursor_open(txn, &local.group, fpta_value_begin(),
+                             fpta_value_end(), nullptr,
+                             fpta_unsorted_dont_fetch, &cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK,
+            fpta_index_add_online(db, "online", "Group",
+                                  fpta_secondary_withdups_ordered_obverse, 0));
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  local.refresh(txn);
+  EXPECT_EQ(count_rows(txn, &local.id),
+            count_rows(txn, &local.group));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  free(pt);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,399 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_bitmap.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_bitmap.fpta" MDBX_LOCK_SUFFIX;
+
+static size_t bitmap_count(fpta_txn *txn, fpta_name *column_id,
+                           fpta_filter *filter, fpta_cursor_options options,
+                           fpta_cursor_stat *stat) {
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK,
+            fpta_cursor_open(txn, column_id, fpta_value_begin(),
+                             fpta_value_end(), filter, options, &cursor));
+  size_t count = 0;
+  for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS;
+       rc = fpta_cursor_move(cursor, fpta_next))
+    ++count;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, stat));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  return count;
+}
+
+TEST(Index, Bitmap) {
+  /* Smoke-проверка битовых индексов.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с двумя битовыми индексами по колонкам
+   *     Status и Flag, проверяя отказы для неподходящих индексов и PK.
+   *
+   *  2. Вставляем строки по одной и пакетом так, чтобы номера строк
+   *     попадали в несколько контейнеров, как в виде массивов, так
+   *     и в виде битовых карт.
+   *
+   *  3. Сверяем результаты курсоров с фильтрами из условий "И", "ИЛИ"
+   *     и "НЕ" на индексированные колонки, а также с условиями на другие
+   *     колонки, с ожидаемыми по модели данных, и проверяем что строки
+   *     отбрасываются по битовым индексам.
+   *
+   *  4. Изменяем и удаляем строки, повторяем проверки.
+   *
+   *  5. Очищаем таблицу, удаляем индекс и таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  16, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Name", fptu_cstr,
+                                          fpta_primary_unique_ordered_obverse,
+                                          &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Status", fptu_uint16,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  // номером строки может служить только PK фиксированного размера
+  EXPECT_EQ(FPTA_ETYPE, fpta_describe_index_bitmap("Status", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Status", fptu_uint16,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Flag", fptu_uint16,
+                         fpta_secondary_withdups_unordered_nullable_obverse,
+                         &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Code", fptu_uint32,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Name", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Qty", fptu_int32,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_bitmap("Id", &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_bitmap("Code", &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_bitmap("Qty", &def));
+  EXPECT_EQ(FPTA_ETYPE, fpta_describe_index_bitmap("Name", &def));
+  EXPECT_EQ(FPTA_COLUMN_MISSING, fpta_describe_index_bitmap("Nothing", &def));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_bitmap("Status", &def));
+  EXPECT_EQ(FPTA_EEXIST, fpta_describe_index_bitmap("Status", &def));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_bitmap("Flag", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "tickets", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_status, col_flag, col_code, col_name, col_qty;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "tickets"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_status, "Status"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_flag, "Flag"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_code, "Code"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_qty, "Qty"));
+  auto refresh = [&]() {
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_status));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_flag));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_code));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_qty));
+  };
+
+  /* модель данных: Status и Flag каждой строки, Flag = 0 означает null */
+  struct ticket {
+    unsigned status, flag;
+  };
+  std::map<uint64_t, ticket> model;
+  auto make_row = [&](fptu_rw *pt, uint64_t id, const ticket &t) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_status, fpta_value_uint(t.status)));
+    if (t.flag) {
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &col_flag, fpta_value_uint(t.flag)));
+    }
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_code,
+                                          fpta_value_uint(uint32_t(id))));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_name, fpta_value_cstr("ticket")));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_qty,
+                                          fpta_value_sint(int(id % 10))));
+    return fptu_take_noshrink(pt);
+  };
+  auto ticket_of = [](unsigned n) {
+    ticket t;
+    t.status = n % 7;
+    t.flag = (n % 3) ? n % 2 + 1 : 0;
+    return t;
+  };
+
+  //--------------------------------------------------------------------------
+  // вставляем строки по одной и пакетом
+  const unsigned total = 60000, batch = 1000;
+  fptu_rw *pt = fptu_alloc(6, 256);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  for (unsigned n = 0; n < total - batch; ++n) {
+    const uint64_t id = uint64_t(n) * 3;
+    model[id] = ticket_of(n);
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, make_row(pt, id, model[id])));
+  }
+  std::vector<fptu_rw *> batch_rows;
+  std::vector<fptu_ro> batch_ro;
+  for (unsigned n = total - batch; n < total; ++n) {
+    const uint64_t id = uint64_t(n) * 3;
+    model[id] = ticket_of(n);
+    batch_rows.push_back(fptu_alloc(6, 256));
+    ASSERT_NE(nullptr, batch_rows.back());
+    batch_ro.push_back(make_row(batch_rows.back(), id, model[id]));
+  }
+  EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &table, batch_ro.data(),
+                                    batch_ro.size(), fpta_insert, nullptr));
+  for (auto row : batch_rows)
+    free(row);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // сверяем выборки с моделью
+  fpta_filter status_eq, flag_eq, status_lt, qty_eq, and_node, or_node,
+      not_node, mixed_node;
+  status_eq.type = fpta_node_eq;
+  status_eq.node_cmp.left_id = &col_status;
+  status_eq.node_cmp.right_value = fpta_value_uint(3);
+  flag_eq.type = fpta_node_eq;
+  flag_eq.node_cmp.left_id = &col_flag;
+  flag_eq.node_cmp.right_value = fpta_value_uint(2);
+  status_lt.type = fpta_node_lt;
+  status_lt.node_cmp.left_id = &col_status;
+  status_lt.node_cmp.right_value = fpta_value_uint(2);
+  qty_eq.type = fpta_node_eq;
+  qty_eq.node_cmp.left_id = &col_qty;
+  qty_eq.node_cmp.right_value = fpta_value_sint(4);
+  and_node.type = fpta_node_and;
+  and_node.node_and.a = &status_eq;
+  and_node.node_and.b = &flag_eq;
+  not_node.type = fpta_node_not;
+  not_node.node_not = &and_node;
+  or_node.type = fpta_node_or;
+  or_node.node_or.a = &not_node;
+  or_node.node_or.b = &status_lt;
+  mixed_node.type = fpta_node_and;
+  mixed_node.node_and.a = &qty_eq;
+  mixed_node.node_and.b = &or_node;
+
+  /* exact - все колонки фильтров индексированы битовыми индексами */
+  auto check = [&](bool exact) {
+    size_t expect_and = 0, expect_or = 0, expect_mixed = 0, expect_null = 0;
+    for (const auto &i : model) {
+      const bool a = i.second.status == 3 && i.second.flag == 2;
+      const bool o = !a || i.second.status < 2;
+      expect_and += a;
+      expect_or += o;
+      expect_mixed += o && i.first % 10 == 4;
+      expect_null += i.second.flag == 0;
+    }
+
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+    fpta_cursor_stat stat;
+    EXPECT_EQ(expect_and, bitmap_count(txn, &col_id, &and_node, fpta_ascending,
+                                       &stat));
+    EXPECT_EQ(expect_and, stat.results);
+    // при переходах поиском отброшенные строки не перебираются
+    EXPECT_LT(0u, stat.bitmap_filtered);
+    EXPECT_GE(model.size() - expect_and, stat.bitmap_filtered);
+    EXPECT_EQ(expect_and, bitmap_count(txn, &col_id, &and_node, fpta_descending,
+                                       &stat));
+    if (exact) {
+      EXPECT_EQ(model.size() - expect_and, stat.bitmap_filtered);
+    }
+    EXPECT_EQ(expect_and, bitmap_count(txn, &col_code, &and_node, fpta_unsorted,
+                                       &stat));
+    if (exact) {
+      EXPECT_EQ(model.size() - expect_and, stat.bitmap_filtered);
+      EXPECT_EQ(0u, stat.pk_lookups);
+    }
+    EXPECT_EQ(expect_or, bitmap_count(txn, &col_id, &or_node, fpta_descending,
+                                      &stat));
+    if (exact) {
+      EXPECT_EQ(model.size() - expect_or, stat.bitmap_filtered);
+    }
+    // условие на колонку без битового индекса проверяется по строкам
+    EXPECT_EQ(expect_mixed, bitmap_count(txn, &col_id, &mixed_node,
+                                         fpta_descending, &stat));
+    if (exact) {
+      EXPECT_EQ(model.size() - expect_or, stat.bitmap_filtered);
+    }
+
+    // отсутствующее значение nullable-колонки
+    fpta_filter flag_null;
+    flag_null.type = fpta_node_eq;
+    flag_null.node_cmp.left_id = &col_flag;
+    flag_null.node_cmp.right_value = fpta_value_null();
+    EXPECT_EQ(expect_null, bitmap_count(txn, &col_id, &flag_null,
+                                        fpta_descending, &stat));
+    EXPECT_EQ(model.size() - expect_null, stat.bitmap_filtered);
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+
+    // в пишущей транзакции фильтр проверяется по строкам
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+    EXPECT_EQ(expect_and, bitmap_count(txn, &col_id, &and_node, fpta_ascending,
+                                       &stat));
+    EXPECT_EQ(0u, stat.bitmap_filtered);
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+    txn = nullptr;
+  };
+  check(true);
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  // к следующей подходящей строке курсор переходит поиском
+  fpta_cursor_stat cursor_stat;
+  bitmap_count(txn, &col_id, &and_node, fpta_ascending, &cursor_stat);
+  EXPECT_LT(0u, cursor_stat.index_searches);
+  EXPECT_GT(model.size() / 2, cursor_stat.index_scans);
+
+  // курсоры по самому битовому индексу не поддерживаются
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_NO_INDEX,
+            fpta_cursor_open(txn, &col_status, fpta_value_begin(),
+                             fpta_value_end(), nullptr, fpta_unsorted,
+                             &cursor));
+  size_t row_count = 0;
+  fpta_table_stat table_stat;
+  EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &row_count, &table_stat));
+  EXPECT_EQ(model.size(), row_count);
+  EXPECT_LT(0u, table_stat.bitmap_bytes);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // изменяем и удаляем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  unsigned n = 0;
+  for (auto i = model.begin(); i != model.end(); ++n) {
+    if (n % 5 == 0) {
+      ASSERT_EQ(FPTA_OK,
+                fpta_delete(txn, &table, make_row(pt, i->first, i->second)));
+      i = model.erase(i);
+      continue;
+    }
+    if (n % 5 == 1) {
+      i->second.status = 3;
+      i->second.flag = (n % 4) ? 2 : 0;
+      ASSERT_EQ(FPTA_OK, fpta_update_row(txn, &table,
+                                         make_row(pt, i->first, i->second)));
+    }
+    ++i;
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check(true);
+
+  //--------------------------------------------------------------------------
+  // после очистки таблицы битовые индексы пусты
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  ASSERT_EQ(FPTA_OK, fpta_table_clear(txn, &table, true));
+  model.clear();
+  for (unsigned i = 0; i < 100; ++i) {
+    model[i] = ticket_of(i);
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, make_row(pt, i, model[i])));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check(true);
+
+  // индекс удаляется вместе с таблицей битовых множеств
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_index_drop(txn, "tickets", "Status"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check(false);
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "tickets"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_status);
+  fpta_name_destroy(&col_flag);
+  fpta_name_destroy(&col_code);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_qty);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
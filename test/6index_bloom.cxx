@@ -0,0 +1,342 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+#include <atomic>
+#include <thread>
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_bloom.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_bloom.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Index, Bloom) {
+  /* Smoke-проверка фильтров Блума уникальных вторичных индексов.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с уникальным вторичным индексом по Email,
+   *     для которого включаем фильтр Блума, проверяя отказ для индексов
+   *     с дубликатами и недопустимого количества бит на ключ.
+   *
+   *  2. Вставляем строки несколькими транзакциями так, чтобы фильтр
+   *     несколько раз перестраивался с увеличением размера, и проверяем
+   *     поиск присутствующих и отсутствующих значений, а также контроль
+   *     уникальности.
+   *
+   *  3. Проверяем, что изменения отмененной транзакции не попадают
+   *     в фильтр, а после очистки таблицы фильтр становится пустым.
+   *
+   *  4. Повторно открываем базу, проверяем данные и удаляем индекс.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Email", fptu_cstr,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Name", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_bloom("Id", &def, 0));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_bloom("Name", &def, 0));
+  EXPECT_EQ(FPTA_COLUMN_MISSING, fpta_describe_index_bloom("Nothing", &def, 0));
+  EXPECT_EQ(FPTA_EINVAL, fpta_describe_index_bloom(
+                             "Email", &def, fpta_bloom_bits_max + 1));
+  EXPECT_EQ(FPTA_EINVAL, fpta_describe_index_bloom(
+                             "Email", &def, fpta_bloom_bits_min - 1));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_bloom("Email", &def, 0));
+  EXPECT_EQ(FPTA_EEXIST, fpta_describe_index_bloom("Email", &def, 16));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "accounts", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_email, col_name;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "accounts"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_email, "Email"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+
+  fptu_rw *pt = fptu_alloc(3, 256);
+  ASSERT_NE(nullptr, pt);
+  auto make_row = [&](unsigned id, const std::string &email) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_email, fpta_value_str(email)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_name,
+                                          fpta_value_cstr("name")));
+    return fptu_take_noshrink(pt);
+  };
+  auto email_of = [](unsigned id) {
+    return "user-" + std::to_string(id) + "@example.org";
+  };
+  fptu_ro row;
+  auto get_by_email = [&](unsigned id) {
+    const std::string email = email_of(id);
+    fpta_value value = fpta_value_str(email);
+    return fpta_get(txn, &col_email, &value, &row);
+  };
+
+  //--------------------------------------------------------------------------
+  // пока фильтр не построен, поиск не отсекается и не учитывается
+  // в статистике, в том числе как ложные срабатывания
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_email));
+  for (unsigned id = 0; id < 42; ++id) {
+    ASSERT_EQ(FPTA_NOTFOUND, get_by_email(id));
+  }
+  fpta_table_stat stat;
+  EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, nullptr, &stat));
+  EXPECT_EQ(0u, stat.bloom_lookups);
+  EXPECT_EQ(0u, stat.bloom_false_positives);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // вставляем строки несколькими транзакциями
+  const unsigned batch = 250, batches = 6;
+  for (unsigned b = 0; b < batches; ++b) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    ASSERT_NE(nullptr, txn);
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+    // при вставке с предварительной проверкой уникальности фильтр
+    // позволяет обойтись без поиска в индексе
+    for (unsigned id = b * batch; id < (b + 1) * batch; ++id)
+      ASSERT_EQ(FPTA_OK, fpta_probe_and_insert_row(
+                             txn, &table, make_row(id, email_of(id))));
+    // повтор значения в уникальном индексе
+    EXPECT_EQ(FPTA_KEYEXIST, fpta_probe_and_insert_row(
+                                 txn, &table, make_row(100500, email_of(b))));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  }
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_email));
+  for (unsigned id = 0; id < batch * batches; id += 7) {
+    ASSERT_EQ(FPTA_OK, get_by_email(id));
+  }
+  for (unsigned id = batch * batches; id < batch * batches * 2; ++id) {
+    ASSERT_EQ(FPTA_NOTFOUND, get_by_email(id));
+  }
+  size_t row_count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &row_count, &stat));
+  EXPECT_EQ(batch * batches, row_count);
+  EXPECT_LT(0u, stat.bloom_bytes);
+  EXPECT_LT(stat.bloom_negatives, stat.bloom_lookups);
+  EXPECT_GE(stat.bloom_lookups - stat.bloom_negatives,
+            stat.bloom_false_positives);
+  // ложные срабатывания крайне редки при 10 битах на ключ
+  EXPECT_LT(batch * batches * 9 / 10, stat.bloom_negatives);
+  EXPECT_GT(batch * batches / 10, stat.bloom_false_positives);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // читающие транзакции проверяют копию фильтра без блокировки,
+  // конкурентно с ее изменениями и перестроениями при вставке
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (unsigned t = 0; t < 4; ++t)
+    readers.push_back(std::thread([&, t]() {
+      fpta_name rtable, remail;
+      EXPECT_EQ(FPTA_OK, fpta_table_init(&rtable, "accounts"));
+      EXPECT_EQ(FPTA_OK, fpta_column_init(&rtable, &remail, "Email"));
+      for (unsigned n = t; !done.load() || n < 1000 + t; n += 4) {
+        fpta_txn *rtxn = nullptr;
+        EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &rtxn));
+        ASSERT_NE(nullptr, rtxn);
+        ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(rtxn, &rtable, &remail));
+        fptu_ro found;
+        const std::string present = email_of(n * 7 % (batch * batches));
+        fpta_value value = fpta_value_str(present);
+        ASSERT_EQ(FPTA_OK, fpta_get(rtxn, &remail, &value, &found));
+        const std::string absent = email_of(batch * batches * 10 + n);
+        value = fpta_value_str(absent);
+        ASSERT_EQ(FPTA_NOTFOUND, fpta_get(rtxn, &remail, &value, &found));
+        ASSERT_EQ(FPTA_OK, fpta_transaction_end(rtxn, false));
+      }
+      fpta_name_destroy(&remail);
+      fpta_name_destroy(&rtable);
+    }));
+  for (unsigned b = 0; b < batches; ++b) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    ASSERT_NE(nullptr, txn);
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+    for (unsigned id = (batches + b) * batch * 2;
+         id < (batches + b) * batch * 2 + batch; ++id)
+      ASSERT_EQ(FPTA_OK, fpta_probe_and_insert_row(
+                             txn, &table, make_row(id, email_of(id))));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, b % 2 != 0));
+    txn = nullptr;
+  }
+  done = true;
+  for (auto &reader : readers)
+    reader.join();
+
+  //--------------------------------------------------------------------------
+  // изменения отмененной транзакции не должны остаться в фильтре,
+  // а вставленные ключи сразу видны внутри пишущей транзакции
+  const unsigned ghost = batch * batches;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK,
+            fpta_insert_row(txn, &table, make_row(ghost, email_of(ghost))));
+  EXPECT_EQ(FPTA_OK, get_by_email(ghost));
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_probe_and_insert_row(txn, &table,
+                                      make_row(ghost + 1, email_of(ghost))));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  EXPECT_EQ(FPTA_NOTFOUND, get_by_email(ghost));
+  ASSERT_EQ(FPTA_OK,
+            fpta_probe_and_insert_row(txn, &table,
+                                      make_row(ghost + 1, email_of(ghost))));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_email));
+  EXPECT_EQ(FPTA_OK, get_by_email(ghost));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // после очистки таблицы фильтр пуст, но продолжает работать
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK, fpta_table_clear(txn, &table, true));
+  EXPECT_EQ(FPTA_NOTFOUND, get_by_email(1));
+  for (unsigned id = 0; id < batch; ++id)
+    ASSERT_EQ(FPTA_OK, fpta_probe_and_insert_row(txn, &table,
+                                                 make_row(id, email_of(id))));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_probe_and_insert_row(
+                               txn, &table, make_row(100500, email_of(1))));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // фильтр сохраняется в базе, а удаляется вместе с индексом
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  EXPECT_EQ(FPTA_OK, get_by_email(7));
+  EXPECT_EQ(FPTA_NOTFOUND, get_by_email(ghost));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_probe_and_insert_row(
+                               txn, &table, make_row(100500, email_of(7))));
+  EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &row_count, &stat));
+  EXPECT_EQ(batch, row_count);
+  EXPECT_LT(0u, stat.bloom_bytes);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_index_drop(txn, "accounts", "Email"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &row_count, &stat));
+  EXPECT_EQ(batch, row_count);
+  EXPECT_EQ(0u, stat.bloom_bytes);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "accounts"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_email);
+  fpta_name_destroy(&col_name);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,263 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_covering.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_covering.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Index, Covering) {
+  /* Smoke-проверка покрывающего вторичного индекса, в котором вместе
+   * с PK хранятся копии значений некоторых колонок строки.
+   *
+   * Сценарий:
+   *  1. Создаем базу с одной таблицей, в которой уникальный вторичный
+   *     индекс покрывает две неиндексированные колонки. Попутно проверяем
+   *     отказы для неуникального индекса и повторного описания.
+   *
+   *  2. Вставляем 10 строк.
+   *
+   *  3. Проверяем, что фильтр по покрываемым колонкам вычисляется без
+   *     чтения строк, а по остальным колонкам - с чтением.
+   *
+   *  4. Изменяем покрываемую колонку, значение PK и индексируемой колонки,
+   *     удаляем строки. После каждого изменения проверяем копии значений
+   *     в индексе и согласованность индексов.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Code", fptu_cstr,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Grp", fptu_uint32,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Qty", fptu_int64,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Price", fptu_fp64,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Note", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+  const char *const covered[] = {"Qty", "Price"};
+  EXPECT_EQ(FPTA_EFLAG,
+            fpta_describe_covering_index("Grp", &def, covered, 2));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_covering_index("Id", &def, covered, 2));
+  const char *const missing[] = {"Qty", "Nothing"};
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_describe_covering_index("Code", &def, missing, 2));
+  EXPECT_EQ(FPTA_OK, fpta_describe_covering_index("Code", &def, covered, 2));
+  EXPECT_EQ(FPTA_EEXIST,
+            fpta_describe_covering_index("Code", &def, covered, 1));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "goods", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // готовим идентификаторы и вставляем 10 строк
+  fpta_name table, col_id, col_code, col_grp, col_qty, col_price, col_note;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "goods"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_code, "Code"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_grp, "Grp"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_qty, "Qty"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_price, "Price"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_note, "Note"));
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_code));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_grp));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_qty));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_price));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_note));
+
+  const auto make_row = [&](fptu_rw *pt, unsigned id, const char *code,
+                            int64_t qty) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_code, fpta_value_cstr(code)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_grp, fpta_value_uint(id % 3)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_qty, fpta_value_sint(qty)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_price, fpta_value_float(id * 1.5)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_note, fpta_value_cstr("note")));
+    return fptu_take_noshrink(pt);
+  };
+
+  fptu_rw *pt = fptu_alloc(6, 8 * 4 + 32);
+  ASSERT_NE(nullptr, pt);
+  char code[16];
+  for (unsigned i = 0; i < 10; ++i) {
+    snprintf(code, sizeof(code), "c%02u", i);
+    EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table, make_row(pt, i, code,
+                                                              i * 10)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // фильтр по покрываемым колонкам вычисляется без чтения строк
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_filter filter;
+  filter.type = fpta_node_ge;
+  filter.node_cmp.left_id = &col_qty;
+  filter.node_cmp.right_value = fpta_value_sint(50);
+  size_t pk_lookups = ~size_t(0);
+  EXPECT_EQ(5u, count_covered(txn, &col_code, &filter, &pk_lookups));
+  EXPECT_EQ(0u, pk_lookups);
+
+  // тот же фильтр по неполностью покрывающему индексу требует чтения строк
+  EXPECT_EQ(5u, count_covered(txn, &col_grp, &filter, &pk_lookups));
+  EXPECT_LT(0u, pk_lookups);
+  filter.node_cmp.left_id = &col_note;
+  filter.node_cmp.right_value = fpta_value_cstr("note");
+  filter.type = fpta_node_eq;
+  EXPECT_EQ(10u, count_covered(txn, &col_code, &filter, &pk_lookups));
+  EXPECT_LT(0u, pk_lookups);
+
+  // копии значений доступны через курсор без чтения строки
+  fpta_cursor *cursor = nullptr;
+  fpta_value value = fpta_value_cstr("c07");
+  EXPECT_EQ(FPTA_OK,
+            fpta_cursor_open(txn, &col_code, value, fpta_value_epsilon(),
+                             nullptr, fpta_unsorted, &cursor));
+  fptu_ro projection;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_get_covered(cursor, &projection));
+  EXPECT_EQ(nullptr, fptu_check_ro(projection));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(projection, &col_qty, &value));
+  EXPECT_EQ(70, value.sint);
+  EXPECT_EQ(FPTA_OK, fpta_get_column(projection, &col_price, &value));
+  EXPECT_EQ(7 * 1.5, value.fp);
+  EXPECT_EQ(FPTA_NODATA, fpta_get_column(projection, &col_note, &value));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // изменяем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+
+  // изменяется только покрываемая колонка
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(pt, 3, "c03", 1000)));
+  // изменяется индексируемая колонка
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table, make_row(pt, 4, "x04", 40)));
+  value = fpta_value_cstr("c04");
+  fptu_ro row;
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_code, &value, &row));
+  value = fpta_value_cstr("x04");
+  EXPECT_EQ(FPTA_OK, fpta_get(txn, &col_code, &value, &row));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &value));
+  EXPECT_EQ(4u, value.uint);
+
+  // через курсор изменяется PK и покрываемая колонка
+  value = fpta_value_cstr("c05");
+  EXPECT_EQ(FPTA_OK,
+            fpta_cursor_open(txn, &col_code, value, fpta_value_epsilon(),
+                             nullptr, fpta_unsorted, &cursor));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_update(cursor, make_row(pt, 105, "c05", 5)));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_get_covered(cursor, &projection));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(projection, &col_qty, &value));
+  EXPECT_EQ(5, value.sint);
+  EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &value));
+  EXPECT_EQ(105u, value.uint);
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+  // удаляем строки
+  value = fpta_value_cstr("c01");
+  EXPECT_EQ(FPTA_OK, fpta_delete_by_key(txn, &col_code, &value));
+  EXPECT_EQ(FPTA_OK, fpta_delete(txn, &table, make_row(pt, 2, "c02", 20)));
+  free(pt);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // проверяем копии значений и согласованность индексов
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  filter.type = fpta_node_ge;
+  filter.node_cmp.left_id = &col_qty;
+  filter.node_cmp.right_value = fpta_value_sint(40);
+  /* 1000 (c03), 40 (x04), 60..90 (c06..c09) */
+  EXPECT_EQ(6u, count_covered(txn, &col_code, &filter, &pk_lookups));
+  EXPECT_EQ(0u, pk_lookups);
+  EXPECT_EQ(6u, count_covered(txn, &col_id, &filter, &pk_lookups));
+  EXPECT_EQ(8u, count_rows(txn, &col_id));
+  EXPECT_EQ(8u, count_rows(txn, &col_code));
+  EXPECT_EQ(8u, count_rows(txn, &col_grp));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_code);
+  fpta_name_destroy(&col_grp);
+  fpta_name_destroy(&col_qty);
+  fpta_name_destroy(&col_price);
+  fpta_name_destroy(&col_note);
+
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
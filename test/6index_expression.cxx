@@ -0,0 +1,347 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_expression.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_expression.fpta" MDBX_LOCK_SUFFIX;
+
+static int key_lower(fptu_ro row, fpta_value *value, void *buffer,
+                     void *context) {
+  fpta_value email;
+  int rc = fpta_get_column(row, (const fpta_name *)context, &email);
+  if (rc != FPTA_OK)
+    return rc;
+  if (email.binary_length > fpta_key_function_buffer)
+    return FPTA_DATALEN_MISMATCH;
+  char *const lower = (char *)buffer;
+  for (unsigned i = 0; i < email.binary_length; ++i)
+    lower[i] = (char)tolower((unsigned char)email.str[i]);
+  *value = fpta_value_string(lower, email.binary_length);
+  return FPTA_OK;
+}
+
+static int key_day(fptu_ro row, fpta_value *value, void *buffer,
+                   void *context) {
+  (void)buffer;
+  fpta_value stamp;
+  int rc = fpta_get_column(row, (const fpta_name *)context, &stamp);
+  if (rc == FPTA_NODATA)
+    /* nullptr-значение, т.е. колонка-выражение также отсутствует */
+    return FPTA_OK;
+  if (rc != FPTA_OK)
+    return rc;
+  *value = fpta_value_uint(stamp.uint / 86400);
+  return FPTA_OK;
+}
+
+TEST(Index, Expression) {
+  /* Smoke-проверка индексов по выражениям, ключи которых вычисляются
+   * зарегистрированными в БД функциями и не хранятся в строках.
+   *
+   * Сценарий:
+   *  1. Создаем базу, регистрируем функции "lower" (приведение Email
+   *     к нижнему регистру) и "day" (номер суток по Stamp), после чего
+   *     создаем таблицу с уникальным индексом по "lower" и составным
+   *     индексом, в который входит не-индексируемая колонка "day".
+   *     Попутно проверяем отказы для первичного индекса, повторного
+   *     описания и повторной регистрации.
+   *
+   *  2. Вставляем строки и проверяем, что уникальность контролируется
+   *     по вычисленному значению, а поиск и выборка по индексам
+   *     производится по значениям результатов функций.
+   *
+   *  3. Изменяем и удаляем строки, после чего повторно открываем базу
+   *     и проверяем, что без регистрации функций изменение данных
+   *     невозможно, а после регистрации индексы согласованы.
+   *
+   *  4. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // готовим идентификаторы, они же передаются функциям как контекст
+  fpta_name table, col_id, col_email, col_stamp, col_lower, col_day,
+      col_day_email;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "people"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_email, "Email"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_stamp, "Stamp"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_lower, "EmailLower"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_day, "Day"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_day_email, "DayEmail"));
+
+  const auto register_functions = [&](fpta_db *db) {
+    EXPECT_EQ(FPTA_OK, fpta_db_register_key_function(db, "lower", key_lower,
+                                                     &col_email));
+    EXPECT_EQ(FPTA_OK, fpta_db_register_key_function(db, "day", key_day,
+                                                     &col_stamp));
+  };
+
+  // создаем базу и регистрируем функции
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+  register_functions(db);
+  EXPECT_EQ(FPTA_EEXIST, fpta_db_register_key_function(db, "lower", key_lower,
+                                                       &col_email));
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_db_register_key_function(db, "upper", nullptr, nullptr));
+  EXPECT_EQ(FPTA_ENAME, fpta_db_register_key_function(
+                            db, "not a name", key_lower, &col_email));
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Email", fptu_cstr, fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Stamp", fptu_uint64,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "EmailLower", fptu_cstr,
+                         fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Day", fptu_uint32,
+                                          fpta_noindex_nullable, &def));
+  const char *const day_email[] = {"Day", "Email"};
+  EXPECT_EQ(FPTA_OK, fpta_describe_composite_index(
+                         "DayEmail", fpta_secondary_withdups_ordered_obverse,
+                         &def, day_email, 2));
+
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_expression_column("Id", &def, "lower"));
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_describe_expression_column("Nothing", &def, "lower"));
+  EXPECT_EQ(FPTA_OK,
+            fpta_describe_expression_column("EmailLower", &def, "lower"));
+  EXPECT_EQ(FPTA_EEXIST,
+            fpta_describe_expression_column("EmailLower", &def, "day"));
+  EXPECT_EQ(FPTA_OK, fpta_describe_expression_column("Day", &def, "day"));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "people", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  const auto refresh = [&]() {
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_email));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_stamp));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_lower));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_day));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_day_email));
+  };
+
+  // строки без значения Stamp (stamp == 0) не имеют и значения Day
+  fptu_rw *pt = fptu_alloc(4, 8 * 2 + 64);
+  ASSERT_NE(nullptr, pt);
+  const auto make_row = [&](unsigned id, const char *email, uint64_t stamp) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_email, fpta_value_cstr(email)));
+    if (stamp) {
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(pt, &col_stamp, fpta_value_uint(stamp)));
+    }
+    return fptu_take_noshrink(pt);
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table,
+                                     make_row(1, "Alice@X.org", 86400 + 1)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_insert_row(txn, &table, make_row(2, "bob@x.org", 86400 * 2)));
+  EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table,
+                                     make_row(3, "CAROL@x.org", 86400 + 7)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_insert_row(txn, &table, make_row(4, "Dave@x.org", 0)));
+  EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table,
+                                     make_row(5, "eve@X.ORG", 86400 * 3)));
+  // уникальность контролируется по вычисленному значению
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_probe_and_put(txn, &table, make_row(6, "ALICE@x.org", 0),
+                               fpta_insert));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  const auto check = [&](unsigned expect_rows, unsigned expect_range,
+                         unsigned expect_day1) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+
+    // точечный поиск по значению функции
+    fptu_ro row;
+    fpta_value value = fpta_value_cstr("alice@x.org");
+    ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_lower, &value, &row));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &value));
+    EXPECT_EQ(1u, value.uint);
+    // значения колонки-выражения в строке нет
+    EXPECT_EQ(FPTA_NODATA, fpta_get_column(row, &col_lower, &value));
+    value = fpta_value_cstr("Alice@X.org");
+    EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_lower, &value, &row));
+
+    // все строки в порядке значений функции, без учета регистра
+    fpta_cursor *cursor = nullptr;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_lower, fpta_value_begin(),
+                                        fpta_value_end(), nullptr,
+                                        fpta_ascending, &cursor));
+    ASSERT_NE(nullptr, cursor);
+    unsigned rows = 0;
+    std::string prev;
+    for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+         rc = fpta_cursor_move(cursor, fpta_next)) {
+      ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+      EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_email, &value));
+      std::string lower(value.str, value.binary_length);
+      std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+      EXPECT_LT(prev, lower);
+      prev = lower;
+      ++rows;
+    }
+    EXPECT_EQ(expect_rows, rows);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // диапазон по значениям функции
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_lower, fpta_value_cstr("b"),
+                                        fpta_value_cstr("d"), nullptr,
+                                        fpta_unsorted_dont_fetch, &cursor));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(expect_range, count);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // составной индекс упорядочен по вычисленному Day
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_day_email,
+                                        fpta_value_begin(), fpta_value_end(),
+                                        nullptr, fpta_ascending, &cursor));
+    ASSERT_NE(nullptr, cursor);
+    unsigned day1 = 0;
+    uint64_t prev_day = 0;
+    rows = 0;
+    for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+         rc = fpta_cursor_move(cursor, fpta_next)) {
+      ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+      ++rows;
+      if (fpta_get_column(row, &col_stamp, &value) != FPTA_OK)
+        continue;
+      const uint64_t day = value.uint / 86400;
+      EXPECT_LE(prev_day, day);
+      prev_day = day;
+      day1 += (day == 1);
+    }
+    EXPECT_EQ(expect_rows, rows);
+    EXPECT_EQ(expect_day1, day1);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  };
+  /* в диапазон [b, d) попадают bob и carol */
+  check(5, 2, 2);
+
+  //--------------------------------------------------------------------------
+  // изменяем и удаляем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  // изменение регистра не меняет ключ
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table,
+                                     make_row(2, "BOB@x.org", 86400 * 2)));
+  // новый адрес и сутки
+  EXPECT_EQ(FPTA_OK, fpta_update_row(txn, &table,
+                                     make_row(3, "Zoe@x.org", 86400 * 4)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(4, "Dave@x.org", 86400)));
+  EXPECT_EQ(FPTA_OK, fpta_delete(txn, &table,
+                                 make_row(5, "eve@X.ORG", 86400 * 3)));
+  fpta_value value = fpta_value_cstr("carol@x.org");
+  fptu_ro row;
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_lower, &value, &row));
+  value = fpta_value_cstr("zoe@x.org");
+  EXPECT_EQ(FPTA_OK, fpta_get(txn, &col_lower, &value, &row));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check(4, 1, 2);
+
+  // в схеме сохраняются только имена функций
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, false, &db));
+  ASSERT_NE(nullptr, db);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  EXPECT_EQ(FPTA_ENOIMP,
+            fpta_insert_row(txn, &table, make_row(6, "frank@x.org", 0)));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  register_functions(db);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  EXPECT_EQ(FPTA_OK,
+            fpta_insert_row(txn, &table, make_row(6, "frank@x.org", 86400)));
+  free(pt);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check(5, 1, 3);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_email);
+  fpta_name_destroy(&col_stamp);
+  fpta_name_destroy(&col_lower);
+  fpta_name_destroy(&col_day);
+  fpta_name_destroy(&col_day_email);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
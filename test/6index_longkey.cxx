@@ -0,0 +1,405 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_longkey.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_longkey.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Index, LongKey) {
+  /* Smoke-проверка индексов с увеличенным лимитом длины ключа, в которых
+   * длинные строки не подрезаются с дополнением хэшем, а точно сохраняют
+   * порядок сортировки.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с первичным индексом по Url и вторичным
+   *     реверсивным индексом по Host, для которых задаем лимиты длины
+   *     ключа. Попутно проверяем отказы для неподходящих колонок,
+   *     лимитов и повторного описания, а также для лимита больше
+   *     допустимого размера ключа в БД.
+   *
+   *  2. Вставляем строки с длинными значениями, различающимися только
+   *     за пределами fpta_max_keylen, и проверяем порядок, точность
+   *     выборки по диапазону, поиск и значения ключей курсора.
+   *
+   *  3. Изменяем и удаляем строки, после чего повторно открываем базу
+   *     и проверяем, что лимиты сохраняются в схеме.
+   *
+   *  4. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  const auto describe_columns = [&def]() {
+    EXPECT_EQ(FPTA_OK, fpta_column_set_reset(&def));
+    EXPECT_EQ(FPTA_OK,
+              fpta_column_describe("Url", fptu_cstr,
+                                   fpta_primary_unique_ordered_obverse, &def));
+    EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                           "Host", fptu_cstr,
+                           fpta_secondary_withdups_ordered_reverse, &def));
+    EXPECT_EQ(FPTA_OK, fpta_column_describe("Hits", fptu_uint64,
+                                            fpta_index_none, &def));
+  };
+
+  describe_columns();
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Title", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse_nullable,
+                         &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_keylen("Hits", &def, 400));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_keylen("Title", &def, 400));
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_describe_index_keylen("Nothing", &def, 400));
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_describe_index_keylen("Url", &def, fpta_max_keylen));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("Url", &def, 400));
+  EXPECT_EQ(FPTA_EEXIST, fpta_describe_index_keylen("Url", &def, 200));
+
+  // лимит превышает допустимый для БД размер ключа
+  describe_columns();
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("Host", &def, 60000));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  EXPECT_EQ(FPTA_DATALEN_MISMATCH, fpta_table_create(txn, "links", &def));
+
+  describe_columns();
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("Url", &def, 400));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("Host", &def, 200));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "links", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_url, col_host, col_hits;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "links"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_url, "Url"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_host, "Host"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_hits, "Hits"));
+
+  const auto refresh = [&]() {
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_url));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_host));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_hits));
+  };
+
+  /* значения различаются только за пределами fpta_max_keylen,
+   * для Url в конце, а для реверсивного Host в начале */
+  const std::string path = "https://example.org/" + std::string(100, 'p');
+  const std::string domain = std::string(100, 'd') + ".example.org";
+  const auto url = [&](char c) { return path + c; };
+  const auto host = [&](char c) { return c + domain; };
+
+  fptu_rw *pt = fptu_alloc(4, 8 + 1024);
+  ASSERT_NE(nullptr, pt);
+  const auto make_row = [&](const std::string &u, const std::string &h,
+                            uint64_t hits) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_url, fpta_value_str(u)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_host, fpta_value_str(h)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_hits, fpta_value_uint(hits)));
+    return fptu_take_noshrink(pt);
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  const char *const order = "ecadb";
+  for (const char *c = order; *c; ++c)
+    EXPECT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, make_row(url(*c), host(*c), 0)));
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_probe_and_put(txn, &table, make_row(url('a'), host('z'), 0),
+                               fpta_insert));
+  // значения длиннее лимита отвергаются
+  EXPECT_EQ(FPTA_DATALEN_MISMATCH,
+            fpta_probe_and_put(txn, &table,
+                               make_row(path + std::string(400, 'x'),
+                                        host('z'), 0),
+                               fpta_insert));
+  EXPECT_EQ(FPTA_DATALEN_MISMATCH,
+            fpta_probe_and_put(txn, &table,
+                               make_row(url('z'), domain + domain, 0),
+                               fpta_insert));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  const auto check = [&](const std::string &expect_urls,
+                         unsigned expect_range) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+
+    // точный порядок и полные значения ключей
+    fpta_cursor *cursor = nullptr;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_url, fpta_value_begin(),
+                                        fpta_value_end(), nullptr,
+                                        fpta_ascending, &cursor));
+    ASSERT_NE(nullptr, cursor);
+    std::string urls;
+    fptu_ro row;
+    fpta_value value, key;
+    for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+         rc = fpta_cursor_move(cursor, fpta_next)) {
+      ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+      ASSERT_EQ(FPTA_OK, fpta_cursor_key(cursor, &key));
+      EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_url, &value));
+      ASSERT_EQ(fpta_string, key.type);
+      EXPECT_EQ(std::string(value.str, value.binary_length),
+                std::string(key.str, key.binary_length));
+      urls += value.str[value.binary_length - 1];
+    }
+    EXPECT_EQ(expect_urls, urls);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // реверсивный индекс упорядочен по началу значений
+    EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_host, fpta_value_begin(),
+                                        fpta_value_end(), nullptr,
+                                        fpta_descending, &cursor));
+    ASSERT_NE(nullptr, cursor);
+    std::string hosts;
+    for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+         rc = fpta_cursor_move(cursor, fpta_next)) {
+      ASSERT_EQ(FPTA_OK, fpta_cursor_key(cursor, &key));
+      ASSERT_EQ(fpta_string, key.type);
+      hosts += key.str[0];
+    }
+    std::string reversed(expect_urls.rbegin(), expect_urls.rend());
+    EXPECT_EQ(reversed, hosts);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // диапазон точный, без захвата соседних значений
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, &col_url, fpta_value_str(url('b')),
+                               fpta_value_str(url('d')), nullptr,
+                               fpta_unsorted_dont_fetch, &cursor));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(expect_range, count);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // граница epsilon переносится из длинного ключа последней строки
+    EXPECT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, &col_url, fpta_value_epsilon(),
+                               fpta_value_end(), nullptr,
+                               fpta_ascending_dont_fetch, &cursor));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+    EXPECT_EQ(1u, count);
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+    // точечный поиск по длинному значению
+    const std::string last = url(expect_urls.back());
+    value = fpta_value_str(last);
+    ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_url, &value, &row));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_host, &value));
+    EXPECT_EQ(host(expect_urls.back()),
+              std::string(value.str, value.binary_length));
+    value = fpta_value_str(url('z'));
+    EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_url, &value, &row));
+
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  };
+  /* в диапазон [b, d) попадают b и c */
+  check("abcde", 2);
+
+  //--------------------------------------------------------------------------
+  // изменяем и удаляем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  // прежние длинные ключи вторичного индекса удаляются
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(url('b'), host('b'), 42)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_delete(txn, &table, make_row(url('c'), host('c'), 0)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_upsert_row(txn, &table, make_row(url('f'), host('f'), 1)));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check("abdef", 1);
+
+  //--------------------------------------------------------------------------
+  // длинный PK при пакетной вставке, загрузке и удалении по ключу
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Ref", fptu_cstr,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe(
+                "Code", fptu_uint64,
+                fpta_secondary_unique_ordered_obverse_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("Ref", &def, 400));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "refs", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name refs, col_ref, col_code;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&refs, "refs"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&refs, &col_ref, "Ref"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&refs, &col_code, "Code"));
+
+  /* ключи длиннее fpta_keybuf_len, упорядоченные по возрастанию,
+   * а Code на единицу больше номера, так как ноль обозначает NULL */
+  const auto ref_of = [&](unsigned n) {
+    char tail[16];
+    snprintf(tail, sizeof(tail), "%05u", n);
+    return path + tail;
+  };
+  std::vector<std::string> ref_values;
+  std::vector<fptu_rw *> ref_rows;
+  const auto make_batch = [&](unsigned from, unsigned to) {
+    std::vector<fptu_ro> batch;
+    for (unsigned n = from; n < to; ++n) {
+      ref_values.push_back(ref_of(n));
+      ref_rows.push_back(fptu_alloc(4, 8 + 1024));
+      fptu_rw *row = ref_rows.back();
+      EXPECT_EQ(FPTA_OK, fpta_upsert_column(row, &col_ref,
+                                            fpta_value_str(ref_values.back())));
+      EXPECT_EQ(FPTA_OK,
+                fpta_upsert_column(row, &col_code, fpta_value_uint(n + 1)));
+      batch.push_back(fptu_take_noshrink(row));
+    }
+    return batch;
+  };
+
+  for (unsigned round = 0; round < 2; ++round) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    ASSERT_NE(nullptr, txn);
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &refs, &col_ref));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_code));
+    const std::vector<fptu_ro> batch = make_batch(round * 50, round * 50 + 50);
+    EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &refs, batch.data(), batch.size(),
+                                      fpta_insert, nullptr));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  }
+
+  // значение вторичного индекса в "грязной" странице длиннее ключа
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  const std::vector<fptu_ro> dirty = make_batch(100, 110);
+  EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &refs, dirty.data(), dirty.size(),
+                                    fpta_insert, nullptr));
+  for (unsigned n : {105u, 42u}) {
+    fpta_value code = fpta_value_uint(n + 1);
+    EXPECT_EQ(FPTA_OK, fpta_delete_by_key(txn, &col_code, &code));
+    EXPECT_EQ(FPTA_NOTFOUND, fpta_delete_by_key(txn, &col_code, &code));
+    fpta_value ref = fpta_value_str(ref_of(n));
+    fptu_ro row;
+    EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_ref, &ref, &row));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // загрузка в непустую таблицу
+  fpta_loader *loader = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &refs, nullptr, 0, &loader));
+  ASSERT_NE(nullptr, loader);
+  for (const fptu_ro &row : make_batch(110, 150))
+    EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, row));
+  ASSERT_EQ(FPTA_OK, fpta_loader_end(loader, false));
+  for (auto row : ref_rows)
+    free(row);
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK,
+            fpta_cursor_open(txn, &col_ref, fpta_value_begin(),
+                             fpta_value_end(), nullptr, fpta_ascending,
+                             &cursor));
+  ASSERT_NE(nullptr, cursor);
+  size_t loaded = 0;
+  for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+       rc = fpta_cursor_move(cursor, fpta_next)) {
+    fptu_ro row;
+    fpta_value code, ref;
+    ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+    ASSERT_EQ(FPTA_OK, fpta_get_column(row, &col_code, &code));
+    EXPECT_NE(106u, code.uint);
+    EXPECT_NE(43u, code.uint);
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_ref, &ref));
+    EXPECT_EQ(ref_of(unsigned(code.uint) - 1),
+              std::string(ref.str, ref.binary_length));
+    ++loaded;
+  }
+  EXPECT_EQ(148u, loaded);
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  fpta_name_destroy(&refs);
+  fpta_name_destroy(&col_ref);
+  fpta_name_destroy(&col_code);
+
+  // лимиты сохраняются в схеме
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, false, &db));
+  ASSERT_NE(nullptr, db);
+  check("abdef", 1);
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_url);
+  fpta_name_destroy(&col_host);
+  fpta_name_destroy(&col_hits);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,350 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+#include <set>
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_multivalued.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_multivalued.fpta" MDBX_LOCK_SUFFIX;
+
+static size_t multivalued_scan(fpta_txn *txn, fpta_name *col_tag,
+                               fpta_name *col_id, const char *tag,
+                               std::multiset<uint64_t> &ids) {
+  fpta_cursor *cursor = nullptr;
+  ids.clear();
+  const int err = fpta_cursor_open(
+      txn, col_tag, tag ? fpta_value_cstr(tag) : fpta_value_begin(),
+      tag ? fpta_value_epsilon() : fpta_value_end(), nullptr, fpta_ascending,
+      &cursor);
+  // для пустого диапазона курсор не открывается
+  if (err == FPTA_NODATA)
+    return 0;
+  EXPECT_EQ(FPTA_OK, err);
+  for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS;
+       rc = fpta_cursor_move(cursor, fpta_next)) {
+    fptu_ro row;
+    fpta_value id;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, col_id, &id));
+    ids.insert(id.uint);
+  }
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  return ids.size();
+}
+
+TEST(Index, Multivalued) {
+  /* Smoke-проверка многозначных индексов.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с многозначным индексом по колонке Tag,
+   *     проверяя отказы для неподходящих индексов и PK.
+   *
+   *  2. Наполняем таблицу загрузчиком, пакетом и по одной строке, при этом
+   *     строки содержат по несколько значений Tag, включая повторы,
+   *     а часть строк не содержит значений вовсе.
+   *
+   *  3. Сверяем выборки курсоров по каждому значению Tag с моделью данных.
+   *
+   *  4. Изменяем наборы значений, удаляем строки напрямую и через курсор,
+   *     обновляем строки через курсор, повторяя проверки.
+   *
+   *  5. Удаляем таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  16, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Tag", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse_nullable,
+                         &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Code", fptu_uint32,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Name", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Qty", fptu_int32,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_multivalued("Id", &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_multivalued("Code", &def));
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_index_multivalued("Qty", &def));
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_describe_index_multivalued("Nothing", &def));
+  EXPECT_EQ(FPTA_OK, fpta_describe_index_multivalued("Tag", &def));
+  EXPECT_EQ(FPTA_EEXIST, fpta_describe_index_multivalued("Tag", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "posts", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_tag, col_code, col_name, col_qty;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "posts"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_tag, "Tag"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_code, "Code"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_qty, "Qty"));
+  auto refresh = [&]() {
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_tag));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_code));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+    EXPECT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_qty));
+  };
+
+  /* модель данных: значения Tag каждой строки в порядке добавления */
+  std::map<uint64_t, std::vector<std::string>> model;
+  auto make_row = [&](fptu_rw *pt, uint64_t id,
+                      const std::vector<std::string> &tags) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_code,
+                                          fpta_value_uint(uint32_t(id))));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_name, fpta_value_cstr("post")));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_qty,
+                                          fpta_value_sint(int(id % 10))));
+    for (const auto &tag : tags)
+      EXPECT_EQ(FPTA_OK,
+                fpta_insert_column(pt, &col_tag, fpta_value_cstr(tag.c_str())));
+    return fptu_take_noshrink(pt);
+  };
+  auto tags_of = [](unsigned n) {
+    std::vector<std::string> tags;
+    if (n % 13) {
+      tags.push_back("a" + std::to_string(n % 5));
+      tags.push_back("b" + std::to_string(n % 7));
+      tags.push_back("c" + std::to_string(n % 11));
+      // повтор значения в строке индексируется один раз
+      tags.push_back(tags.front());
+    }
+    return tags;
+  };
+
+  auto check = [&]() {
+    std::map<std::string, std::multiset<uint64_t>> expect;
+    size_t expect_total = 0;
+    for (const auto &i : model) {
+      const std::set<std::string> tags(i.second.begin(), i.second.end());
+      for (const auto &tag : tags)
+        expect[tag].insert(i.first);
+      // строка без значений индексируется как NULL
+      expect_total += tags.empty() ? 1 : tags.size();
+    }
+    // значения, которых больше нет в строках
+    for (const char *gone : {"a0", "b0", "c0", "z9"})
+      expect.emplace(gone, std::multiset<uint64_t>());
+
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    refresh();
+    std::multiset<uint64_t> ids;
+    for (const auto &i : expect) {
+      EXPECT_EQ(i.second.size(), multivalued_scan(txn, &col_tag, &col_id,
+                                                  i.first.c_str(), ids));
+      EXPECT_EQ(i.second, ids);
+    }
+    EXPECT_EQ(expect_total,
+              multivalued_scan(txn, &col_tag, &col_id, nullptr, ids));
+    size_t row_count = 0;
+    fpta_table_stat stat;
+    EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &row_count, &stat));
+    EXPECT_EQ(model.size(), row_count);
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  };
+
+  //--------------------------------------------------------------------------
+  // наполняем таблицу загрузчиком, пакетом и по одной строке
+  const unsigned loaded = 3000, batch = 500, single = 500;
+  fptu_rw *pt = fptu_alloc(16, 512);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // значения добавляются только в многозначную колонку
+  EXPECT_EQ(FPTA_EFLAG,
+            fpta_insert_column(pt, &col_name, fpta_value_cstr("post")));
+  EXPECT_EQ(FPTA_EVALUE, fpta_insert_column(pt, &col_tag, fpta_value_null()));
+
+  fpta_loader *loader = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &table, nullptr, 0, &loader));
+  ASSERT_NE(nullptr, loader);
+  for (unsigned n = loaded; n > 0; --n) {
+    const uint64_t id = uint64_t(n) * 2;
+    model[id] = tags_of(n);
+    ASSERT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(pt, id, model[id])));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_loader_end(loader, false));
+  check();
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  std::vector<fptu_rw *> batch_rows;
+  std::vector<fptu_ro> batch_ro;
+  for (unsigned n = loaded; n < loaded + batch; ++n) {
+    // в пакете есть как новые, так и уже имеющиеся строки
+    const uint64_t id = uint64_t(n) * 2 - batch;
+    model[id] = tags_of(n);
+    batch_rows.push_back(fptu_alloc(16, 512));
+    ASSERT_NE(nullptr, batch_rows.back());
+    batch_ro.push_back(make_row(batch_rows.back(), id, model[id]));
+  }
+  EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &table, batch_ro.data(),
+                                    batch_ro.size(), fpta_upsert, nullptr));
+  for (auto row : batch_rows)
+    free(row);
+  for (unsigned n = loaded + batch; n < loaded + batch + single; ++n) {
+    const uint64_t id = uint64_t(n) * 2;
+    model[id] = tags_of(n);
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, make_row(pt, id, model[id])));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check();
+
+  //--------------------------------------------------------------------------
+  // изменяем наборы значений и удаляем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  unsigned n = 0;
+  for (auto i = model.begin(); i != model.end(); ++n) {
+    if (n % 7 == 0) {
+      ASSERT_EQ(FPTA_OK,
+                fpta_delete(txn, &table, make_row(pt, i->first, i->second)));
+      i = model.erase(i);
+      continue;
+    }
+    auto &tags = i->second;
+    if (n % 7 == 1) {
+      // убираем одно значение, добавляем новое
+      if (!tags.empty())
+        tags.erase(tags.begin() + 1);
+      tags.push_back("d" + std::to_string(n % 3));
+    } else if (n % 7 == 2) {
+      tags.clear();
+    } else if (n % 7 == 3) {
+      tags = {"e", "e", "d0"};
+    } else {
+      ++i;
+      continue;
+    }
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_row(txn, &table, make_row(pt, i->first, tags)));
+    ++i;
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check();
+
+  //--------------------------------------------------------------------------
+  // изменяем и удаляем строки через курсор по многозначному индексу
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  refresh();
+  fpta_cursor *cursor = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_tag, fpta_value_cstr("d0"),
+                                      fpta_value_epsilon(), nullptr,
+                                      fpta_ascending, &cursor));
+  n = 0;
+  for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS; ++n) {
+    fptu_ro row;
+    fpta_value id;
+    ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+    ASSERT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &id));
+    auto &tags = model[id.uint];
+    if (n % 2 == 0) {
+      ASSERT_EQ(FPTA_OK, fpta_cursor_delete(cursor));
+      model.erase(id.uint);
+      rc = fpta_cursor_eof(cursor);
+      continue;
+    }
+    // без текущего значения курсора строка не может быть изменена
+    const std::vector<std::string> without = {"f"};
+    EXPECT_EQ(FPTA_KEY_MISMATCH,
+              fpta_cursor_update(cursor, make_row(pt, id.uint, without)));
+    tags = {"f", "d0", "f"};
+    ASSERT_EQ(FPTA_OK, fpta_cursor_update(cursor, make_row(pt, id.uint, tags)));
+    rc = fpta_cursor_move(cursor, fpta_next);
+  }
+  EXPECT_LT(2u, n);
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  check();
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "posts"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_tag);
+  fpta_name_destroy(&col_code);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_qty);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,319 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_index_partial.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_index_partial.fpta" MDBX_LOCK_SUFFIX;
+
+static int partial_count(fpta_txn *txn, fpta_name *column_id,
+                         fpta_filter *filter, size_t *count) {
+  fpta_cursor *cursor = nullptr;
+  int rc = fpta_cursor_open(txn, column_id, fpta_value_begin(),
+                            fpta_value_end(), filter,
+                            fpta_unsorted_dont_fetch, &cursor);
+  if (rc != FPTA_OK)
+    return rc;
+  *count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, count, INT_MAX));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  return FPTA_OK;
+}
+
+TEST(Index, Partial) {
+  /* Smoke-проверка частичных вторичных индексов, в которые попадают
+   * только строки удовлетворяющие сохраненному в схеме предикату.
+   *
+   * Сценарий:
+   *  1. Создаем базу с одной таблицей, в которой два частичных индекса:
+   *     неуникальный с предикатом "Status == 1" и уникальный с предикатом
+   *     "Amount >= 100". Попутно проверяем отказы для первичного индекса,
+   *     функторов и повторного описания.
+   *
+   *  2. Вставляем 10 строк, в том числе с повторяющимися значениями
+   *     уникальной колонки у не попадающих в индекс строк.
+   *
+   *  3. Проверяем, что курсор по частичному индексу открывается только
+   *     с фильтром, из которого следует предикат индекса, и возвращает
+   *     те же строки, что и курсор по первичному индексу.
+   *
+   *  4. Изменяем и удаляем строки, в том числе с входом и выходом строки
+   *     из частичного индекса, после чего повторно открываем базу
+   *     и проверяем согласованность индексов.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // готовим идентификаторы, они же используются в предикатах
+  fpta_name table, col_id, col_customer, col_ref, col_status, col_amount;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "orders"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_customer, "Customer"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_ref, "Ref"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_status, "Status"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_amount, "Amount"));
+
+  fpta_filter active;
+  active.type = fpta_node_eq;
+  active.node_cmp.left_id = &col_status;
+  active.node_cmp.right_value = fpta_value_uint(1);
+
+  fpta_filter large;
+  large.type = fpta_node_ge;
+  large.node_cmp.left_id = &col_amount;
+  large.node_cmp.right_value = fpta_value_sint(100);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Customer", fptu_uint64,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Ref", fptu_cstr,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Status", fptu_uint32,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Amount", fptu_int64,
+                                          fpta_noindex_nullable, &def));
+
+  EXPECT_EQ(FPTA_EFLAG, fpta_describe_partial_index("Id", &def, &active));
+  fpta_filter functor;
+  functor.type = fpta_node_fnrow;
+  functor.node_fnrow.predicate = nullptr;
+  functor.node_fnrow.context = nullptr;
+  functor.node_fnrow.arg = nullptr;
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_describe_partial_index("Customer", &def, &functor));
+  fpta_name col_missing;
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_missing, "Nothing"));
+  fpta_filter missing = active;
+  missing.node_cmp.left_id = &col_missing;
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_describe_partial_index("Customer", &def, &missing));
+  fpta_name_destroy(&col_missing);
+
+  EXPECT_EQ(FPTA_OK, fpta_describe_partial_index("Customer", &def, &active));
+  EXPECT_EQ(FPTA_EEXIST,
+            fpta_describe_partial_index("Customer", &def, &large));
+  EXPECT_EQ(FPTA_OK, fpta_describe_partial_index("Ref", &def, &large));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "orders", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // вставляем 10 строк, у первых двух Ref совпадает
+  const auto make_row = [&](fptu_rw *pt, unsigned id, const char *ref,
+                            unsigned status, int64_t amount) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_customer, fpta_value_uint(id % 3)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_ref, fpta_value_cstr(ref)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_status, fpta_value_uint(status)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_amount, fpta_value_sint(amount)));
+    return fptu_take_noshrink(pt);
+  };
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_customer));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_ref));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_status));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_amount));
+  fptu_rw *pt = fptu_alloc(5, 8 * 4 + 16);
+  ASSERT_NE(nullptr, pt);
+  char ref[16];
+  for (unsigned i = 0; i < 10; ++i) {
+    snprintf(ref, sizeof(ref), (i < 2) ? "dup" : "r%02u", i);
+    EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table,
+                                       make_row(pt, i, ref, i % 2, i * 50)));
+  }
+  // уникальность контролируется только для попадающих в индекс строк
+  EXPECT_EQ(FPTA_OK,
+            fpta_insert_row(txn, &table, make_row(pt, 10, "r05", 0, 10)));
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_probe_and_put(txn, &table, make_row(pt, 11, "r05", 0, 500),
+                               fpta_insert));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // курсор по частичному индексу требует подходящего фильтра
+  const auto check = [&](size_t expect_active, size_t expect_large) {
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_NE(nullptr, txn);
+    size_t count = 0;
+    EXPECT_EQ(FPTA_NO_INDEX,
+              partial_count(txn, &col_customer, nullptr, &count));
+    EXPECT_EQ(FPTA_OK,
+              partial_count(txn, &col_customer, &active, &count));
+    EXPECT_EQ(expect_active, count);
+    EXPECT_EQ(FPTA_OK, partial_count(txn, &col_id, &active, &count));
+    EXPECT_EQ(expect_active, count);
+
+    EXPECT_EQ(FPTA_OK, partial_count(txn, &col_ref, &large, &count));
+    EXPECT_EQ(expect_large, count);
+    EXPECT_EQ(FPTA_OK, partial_count(txn, &col_id, &large, &count));
+    EXPECT_EQ(expect_large, count);
+
+    // из "Amount > 200 && Status == 1" следуют оба предиката
+    fpta_filter narrow = large, both;
+    narrow.type = fpta_node_gt;
+    narrow.node_cmp.right_value = fpta_value_uint(200);
+    both.type = fpta_node_and;
+    both.node_and.a = &narrow;
+    both.node_and.b = &active;
+    size_t via_pk = 0;
+    EXPECT_EQ(FPTA_OK, partial_count(txn, &col_id, &both, &via_pk));
+    EXPECT_EQ(FPTA_OK, partial_count(txn, &col_ref, &both, &count));
+    EXPECT_EQ(via_pk, count);
+    EXPECT_EQ(FPTA_OK,
+              partial_count(txn, &col_customer, &both, &count));
+    EXPECT_EQ(via_pk, count);
+
+    // а из "Amount > 50" и "Status != 0" предикаты не следуют
+    narrow.node_cmp.right_value = fpta_value_sint(50);
+    EXPECT_EQ(FPTA_NO_INDEX,
+              partial_count(txn, &col_ref, &narrow, &count));
+    fpta_filter inactive = active;
+    inactive.type = fpta_node_ne;
+    inactive.node_cmp.right_value = fpta_value_uint(0);
+    EXPECT_EQ(FPTA_NO_INDEX,
+              partial_count(txn, &col_customer, &inactive, &count));
+
+    // точечный поиск по частичному индексу недоступен
+    fpta_value value = fpta_value_cstr("r05");
+    fptu_ro row;
+    EXPECT_EQ(FPTA_NO_INDEX, fpta_get(txn, &col_ref, &value, &row));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    txn = nullptr;
+  };
+  /* Status == 1: 1, 3, 5, 7, 9; Amount >= 100: 2..9 */
+  check(5, 8);
+
+  //--------------------------------------------------------------------------
+  // изменяем строки
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  // строка покидает первый индекс
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(pt, 3, "r03", 0, 150)));
+  // строка входит во второй индекс
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(pt, 0, "dup", 0, 1000)));
+  // а другая строка с тем же Ref уже не может в него войти
+  EXPECT_EQ(FPTA_KEYEXIST,
+            fpta_probe_and_put(txn, &table, make_row(pt, 1, "dup", 1, 1000),
+                               fpta_update));
+  // строка меняет значение ключа, оставаясь в индексах
+  EXPECT_EQ(FPTA_OK,
+            fpta_update_row(txn, &table, make_row(pt, 7, "x07", 1, 350)));
+
+  // через курсор нельзя вывести строку из его частичного индекса
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_customer, fpta_value_uint(1),
+                                      fpta_value_epsilon(), &active,
+                                      fpta_unsorted, &cursor));
+  fptu_ro row;
+  fpta_value value;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+  EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &value));
+  const unsigned id = (unsigned)value.uint;
+  EXPECT_EQ(1u, id % 3);
+  snprintf(ref, sizeof(ref), "r%02u", id);
+  EXPECT_EQ(FPTA_KEY_MISMATCH,
+            fpta_cursor_update(cursor, make_row(pt, id, ref, 0, id * 50)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_cursor_update(cursor, make_row(pt, id, ref, 1, id * 50)));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+  // удаляем строки
+  EXPECT_EQ(FPTA_OK,
+            fpta_delete(txn, &table, make_row(pt, 5, "r05", 1, 250)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_delete(txn, &table, make_row(pt, 4, "r04", 0, 200)));
+  EXPECT_EQ(FPTA_OK,
+            fpta_delete(txn, &table, make_row(pt, 10, "r05", 0, 10)));
+  free(pt);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  /* Status == 1: 1, 7, 9; Amount >= 100: 0, 2, 3, 6..9 */
+  check(3, 7);
+
+  // предикаты сохраняются в схеме
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, false, &db));
+  ASSERT_NE(nullptr, db);
+  check(3, 7);
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_customer);
+  fpta_name_destroy(&col_ref);
+  fpta_name_destroy(&col_status);
+  fpta_name_destroy(&col_amount);
+
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
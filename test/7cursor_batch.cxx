@@ -0,0 +1,324 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_cursor_batch.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_cursor_batch.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Cursor, FetchBatch) {
+  /* Smoke-проверка пакетного извлечения строк курсором.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с неуникальными вторичными индексами,
+   *     у которых много дубликатов для каждого значения ключа.
+   *
+   *  2. Для курсоров по первичному и вторичным индексам, с диапазонами,
+   *     фильтрами и в разных порядках сортировки, сверяем строки и ключи,
+   *     извлекаемые пакетами разного размера, с получаемыми посредством
+   *     fpta_cursor_get() и fpta_cursor_move().
+   *
+   *  3. Проверяем, что дубликаты извлекаются из индекса страницами.
+   *
+   *  4. Удаляем таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  16, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Group", fptu_uint16,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Name", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Qty", fptu_int32,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "events", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_group, col_name, col_qty;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "events"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_group, "Group"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_qty, "Qty"));
+
+  //--------------------------------------------------------------------------
+  // наполняем таблицу
+  const unsigned total = 20000;
+  fptu_rw *pt = fptu_alloc(4, 64);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_group));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_qty));
+  for (unsigned n = 0; n < total; ++n) {
+    // идентификаторы вставляются не по порядку
+    const uint64_t id = (n * UINT64_C(7919)) % total;
+    const std::string name = "name-" + std::to_string(id % 17);
+    ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_group, fpta_value_uint(id % 10)));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_name,
+                                          fpta_value_cstr(name.c_str())));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_qty,
+                                          fpta_value_sint(int(id % 3))));
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(pt)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  // сверяем пакетное извлечение с построчным
+  struct item {
+    uint64_t id;
+    fpta_value key;
+  };
+  auto same_key = [](const fpta_value &a, const fpta_value &b) {
+    if (a.type != b.type || a.binary_length != b.binary_length)
+      return false;
+    if (a.type == fpta_unsigned_int)
+      return a.uint == b.uint;
+    return memcmp(a.binary_data, b.binary_data, a.binary_length) == 0;
+  };
+  fpta_cursor_stat stat;
+  auto scan = [&](fpta_name *column, fpta_value from, fpta_value to,
+                  fpta_filter *filter, fpta_cursor_options options,
+                  size_t batch, std::vector<item> &result) {
+    fpta_cursor *cursor = nullptr;
+    result.clear();
+    const int err =
+        fpta_cursor_open(txn, column, from, to, filter, options, &cursor);
+    if (err == FPTA_NODATA)
+      return;
+    ASSERT_EQ(FPTA_OK, err);
+    if (batch == 0) {
+      for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS;
+           rc = fpta_cursor_move(cursor, fpta_next)) {
+        fptu_ro row;
+        fpta_value id;
+        item i;
+        ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+        ASSERT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &id));
+        ASSERT_EQ(FPTA_OK, fpta_cursor_key(cursor, &i.key));
+        i.id = id.uint;
+        result.push_back(i);
+      }
+    } else {
+      std::vector<fptu_ro> rows(batch);
+      std::vector<fpta_value> keys(batch);
+      size_t got = 0;
+      int rc;
+      while ((rc = fpta_cursor_fetch_batch(cursor, rows.data(), keys.data(),
+                                           batch, &got)) == FPTA_SUCCESS) {
+        ASSERT_LT(0u, got);
+        ASSERT_GE(batch, got);
+        for (size_t n = 0; n < got; ++n) {
+          fpta_value id;
+          ASSERT_EQ(FPTA_OK, fpta_get_column(rows[n], &col_id, &id));
+          result.push_back({id.uint, keys[n]});
+        }
+      }
+      EXPECT_EQ(FPTA_NODATA, rc);
+      EXPECT_EQ(0u, got);
+      // ключи не обязательны
+      EXPECT_EQ(FPTA_NODATA, fpta_cursor_fetch_batch(cursor, rows.data(),
+                                                     nullptr, batch, &got));
+      EXPECT_EQ(FPTA_EINVAL, fpta_cursor_fetch_batch(cursor, rows.data(),
+                                                     nullptr, batch, nullptr));
+    }
+    EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, &stat));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  };
+
+  fpta_filter qty_eq;
+  qty_eq.type = fpta_node_eq;
+  qty_eq.node_cmp.left_id = &col_qty;
+  qty_eq.node_cmp.right_value = fpta_value_sint(1);
+  const std::string name_from = "name-12", name_to = "name-5";
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  for (int variant = 0; variant < 8; ++variant) {
+    SCOPED_TRACE("variant " + std::to_string(variant));
+    fpta_name *column = &col_group;
+    fpta_value from = fpta_value_begin(), to = fpta_value_end();
+    fpta_filter *filter = nullptr;
+    fpta_cursor_options options = fpta_ascending;
+    switch (variant) {
+    case 0:
+      break;
+    case 1:
+      from = fpta_value_uint(3);
+      to = fpta_value_uint(7);
+      break;
+    case 2:
+      filter = &qty_eq;
+      break;
+    case 3:
+      options = fpta_descending;
+      break;
+    case 4:
+      column = &col_name;
+      from = fpta_value_cstr(name_from.c_str());
+      to = fpta_value_cstr(name_to.c_str());
+      break;
+    case 5:
+      column = &col_name;
+      options = fpta_unsorted;
+      break;
+    case 6:
+      column = &col_id;
+      from = fpta_value_uint(42);
+      to = fpta_value_uint(total - 42);
+      break;
+    case 7:
+      column = &col_id;
+      filter = &qty_eq;
+      options = fpta_descending;
+      break;
+    }
+
+    std::vector<item> expected, fetched;
+    scan(column, from, to, filter, options, 0, expected);
+    const size_t expected_scans = stat.index_scans;
+    EXPECT_LT(0u, expected.size());
+    for (size_t batch : {1, 3, 64, 1000, 100000}) {
+      SCOPED_TRACE("batch " + std::to_string(batch));
+      scan(column, from, to, filter, options, batch, fetched);
+      ASSERT_EQ(expected.size(), fetched.size());
+      for (size_t n = 0; n < expected.size(); ++n) {
+        ASSERT_EQ(expected[n].id, fetched[n].id);
+        ASSERT_TRUE(same_key(expected[n].key, fetched[n].key));
+      }
+      EXPECT_EQ(expected.size(), stat.results);
+      if (column != &col_id && !filter && options != fpta_descending &&
+          batch > 1) {
+        // дубликаты извлекаются страницами
+        EXPECT_GT(expected_scans / 4, stat.index_scans);
+      } else {
+        EXPECT_EQ(expected_scans, stat.index_scans);
+      }
+    }
+
+    // строки вторичного индекса читаются окнами в порядке PK
+    std::map<uint64_t, size_t> positions;
+    for (size_t n = 0; n < expected.size(); ++n)
+      positions[expected[n].id] = n;
+    const fpta_cursor_options lookup = options | fpta_batched_lookup;
+    for (size_t batch : {1, 3, 64, 1000, 100000}) {
+      SCOPED_TRACE("batched lookup " + std::to_string(batch));
+      scan(column, from, to, filter, lookup, batch, fetched);
+      ASSERT_EQ(expected.size(), fetched.size());
+      EXPECT_EQ(expected.size(), stat.results);
+      if (column != &col_id && !filter) {
+        EXPECT_EQ(expected.size(), stat.pk_lookups);
+      }
+      if (fpta_cursor_is_ordered(options)) {
+        for (size_t n = 0; n < expected.size(); ++n) {
+          ASSERT_EQ(expected[n].id, fetched[n].id);
+          ASSERT_TRUE(same_key(expected[n].key, fetched[n].key));
+        }
+        continue;
+      }
+      for (size_t n = 0; n < fetched.size(); ++n) {
+        ASSERT_EQ(1u, positions.count(fetched[n].id));
+        const item &origin = expected[positions[fetched[n].id]];
+        ASSERT_TRUE(same_key(origin.key, fetched[n].key));
+        // каждый вызов начинает новое окно
+        if (n % batch % 256) {
+          EXPECT_LT(fetched[n - 1].id, fetched[n].id);
+        }
+      }
+      // окно содержит в точности те же строки, что и в порядке индекса
+      for (size_t begin = 0; begin < fetched.size();) {
+        size_t end = begin + 1;
+        while (end < fetched.size() && end % batch % 256)
+          ++end;
+        std::vector<uint64_t> window_expected, window_fetched;
+        for (size_t n = begin; n < end; ++n) {
+          window_expected.push_back(expected[n].id);
+          window_fetched.push_back(fetched[n].id);
+        }
+        std::sort(window_expected.begin(), window_expected.end());
+        ASSERT_EQ(window_expected, window_fetched);
+        begin = end;
+      }
+    }
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "events"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_group);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_qty);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
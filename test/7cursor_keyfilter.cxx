@@ -0,0 +1,278 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_cursor_keyfilter.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_cursor_keyfilter.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Cursor, KeyFilter) {
+  /* Smoke-проверка вычисления фильтра по ключу вторичного индекса.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с упорядоченными, неупорядоченными
+   *     и nullable вторичными индексами.
+   *
+   *  2. Открываем курсоры по вторичным индексам с фильтрами, в которых
+   *     часть условий относится к колонке индекса или PK, и сверяем
+   *     количество строк с ожидаемым по модели данных.
+   *
+   *  3. Проверяем, что отброшенные по ключу строки не читались из
+   *     основной таблицы, а условия, не отделимые от остального фильтра
+   *     или не вычислимые по ключу, проверяются по строкам.
+   *
+   *  4. Удаляем таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  16, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Group", fptu_uint16,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Name", fptu_cstr,
+                         fpta_secondary_withdups_unordered, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Flag", fptu_int32,
+                         fpta_secondary_withdups_ordered_obverse_nullable,
+                         &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Qty", fptu_int32,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "orders", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_group, col_name, col_flag, col_qty;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "orders"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_group, "Group"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_name, "Name"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_flag, "Flag"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_qty, "Qty"));
+
+  //--------------------------------------------------------------------------
+  // наполняем таблицу
+  const unsigned total = 5000;
+  fptu_rw *pt = fptu_alloc(5, 64);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_group));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_name));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_flag));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_qty));
+  for (unsigned id = 0; id < total; ++id) {
+    const std::string name = "name-" + std::to_string(id % 13);
+    ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_group, fpta_value_uint(id % 10)));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_name,
+                                          fpta_value_cstr(name.c_str())));
+    if (id % 4) {
+      ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_flag,
+                                            fpta_value_sint(int(id % 4))));
+    }
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_qty,
+                                          fpta_value_sint(int(id % 3))));
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(pt)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  fpta_cursor_stat stat;
+  auto count = [&](fpta_name *column, fpta_filter *filter,
+                   fpta_cursor_options options) {
+    fpta_cursor *cursor = nullptr;
+    size_t rows = 0;
+    EXPECT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, column, fpta_value_begin(),
+                               fpta_value_end(), filter, options, &cursor));
+    if ((options & fpta_batched_lookup) == 0) {
+      for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS;
+           rc = fpta_cursor_move(cursor, fpta_next))
+        ++rows;
+    } else {
+      fptu_ro batch[100];
+      size_t got;
+      while (fpta_cursor_fetch_batch(cursor, batch, nullptr, 100, &got) ==
+             FPTA_SUCCESS)
+        rows += got;
+    }
+    EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, &stat));
+    EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    return rows;
+  };
+
+  fpta_filter group_eq, id_lt, qty_eq, name_eq, flag_null, flag_gt;
+  group_eq.type = fpta_node_eq;
+  group_eq.node_cmp.left_id = &col_group;
+  group_eq.node_cmp.right_value = fpta_value_uint(3);
+  id_lt.type = fpta_node_lt;
+  id_lt.node_cmp.left_id = &col_id;
+  id_lt.node_cmp.right_value = fpta_value_uint(1000);
+  qty_eq.type = fpta_node_eq;
+  qty_eq.node_cmp.left_id = &col_qty;
+  qty_eq.node_cmp.right_value = fpta_value_sint(1);
+  name_eq.type = fpta_node_eq;
+  name_eq.node_cmp.left_id = &col_name;
+  name_eq.node_cmp.right_value = fpta_value_cstr("name-5");
+  flag_null.type = fpta_node_eq;
+  flag_null.node_cmp.left_id = &col_flag;
+  flag_null.node_cmp.right_value = fpta_value_null();
+  flag_gt.type = fpta_node_gt;
+  flag_gt.node_cmp.left_id = &col_flag;
+  flag_gt.node_cmp.right_value = fpta_value_sint(1);
+
+  fpta_filter and_group_qty, and_all, or_group_qty, and_name_qty,
+      and_flag_qty, and_flag_id;
+  and_group_qty.type = fpta_node_and;
+  and_group_qty.node_and.a = &qty_eq;
+  and_group_qty.node_and.b = &group_eq;
+  and_all.type = fpta_node_and;
+  and_all.node_and.a = &and_group_qty;
+  and_all.node_and.b = &id_lt;
+  or_group_qty.type = fpta_node_or;
+  or_group_qty.node_or.a = &group_eq;
+  or_group_qty.node_or.b = &qty_eq;
+  and_name_qty.type = fpta_node_and;
+  and_name_qty.node_and.a = &name_eq;
+  and_name_qty.node_and.b = &qty_eq;
+  and_flag_qty.type = fpta_node_and;
+  and_flag_qty.node_and.a = &flag_null;
+  and_flag_qty.node_and.b = &qty_eq;
+  and_flag_id.type = fpta_node_and;
+  and_flag_id.node_and.a = &flag_gt;
+  and_flag_id.node_and.b = &id_lt;
+
+  size_t expect_group_qty = 0, expect_all = 0, expect_or = 0,
+         expect_name_qty = 0, expect_flag_qty = 0, expect_flag_id = 0,
+         expect_group = 0, expect_flag_null = 0, expect_flag_gt = 0;
+  for (unsigned id = 0; id < total; ++id) {
+    const bool group = id % 10 == 3, qty = id % 3 == 1, low = id < 1000;
+    const bool name = id % 13 == 5, null = id % 4 == 0, gt = id % 4 > 1;
+    expect_group += group;
+    expect_flag_null += null;
+    expect_flag_gt += gt;
+    expect_group_qty += group && qty;
+    expect_all += group && qty && low;
+    expect_or += group || qty;
+    expect_name_qty += name && qty;
+    expect_flag_qty += null && qty;
+    expect_flag_id += gt && low;
+  }
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  for (auto options : {fpta_ascending, fpta_descending,
+                       fpta_ascending | fpta_batched_lookup,
+                       fpta_unsorted | fpta_batched_lookup}) {
+    SCOPED_TRACE("options " + std::to_string(unsigned(options)));
+    // при пакетном чтении первая строка окна читается повторно
+    auto lookups = [options](size_t n) {
+      return (options & fpta_batched_lookup) ? n + n / 10 : n;
+    };
+
+    // условие на колонку индекса проверяется по ключу
+    EXPECT_EQ(expect_group_qty, count(&col_group, &and_group_qty, options));
+    EXPECT_EQ(total - expect_group, stat.key_filtered);
+    EXPECT_GE(lookups(expect_group + 1), stat.pk_lookups);
+
+    // а также условие на PK
+    EXPECT_EQ(expect_all, count(&col_group, &and_all, options));
+    EXPECT_LT(total - expect_group, stat.key_filtered);
+    EXPECT_GE(lookups(expect_group / 5 + 1), stat.pk_lookups);
+
+    // условия под "ИЛИ" не отделимы от остального фильтра
+    EXPECT_EQ(expect_or, count(&col_group, &or_group_qty, options));
+    EXPECT_EQ(0u, stat.key_filtered);
+
+    // отсутствие значения в nullable-колонке
+    EXPECT_EQ(expect_flag_qty, count(&col_flag, &and_flag_qty, options));
+    EXPECT_EQ(total - expect_flag_null, stat.key_filtered);
+    EXPECT_EQ(expect_flag_id, count(&col_flag, &and_flag_id, options));
+    EXPECT_LT(total - expect_flag_gt, stat.key_filtered);
+
+    // по ключу с хэшем значения условие не вычисляется
+    if (!fpta_cursor_is_ordered(options)) {
+      EXPECT_EQ(expect_name_qty, count(&col_name, &and_name_qty, options));
+      EXPECT_EQ(0u, stat.key_filtered);
+      EXPECT_LE(total, stat.pk_lookups);
+      EXPECT_GE(lookups(total), stat.pk_lookups);
+    }
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "orders"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_group);
+  fpta_name_destroy(&col_name);
+  fpta_name_destroy(&col_flag);
+  fpta_name_destroy(&col_qty);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
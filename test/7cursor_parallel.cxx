@@ -0,0 +1,318 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+#include <thread>
+
+static const char testdb_name[] = TEST_DB_DIR "ut_cursor_parallel.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_cursor_parallel.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Cursor, ParallelScan) {
+  /* Smoke-проверка параллельного просмотра выборки.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с упорядоченными и неупорядоченным
+   *     индексами, наполняем её строками.
+   *
+   *  2. Выполняем агрегацию посредством fpta_apply_visitor_parallel()
+   *     по первичному и вторичным индексам, в том числе с фильтром,
+   *     в обратном порядке и по одному значению ключа, и сверяем результат
+   *     с последовательным просмотром посредством fpta_apply_visitor().
+   *
+   *  3. Проверяем, что после фиксации изменений другой транзакцией
+   *     параллельный просмотр в ранее начатой транзакции видит прежний
+   *     снимок данных, а в пишущей транзакции видит её изменения.
+   *
+   *  4. Удаляем таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  32, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Account", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Tag", fptu_uint32,
+                                          fpta_secondary_withdups_unordered,
+                                          &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Amount", fptu_int64,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "ledger", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  struct scan_names {
+    fpta_name table, id, account, tag, amount;
+  } names;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&names.table, "ledger"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&names.table, &names.id, "Id"));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_init(&names.table, &names.account, "Account"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&names.table, &names.tag, "Tag"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&names.table, &names.amount, "Amount"));
+
+  //--------------------------------------------------------------------------
+  // наполняем таблицу
+  auto insert = [&](fpta_txn *txn, unsigned id) {
+    fptu_rw *pt = fptu_alloc(4, 64);
+    ASSERT_NE(nullptr, pt);
+    const std::string account = "acc-" + std::to_string(1000 + id % 97);
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &names.table, &names.id));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &names.account));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &names.tag));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &names.amount));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &names.id, fpta_value_uint(id)));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &names.account,
+                                          fpta_value_cstr(account.c_str())));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &names.tag, fpta_value_uint(id % 7)));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &names.amount,
+                                          fpta_value_sint(int(id % 101) - 50)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &names.table, fptu_take_noshrink(pt)));
+    free(pt);
+  };
+
+  const unsigned total = 20000;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  for (unsigned id = 0; id < total; ++id)
+    insert(txn, id);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  struct scan_result {
+    int64_t sum;
+    size_t rows;
+    std::vector<std::string> accounts;
+  };
+
+  auto visitor = [](const fptu_ro *row, void *context, void *arg) -> int {
+    scan_names *names = static_cast<scan_names *>(arg);
+    scan_result *part = static_cast<scan_result *>(context);
+    fpta_value value;
+    int rc = fpta_get_column(*row, &names->amount, &value);
+    if (rc != FPTA_OK)
+      return rc;
+    part->sum += value.sint;
+    part->rows += 1;
+    rc = fpta_get_column(*row, &names->account, &value);
+    if (rc != FPTA_OK)
+      return rc;
+    part->accounts.emplace_back(value.str, value.binary_length);
+    return FPTA_OK;
+  };
+
+  auto combiner = [](void *result, void *context, void *arg) -> int {
+    (void)arg;
+    scan_result *all = static_cast<scan_result *>(result);
+    scan_result *part = static_cast<scan_result *>(context);
+    all->sum += part->sum;
+    all->rows += part->rows;
+    all->accounts.insert(all->accounts.end(), part->accounts.begin(),
+                         part->accounts.end());
+    all->accounts.push_back("|");
+    return FPTA_OK;
+  };
+
+  // сравнивает параллельный просмотр с последовательным,
+  // возвращает количество задействованных частей
+  auto compare = [&](fpta_name *column, fpta_value from, fpta_value to,
+                     fpta_filter *filter, fpta_cursor_options options,
+                     unsigned partitions) -> size_t {
+    scan_result expected = {0, 0, {}};
+    size_t count = 0;
+    int rc = fpta_apply_visitor(txn, column, from, to, filter, options, 0,
+                                SIZE_MAX, nullptr, nullptr, &count, visitor,
+                                &expected, &names);
+    EXPECT_TRUE(rc == FPTA_NODATA || rc == FPTA_OK);
+    EXPECT_EQ(expected.rows, count);
+
+    std::vector<scan_result> parts(partitions, {0, 0, {}});
+    std::vector<void *> contexts;
+    for (auto &part : parts)
+      contexts.push_back(&part);
+    scan_result all = {0, 0, {}};
+    count = ~size_t(0);
+    EXPECT_EQ(FPTA_OK, fpta_apply_visitor_parallel(
+                           txn, column, from, to, filter, options, partitions,
+                           contexts.data(), &count, visitor, combiner, &all,
+                           &names));
+    EXPECT_EQ(expected.rows, count);
+    EXPECT_EQ(expected.rows, all.rows);
+    EXPECT_EQ(expected.sum, all.sum);
+
+    // части следуют в порядке выборки и не пересекаются
+    std::vector<std::string> sequence;
+    size_t used = 0;
+    for (const auto &account : all.accounts) {
+      if (account == "|")
+        ++used;
+      else
+        sequence.push_back(account);
+    }
+    if (fpta_cursor_is_ordered(options) && column == &names.account) {
+      EXPECT_EQ(expected.accounts, sequence);
+    }
+    EXPECT_GE(partitions, used);
+    return used;
+  };
+
+  fpta_filter positive;
+  positive.type = fpta_node_gt;
+  positive.node_cmp.left_id = &names.amount;
+  positive.node_cmp.right_value = fpta_value_sint(0);
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_apply_visitor_parallel(
+                txn, &names.id, fpta_value_begin(), fpta_value_end(), nullptr,
+                fpta_ascending, 0, nullptr, nullptr, visitor, combiner,
+                nullptr, &names));
+
+  // по первичному ключу выборка разбивается на несколько частей
+  EXPECT_LT(1u, compare(&names.id, fpta_value_begin(), fpta_value_end(),
+                        nullptr, fpta_unsorted, 8));
+  EXPECT_LT(1u, compare(&names.id, fpta_value_uint(1234),
+                        fpta_value_uint(15000), &positive, fpta_ascending, 5));
+  EXPECT_EQ(1u, compare(&names.id, fpta_value_begin(), fpta_value_end(),
+                        nullptr, fpta_ascending, 1));
+
+  // по вторичному индексу с дубликатами, в том числе в обратном порядке
+  for (auto options : {fpta_ascending, fpta_descending}) {
+    SCOPED_TRACE("options " + std::to_string(unsigned(options)));
+    EXPECT_LT(1u, compare(&names.account, fpta_value_begin(),
+                          fpta_value_end(), nullptr, options, 16));
+    EXPECT_LT(1u, compare(&names.account, fpta_value_cstr("acc-1010"),
+                          fpta_value_cstr("acc-1050"), &positive, options, 4));
+    EXPECT_EQ(1u, compare(&names.account, fpta_value_cstr("acc-1042"),
+                          fpta_value_epsilon(), nullptr, options, 4));
+  }
+
+  // неупорядоченный индекс не разбивается на части
+  EXPECT_EQ(1u, compare(&names.tag, fpta_value_begin(), fpta_value_end(),
+                        &positive, fpta_unsorted, 8));
+
+  // прерывание обработки функтором
+  std::vector<scan_result> parts(4, {0, 0, {}});
+  std::vector<void *> contexts;
+  for (auto &part : parts)
+    contexts.push_back(&part);
+  EXPECT_EQ(FPTA_EVALUE,
+            fpta_apply_visitor_parallel(
+                txn, &names.id, fpta_value_begin(), fpta_value_end(), nullptr,
+                fpta_ascending, 4, contexts.data(), nullptr,
+                [](const fptu_ro *, void *context, void *) -> int {
+                  scan_result *part = static_cast<scan_result *>(context);
+                  return (++part->rows > 100) ? FPTA_EVALUE : FPTA_OK;
+                },
+                combiner, nullptr, nullptr));
+
+  //--------------------------------------------------------------------------
+  // изменения, зафиксированные после начала транзакции, не видны
+  std::thread writer([&]() {
+    fpta_txn *wtxn = nullptr;
+    EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &wtxn));
+    ASSERT_NE(nullptr, wtxn);
+    for (unsigned id = total; id < total + 1000; ++id)
+      insert(wtxn, id);
+    EXPECT_EQ(FPTA_OK, fpta_transaction_end(wtxn, false));
+  });
+  writer.join();
+
+  scan_result before = {0, 0, {}};
+  std::fill(parts.begin(), parts.end(), scan_result({0, 0, {}}));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_apply_visitor_parallel(
+                         txn, &names.id, fpta_value_begin(), fpta_value_end(),
+                         nullptr, fpta_ascending, 4, contexts.data(), &count,
+                         visitor, combiner, &before, &names));
+  EXPECT_EQ(total, count);
+  EXPECT_EQ(total, before.rows);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // в пишущей транзакции видны её собственные изменения
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  insert(txn, total + 1000);
+  EXPECT_LT(1u, compare(&names.id, fpta_value_begin(), fpta_value_end(),
+                        nullptr, fpta_ascending, 8));
+  std::fill(parts.begin(), parts.end(), scan_result({0, 0, {}}));
+  EXPECT_EQ(FPTA_OK, fpta_apply_visitor_parallel(
+                         txn, &names.id, fpta_value_begin(), fpta_value_end(),
+                         nullptr, fpta_ascending, 4, contexts.data(), &count,
+                         visitor, combiner, &before, &names));
+  EXPECT_EQ(total + 1001, count);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "ledger"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&names.table);
+  fpta_name_destroy(&names.id);
+  fpta_name_destroy(&names.account);
+  fpta_name_destroy(&names.tag);
+  fpta_name_destroy(&names.amount);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,283 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_cursor_skip.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_cursor_skip.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(Cursor, Skip) {
+  /* Smoke-проверка пропуска строк курсором.
+   *
+   * Сценарий:
+   *  1. Создаем базу и таблицу с уникальным PK и неуникальными вторичными
+   *     индексами, наполняем её строками.
+   *
+   *  2. Для курсоров в обоих направлениях, с фильтром и без, сверяем
+   *     позицию после точного пропуска n строк посредством fpta_cursor_skip()
+   *     с позицией после n вызовов fpta_cursor_move(fpta_next).
+   *
+   *  3. Проверяем, что точный пропуск по неуникальному индексу проходит
+   *     группы дубликатов без их перебора, а приблизительный пропуск
+   *     попадает в окрестность нужной строки за логарифмическое количество
+   *     операций.
+   *
+   *  4. Удаляем таблицу, освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  32, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Id", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Category", fptu_uint16,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "Title", fptu_cstr,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("Score", fptu_int32,
+                                          fpta_index_none, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "listing", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  fpta_name table, col_id, col_category, col_title, col_score;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "listing"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "Id"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_category, "Category"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_title, "Title"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_score, "Score"));
+
+  //--------------------------------------------------------------------------
+  // наполняем таблицу
+  const unsigned total = 20000;
+  fptu_rw *pt = fptu_alloc(4, 64);
+  ASSERT_NE(nullptr, pt);
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_category));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_title));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_score));
+  for (unsigned id = 0; id < total; ++id) {
+    char title[32];
+    snprintf(title, sizeof(title), "title-%05u", id * 7919 % total / 3);
+    ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_id, fpta_value_uint(id)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_category, fpta_value_uint(id % 5)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_title, fpta_value_cstr(title)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_score, fpta_value_sint(id % 11)));
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(pt)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+  free(pt);
+
+  //--------------------------------------------------------------------------
+  fpta_filter score_lt;
+  score_lt.type = fpta_node_lt;
+  score_lt.node_cmp.left_id = &col_score;
+  score_lt.node_cmp.right_value = fpta_value_sint(3);
+
+  auto row_id = [&](fpta_cursor *cursor) {
+    fptu_ro row;
+    EXPECT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+    fpta_value id;
+    EXPECT_EQ(FPTA_OK, fpta_get_column(row, &col_id, &id));
+    return id.uint;
+  };
+
+  struct skip_case {
+    const char *label;
+    fpta_name *column;
+    fpta_value from, to;
+    fpta_filter *filter;
+  };
+  const skip_case cases[] = {
+      {"Id", &col_id, fpta_value_begin(), fpta_value_end(), nullptr},
+      {"Id", &col_id, fpta_value_uint(1234), fpta_value_uint(17000),
+       &score_lt},
+      {"Category", &col_category, fpta_value_begin(), fpta_value_end(),
+       nullptr},
+      {"Category", &col_category, fpta_value_uint(1), fpta_value_uint(4),
+       nullptr},
+      {"Category", &col_category, fpta_value_begin(), fpta_value_end(),
+       &score_lt},
+      {"Title", &col_title, fpta_value_begin(), fpta_value_end(), nullptr},
+      {"Title", &col_title, fpta_value_cstr("title-01000"),
+       fpta_value_cstr("title-05000"), nullptr}};
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  for (const auto &item : cases) {
+    for (auto options : {fpta_ascending, fpta_descending}) {
+      SCOPED_TRACE("column " + std::string(item.label) + ", options " +
+                   std::to_string(unsigned(options)) +
+                   (item.filter ? ", filtered" : ""));
+
+      // эталонная последовательность строк
+      fpta_cursor *cursor = nullptr;
+      std::vector<uint64_t> sequence;
+      EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, item.column, item.from,
+                                          item.to, item.filter, options,
+                                          &cursor));
+      for (int rc = fpta_cursor_eof(cursor); rc == FPTA_SUCCESS;
+           rc = fpta_cursor_move(cursor, fpta_next))
+        sequence.push_back(row_id(cursor));
+      EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      ASSERT_LT(1000u, sequence.size());
+
+      for (size_t n : {size_t(0), size_t(1), size_t(7), size_t(999),
+                       sequence.size() / 2, sequence.size() - 1,
+                       sequence.size(), sequence.size() + 42}) {
+        SCOPED_TRACE("n " + std::to_string(n));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, item.column, item.from,
+                                            item.to, item.filter, options,
+                                            &cursor));
+        // от первой строки, а также из середины группы дубликатов
+        for (size_t start : {size_t(0), size_t(3)}) {
+          if (start) {
+            EXPECT_EQ(FPTA_OK, fpta_cursor_skip(cursor, start, true));
+          }
+          EXPECT_EQ(FPTA_OK, fpta_cursor_reset_accounting(cursor));
+          const int rc = fpta_cursor_skip(cursor, n, true);
+          if (start + n < sequence.size()) {
+            ASSERT_EQ(FPTA_OK, rc);
+            EXPECT_EQ(sequence[start + n], row_id(cursor));
+          } else {
+            EXPECT_EQ(FPTA_NODATA, rc);
+            EXPECT_EQ(FPTA_NODATA, fpta_cursor_eof(cursor));
+          }
+          ASSERT_EQ(FPTA_OK, fpta_cursor_move(cursor, fpta_first));
+          if (start + n >= sequence.size())
+            break;
+        }
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+
+      // группы дубликатов пропускаются без перебора
+      if (item.column == &col_category && !item.filter) {
+        fpta_cursor_stat stat;
+        EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, item.column, item.from,
+                                            item.to, item.filter, options,
+                                            &cursor));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_reset_accounting(cursor));
+        const size_t n = sequence.size() - 2;
+        EXPECT_EQ(FPTA_OK, fpta_cursor_skip(cursor, n, true));
+        EXPECT_EQ(sequence[n], row_id(cursor));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, &stat));
+        EXPECT_GT(sequence.size() / 100,
+                  stat.index_scans + stat.index_searches);
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+
+      // приблизительный пропуск в окрестность нужной строки
+      if (!item.filter && item.column != &col_category) {
+        fpta_cursor_stat stat;
+        const size_t n = sequence.size() * 2 / 3;
+        EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, item.column, item.from,
+                                            item.to, item.filter, options,
+                                            &cursor));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_reset_accounting(cursor));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_skip(cursor, n, false));
+        const auto id = row_id(cursor);
+        const auto landed =
+            std::find(sequence.begin(), sequence.end(), id) - sequence.begin();
+        EXPECT_NEAR(double(n), double(landed), sequence.size() / 20.0);
+        EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, &stat));
+        EXPECT_GT(200u, stat.index_scans + stat.index_searches);
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+        EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, item.column, item.from,
+                                            item.to, item.filter, options,
+                                            &cursor));
+        EXPECT_EQ(FPTA_NODATA,
+                  fpta_cursor_skip(cursor, sequence.size() + 1000, false));
+        EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+    }
+  }
+
+  // постраничная выборка с пропуском посредством fpta_apply_visitor()
+  size_t count = 0;
+  fpta_value page_top;
+  EXPECT_EQ(FPTA_OK,
+            fpta_apply_visitor(
+                txn, &col_id, fpta_value_begin(), fpta_value_end(), nullptr,
+                fpta_ascending, 12345, 10, &page_top, nullptr, &count,
+                [](const fptu_ro *, void *, void *) -> int { return FPTA_OK; },
+                nullptr, nullptr));
+  EXPECT_EQ(10u, count);
+  EXPECT_EQ(12345u, page_top.uint);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_table_drop(txn, "listing"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_id);
+  fpta_name_destroy(&col_category);
+  fpta_name_destroy(&col_title);
+  fpta_name_destroy(&col_score);
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,990 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char testdb_name[] = TEST_DB_DIR "ut_bench.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_bench.fpta" MDBX_LOCK_SUFFIX;
+
+/* Микро-бенчмарки горячих путей. Результаты только выводятся, а не
+ * проверяются, так как зависят от платформы и нагрузки на CI. */
+
+class bench_stopwatch {
+  const char *const caption;
+  const size_t ops;
+  const std::chrono::steady_clock::time_point start;
+
+public:
+  bench_stopwatch(const char *caption, size_t ops)
+      : caption(caption), ops(ops), start(std::chrono::steady_clock::now()) {}
+
+  double ns_per_op() const {
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+  }
+
+  ~bench_stopwatch() {
+    std::cout << "[    BENCH ] " << caption << ": " << ns_per_op()
+              << " ns/op, " << ops << " ops" << std::endl;
+  }
+};
+
+static void bench_create_db(fpta_db **pdb,
+                            fpta_durability durability = fpta_weak,
+                            size_t megabytes = 32) {
+  // чистим
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, durability,
+                                  fpta_regime_default, megabytes, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("str", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "table", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  *pdb = db;
+}
+
+static void bench_fill(fpta_db *db, size_t rows) {
+  fpta_name table, pk, str;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "table"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &str, "str"));
+
+  fptu_rw *tuple = fptu_alloc(2, 64);
+  ASSERT_NE(nullptr, tuple);
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &str));
+  for (size_t i = 0; i < rows; ++i) {
+    ASSERT_EQ(FPTU_OK, fptu_clear(tuple));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(tuple, &pk, fpta_value_uint(i)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(
+                  tuple, &str,
+                  fpta_value_cstr(std::to_string(i * 2654435761u).c_str())));
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, fptu_take_noshrink(tuple)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  free(tuple);
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&str);
+}
+
+static void bench_remove_db(fpta_db *db) {
+  ASSERT_EQ(FPTA_OK, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(Bench, ReadTxnBeginEnd) {
+  /* Стоимость пары fpta_transaction_begin(fpta_read)/fpta_transaction_end().
+   *
+   * Для сравнения замеряется "прежний" путь без пула: выделение памяти
+   * под транзакцию, mdbx_txn_begin(), mdbx_txn_commit() и освобождение. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t reps = 10000;
+#else
+  const size_t reps = 1000000;
+#endif
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db));
+
+  uint64_t db_version = 0, schema_version = 0;
+  {
+    MDBX_env *env = fpta_mdbx_env(db);
+    ASSERT_NE(nullptr, env);
+    bench_stopwatch stopwatch("calloc + mdbx_txn_begin/commit", reps);
+    for (size_t i = 0; i < reps; ++i) {
+      void *holder = calloc(1, 64);
+      ASSERT_NE(nullptr, holder);
+      MDBX_txn *mdbx_txn = nullptr;
+      ASSERT_EQ(MDBX_SUCCESS,
+                mdbx_txn_begin(env, nullptr, MDBX_RDONLY, &mdbx_txn));
+      db_version += mdbx_txn_id(mdbx_txn);
+      ASSERT_EQ(MDBX_SUCCESS, mdbx_txn_commit(mdbx_txn));
+      free(holder);
+    }
+  }
+
+  {
+    bench_stopwatch stopwatch("fpta_transaction_begin/end(fpta_read)", reps);
+    for (size_t i = 0; i < reps; ++i) {
+      fpta_txn *txn = nullptr;
+      ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+      ASSERT_EQ(FPTA_OK,
+                fpta_transaction_versions(txn, &db_version, &schema_version));
+      ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    }
+  }
+
+  /* Читающие транзакции из пула должны возобновляться в других потоках
+   * и видеть изменения схемы. */
+  std::thread reader([db, schema_version]() {
+    for (int i = 0; i < 42; ++i) {
+      fpta_txn *txn = nullptr;
+      uint64_t current_db_version = 0, current_schema_version = 0;
+      ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+      ASSERT_EQ(FPTA_OK, fpta_transaction_versions(txn, &current_db_version,
+                                                   &current_schema_version));
+      EXPECT_EQ(schema_version, current_schema_version);
+      ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+    }
+  });
+  reader.join();
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("pk", fptu_cstr,
+                                          fpta_primary_unique_ordered_obverse,
+                                          &def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "table2", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  uint64_t new_db_version = 0, new_schema_version = 0;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_versions(txn, &new_db_version,
+                                               &new_schema_version));
+  EXPECT_LT(schema_version, new_schema_version);
+  EXPECT_EQ(new_db_version, new_schema_version);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  bench_remove_db(db);
+}
+
+TEST(Bench, CursorOpenClose) {
+  /* Стоимость открытия/закрытия курсора с размещением в куче (через пул
+   * свободных курсоров) и в памяти на стеке (fpta_cursor_open_external). */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t reps = 10000;
+#else
+  const size_t reps = 300000;
+#endif
+  const size_t rows = 42;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db));
+  ASSERT_NO_FATAL_FAILURE(bench_fill(db, rows));
+
+  fpta_name table, pk;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "table"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+
+  {
+    bench_stopwatch stopwatch("fpta_cursor_open/close", reps);
+    for (size_t i = 0; i < reps; ++i) {
+      fpta_cursor *cursor = nullptr;
+      ASSERT_EQ(FPTA_OK, fpta_cursor_open(txn, &pk, fpta_value_uint(i % rows),
+                                          fpta_value_epsilon(), nullptr,
+                                          fpta_unsorted, &cursor));
+      ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    }
+  }
+
+  {
+    bench_stopwatch stopwatch("fpta_cursor_open_external/close", reps);
+    for (size_t i = 0; i < reps; ++i) {
+      fpta_cursor_storage storage;
+      fpta_cursor *cursor = nullptr;
+      ASSERT_EQ(FPTA_OK,
+                fpta_cursor_open_external(txn, &pk, fpta_value_uint(i % rows),
+                                          fpta_value_epsilon(), nullptr,
+                                          fpta_unsorted, &storage, &cursor));
+      ASSERT_EQ(static_cast<void *>(&storage), static_cast<void *>(cursor));
+      ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+    }
+  }
+
+  /* курсор во внешней памяти полностью функционален */
+  fpta_cursor_storage storage;
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_cursor_open_external(txn, &pk, fpta_value_begin(),
+                                      fpta_value_end(), nullptr, fpta_ascending,
+                                      nullptr, &cursor));
+  EXPECT_EQ(nullptr, cursor);
+  ASSERT_EQ(FPTA_OK, fpta_cursor_open_external(
+                         txn, &pk, fpta_value_begin(), fpta_value_end(),
+                         nullptr, fpta_ascending, &storage, &cursor));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+  EXPECT_EQ(rows, count);
+  ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  EXPECT_EQ(FPTA_EINVAL, fpta_cursor_close(cursor));
+
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  bench_remove_db(db);
+}
+
+struct bench_insert_arg {
+  fpta_name table, pk;
+  fptu_rw *tuple;
+  uint64_t key;
+  bool fail /* отказаться от вставки после её выполнения */;
+};
+
+static int bench_insert(fpta_txn *txn, void *arg) {
+  bench_insert_arg *const ctx = static_cast<bench_insert_arg *>(arg);
+  int rc = fpta_name_refresh_couple(txn, &ctx->table, &ctx->pk);
+  if (rc != FPTA_OK)
+    return rc;
+  rc = fptu_clear(ctx->tuple);
+  if (rc != FPTU_OK)
+    return rc;
+  rc = fpta_upsert_column(ctx->tuple, &ctx->pk, fpta_value_uint(ctx->key));
+  if (rc != FPTA_OK)
+    return rc;
+  rc = fpta_insert_row(txn, &ctx->table, fptu_take_noshrink(ctx->tuple));
+  if (rc == FPTA_OK && ctx->fail)
+    rc = FPTA_EINVAL;
+  return rc;
+}
+
+static void bench_insert_init(bench_insert_arg *ctx) {
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&ctx->table, "table"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&ctx->table, &ctx->pk, "pk"));
+  ctx->tuple = fptu_alloc(2, 64);
+  ASSERT_NE(nullptr, ctx->tuple);
+  ctx->key = 0;
+  ctx->fail = false;
+}
+
+static void bench_insert_destroy(bench_insert_arg *ctx) {
+  free(ctx->tuple);
+  fpta_name_destroy(&ctx->table);
+  fpta_name_destroy(&ctx->pk);
+}
+
+TEST(Bench, GroupCommit) {
+  /* Вставка строк множеством потоков: каждая строка в отдельной пишущей
+   * транзакции, либо посредством групповой фиксации. Дополнительно
+   * проверяется, что отказ одного из запросов не влияет на остальные. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const unsigned reps = 200;
+#else
+  const unsigned reps = 5000;
+#endif
+  const unsigned nthreads = 8;
+  const uint64_t group_base = 1000000;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db, fpta_lazy));
+
+  {
+    bench_stopwatch stopwatch("insert, txn per row (8 threads, lazy)",
+                              nthreads * reps);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nthreads; ++t)
+      threads.push_back(std::thread([db, t, reps]() {
+        bench_insert_arg ctx;
+        ASSERT_NO_FATAL_FAILURE(bench_insert_init(&ctx));
+        for (unsigned i = 0; i < reps; ++i) {
+          fpta_txn *txn = nullptr;
+          ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+          ctx.key = t * reps + i;
+          ASSERT_EQ(FPTA_OK, bench_insert(txn, &ctx));
+          ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+        }
+        bench_insert_destroy(&ctx);
+      }));
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  {
+    bench_stopwatch stopwatch("insert, group commit (8 threads, lazy)",
+                              nthreads * reps);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nthreads; ++t)
+      threads.push_back(std::thread([db, t, reps, group_base]() {
+        bench_insert_arg ctx;
+        ASSERT_NO_FATAL_FAILURE(bench_insert_init(&ctx));
+        for (unsigned i = 0; i < reps; ++i) {
+          ctx.key = group_base + t * reps + i;
+          ASSERT_EQ(FPTA_OK, fpta_transaction_submit(db, bench_insert, &ctx));
+          if (i % 16 == 0) {
+            /* дубликат ключа из первой фазы */
+            ctx.key = t * reps + i;
+            ASSERT_EQ(FPTA_KEYEXIST,
+                      fpta_transaction_submit(db, bench_insert, &ctx));
+          }
+        }
+        bench_insert_destroy(&ctx);
+      }));
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  /* множество отказов в пачках не мешает фиксации остальных запросов */
+  const unsigned failing_threads = nthreads * 2, failing_reps = reps / 4;
+  {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < failing_threads; ++t)
+      threads.push_back(
+          std::thread([db, t, failing_reps, group_base]() {
+            bench_insert_arg ctx;
+            ASSERT_NO_FATAL_FAILURE(bench_insert_init(&ctx));
+            for (unsigned i = 0; i < failing_reps; ++i) {
+              ctx.key = group_base * 3 + t * failing_reps + i;
+              ctx.fail = (i + t) % 2 != 0;
+              ASSERT_EQ(ctx.fail ? FPTA_EINVAL : FPTA_OK,
+                        fpta_transaction_submit(db, bench_insert, &ctx));
+            }
+            bench_insert_destroy(&ctx);
+          }));
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  /* отказ после вставки откатывает её */
+  bench_insert_arg ctx;
+  ASSERT_NO_FATAL_FAILURE(bench_insert_init(&ctx));
+  ctx.key = group_base * 2;
+  ctx.fail = true;
+  EXPECT_EQ(FPTA_EINVAL, fpta_transaction_submit(db, bench_insert, &ctx));
+  EXPECT_EQ(FPTA_EINVAL, fpta_transaction_submit(db, nullptr, &ctx));
+
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &ctx.table, &ctx.pk));
+  fpta_cursor *cursor = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_cursor_open(txn, &ctx.pk, fpta_value_begin(),
+                                      fpta_value_end(), nullptr,
+                                      fpta_unsorted_dont_fetch, &cursor));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+  size_t committed = 0;
+  for (unsigned t = 0; t < failing_threads; ++t)
+    committed += (failing_reps + 1 - t % 2) / 2;
+  EXPECT_EQ(2u * nthreads * reps + committed, count);
+  const fpta_value rejected = fpta_value_uint(ctx.key);
+  EXPECT_EQ(FPTA_NODATA, fpta_cursor_locate(cursor, true, &rejected, nullptr));
+  ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  bench_insert_destroy(&ctx);
+  bench_remove_db(db);
+}
+
+static void bench_batch_table(fpta_db *db, const char *name) {
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "se", fptu_uint64,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("str", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, name, &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+}
+
+static void bench_batch_rows(fpta_db *db, size_t reps,
+                             std::vector<std::string> &holder,
+                             std::vector<fptu_ro> &ordered,
+                             std::vector<fptu_ro> &shuffled) {
+  /* Сериализованные кортежи хранятся в строках, а ключи
+   * перемешиваются детерминированно. */
+  fpta_name table, pk, se, str;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "loop"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se, "se"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &str, "str"));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &str));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  fptu_rw *tuple = fptu_alloc(3, 64);
+  ASSERT_NE(nullptr, tuple);
+  holder.resize(reps);
+  ordered.resize(reps);
+  shuffled.resize(reps);
+  for (size_t i = 0; i < reps; ++i) {
+    ASSERT_EQ(FPTU_OK, fptu_clear(tuple));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(tuple, &pk, fpta_value_uint(i)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(tuple, &se, fpta_value_uint(i % 1009)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(
+                  tuple, &str,
+                  fpta_value_cstr(std::to_string(i * 2654435761u).c_str())));
+    const fptu_ro row = fptu_take_noshrink(tuple);
+    holder[i].assign(static_cast<const char *>(row.sys.iov_base),
+                     row.sys.iov_len);
+    ordered[i].sys.iov_base = const_cast<char *>(holder[i].data());
+    ordered[i].sys.iov_len = holder[i].size();
+  }
+  for (size_t i = 0; i < reps; ++i)
+    shuffled[i] = ordered[(i * 2654435761u) % reps];
+  free(tuple);
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&se);
+  fpta_name_destroy(&str);
+}
+
+TEST(Bench, PutBatch) {
+  /* Вставка строк в случайном и возрастающем порядке ключей посредством
+   * fpta_put() для каждой строки и одним вызовом fpta_put_batch(). */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t reps = 10000;
+#else
+  const size_t reps = 100000;
+#endif
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db));
+
+  fpta_name table, batch;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "loop"));
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&batch, "batch"));
+  ASSERT_NO_FATAL_FAILURE(bench_batch_table(db, "loop"));
+  ASSERT_NO_FATAL_FAILURE(bench_batch_table(db, "batch"));
+
+  std::vector<std::string> holder;
+  std::vector<fptu_ro> ordered, shuffled;
+  ASSERT_NO_FATAL_FAILURE(
+      bench_batch_rows(db, reps, holder, ordered, shuffled));
+  fpta_txn *txn = nullptr;
+
+  for (const bool monotonic : {false, true}) {
+    const std::vector<fptu_ro> &rows = monotonic ? ordered : shuffled;
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    {
+      bench_stopwatch stopwatch(monotonic ? "fpta_put(), ordered keys"
+                                          : "fpta_put(), shuffled keys",
+                                reps);
+      for (size_t i = 0; i < reps; ++i)
+        ASSERT_EQ(FPTA_OK, fpta_put(txn, &table, rows[i], fpta_insert));
+    }
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    {
+      bench_stopwatch stopwatch(monotonic ? "fpta_put_batch(), ordered keys"
+                                          : "fpta_put_batch(), shuffled keys",
+                                reps);
+      ASSERT_EQ(FPTA_OK, fpta_put_batch(txn, &batch, rows.data(), reps,
+                                        fpta_insert, nullptr));
+    }
+    /* откатываем, чтобы следующий проход вставлял в пустую таблицу */
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+  }
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&batch);
+  bench_remove_db(db);
+}
+
+TEST(Bench, BulkLoad) {
+  /* Загрузка строк в случайном порядке ключей в таблицу со вторичным
+   * индексом: циклом fpta_insert_row() и посредством fpta_loader,
+   * в том числе с малым бюджетом памяти для слияния серий из файла. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t reps = 10000;
+#else
+  const size_t reps = 100000;
+#endif
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db, fpta_weak, 128));
+  ASSERT_NO_FATAL_FAILURE(bench_batch_table(db, "loop"));
+  ASSERT_NO_FATAL_FAILURE(bench_batch_table(db, "bulk"));
+  ASSERT_NO_FATAL_FAILURE(bench_batch_table(db, "spill"));
+
+  std::vector<std::string> holder;
+  std::vector<fptu_ro> ordered, shuffled;
+  ASSERT_NO_FATAL_FAILURE(
+      bench_batch_rows(db, reps, holder, ordered, shuffled));
+
+  fpta_name table;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "loop"));
+  {
+    bench_stopwatch stopwatch("fpta_insert_row() loop", reps);
+    fpta_txn *txn = nullptr;
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    for (size_t i = 0; i < reps; ++i)
+      ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, shuffled[i]));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  }
+  fpta_name_destroy(&table);
+
+  for (const char *name : {"bulk", "spill"}) {
+    const bool spill = strcmp(name, "spill") == 0;
+    EXPECT_EQ(FPTA_OK, fpta_table_init(&table, name));
+    bench_stopwatch stopwatch(spill ? "fpta_loader, sorted runs on disk"
+                                    : "fpta_loader, sorted in memory",
+                              reps);
+    fpta_loader *loader = nullptr;
+    /* малый бюджет, чтобы получить множество серий */
+    ASSERT_EQ(FPTA_OK,
+              fpta_loader_begin(db, &table, spill ? TEST_DB_DIR "." : nullptr,
+                                spill ? 42 * 1024 : 0, &loader));
+    for (size_t i = 0; i < reps; ++i)
+      ASSERT_EQ(FPTA_OK, fpta_loader_put(loader, shuffled[i]));
+    ASSERT_EQ(FPTA_OK, fpta_loader_end(loader, false));
+    fpta_name_destroy(&table);
+  }
+
+  bench_remove_db(db);
+}
+
+TEST(Bench, GetMany) {
+  /* Чтение сотен строк по первичному и уникальному вторичному ключам
+   * циклом fpta_get() и одним вызовом fpta_get_many(), часть ключей
+   * отсутствует. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t rows = 10000, reps = 20;
+#else
+  const size_t rows = 100000, reps = 200;
+#endif
+  const size_t fanout = 500;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db, fpta_weak, 64));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "uid", fptu_uint64,
+                         fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("str", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "many", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, uid, str;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "many"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &uid, "uid"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &str, "str"));
+
+  /* чётные значения pk, uid - перестановка 32-битных чисел. */
+  fptu_rw *tuple = fptu_alloc(3, 64);
+  ASSERT_NE(nullptr, tuple);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &uid));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &str));
+  for (size_t i = 0; i < rows; ++i) {
+    ASSERT_EQ(FPTU_OK, fptu_clear(tuple));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(tuple, &pk, fpta_value_uint(i * 2)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(tuple, &uid,
+                                 fpta_value_uint(uint32_t(i * 2654435761u))));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(tuple, &str,
+                                 fpta_value_cstr(std::to_string(i).c_str())));
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, fptu_take_noshrink(tuple)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  free(tuple);
+
+  /* Ключи каждого запроса перемешаны, но сосредоточены в окне из
+   * нескольких тысяч строк. Каждый десятый ключ отсутствует в таблице. */
+  const size_t window = fanout * 8;
+  std::vector<fpta_value> pk_keys(fanout * reps), uid_keys(fanout * reps);
+  for (size_t i = 0; i < pk_keys.size(); ++i) {
+    const size_t base = (i / fanout * 7919 * fanout) % (rows - window);
+    const size_t n = base + (i * 2654435761u) % window;
+    const bool miss = i % 10 == 0;
+    pk_keys[i] = fpta_value_uint(n * 2 + miss);
+    uid_keys[i] = fpta_value_uint(uint32_t(n * 2654435761u) ^ miss);
+  }
+
+  std::vector<fptu_ro> single(fanout), many(fanout);
+  std::vector<int> rcs(fanout);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  for (fpta_name *column : {&pk, &uid}) {
+    const bool primary = column == &pk;
+    const fpta_value *const keys = primary ? pk_keys.data() : uid_keys.data();
+    {
+      bench_stopwatch stopwatch(primary ? "fpta_get(), primary key"
+                                        : "fpta_get(), secondary key",
+                                fanout * reps);
+      for (size_t r = 0; r < reps; ++r)
+        for (size_t i = 0; i < fanout; ++i)
+          fpta_get(txn, column, &keys[r * fanout + i], &single[i]);
+    }
+    {
+      bench_stopwatch stopwatch(primary ? "fpta_get_many(), primary key"
+                                        : "fpta_get_many(), secondary key",
+                                fanout * reps);
+      for (size_t r = 0; r < reps; ++r)
+        EXPECT_EQ(FPTA_NOTFOUND,
+                  fpta_get_many(txn, column, &keys[r * fanout], fanout,
+                                many.data(), rcs.data()));
+    }
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&uid);
+  fpta_name_destroy(&str);
+  bench_remove_db(db);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(Bench, WriteWideSecondary) {
+  /* Обновление строк таблицы с десятком вторичных индексов, при котором
+   * меняется значение одной индексированной колонки либо только
+   * неиндексированной. Сравнивается fpta_validate_upsert_row() вместе с
+   * fpta_upsert_row(), где ключи строк вычисляются повторно, и
+   * fpta_probe_and_upsert_row(). */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t rows = 2000, updates = 20000;
+#else
+  const size_t rows = 20000, updates = 200000;
+#endif
+  const unsigned secondaries = 10;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db, fpta_weak, 256));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  for (unsigned i = 0; i < secondaries; ++i) {
+    const fpta_index_type index =
+        (i % 3 == 0) ? fpta_secondary_unique_ordered_obverse
+                     : (i % 3 == 1) ? fpta_secondary_withdups_ordered_obverse
+                                    : fpta_secondary_withdups_unordered;
+    EXPECT_EQ(FPTA_OK,
+              fpta_column_describe(("se_" + std::to_string(i)).c_str(),
+                                   (i & 1) ? fptu_cstr : fptu_uint64, index,
+                                   &def));
+  }
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("payload", fptu_uint64,
+                                          fpta_noindex_nullable, &def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "wide", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, payload, se[secondaries];
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "wide"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &payload, "payload"));
+  for (unsigned i = 0; i < secondaries; ++i)
+    EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se[i],
+                                        ("se_" + std::to_string(i)).c_str()));
+
+  /* значения колонки se_i строки n уникальны и задаются версией v,
+   * при обновлении версия меняется только у одной из колонок. */
+  std::vector<unsigned> versions(rows * secondaries, 0);
+  fptu_rw *tuple = fptu_alloc(secondaries + 2, secondaries * 32);
+  ASSERT_NE(nullptr, tuple);
+  auto fill = [&](size_t n, uint64_t tag) {
+    ASSERT_EQ(FPTU_OK, fptu_clear(tuple));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(tuple, &pk, fpta_value_uint(n)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(tuple, &payload, fpta_value_uint(tag)));
+    for (unsigned i = 0; i < secondaries; ++i) {
+      const uint64_t value =
+          (uint64_t(versions[n * secondaries + i]) << 32 | n) * 2654435761u;
+      ASSERT_EQ(FPTA_OK,
+                fpta_upsert_column(
+                    tuple, &se[i],
+                    (i & 1) ? fpta_value_cstr(std::to_string(value).c_str())
+                            : fpta_value_uint(value)));
+    }
+  };
+
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &payload));
+  for (unsigned i = 0; i < secondaries; ++i)
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se[i]));
+  for (size_t n = 0; n < rows; ++n) {
+    ASSERT_NO_FATAL_FAILURE(fill(n, 0));
+    ASSERT_EQ(FPTA_OK,
+              fpta_insert_row(txn, &table, fptu_take_noshrink(tuple)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  for (int mode = 0; mode < 4; ++mode) {
+    const bool probe = mode & 1, payload_only = mode & 2;
+    const std::string caption =
+        std::string(probe ? "fpta_probe_and_upsert_row()"
+                          : "fpta_validate_upsert_row() + fpta_upsert_row()") +
+        (payload_only ? ", non-indexed change" : ", one index changed");
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    {
+      bench_stopwatch stopwatch(caption.c_str(), updates);
+      for (size_t u = 0; u < updates; ++u) {
+        const size_t n = (u * 2654435761u) % rows;
+        if (!payload_only)
+          versions[n * secondaries + u % secondaries] += 1;
+        fill(n, u * 4 + mode);
+        const fptu_ro row = fptu_take_noshrink(tuple);
+        if (probe)
+          ASSERT_EQ(FPTA_OK, fpta_probe_and_upsert_row(txn, &table, row));
+        else {
+          ASSERT_EQ(FPTA_OK, fpta_validate_upsert_row(txn, &table, row));
+          ASSERT_EQ(FPTA_OK, fpta_upsert_row(txn, &table, row));
+        }
+      }
+    }
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  }
+
+  free(tuple);
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&payload);
+  for (unsigned i = 0; i < secondaries; ++i)
+    fpta_name_destroy(&se[i]);
+  bench_remove_db(db);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(Bench, LongKeys) {
+  /* Вставка, точечный поиск и выборка по диапазону для упорядоченного
+   * индекса по длинным строкам (URL) с общим началом: с подрезкой ключей
+   * до fpta_max_keylen с хэшем остатка и с увеличенным лимитом длины
+   * ключа, при котором ключи хранятся целиком. Для подрезанных ключей
+   * порядок нарушается, поэтому диапазон выбирает не те строки. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+#ifdef CI
+  const size_t rows = 10000, lookups = 20000;
+#else
+  const size_t rows = 100000, lookups = 200000;
+#endif
+  const size_t categories = 100;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(bench_create_db(&db, fpta_weak, 256));
+
+  const char *const tables[2] = {"hashed", "exact"};
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  for (const char *name : tables) {
+    fpta_column_set def;
+    fpta_column_set_init(&def);
+    EXPECT_EQ(FPTA_OK,
+              fpta_column_describe("url", fptu_cstr,
+                                   fpta_primary_unique_ordered_obverse, &def));
+    EXPECT_EQ(FPTA_OK, fpta_column_describe("hits", fptu_uint64,
+                                            fpta_noindex_nullable, &def));
+    if (name == tables[1]) {
+      EXPECT_EQ(FPTA_OK, fpta_describe_index_keylen("url", &def, 256));
+    }
+    ASSERT_EQ(FPTA_OK, fpta_table_create(txn, name, &def));
+    EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  /* категория и номер расположены за пределами fpta_max_keylen. */
+  const std::string site = "https://example.org/" + std::string(40, 'c');
+  const auto category = [&](size_t k) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "/%03u/", unsigned(k));
+    return site + buf;
+  };
+  const auto url = [&](size_t n) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%08u?ref=", unsigned(n * 2654435761u));
+    return category(n % categories) + buf + std::string(40, 'r');
+  };
+  std::vector<std::string> urls(rows);
+  for (size_t n = 0; n < rows; ++n)
+    urls[n] = url(n);
+
+  fptu_rw *tuple = fptu_alloc(2, 256);
+  ASSERT_NE(nullptr, tuple);
+  for (const char *name : tables) {
+    const std::string caption = std::string(name) + " keys",
+                      caption_insert = caption + ", insert",
+                      caption_get = caption + ", fpta_get()",
+                      caption_range = caption + ", range scan";
+    fpta_name table, col_url, col_hits;
+    EXPECT_EQ(FPTA_OK, fpta_table_init(&table, name));
+    EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_url, "url"));
+    EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_hits, "hits"));
+
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_url));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_hits));
+    {
+      bench_stopwatch stopwatch(caption_insert.c_str(), rows);
+      for (size_t n = 0; n < rows; ++n) {
+        ASSERT_EQ(FPTU_OK, fptu_clear(tuple));
+        ASSERT_EQ(FPTA_OK, fpta_upsert_column(tuple, &col_url,
+                                              fpta_value_str(urls[n])));
+        ASSERT_EQ(FPTA_OK,
+                  fpta_upsert_column(tuple, &col_hits, fpta_value_uint(n)));
+        ASSERT_EQ(FPTA_OK,
+                  fpta_insert_row(txn, &table, fptu_take_noshrink(tuple)));
+      }
+    }
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_url));
+    {
+      bench_stopwatch stopwatch(caption_get.c_str(), lookups);
+      for (size_t i = 0; i < lookups; ++i) {
+        const fpta_value key =
+            fpta_value_str(urls[(i * 2654435761u) % rows]);
+        fptu_ro row;
+        ASSERT_EQ(FPTA_OK, fpta_get(txn, &col_url, &key, &row));
+      }
+    }
+
+    /* Выборка строк одной категории, для подрезанных ключей границы
+     * диапазона также хэшируются и в него попадают случайные строки. */
+    size_t matched = 0, selected = 0;
+    {
+      bench_stopwatch stopwatch(caption_range.c_str(), rows);
+      for (size_t k = 0; k < categories; ++k) {
+        const std::string from = category(k), to = category(k + 1);
+        fpta_cursor *cursor = nullptr;
+        ASSERT_EQ(FPTA_OK, fpta_cursor_open(txn, &col_url, fpta_value_str(from),
+                                            fpta_value_str(to), nullptr,
+                                            fpta_ascending_dont_fetch,
+                                            &cursor));
+        for (int rc = fpta_cursor_move(cursor, fpta_first); rc == FPTA_OK;
+             rc = fpta_cursor_move(cursor, fpta_next)) {
+          fptu_ro row;
+          fpta_value value;
+          ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+          ASSERT_EQ(FPTA_OK, fpta_get_column(row, &col_url, &value));
+          ++selected;
+          matched += from.compare(0, from.size(), value.str, from.size()) == 0;
+        }
+        ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+      }
+    }
+    std::cout << "[    BENCH ] " << caption << ": " << selected
+              << " rows selected by ranges, " << matched << " of " << rows
+              << " matched exactly" << std::endl;
+    if (name == tables[1]) {
+      EXPECT_EQ(rows, selected);
+      EXPECT_EQ(rows, matched);
+    }
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+    fpta_name_destroy(&table);
+    fpta_name_destroy(&col_url);
+    fpta_name_destroy(&col_hits);
+  }
+  free(tuple);
+  bench_remove_db(db);
+}
+
+//------------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
@@ -1499,6 +1499,706 @@ TEST(Nullable, SchemaReload) {
 
 //----------------------------------------------------------------------------
 
+static void crud_create_db(fpta_db **pdb, size_t megabytes = 32) {
+  // чистим
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  megabytes, true, &db));
+  ASSERT_NE(nullptr, db);
+  *pdb = db;
+}
+
+static void crud_remove_db(fpta_db *db) {
+  ASSERT_EQ(FPTA_OK, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+/* Сохраняет сериализованную строку, так как буфер кортежа используется
+ * повторно, и возвращает ссылающийся на копию fptu_ro. */
+static fptu_ro crud_hold_row(std::deque<std::string> &holder, fptu_rw *pt) {
+  const fptu_ro row = fptu_take_noshrink(pt);
+  holder.emplace_back(static_cast<const char *>(row.sys.iov_base),
+                      row.sys.iov_len);
+  fptu_ro copy;
+  copy.sys.iov_base = const_cast<char *>(holder.back().data());
+  copy.sys.iov_len = holder.back().size();
+  return copy;
+}
+
+/* Проверяет, что индекс column содержит в точности пары из expected, т.е.
+ * каждое из значений находится через индекс в строке с заданным PK,
+ * а общее количество пар совпадает. */
+static void
+crud_check_index(fpta_txn *txn, fpta_name *column, fpta_name *pk,
+                 const std::vector<std::pair<fpta_value, uint64_t>> &expected) {
+  fpta_cursor *cursor = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_cursor_open(txn, column, fpta_value_begin(),
+                                      fpta_value_end(), nullptr,
+                                      fpta_unsorted_dont_fetch, &cursor));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+  EXPECT_EQ(expected.size(), count);
+  ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+
+  for (const auto &pair : expected) {
+    SCOPED_TRACE("pk " + std::to_string(pair.second));
+    ASSERT_EQ(FPTA_OK,
+              fpta_cursor_open(txn, column, pair.first, fpta_value_epsilon(),
+                               nullptr, fpta_unsorted, &cursor));
+    bool found = false;
+    do {
+      fptu_ro row;
+      fpta_value value;
+      ASSERT_EQ(FPTA_OK, fpta_cursor_get(cursor, &row));
+      ASSERT_EQ(FPTA_OK, fpta_get_column(row, pk, &value));
+      found |= value.uint == pair.second;
+    } while (fpta_cursor_move(cursor, fpta_next) == FPTA_OK);
+    EXPECT_TRUE(found);
+    ASSERT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  }
+}
+
+TEST(CRUD, PutBatch) {
+  /* Проверка fpta_put_batch().
+   *
+   * Сценарий:
+   *  1. Создаем таблицу с первичным индексом по pk и вторичным
+   *     с дубликатами по se.
+   *
+   *  2. Вставляем упорядоченную по pk порцию в пустую таблицу, т.е. в
+   *     режиме MDBX_APPEND, проверяем коды результата строк.
+   *
+   *  3. Вставляем порцию, ключи которой перемешаны и частично меньше уже
+   *     имеющихся, т.е. добавление в конец возможно только для части
+   *     строк, а также две строки с одинаковым pk, из которых должна
+   *     остаться последняя.
+   *
+   *  4. Применяем порции с ошибками в отдельных строках (нет pk, повтор
+   *     pk при fpta_insert, отсутствие строки при fpta_update) вперемешку
+   *     с корректными строками и проверяем, что последние применены.
+   *
+   *  5. После каждого шага проверяем, что вторичный индекс содержит
+   *     в точности ожидаемые пары. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(crud_create_db(&db));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "se", fptu_uint64,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "batch", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, se;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "batch"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se, "se"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  fptu_rw *pt = fptu_alloc(2, 32);
+  ASSERT_NE(nullptr, pt);
+  std::deque<std::string> holder;
+  std::map<uint64_t, uint64_t> model;
+  auto make_row = [&](uint64_t pk_value, uint64_t se_value) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &pk, fpta_value_uint(pk_value)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se, fpta_value_uint(se_value)));
+    return crud_hold_row(holder, pt);
+  };
+  auto check = [&]() {
+    std::vector<std::pair<fpta_value, uint64_t>> expected;
+    for (const auto &pair : model)
+      expected.emplace_back(fpta_value_uint(pair.second), pair.first);
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    size_t rows = 0;
+    EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &rows, nullptr));
+    EXPECT_EQ(model.size(), rows);
+    ASSERT_NO_FATAL_FAILURE(crud_check_index(txn, &se, &pk, expected));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  };
+
+  //--------------------------------------------------------------------------
+  // упорядоченная порция в пустую таблицу
+  std::vector<fptu_ro> batch;
+  for (uint64_t n = 1; n <= 10; ++n) {
+    batch.push_back(make_row(n * 10, n % 3));
+    model[n * 10] = n % 3;
+  }
+  std::vector<int> rcs(batch.size(), FPTA_EOOPS);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &table, batch.data(), batch.size(),
+                                    fpta_insert, rcs.data()));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  for (const int rc : rcs)
+    EXPECT_EQ(FPTA_OK, rc);
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  //--------------------------------------------------------------------------
+  // перемешанная порция, ключи которой частично меньше имеющихся
+  batch.clear();
+  for (const uint64_t n : {105, 5, 120, 110, 55, 120, 115}) {
+    const uint64_t se_value = n + batch.size();
+    batch.push_back(make_row(n, se_value));
+    model[n] = se_value;
+  }
+  rcs.assign(batch.size(), FPTA_EOOPS);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  EXPECT_EQ(FPTA_OK, fpta_put_batch(txn, &table, batch.data(), batch.size(),
+                                    fpta_upsert, rcs.data()));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  for (const int rc : rcs)
+    EXPECT_EQ(FPTA_OK, rc);
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  //--------------------------------------------------------------------------
+  // ошибки отдельных строк не мешают применению остальных
+  batch.clear();
+  batch.push_back(make_row(10, 42));
+  batch.push_back(make_row(7, 43));
+  EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se, fpta_value_uint(44)));
+  batch.push_back(crud_hold_row(holder, pt));
+  batch.push_back(make_row(200, 45));
+  batch.push_back(make_row(7, 46));
+  model[7] = 43;
+  model[200] = 45;
+  rcs.assign(batch.size(), FPTA_EOOPS);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_put_batch(txn, &table, batch.data(), batch.size(),
+                           fpta_insert, rcs.data()));
+  EXPECT_EQ(FPTA_KEYEXIST, rcs[0]);
+  EXPECT_EQ(FPTA_OK, rcs[1]);
+  EXPECT_EQ(FPTA_COLUMN_MISSING, rcs[2]);
+  EXPECT_EQ(FPTA_OK, rcs[3]);
+  EXPECT_EQ(FPTA_KEYEXIST, rcs[4]);
+
+  batch.clear();
+  batch.push_back(make_row(999, 47));
+  batch.push_back(make_row(200, 48));
+  batch.push_back(make_row(5, 1));
+  model[200] = 48;
+  model[5] = 1;
+  rcs.assign(batch.size(), FPTA_EOOPS);
+  EXPECT_EQ(FPTA_NOTFOUND,
+            fpta_put_batch(txn, &table, batch.data(), batch.size(),
+                           fpta_update, rcs.data()));
+  EXPECT_EQ(FPTA_NOTFOUND, rcs[0]);
+  EXPECT_EQ(FPTA_OK, rcs[1]);
+  EXPECT_EQ(FPTA_OK, rcs[2]);
+
+  EXPECT_EQ(FPTA_EFLAG, fpta_put_batch(txn, &table, batch.data(), 1,
+                                       (fpta_put_options)42, nullptr));
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_put_batch(txn, &table, nullptr, 1, fpta_insert, nullptr));
+  EXPECT_EQ(FPTA_OK,
+            fpta_put_batch(txn, &table, nullptr, 0, fpta_insert, nullptr));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  free(pt);
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&se);
+  ASSERT_NO_FATAL_FAILURE(crud_remove_db(db));
+}
+
+//----------------------------------------------------------------------------
+
+TEST(CRUD, BulkLoader) {
+  /* Проверка загрузчика fpta_loader.
+   *
+   * Сценарий:
+   *  1. Создаем таблицу с первичным индексом по pk, вторичным с дубликатами
+   *     по se и уникальным вторичным по uid.
+   *
+   *  2. Загружаем строки в перемешанном порядке с малым бюджетом памяти,
+   *     указав несуществующий каталог для временных файлов. Загрузка
+   *     должна прерваться ошибкой, т.е. серии действительно сбрасываются
+   *     на диск, а таблица остаться пустой.
+   *
+   *  3. Повторяем загрузку с существующим каталогом и проверяем количество
+   *     строк и пар в каждом из индексов.
+   *
+   *  4. Проверяем, что повтор первичного ключа (с уже имеющейся строкой
+   *     или в пределах загрузки) и нарушение уникальности вторичного
+   *     индекса отменяют загрузку целиком, а ошибка в данных отдельной
+   *     строки её не прерывает. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  const unsigned rows = 2000;
+  /* порядка полусотни строк на серию */
+  const size_t budget = 4096;
+  static const char missing_dir[] = TEST_DB_DIR "ut_crud.missing";
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(crud_create_db(&db));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "se", fptu_uint64,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("uid", fptu_uint64,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "bulk", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, se, uid;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "bulk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se, "se"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &uid, "uid"));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &uid));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  /* значения pk чётные, uid - перестановка 32-битных чисел */
+  fptu_rw *pt = fptu_alloc(3, 32);
+  ASSERT_NE(nullptr, pt);
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> model;
+  auto make_row = [&](uint64_t pk_value, uint64_t se_value,
+                      uint64_t uid_value) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &pk, fpta_value_uint(pk_value)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se, fpta_value_uint(se_value)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &uid, fpta_value_uint(uid_value)));
+    return fptu_take_noshrink(pt);
+  };
+  auto check = [&]() {
+    std::vector<std::pair<fpta_value, uint64_t>> se_pairs, uid_pairs;
+    for (const auto &item : model) {
+      se_pairs.emplace_back(fpta_value_uint(item.second.first), item.first);
+      uid_pairs.emplace_back(fpta_value_uint(item.second.second), item.first);
+    }
+    ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+    size_t count = 0;
+    EXPECT_EQ(FPTA_OK, fpta_table_info(txn, &table, &count, nullptr));
+    EXPECT_EQ(model.size(), count);
+    ASSERT_NO_FATAL_FAILURE(crud_check_index(txn, &se, &pk, se_pairs));
+    ASSERT_NO_FATAL_FAILURE(crud_check_index(txn, &uid, &pk, uid_pairs));
+    ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  };
+  auto load = [&](const char *spill_dir, fpta_loader **ploader) {
+    ASSERT_EQ(FPTA_OK,
+              fpta_loader_begin(db, &table, spill_dir, budget, ploader));
+    int rc = FPTA_OK;
+    for (unsigned i = 0; i < rows && rc == FPTA_OK; ++i) {
+      const unsigned n = (i * 7919) % rows;
+      rc = fpta_loader_put(*ploader, make_row(n * 2, n % 17,
+                                              uint32_t(n * 2654435761u)));
+    }
+    if (spill_dir == missing_dir) {
+      EXPECT_NE(FPTA_OK, rc);
+      EXPECT_EQ(rc, fpta_loader_end(*ploader, false));
+    } else {
+      EXPECT_EQ(FPTA_OK, rc);
+      EXPECT_EQ(FPTA_OK, fpta_loader_end(*ploader, false));
+    }
+    *ploader = nullptr;
+  };
+
+  //--------------------------------------------------------------------------
+  // серии не удается сбросить на диск
+  fpta_loader *loader = nullptr;
+  ASSERT_NO_FATAL_FAILURE(load(missing_dir, &loader));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  //--------------------------------------------------------------------------
+  // загрузка со слиянием серий из временных файлов
+  ASSERT_NO_FATAL_FAILURE(load(TEST_DB_DIR ".", &loader));
+  for (unsigned n = 0; n < rows; ++n)
+    model[n * 2] = std::make_pair(n % 17, uint32_t(n * 2654435761u));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  //--------------------------------------------------------------------------
+  // повтор первичного ключа с имеющейся строкой
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &table, nullptr, budget, &loader));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(1, 1, 1)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(42, 2, 2)));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_loader_end(loader, false));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  // повтор первичного ключа в пределах загрузки
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &table, nullptr, budget, &loader));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(3, 3, 3)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(5, 5, 5)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(3, 4, 4)));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_loader_end(loader, false));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  // нарушение уникальности вторичного индекса
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &table, nullptr, budget, &loader));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(7, 7, 7)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(9, 9, 7)));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_loader_end(loader, false));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  // ошибка в данных строки не прерывает загрузку
+  ASSERT_EQ(FPTA_OK, fpta_loader_begin(db, &table, nullptr, budget, &loader));
+  EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se, fpta_value_uint(11)));
+  EXPECT_EQ(FPTA_COLUMN_MISSING,
+            fpta_loader_put(loader, fptu_take_noshrink(pt)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_put(loader, make_row(11, 11, 11)));
+  EXPECT_EQ(FPTA_OK, fpta_loader_end(loader, false));
+  model[11] = std::make_pair(11, 11);
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  EXPECT_EQ(FPTA_EINVAL, fpta_loader_begin(db, &table, nullptr, 0, nullptr));
+  free(pt);
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&se);
+  fpta_name_destroy(&uid);
+  ASSERT_NO_FATAL_FAILURE(crud_remove_db(db));
+}
+
+//----------------------------------------------------------------------------
+
+TEST(CRUD, GetMany) {
+  /* Проверка fpta_get_many().
+   *
+   * Сценарий:
+   *  1. Создаем таблицу с первичным индексом по pk, уникальным
+   *     неупорядоченным вторичным по uid, вторичным с дубликатами по se
+   *     и неиндексированной колонкой str, вставляем десяток строк.
+   *
+   *  2. Запрашиваем строки по первичному и вторичному ключам, которые
+   *     перемешаны, частично повторяются или отсутствуют в таблице.
+   *     Результат для каждой позиции должен совпадать с fpta_get(),
+   *     а код возврата - соответствовать первому отсутствующему ключу.
+   *
+   *  3. Проверяем ошибки в отдельных значениях и в аргументах. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(crud_create_db(&db));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("uid", fptu_uint64,
+                                 fpta_secondary_unique_unordered, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "se", fptu_uint64,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("str", fptu_cstr,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "many", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, uid, se, str;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "many"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &uid, "uid"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se, "se"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &str, "str"));
+
+  // строки с pk = 10, 20 ... 100 и uid = 1000 + pk * 3
+  fptu_rw *pt = fptu_alloc(4, 64);
+  ASSERT_NE(nullptr, pt);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &uid));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &str));
+  for (uint64_t n = 10; n <= 100; n += 10) {
+    ASSERT_EQ(FPTU_OK, fptu_clear(pt));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &pk, fpta_value_uint(n)));
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &uid, fpta_value_uint(1000 + n * 3)));
+    ASSERT_EQ(FPTA_OK, fpta_upsert_column(pt, &se, fpta_value_uint(n % 3)));
+    const std::string text = std::to_string(n);
+    ASSERT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &str, fpta_value_cstr(text.c_str())));
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(pt)));
+  }
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  free(pt);
+
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  fptu_ro rows[8];
+  int rcs[8];
+  /* Сверяет результаты fpta_get_many() с fpta_get() для каждого ключа,
+   * expected_pk - ожидаемое значение pk или 0 для отсутствующего ключа. */
+  auto check = [&](fpta_name *column, const std::vector<fpta_value> &keys,
+                   const std::vector<uint64_t> &expected_pk, int expected_rc) {
+    ASSERT_LE(keys.size(), 8u);
+    ASSERT_EQ(keys.size(), expected_pk.size());
+    for (size_t i = 0; i < 8; ++i)
+      rcs[i] = -1;
+    EXPECT_EQ(expected_rc, fpta_get_many(txn, column, keys.data(), keys.size(),
+                                         rows, rcs));
+    for (size_t i = 0; i < keys.size(); ++i) {
+      SCOPED_TRACE("key #" + std::to_string(i));
+      fptu_ro single;
+      EXPECT_EQ(fpta_get(txn, column, &keys[i], &single), rcs[i]);
+      if (expected_pk[i] == 0) {
+        EXPECT_EQ(FPTA_NOTFOUND, rcs[i]);
+        EXPECT_EQ(nullptr, rows[i].sys.iov_base);
+        EXPECT_EQ(0u, rows[i].sys.iov_len);
+        continue;
+      }
+      EXPECT_EQ(FPTA_OK, rcs[i]);
+      ASSERT_EQ(single.sys.iov_len, rows[i].sys.iov_len);
+      EXPECT_EQ(0, memcmp(single.sys.iov_base, rows[i].sys.iov_base,
+                          single.sys.iov_len));
+      fpta_value value;
+      ASSERT_EQ(FPTA_OK, fpta_get_column(rows[i], &pk, &value));
+      EXPECT_EQ(expected_pk[i], value.uint);
+    }
+    EXPECT_EQ(-1, rcs[keys.size()]);
+  };
+
+  // первичный ключ: перемешанные, повторяющиеся и отсутствующие ключи
+  ASSERT_NO_FATAL_FAILURE(check(
+      &pk,
+      {fpta_value_uint(70), fpta_value_uint(15), fpta_value_uint(10),
+       fpta_value_uint(70), fpta_value_uint(100), fpta_value_uint(0),
+       fpta_value_uint(40)},
+      {70, 0, 10, 70, 100, 0, 40}, FPTA_NOTFOUND));
+  ASSERT_NO_FATAL_FAILURE(check(
+      &pk, {fpta_value_uint(90), fpta_value_uint(20), fpta_value_uint(90)},
+      {90, 20, 90}, FPTA_OK));
+
+  // вторичный ключ
+  ASSERT_NO_FATAL_FAILURE(check(
+      &uid,
+      {fpta_value_uint(1300), fpta_value_uint(1031), fpta_value_uint(1030),
+       fpta_value_uint(1300), fpta_value_uint(1120), fpta_value_uint(7)},
+      {100, 0, 10, 100, 40, 0}, FPTA_NOTFOUND));
+  ASSERT_NO_FATAL_FAILURE(check(
+      &uid, {fpta_value_uint(1150), fpta_value_uint(1060)}, {50, 20},
+      FPTA_OK));
+
+  // ошибки значений ключей касаются только соответствующих позиций
+  const fpta_value mixed[3] = {fpta_value_uint(30), fpta_value_cstr("42"),
+                               fpta_value_uint(60)};
+  EXPECT_EQ(FPTA_ETYPE, fpta_get_many(txn, &pk, mixed, 3, rows, rcs));
+  EXPECT_EQ(FPTA_OK, rcs[0]);
+  EXPECT_EQ(FPTA_ETYPE, rcs[1]);
+  EXPECT_EQ(nullptr, rows[1].sys.iov_base);
+  EXPECT_EQ(FPTA_OK, rcs[2]);
+  EXPECT_NE(nullptr, rows[2].sys.iov_base);
+
+  // ошибки аргументов
+  EXPECT_EQ(FPTA_OK, fpta_get_many(txn, &pk, mixed, 1, rows, nullptr));
+  EXPECT_NE(nullptr, rows[0].sys.iov_base);
+  EXPECT_EQ(FPTA_OK, fpta_get_many(txn, &pk, nullptr, 0, nullptr, nullptr));
+  EXPECT_EQ(FPTA_EINVAL, fpta_get_many(txn, &pk, mixed, 1, nullptr, rcs));
+  EXPECT_EQ(FPTA_EINVAL, fpta_get_many(txn, &pk, nullptr, 1, rows, rcs));
+  EXPECT_EQ(FPTA_EINVAL, rcs[0]);
+  EXPECT_EQ(FPTA_NO_INDEX, fpta_get_many(txn, &str, mixed, 1, rows, rcs));
+  EXPECT_EQ(FPTA_NO_INDEX, rcs[0]);
+  EXPECT_EQ(FPTA_NO_INDEX, fpta_get_many(txn, &se, mixed, 1, rows, rcs));
+  EXPECT_EQ(FPTA_NO_INDEX, rcs[0]);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&uid);
+  fpta_name_destroy(&se);
+  fpta_name_destroy(&str);
+  ASSERT_NO_FATAL_FAILURE(crud_remove_db(db));
+}
+
+//----------------------------------------------------------------------------
+
+TEST(CRUD, UpdateWideSecondary) {
+  /* Проверка обновления строк таблицы с несколькими вторичными индексами,
+   * при котором меняется только часть индексированных колонок.
+   *
+   * Сценарий:
+   *  1. Создаем таблицу с первичным индексом по pk и шестью вторичными
+   *     индексами всех видов (уникальные и с дубликатами, упорядоченные
+   *     и неупорядоченные, по числам и строкам), вставляем строки.
+   *
+   *  2. Обновляем строки, изменяя значения части колонок, чередуя
+   *     fpta_probe_and_upsert_row() и fpta_validate_upsert_row() вместе
+   *     с fpta_upsert_row(), в том числе без изменения индексированных
+   *     колонок. После каждого обновления проверяем, что каждый индекс
+   *     содержит в точности ожидаемые пары.
+   *
+   *  3. Проверяем, что обновление с нарушением уникальности отклоняется
+   *     и не изменяет индексы. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  const unsigned rows = 8, secondaries = 6;
+
+  fpta_db *db = nullptr;
+  ASSERT_NO_FATAL_FAILURE(crud_create_db(&db));
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  for (unsigned i = 0; i < secondaries; ++i) {
+    const fpta_index_type index =
+        (i % 3 == 0) ? fpta_secondary_unique_ordered_obverse
+                     : (i % 3 == 1) ? fpta_secondary_withdups_ordered_obverse
+                                    : fpta_secondary_withdups_unordered;
+    EXPECT_EQ(FPTA_OK,
+              fpta_column_describe(("se_" + std::to_string(i)).c_str(),
+                                   (i & 1) ? fptu_cstr : fptu_uint64, index,
+                                   &def));
+  }
+  EXPECT_EQ(FPTA_OK, fpta_column_describe("payload", fptu_uint64,
+                                          fpta_noindex_nullable, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "wide", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  fpta_name table, pk, payload, se[secondaries];
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "wide"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &payload, "payload"));
+  for (unsigned i = 0; i < secondaries; ++i)
+    EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &se[i],
+                                        ("se_" + std::to_string(i)).c_str()));
+
+  /* Значение колонки se_i строки n задается версией v, для индексов
+   * с дубликатами значения повторяются у каждой третьей строки. */
+  unsigned versions[rows][secondaries] = {};
+  std::deque<std::string> holder;
+  auto value = [&](unsigned n, unsigned i) {
+    const uint64_t number =
+        (i % 3 == 0 ? n : n % 3) * 1000 + i * 10 + versions[n][i];
+    if (!(i & 1))
+      return fpta_value_uint(number);
+    holder.push_back(std::to_string(number));
+    return fpta_value_cstr(holder.back().c_str());
+  };
+  fptu_rw *pt = fptu_alloc(secondaries + 2, secondaries * 32);
+  ASSERT_NE(nullptr, pt);
+  auto make_row = [&](unsigned n, uint64_t tag) {
+    EXPECT_EQ(FPTU_OK, fptu_clear(pt));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &pk, fpta_value_uint(n)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &payload, fpta_value_uint(tag)));
+    for (unsigned i = 0; i < secondaries; ++i)
+      EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se[i], value(n, i)));
+    return fptu_take_noshrink(pt);
+  };
+  auto check = [&]() {
+    holder.clear();
+    for (unsigned i = 0; i < secondaries; ++i) {
+      SCOPED_TRACE("se_" + std::to_string(i));
+      std::vector<std::pair<fpta_value, uint64_t>> expected;
+      for (unsigned n = 0; n < rows; ++n)
+        expected.emplace_back(value(n, i), n);
+      ASSERT_NO_FATAL_FAILURE(crud_check_index(txn, &se[i], &pk, expected));
+    }
+  };
+
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &payload));
+  for (unsigned i = 0; i < secondaries; ++i)
+    ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &se[i]));
+  for (unsigned n = 0; n < rows; ++n)
+    ASSERT_EQ(FPTA_OK, fpta_insert_row(txn, &table, make_row(n, 0)));
+  ASSERT_NO_FATAL_FAILURE(check());
+
+  //--------------------------------------------------------------------------
+  // обновления с изменением части колонок, маска 0 - только payload
+  static const unsigned masks[] = {5, 56, 0, 18, 63, 1, 0, 34, 12, 41};
+  for (unsigned step = 0; step < sizeof(masks) / sizeof(masks[0]); ++step) {
+    const unsigned n = (step * 5) % rows;
+    const bool probe = step & 1;
+    SCOPED_TRACE("step " + std::to_string(step) + ", row " +
+                 std::to_string(n) + (probe ? ", probe" : ", validate"));
+    for (unsigned i = 0; i < secondaries; ++i)
+      if (masks[step] & (1u << i))
+        versions[n][i] += 1;
+    const fptu_ro row = make_row(n, step + 1);
+    if (probe)
+      ASSERT_EQ(FPTA_OK, fpta_probe_and_upsert_row(txn, &table, row));
+    else {
+      ASSERT_EQ(FPTA_OK, fpta_validate_upsert_row(txn, &table, row));
+      ASSERT_EQ(FPTA_OK, fpta_upsert_row(txn, &table, row));
+    }
+    ASSERT_NO_FATAL_FAILURE(check());
+  }
+
+  //--------------------------------------------------------------------------
+  // нарушение уникальности: строка 1 получает значение se_0 строки 2,
+  // а изменение se_1 в той же строке не должно попасть в индекс
+  versions[1][1] += 1;
+  make_row(1, 42);
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &se[0], value(2, 0)));
+  const fptu_ro row = fptu_take_noshrink(pt);
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_validate_upsert_row(txn, &table, row));
+  EXPECT_EQ(FPTA_KEYEXIST, fpta_probe_and_upsert_row(txn, &table, row));
+  versions[1][1] -= 1;
+  ASSERT_NO_FATAL_FAILURE(check());
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NO_FATAL_FAILURE(check());
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+
+  free(pt);
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  fpta_name_destroy(&payload);
+  for (unsigned i = 0; i < secondaries; ++i)
+    fpta_name_destroy(&se[i]);
+  ASSERT_NO_FATAL_FAILURE(crud_remove_db(db));
+}
+
+//----------------------------------------------------------------------------
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   mdbx_setup_debug(MDBX_LOG_WARN,
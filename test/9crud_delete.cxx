@@ -0,0 +1,175 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fpta_test.h"
+#include "tools.hpp"
+
+static const char testdb_name[] = TEST_DB_DIR "ut_crud_delete.fpta";
+static const char testdb_name_lck[] =
+    TEST_DB_DIR "ut_crud_delete.fpta" MDBX_LOCK_SUFFIX;
+
+TEST(CRUD, DeleteByKey) {
+  /* Smoke-проверка удаления строк по значению первичного и уникального
+   * вторичного ключа, без предварительного чтения строки.
+   *
+   * Сценарий:
+   *  1. Создаем базу с одной таблицей, в которой есть уникальный и
+   *     допускающий дубликаты вторичные индексы.
+   *
+   *  2. Вставляем 11 строк с близкими значениями ключей.
+   *
+   *  3. Удаляем строку по первичному ключу, затем строку из той же
+   *     (теперь "грязной") страницы по вторичному ключу. Проверяем
+   *     отсутствие удаленных строк и согласованность всех индексов.
+   *
+   *  4. Проверяем обработку отсутствующих ключей и неуникального индекса.
+   *
+   *  5. Завершаем операции и освобождаем ресурсы.
+   */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  // создаем базу
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  // описываем структуру таблицы и создаем её
+  fpta_txn *txn = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_NE(nullptr, txn);
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("Nnn", fptu_int64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_describe(
+                         "_createdAt", fptu_datetime,
+                         fpta_secondary_withdups_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("_id", fptu_int64,
+                                 fpta_secondary_unique_ordered_obverse, &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_validate(&def));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "victims", &def));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // готовим идентификаторы и вставляем 11 строк
+  fpta_name table, col_num, col_date, col_id;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "victims"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_num, "Nnn"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_date, "_createdAt"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &col_id, "_id"));
+
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &col_num));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_date));
+  ASSERT_EQ(FPTA_OK, fpta_name_refresh(txn, &col_id));
+
+  fptu_rw *pt = fptu_alloc(3, 8 + 8 + 8);
+  ASSERT_NE(nullptr, pt);
+  for (int i = 0; i < 11; ++i) {
+    fptu_time datetime;
+    datetime.fixedpoint = 1492170771 + i / 2;
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_num, fpta_value_sint(100 + i)));
+    EXPECT_EQ(FPTA_OK, fpta_upsert_column(pt, &col_date,
+                                          fpta_value_datetime(datetime)));
+    EXPECT_EQ(FPTA_OK,
+              fpta_upsert_column(pt, &col_id,
+                                 fpta_value_sint(6408824664381050880 + i)));
+    EXPECT_EQ(FPTA_OK, fpta_put(txn, &table, fptu_take_noshrink(pt),
+                                fpta_insert));
+  }
+  free(pt);
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // начинаем транзакцию с удалениями
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  ASSERT_NE(nullptr, txn);
+  fptu_ro row;
+  fpta_value num = fpta_value_sint(104);
+  fpta_value id = fpta_value_sint(6408824664381050880 + 4);
+  EXPECT_EQ(FPTA_OK, fpta_delete_by_key(txn, &col_num, &num));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_num, &num, &row));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_id, &id, &row));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_delete_by_key(txn, &col_num, &num));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_delete_by_key(txn, &col_id, &id));
+
+  // соседняя строка теперь в "грязной" странице
+  num = fpta_value_sint(105);
+  id = fpta_value_sint(6408824664381050880 + 5);
+  EXPECT_EQ(FPTA_OK, fpta_get(txn, &col_id, &id, &row));
+  EXPECT_EQ(MDBX_RESULT_TRUE, mdbx_is_dirty(txn->mdbx_txn, row.sys.iov_base));
+  EXPECT_EQ(FPTA_OK, fpta_delete_by_key(txn, &col_id, &id));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_num, &num, &row));
+  EXPECT_EQ(FPTA_NOTFOUND, fpta_get(txn, &col_id, &id, &row));
+
+  // неуникальный индекс и неверный тип значения
+  fptu_time datetime;
+  datetime.fixedpoint = 1492170771;
+  const fpta_value date = fpta_value_datetime(datetime);
+  EXPECT_EQ(FPTA_NO_INDEX, fpta_delete_by_key(txn, &col_date, &date));
+  const fpta_value str = fpta_value_cstr("104");
+  EXPECT_EQ(FPTA_ETYPE, fpta_delete_by_key(txn, &col_num, &str));
+  EXPECT_EQ(FPTA_EINVAL, fpta_delete_by_key(txn, &col_num, nullptr));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  // проверяем согласованность индексов
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_read, &txn));
+  ASSERT_NE(nullptr, txn);
+  EXPECT_EQ(9u, count_rows(txn, &col_num));
+  EXPECT_EQ(9u, count_rows(txn, &col_date));
+  EXPECT_EQ(9u, count_rows(txn, &col_id));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  txn = nullptr;
+
+  //--------------------------------------------------------------------------
+  // освобождаем ресурсы
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&col_num);
+  fpta_name_destroy(&col_date);
+  fpta_name_destroy(&col_id);
+
+  EXPECT_EQ(FPTA_SUCCESS, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//----------------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  mdbx_setup_debug(MDBX_LOG_WARN,
+                   MDBX_DBG_ASSERT | MDBX_DBG_AUDIT | MDBX_DBG_DUMP |
+                       MDBX_DBG_LEGACY_MULTIOPEN | MDBX_DBG_JITTER,
+                   nullptr);
+  return RUN_ALL_TESTS();
+}
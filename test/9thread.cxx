@@ -16,9 +16,12 @@
  */
 
 #include "fpta_test.h"
+#include <atomic>
+#include <chrono>
 #include <functional> // for std::ref
 #include <string>
 #include <thread>
+#include <vector>
 
 static const char testdb_name[] = TEST_DB_DIR "ut_thread.fpta";
 static const char testdb_name_lck[] =
@@ -897,6 +900,232 @@ TEST(Threaded, AsyncSchemaChange) {
 
 //------------------------------------------------------------------------------
 
+static void guard_thread_proc(fpta_db *db, const int reps,
+                              const volatile bool &start_flag) {
+  while (!start_flag)
+    std::this_thread::yield();
+
+  for (int i = 0; i < reps; ++i) {
+    fpta_txn *txn = nullptr;
+    int err = fpta_transaction_begin(db, fpta_read, &txn);
+    if (err != FPTA_OK) {
+      EXPECT_EQ(FPTA_OK, err);
+      break;
+    }
+    err = fpta_transaction_end(txn, false);
+    if (err != FPTA_OK) {
+      EXPECT_EQ(FPTA_OK, err);
+      break;
+    }
+  }
+}
+
+TEST(Threaded, SchemaGuardScaling) {
+  /* Сценарий:
+   *  - открываем БД с изменяемой схемой, т.е. с блокировкой схемы;
+   *  - для 1, 2, 4 ... N потоков измеряем среднее время пары
+   *    fpta_transaction_begin(fpta_read) + fpta_transaction_end();
+   *  - параллельно с читателями несколько раз запускаем транзакции уровня
+   *    fpta_schema, которые должны дождаться ухода всех читателей. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_weak, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+#ifdef CI
+  const int reps = 10000;
+#else
+  const int reps = 100000;
+#endif
+  const unsigned ncpu = std::thread::hardware_concurrency();
+  const unsigned max_threads = std::min(32u, std::max(2u, ncpu * 2));
+
+  for (unsigned nthreads = 1; nthreads <= max_threads; nthreads <<= 1) {
+    SCOPED_TRACE("threads " + std::to_string(nthreads));
+    volatile bool start_flag = false;
+    std::vector<std::thread> threads;
+    for (unsigned n = 0; n < nthreads; ++n)
+      threads.push_back(
+          std::thread(guard_thread_proc, db, reps, std::cref(start_flag)));
+
+    const auto begin = std::chrono::steady_clock::now();
+    start_flag = true;
+    for (int i = 0; i < 3; ++i) {
+      fpta_txn *txn = nullptr;
+      EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+      EXPECT_EQ(FPTA_OK, fpta_transaction_end(txn, true));
+      std::this_thread::yield();
+    }
+    for (auto &thread : threads)
+      thread.join();
+    const auto end = std::chrono::steady_clock::now();
+
+    const double ns =
+        std::chrono::duration<double, std::nano>(end - begin).count();
+    printf("[ SCALING  ] %2u thread(s): %.1f ns/txn per thread, "
+           "%.1f Mtxn/s total\n",
+           nthreads, ns / reps, nthreads * reps * 1e3 / ns);
+    fflush(stdout);
+  }
+
+  EXPECT_EQ(FPTA_OK, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t async_commit_one(fpta_db *db) {
+  /* Изменение только последовательности не затрагивает страниц данных
+   * и фиксируется как сильная точка, поэтому вставляем строку. */
+  fpta_name table, pk;
+  EXPECT_EQ(FPTA_OK, fpta_table_init(&table, "table"));
+  EXPECT_EQ(FPTA_OK, fpta_column_init(&table, &pk, "pk"));
+  fptu_rw *tuple = fptu_alloc(1, 8);
+  EXPECT_NE(nullptr, tuple);
+
+  fpta_txn *txn = nullptr;
+  uint64_t sequence = 0, txnid = 0;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  EXPECT_EQ(FPTA_OK, fpta_db_sequence(txn, &sequence, 1));
+  EXPECT_EQ(FPTA_OK, fpta_name_refresh_couple(txn, &table, &pk));
+  EXPECT_EQ(FPTA_OK, fpta_upsert_column(tuple, &pk, fpta_value_uint(sequence)));
+  EXPECT_EQ(FPTA_OK, fpta_insert_row(txn, &table, fptu_take_noshrink(tuple)));
+  EXPECT_EQ(FPTA_OK, fpta_transaction_commit_async(txn, &txnid));
+  EXPECT_LT(0u, txnid);
+
+  free(tuple);
+  fpta_name_destroy(&table);
+  fpta_name_destroy(&pk);
+  return txnid;
+}
+
+struct durable_counter {
+  std::atomic<unsigned> fired, failed;
+  std::atomic<uint64_t> last;
+};
+
+static void durable_callback(fpta_db *db, uint64_t txnid, int err,
+                             void *arg) {
+  durable_counter *counter = static_cast<durable_counter *>(arg);
+  uint64_t durable = 0;
+  EXPECT_EQ(FPTA_OK, fpta_durable_txnid(db, &durable));
+  EXPECT_LE(txnid, durable);
+  if (err != FPTA_OK)
+    counter->failed += 1;
+  counter->last = txnid;
+  counter->fired += 1;
+}
+
+TEST(Threaded, AsyncCommitDurability) {
+  /* Сценарий:
+   *  - в режиме fpta_lazy фиксируем транзакции асинхронно и убеждаемся,
+   *    что их изменения еще не сохранены;
+   *  - запускаем фоновый поток с порогом по времени и дожидаемся
+   *    durability, в том числе через функторы уведомлений;
+   *  - при остановке фонового потока все уведомления должны сработать;
+   *  - без фонового потока ожидание выполняет сброс самостоятельно. */
+  const bool skipped = GTEST_IS_EXECUTION_TIMEOUT();
+  if (skipped)
+    return;
+
+  if (REMOVE_FILE(testdb_name) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+  if (REMOVE_FILE(testdb_name_lck) != 0) {
+    ASSERT_EQ(ENOENT, errno);
+  }
+
+  fpta_db *db = nullptr;
+  ASSERT_EQ(FPTA_OK, test_db_open(testdb_name, fpta_lazy, fpta_regime_default,
+                                  1, true, &db));
+  ASSERT_NE(nullptr, db);
+
+  fpta_column_set def;
+  fpta_column_set_init(&def);
+  EXPECT_EQ(FPTA_OK,
+            fpta_column_describe("pk", fptu_uint64,
+                                 fpta_primary_unique_ordered_obverse, &def));
+  fpta_txn *txn = nullptr;
+  ASSERT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_schema, &txn));
+  ASSERT_EQ(FPTA_OK, fpta_table_create(txn, "table", &def));
+  ASSERT_EQ(FPTA_OK, fpta_transaction_end(txn, false));
+  EXPECT_EQ(FPTA_OK, fpta_column_set_destroy(&def));
+
+  durable_counter counter;
+  counter.fired = counter.failed = 0;
+  counter.last = 0;
+
+  uint64_t txnid = async_commit_one(db);
+  uint64_t durable = ~0ull;
+  EXPECT_EQ(FPTA_OK, fpta_durable_txnid(db, &durable));
+  EXPECT_GT(txnid, durable);
+  EXPECT_EQ(FPTA_ETIMEDOUT, fpta_durable_wait(db, txnid, 0));
+  EXPECT_EQ(FPTA_EINVAL, fpta_durable_wait(db, txnid + 1, 0));
+  EXPECT_EQ(FPTA_EINVAL,
+            fpta_durable_notify(db, txnid, nullptr, &counter));
+
+  /* уведомление срабатывает после сброса фоновым потоком */
+  EXPECT_EQ(FPTA_EINVAL, fpta_db_flusher_start(db, 0, 0));
+  ASSERT_EQ(FPTA_OK, fpta_db_flusher_start(db, 0, 20));
+  EXPECT_EQ(FPTA_EBUSY, fpta_db_flusher_start(db, 0, 20));
+  EXPECT_EQ(FPTA_OK, fpta_durable_notify(db, txnid, durable_callback,
+                                         &counter));
+  EXPECT_EQ(FPTA_OK, fpta_durable_wait(db, txnid, 10000));
+  for (int i = 0; i < 1000 && counter.fired.load() < 1; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_EQ(1u, counter.fired.load());
+  EXPECT_EQ(txnid, counter.last.load());
+
+  /* уже сохраненные изменения: функтор вызывается сразу */
+  EXPECT_EQ(FPTA_OK, fpta_durable_notify(db, txnid, durable_callback,
+                                         &counter));
+  EXPECT_EQ(2u, counter.fired.load());
+
+  /* остановка фонового потока выполняет все уведомления */
+  for (int i = 0; i < 5; ++i)
+    EXPECT_EQ(FPTA_OK, fpta_durable_notify(db, async_commit_one(db),
+                                           durable_callback, &counter));
+  EXPECT_EQ(FPTA_OK, fpta_db_flusher_stop(db));
+  EXPECT_EQ(7u, counter.fired.load());
+  EXPECT_EQ(FPTA_OK, fpta_db_flusher_stop(db));
+
+  /* без фонового потока */
+  txnid = async_commit_one(db);
+  EXPECT_EQ(FPTA_ETIMEDOUT, fpta_durable_wait(db, txnid, 0));
+  EXPECT_EQ(FPTA_OK, fpta_durable_wait(db, txnid, 1));
+  EXPECT_EQ(FPTA_OK, fpta_durable_txnid(db, &durable));
+  EXPECT_LE(txnid, durable);
+  txnid = async_commit_one(db);
+  EXPECT_EQ(FPTA_OK, fpta_durable_notify(db, txnid, durable_callback,
+                                         &counter));
+  EXPECT_EQ(8u, counter.fired.load());
+  EXPECT_EQ(0u, counter.failed.load());
+
+  /* пустая транзакция не порождает новой версии */
+  uint64_t empty_txnid = 0;
+  EXPECT_EQ(FPTA_OK, fpta_transaction_begin(db, fpta_write, &txn));
+  EXPECT_EQ(FPTA_OK, fpta_transaction_commit_async(txn, &empty_txnid));
+  EXPECT_EQ(txnid, empty_txnid);
+
+  EXPECT_EQ(FPTA_OK, fpta_db_close(db));
+  ASSERT_TRUE(REMOVE_FILE(testdb_name) == 0);
+  ASSERT_TRUE(REMOVE_FILE(testdb_name_lck) == 0);
+}
+
+//------------------------------------------------------------------------------
+
 int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   mdbx_setup_debug(MDBX_LOG_WARN,
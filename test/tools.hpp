@@ -117,3 +117,34 @@ inline bool is_valid4secondary(fptu_type pk_type, fpta_index_type pk_index,
 
   return true;
 }
+
+//----------------------------------------------------------------------------
+
+/* кол-во строк, доступных через индекс по заданной колонке */
+inline size_t count_rows(fpta_txn *txn, fpta_name *column_id) {
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, column_id, fpta_value_begin(),
+                                      fpta_value_end(), nullptr,
+                                      fpta_unsorted_dont_fetch, &cursor));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  return count;
+}
+
+/* кол-во строк, отобранных фильтром при просмотре индекса по заданной
+ * колонке, а также кол-во обращений к строкам по PK при этом */
+inline size_t count_covered(fpta_txn *txn, fpta_name *column_id,
+                            fpta_filter *filter, size_t *pk_lookups) {
+  fpta_cursor *cursor = nullptr;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_open(txn, column_id, fpta_value_begin(),
+                                      fpta_value_end(), filter,
+                                      fpta_unsorted_dont_fetch, &cursor));
+  size_t count = 0;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_count(cursor, &count, INT_MAX));
+  fpta_cursor_stat stat;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_info(cursor, &stat));
+  *pk_lookups = stat.pk_lookups;
+  EXPECT_EQ(FPTA_OK, fpta_cursor_close(cursor));
+  return count;
+}
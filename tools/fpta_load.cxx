@@ -0,0 +1,178 @@
+/*
+ *  Fast Positive Tables (libfpta), aka Позитивные Таблицы.
+ *  Copyright 2016-2020 Leonid Yuriev <leo@yuriev.ru>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/* fpta_load - массовая загрузка строк в таблицу посредством fpta_loader.
+ *
+ * Входной поток состоит из сериализованных кортежей libfptu, каждому из
+ * которых предшествует его длина в виде 32-битного little-endian числа. */
+
+#include "fast_positive/tables.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-s spill_dir] [-m megabytes] [-k] [-q] database table "
+          "[input]\n"
+          "  -s spill_dir  directory for temporary sorted runs\n"
+          "  -m megabytes  sort memory per index (default 64)\n"
+          "  -k            keep going, skip rejected tuples\n"
+          "  -q            be quiet, don't print statistics\n"
+          "  input         file with length-prefixed tuples, "
+          "stdin by default\n",
+          prog);
+  exit(EXIT_FAILURE);
+}
+
+static bool read_tuple(FILE *input, void **buffer, size_t *capacity,
+                       fptu_ro *row) {
+  unsigned char prefix[4];
+  if (fread(prefix, sizeof(prefix), 1, input) != 1)
+    return false;
+
+  const size_t length = prefix[0] | (size_t)prefix[1] << 8 |
+                        (size_t)prefix[2] << 16 | (size_t)prefix[3] << 24;
+  if (length > fptu_max_tuple_bytes) {
+    fprintf(stderr, "fpta_load: tuple too long (%zu bytes)\n", length);
+    exit(EXIT_FAILURE);
+  }
+  if (length > *capacity) {
+    void *larger = realloc(*buffer, length);
+    if (!larger) {
+      fprintf(stderr, "fpta_load: out of memory\n");
+      exit(EXIT_FAILURE);
+    }
+    *buffer = larger;
+    *capacity = length;
+  }
+  if (length && fread(*buffer, length, 1, input) != 1) {
+    fprintf(stderr, "fpta_load: unexpected end of input\n");
+    exit(EXIT_FAILURE);
+  }
+
+  row->sys.iov_base = *buffer;
+  row->sys.iov_len = length;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  const char *spill_dir = nullptr;
+  size_t run_bytes = 0;
+  bool quiet = false, keep_going = false;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+      spill_dir = argv[++i];
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+      run_bytes = (size_t)strtoull(argv[++i], nullptr, 10) << 20;
+    else if (strcmp(argv[i], "-k") == 0)
+      keep_going = true;
+    else if (strcmp(argv[i], "-q") == 0)
+      quiet = true;
+    else
+      usage(argv[0]);
+  }
+  if (argc - i < 2 || argc - i > 3)
+    usage(argv[0]);
+
+  const char *const db_path = argv[i];
+  const char *const table_name = argv[i + 1];
+  const char *const input_path = (argc - i > 2) ? argv[i + 2] : "-";
+
+  FILE *input = stdin;
+  if (strcmp(input_path, "-") != 0) {
+    input = fopen(input_path, "rb");
+    if (!input) {
+      perror(input_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  fpta_db *db = nullptr;
+  int rc = fpta_db_open_existing(db_path, fpta_weak, fpta_regime_default,
+                                 false, &db);
+  if (rc != FPTA_SUCCESS) {
+    fprintf(stderr, "fpta_load: %s: %s\n", db_path, fpta_strerror(rc));
+    return EXIT_FAILURE;
+  }
+
+  fpta_name table;
+  rc = fpta_table_init(&table, table_name);
+  if (rc != FPTA_SUCCESS) {
+    fprintf(stderr, "fpta_load: %s: %s\n", table_name, fpta_strerror(rc));
+    fpta_db_close(db);
+    return EXIT_FAILURE;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  fpta_loader *loader = nullptr;
+  rc = fpta_loader_begin(db, &table, spill_dir, run_bytes, &loader);
+  if (rc != FPTA_SUCCESS) {
+    fprintf(stderr, "fpta_load: %s: %s\n", table_name, fpta_strerror(rc));
+    fpta_name_destroy(&table);
+    fpta_db_close(db);
+    return EXIT_FAILURE;
+  }
+
+  void *buffer = nullptr;
+  size_t capacity = 0, loaded = 0, rejected = 0;
+  bool failed = false;
+  fptu_ro row;
+  while (!failed && read_tuple(input, &buffer, &capacity, &row)) {
+    const char *trouble = fptu_check_ro(row);
+    rc = trouble ? (int)FPTA_EINVAL : fpta_loader_put(loader, row);
+    if (rc == FPTA_SUCCESS) {
+      loaded += 1;
+      continue;
+    }
+    fprintf(stderr, "fpta_load: tuple #%zu: %s\n", loaded + rejected + 1,
+            trouble ? trouble : fpta_strerror(rc));
+    rejected += 1;
+    /* после фатальной ошибки загрузчик будет возвращать её для всех
+     * последующих строк, а fpta_loader_end() отменит загрузку. */
+    failed = !keep_going;
+  }
+  free(buffer);
+  failed |= ferror(input) != 0;
+  if (input != stdin)
+    fclose(input);
+
+  rc = fpta_loader_end(loader, failed);
+  if (rc != FPTA_SUCCESS)
+    fprintf(stderr, "fpta_load: %s: %s\n", table_name, fpta_strerror(rc));
+  else if (failed)
+    fprintf(stderr, "fpta_load: aborted, nothing loaded\n");
+  else if (!quiet) {
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    printf("fpta_load: %zu rows loaded, %zu rejected, %.3f seconds\n",
+           loaded, rejected, seconds);
+  }
+
+  fpta_name_destroy(&table);
+  int err = fpta_db_close(db);
+  if (err != FPTA_SUCCESS) {
+    fprintf(stderr, "fpta_load: %s: %s\n", db_path, fpta_strerror(err));
+    rc = err;
+  }
+  return (rc == FPTA_SUCCESS && !failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}